@@ -0,0 +1,405 @@
+// Micro-benchmarks for the scanner's hot kernels on synthetic mysqldump data.
+// Each kernel is timed over repeated runs on one pinned CPU and reported in
+// ns/byte with min, median, mean and standard deviation, so a change to one
+// kernel can be measured without end-to-end noise. Not a test; build with
+//   cmake --build <dir> --target bench_kernels
+#define _GNU_SOURCE // For sched_setaffinity, fmemopen
+#include "sql_indexer.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#define DEFAULT_REPETITIONS 15
+#define DEFAULT_MIN_RUN_MS 50
+#define DUMP_BYTES (8u << 20)
+
+typedef struct {
+    const char *name;
+    const char *input;
+    size_t input_len;
+    // Runs the kernel once over the whole input; returns a value that depends
+    // on the work done so the compiler cannot drop it
+    size_t (*run)(const char *input, size_t input_len);
+} Kernel;
+
+// --- Static Helper Function Declarations ---
+static double now_ns(void);
+static int compare_doubles(const void *a, const void *b);
+static bool pin_to_cpu(int cpu);
+static unsigned int bench_rand(unsigned int *state);
+static bool append_text(char **buf, size_t *len, size_t *cap, const char *fmt, ...);
+static bool append_table_body(char **buf, size_t *len, size_t *cap);
+static bool append_row(char **buf, size_t *len, size_t *cap, unsigned int *seed, long id);
+static char *build_dump(size_t target_bytes, size_t *len);
+static char *build_table_body(size_t *len);
+static char *build_values_list(size_t *len);
+static void bench_kernel(const Kernel *kernel, int repetitions, double min_run_ns);
+static size_t run_scan(const char *input, size_t input_len, bool assume_mysqldump);
+static size_t run_scan_default(const char *input, size_t input_len);
+static size_t run_scan_mysqldump(const char *input, size_t input_len);
+static size_t run_closing_paren(const char *input, size_t input_len);
+static size_t run_parse_columns(const char *input, size_t input_len);
+static size_t run_insert_rows(const char *input, size_t input_len);
+static size_t run_sha256(const char *input, size_t input_len);
+static size_t run_count_newlines(const char *input, size_t input_len);
+
+int main(int argc, char *argv[]) {
+    int repetitions = DEFAULT_REPETITIONS;
+    int min_run_ms = DEFAULT_MIN_RUN_MS;
+    int cpu = -1;
+    const char *filter = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc) {
+            min_run_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !filter) {
+            filter = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--reps N] [--min-time-ms MS] [--cpu N] [kernel-name-filter]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (repetitions < 1) {
+        repetitions = 1;
+    }
+
+#ifdef __linux__
+    if (cpu < 0) {
+        cpu = sched_getcpu();
+    }
+#endif
+    if (pin_to_cpu(cpu)) {
+        printf("Pinned to CPU %d, %d repetitions of >= %d ms each\n", cpu, repetitions, min_run_ms);
+    } else {
+        printf("Not pinned to a CPU; %d repetitions of >= %d ms each\n", repetitions, min_run_ms);
+    }
+
+    size_t dump_len, body_len, values_len;
+    char *dump = build_dump(DUMP_BYTES, &dump_len);
+    char *body = build_table_body(&body_len);
+    char *values = build_values_list(&values_len);
+    if (!dump || !body || !values) {
+        perror("Failed to build benchmark input");
+        return 1;
+    }
+
+    const Kernel kernels[] = {
+        {"process_chunk", dump, dump_len, run_scan_default},
+        {"process_chunk/mysqldump", dump, dump_len, run_scan_mysqldump},
+        {"find_closing_paren", body, body_len, run_closing_paren},
+        {"parse_table_columns", body, body_len, run_parse_columns},
+        {"parse_insert_row", values, values_len, run_insert_rows},
+        {"sha256_update", dump, dump_len, run_sha256},
+        {"count_newlines", dump, dump_len, run_count_newlines},
+    };
+
+    mem_stats_init();
+    printf("%-26s %10s %10s %10s %10s %8s %10s %10s %10s\n", "Kernel", "Bytes", "Min", "Median", "Mean", "Stddev",
+           "MiB/s", "Allocs", "Alloc B");
+    printf("%-26s %10s %10s %10s %10s %8s %10s %10s %10s\n", "", "", "ns/B", "ns/B", "ns/B", "%", "(median)",
+           "per run", "per run");
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+        if (!filter || strstr(kernels[i].name, filter)) {
+            bench_kernel(&kernels[i], repetitions, min_run_ms * 1e6);
+        }
+    }
+
+    free(dump);
+    free(body);
+    free(values);
+    mem_stats_print(stdout);
+    return 0;
+}
+
+// --- Static Helper Function Implementations ---
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static bool pin_to_cpu(int cpu) {
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+#endif
+    (void)cpu;
+    return false;
+}
+
+// One repetition calls the kernel enough times to last min_run_ns; the
+// iteration count is calibrated once so every repetition does equal work.
+static void bench_kernel(const Kernel *kernel, int repetitions, double min_run_ns) {
+    volatile size_t sink = 0;
+    MemTotals before, after;
+    mem_stats_totals(&before);
+    double start = now_ns();
+    sink += kernel->run(kernel->input, kernel->input_len); // Warm-up, calibration and allocation count
+    double once = now_ns() - start;
+    mem_stats_totals(&after);
+    long iterations = once > 0 ? (long)ceil(min_run_ns / once) : 1;
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    double *samples = malloc((size_t)repetitions * sizeof(double));
+    if (!samples) {
+        perror("Failed to allocate benchmark samples");
+        return;
+    }
+    for (int r = 0; r < repetitions; ++r) {
+        start = now_ns();
+        for (long it = 0; it < iterations; ++it) {
+            sink += kernel->run(kernel->input, kernel->input_len);
+        }
+        samples[r] = (now_ns() - start) / ((double)iterations * (double)kernel->input_len);
+    }
+
+    double mean = 0;
+    for (int r = 0; r < repetitions; ++r) {
+        mean += samples[r];
+    }
+    mean /= repetitions;
+    double variance = 0;
+    for (int r = 0; r < repetitions; ++r) {
+        variance += (samples[r] - mean) * (samples[r] - mean);
+    }
+    double stddev = repetitions > 1 ? sqrt(variance / (repetitions - 1)) : 0;
+    qsort(samples, (size_t)repetitions, sizeof(double), compare_doubles);
+    double median = repetitions % 2 ? samples[repetitions / 2]
+                                    : (samples[repetitions / 2 - 1] + samples[repetitions / 2]) / 2;
+
+    printf("%-26s %10zu %10.3f %10.3f %10.3f %8.1f %10.1f %10llu %10llu\n", kernel->name, kernel->input_len,
+           samples[0], median, mean, mean > 0 ? 100.0 * stddev / mean : 0, 1e9 / median / (1024.0 * 1024.0),
+           after.allocations + after.reallocations - before.allocations - before.reallocations,
+           after.bytes - before.bytes);
+    free(samples);
+    (void)sink;
+}
+
+// --- Synthetic Input ---
+// Deterministic mysqldump-style text: comment headers, SET statements,
+// CREATE TABLE with keys, and extended INSERTs mixing numbers, NULLs,
+// escaped strings and hex literals.
+
+static unsigned int bench_rand(unsigned int *state) {
+    *state = *state * 1103515245u + 12345u;
+    return (*state >> 16) & 0x7fff;
+}
+
+// Appends printf output, growing the buffer. Returns false on allocation failure.
+static bool append_text(char **buf, size_t *len, size_t *cap, const char *fmt, ...) {
+    va_list args;
+    for (;;) {
+        va_start(args, fmt);
+        int n = vsnprintf(*buf + *len, *cap - *len, fmt, args);
+        va_end(args);
+        if (n < 0) {
+            return false;
+        }
+        if ((size_t)n < *cap - *len) {
+            *len += (size_t)n;
+            return true;
+        }
+        size_t new_cap = *cap * 2 + (size_t)n;
+        char *new_buf = realloc(*buf, new_cap);
+        if (!new_buf) {
+            return false;
+        }
+        *buf = new_buf;
+        *cap = new_cap;
+    }
+}
+
+static bool append_table_body(char **buf, size_t *len, size_t *cap) {
+    bool ok = append_text(buf, len, cap,
+        "\n  `id` bigint(20) unsigned NOT NULL AUTO_INCREMENT,\n"
+        "  `tenant_id` int(11) NOT NULL DEFAULT '0',\n"
+        "  `email` varchar(255) CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci NOT NULL,\n"
+        "  `display_name` varchar(100) DEFAULT NULL COMMENT 'Shown in the UI, may contain ''quotes''',\n"
+        "  `status` enum('active','disabled','pending') NOT NULL DEFAULT 'pending',\n"
+        "  `balance` decimal(12,2) NOT NULL DEFAULT '0.00',\n"
+        "  `flags` bit(8) DEFAULT b'00000000',\n"
+        "  `avatar` mediumblob,\n"
+        "  `settings` json DEFAULT NULL,\n"
+        "  `created_at` datetime NOT NULL DEFAULT CURRENT_TIMESTAMP,\n"
+        "  `updated_at` timestamp NULL DEFAULT NULL ON UPDATE CURRENT_TIMESTAMP,\n");
+    for (int i = 0; ok && i < 20; ++i) {
+        ok = append_text(buf, len, cap, "  `attr_%02d` varchar(%d) DEFAULT NULL,\n", i, 16 + i * 8);
+    }
+    return ok && append_text(buf, len, cap,
+        "  PRIMARY KEY (`id`),\n"
+        "  UNIQUE KEY `uniq_email` (`tenant_id`,`email`),\n"
+        "  KEY `idx_status` (`status`,`created_at`),\n"
+        "  CONSTRAINT `fk_tenant` FOREIGN KEY (`tenant_id`) REFERENCES `tenants` (`id`) ON DELETE CASCADE\n");
+}
+
+static bool append_row(char **buf, size_t *len, size_t *cap, unsigned int *seed, long id) {
+    return append_text(buf, len, cap,
+        "(%ld,%u,'user%ld@example.com',%s,'%s',%u.%02u,b'%u',0x%04X%04X,'{\\\"k\\\":\\\"v\\\\n%u\\\"}','2024-01-%02u 12:00:00',NULL)",
+        id, bench_rand(seed) % 100, id, bench_rand(seed) % 4 ? "'Name with \\'escape\\' and ; and )'" : "NULL",
+        bench_rand(seed) % 2 ? "active" : "pending", bench_rand(seed) % 10000, bench_rand(seed) % 100,
+        bench_rand(seed) % 2, bench_rand(seed), bench_rand(seed), bench_rand(seed), 1 + bench_rand(seed) % 28);
+}
+
+static char *build_dump(size_t target_bytes, size_t *len) {
+    size_t cap = target_bytes + 65536;
+    char *buf = malloc(cap);
+    unsigned int seed = 42;
+    long id = 1;
+    bool ok = buf != NULL;
+    *len = 0;
+    if (ok) {
+        buf[0] = '\0';
+        ok = append_text(&buf, len, &cap,
+            "-- MySQL dump 10.13  Distrib 8.0.36, for Linux (x86_64)\n--\n"
+            "/*!40101 SET @OLD_CHARACTER_SET_CLIENT=@@CHARACTER_SET_CLIENT */;\n"
+            "/*!40101 SET NAMES utf8mb4 */;\n/*!40103 SET TIME_ZONE='+00:00' */;\n");
+    }
+    for (int table = 0; ok && *len < target_bytes; ++table) {
+        ok = append_text(&buf, len, &cap,
+            "\n--\n-- Table structure for table `users_%d`\n--\n\nDROP TABLE IF EXISTS `users_%d`;\n"
+            "/*!40101 SET @saved_cs_client     = @@character_set_client */;\nCREATE TABLE `users_%d` (",
+            table, table, table) &&
+            append_table_body(&buf, len, &cap) &&
+            append_text(&buf, len, &cap, ") ENGINE=InnoDB DEFAULT CHARSET=utf8mb4;\n\nLOCK TABLES `users_%d` WRITE;\n", table);
+        // A few extended INSERTs of ~64 KiB, as mysqldump's --net-buffer-length produces
+        for (int stmt = 0; ok && stmt < 8 && *len < target_bytes; ++stmt) {
+            ok = append_text(&buf, len, &cap, "INSERT INTO `users_%d` VALUES ", table);
+            size_t stmt_start = *len;
+            while (ok && *len - stmt_start < 65536) {
+                ok = append_row(&buf, len, &cap, &seed, id++) && append_text(&buf, len, &cap, ",");
+            }
+            if (ok) {
+                buf[*len - 1] = ';';
+                ok = append_text(&buf, len, &cap, "\n");
+            }
+        }
+        ok = ok && append_text(&buf, len, &cap, "UNLOCK TABLES;\n");
+    }
+    if (!ok) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static char *build_table_body(size_t *len) {
+    size_t cap = 4096;
+    char *buf = malloc(cap);
+    *len = 0;
+    if (!buf || !append_table_body(&buf, len, &cap)) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static char *build_values_list(size_t *len) {
+    size_t cap = 1 << 20;
+    char *buf = malloc(cap);
+    unsigned int seed = 7;
+    bool ok = buf != NULL;
+    *len = 0;
+    for (long id = 1; ok && id <= 2000; ++id) {
+        ok = append_row(&buf, len, &cap, &seed, id) && append_text(&buf, len, &cap, id < 2000 ? "," : ";");
+    }
+    if (!ok) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+// --- Kernels ---
+
+// The whole chunk loop over an in-memory stream; fread from fmemopen is a memcpy
+static size_t run_scan(const char *input, size_t input_len, bool assume_mysqldump) {
+    FILE *stream = fmemopen((void *)input, input_len, "rb");
+    ParsingContext ctx = {0};
+    if (!stream || !initialize_context_stream(&ctx, stream)) {
+        perror("Failed to open benchmark stream");
+        exit(1);
+    }
+    ctx.assume_mysqldump = assume_mysqldump;
+    process_sql_file(&ctx);
+    size_t result = (size_t)ctx.index.count + (size_t)ctx.current_line;
+    cleanup_context(&ctx);
+    return result;
+}
+
+static size_t run_scan_default(const char *input, size_t input_len) {
+    return run_scan(input, input_len, false);
+}
+
+static size_t run_scan_mysqldump(const char *input, size_t input_len) {
+    return run_scan(input, input_len, true);
+}
+
+static size_t run_closing_paren(const char *input, size_t input_len) {
+    // The body has no enclosing parentheses, so this scans all of it
+    const char *close = sql_find_closing_paren(input, input + input_len);
+    return close ? (size_t)(close - input) : input_len;
+}
+
+static size_t run_parse_columns(const char *input, size_t input_len) {
+    TableInfo table_info = {0};
+    table_info.schema_id = -1;
+    parse_table_columns(NULL, &table_info, input, input + input_len);
+    size_t result = (size_t)table_info.column_count + (size_t)table_info.key_count;
+    free_table_definition(&table_info);
+    return result;
+}
+
+static size_t run_insert_rows(const char *input, size_t input_len) {
+    const char *p = input;
+    const char *end = input + input_len;
+    SqlRow row = {0};
+    size_t values = 0;
+    while (p < end && *p == '(') {
+        const char *row_end;
+        if (parse_insert_row(p, end, &row, &row_end) != ROW_COMPLETE) {
+            break;
+        }
+        values += (size_t)row.count;
+        p = row_end + 1; // Skip ',' or ';'
+    }
+    cleanup_sql_row(&row);
+    return values;
+}
+
+static size_t run_sha256(const char *input, size_t input_len) {
+    SHA256_CTX ctx;
+    BYTE hash[SHA256_BLOCK_SIZE];
+    sha256_init(&ctx);
+    sha256_update(&ctx, (const BYTE *)input, input_len);
+    sha256_final(&ctx, hash);
+    return hash[0];
+}
+
+static size_t run_count_newlines(const char *input, size_t input_len) {
+    const char *last = NULL;
+    return sql_count_newlines(input, input + input_len, &last);
+}
@@ -0,0 +1,199 @@
+#include "column_type.h"
+#include "sql_tokenizer.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Type Name Table ---
+typedef struct {
+    const char *name;
+    TypeClass type_class;
+    int storage_bytes;
+} TypeNameEntry;
+
+static const TypeNameEntry TYPE_NAMES[] = {
+    {"TINYINT", TYPE_CLASS_INTEGER, 1},
+    {"BOOL", TYPE_CLASS_INTEGER, 1},
+    {"BOOLEAN", TYPE_CLASS_INTEGER, 1},
+    {"SMALLINT", TYPE_CLASS_INTEGER, 2},
+    {"MEDIUMINT", TYPE_CLASS_INTEGER, 3},
+    {"INT", TYPE_CLASS_INTEGER, 4},
+    {"INTEGER", TYPE_CLASS_INTEGER, 4},
+    {"BIGINT", TYPE_CLASS_INTEGER, 8},
+    {"SERIAL", TYPE_CLASS_INTEGER, 8},
+    {"DECIMAL", TYPE_CLASS_DECIMAL, 0},
+    {"DEC", TYPE_CLASS_DECIMAL, 0},
+    {"NUMERIC", TYPE_CLASS_DECIMAL, 0},
+    {"FIXED", TYPE_CLASS_DECIMAL, 0},
+    {"FLOAT", TYPE_CLASS_FLOAT, 4},
+    {"DOUBLE", TYPE_CLASS_FLOAT, 8},
+    {"REAL", TYPE_CLASS_FLOAT, 8},
+    {"BIT", TYPE_CLASS_BIT, 0},
+    {"CHAR", TYPE_CLASS_CHAR, 0},
+    {"NCHAR", TYPE_CLASS_CHAR, 0},
+    {"VARCHAR", TYPE_CLASS_CHAR, 0},
+    {"NVARCHAR", TYPE_CLASS_CHAR, 0},
+    {"BINARY", TYPE_CLASS_BINARY, 0},
+    {"VARBINARY", TYPE_CLASS_BINARY, 0},
+    {"TINYTEXT", TYPE_CLASS_TEXT, 1},
+    {"TEXT", TYPE_CLASS_TEXT, 2},
+    {"MEDIUMTEXT", TYPE_CLASS_TEXT, 3},
+    {"LONGTEXT", TYPE_CLASS_TEXT, 4},
+    {"TINYBLOB", TYPE_CLASS_BLOB, 1},
+    {"BLOB", TYPE_CLASS_BLOB, 2},
+    {"MEDIUMBLOB", TYPE_CLASS_BLOB, 3},
+    {"LONGBLOB", TYPE_CLASS_BLOB, 4},
+    {"ENUM", TYPE_CLASS_ENUM, 0},
+    {"SET", TYPE_CLASS_SET, 0},
+    {"DATE", TYPE_CLASS_DATE, 0},
+    {"TIME", TYPE_CLASS_TIME, 0},
+    {"DATETIME", TYPE_CLASS_DATETIME, 0},
+    {"TIMESTAMP", TYPE_CLASS_TIMESTAMP, 0},
+    {"YEAR", TYPE_CLASS_YEAR, 0},
+    {"JSON", TYPE_CLASS_JSON, 0},
+    {"GEOMETRY", TYPE_CLASS_GEOMETRY, 0},
+    {"POINT", TYPE_CLASS_GEOMETRY, 0},
+    {"LINESTRING", TYPE_CLASS_GEOMETRY, 0},
+    {"POLYGON", TYPE_CLASS_GEOMETRY, 0},
+    {"MULTIPOINT", TYPE_CLASS_GEOMETRY, 0},
+    {"MULTILINESTRING", TYPE_CLASS_GEOMETRY, 0},
+    {"MULTIPOLYGON", TYPE_CLASS_GEOMETRY, 0},
+    {"GEOMETRYCOLLECTION", TYPE_CLASS_GEOMETRY, 0},
+};
+
+static const char *const TYPE_CLASS_NAMES[] = {
+    "UNKNOWN", "INTEGER", "DECIMAL", "FLOAT", "BIT", "CHAR", "BINARY", "TEXT",
+    "BLOB", "ENUM", "SET", "DATE", "TIME", "DATETIME", "TIMESTAMP", "YEAR",
+    "JSON", "GEOMETRY"
+};
+
+// --- Static Helper Function Declarations ---
+static bool parse_type_arguments(SqlTokenizer *tz, ColumnTypeDesc *desc);
+static bool append_enum_value(ColumnTypeDesc *desc, StrSpan literal);
+
+// --- Function Implementations ---
+
+bool parse_column_type(const char *type, ColumnTypeDesc *desc) {
+    SqlTokenizer tz;
+    SqlToken tok;
+
+    desc->type_class = TYPE_CLASS_UNKNOWN;
+    desc->storage_bytes = 0;
+    desc->length = -1;
+    desc->precision = -1;
+    desc->scale = -1;
+    desc->is_unsigned = false;
+    desc->is_zerofill = false;
+    desc->enum_values = NULL;
+    desc->enum_value_count = 0;
+
+    sql_tokenizer_init(&tz, type, type + strlen(type));
+    if (!sql_next_token(&tz, &tok) || tok.type != SQL_TOK_WORD) {
+        return true;
+    }
+
+    for (size_t i = 0; i < sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]); i++) {
+        if (sql_span_equals_ci(tok.text, TYPE_NAMES[i].name)) {
+            desc->type_class = TYPE_NAMES[i].type_class;
+            desc->storage_bytes = TYPE_NAMES[i].storage_bytes;
+            break;
+        }
+    }
+    if (sql_token_is_word(&tok, "BOOL") || sql_token_is_word(&tok, "BOOLEAN")) {
+        desc->length = 1;
+    } else if (sql_token_is_word(&tok, "SERIAL")) {
+        desc->is_unsigned = true; // BIGINT UNSIGNED NOT NULL AUTO_INCREMENT UNIQUE
+    }
+
+    while (sql_next_token(&tz, &tok)) {
+        if (tok.type == SQL_TOK_LPAREN) {
+            if (!parse_type_arguments(&tz, desc)) {
+                cleanup_column_type(desc);
+                return false;
+            }
+        } else if (sql_token_is_word(&tok, "UNSIGNED")) {
+            desc->is_unsigned = true;
+        } else if (sql_token_is_word(&tok, "ZEROFILL")) {
+            desc->is_zerofill = true;
+            desc->is_unsigned = true; // ZEROFILL implies UNSIGNED
+        }
+        // Anything else (e.g. DOUBLE PRECISION) carries no extra information
+    }
+    return true;
+}
+
+void cleanup_column_type(ColumnTypeDesc *desc) {
+    free(desc->charset);
+    free(desc->collation);
+    for (int i = 0; i < desc->enum_value_count; i++) {
+        free(desc->enum_values[i]);
+    }
+    free(desc->enum_values);
+    desc->charset = NULL;
+    desc->collation = NULL;
+    desc->enum_values = NULL;
+    desc->enum_value_count = 0;
+}
+
+const char *type_class_to_string(TypeClass type_class) {
+    return TYPE_CLASS_NAMES[type_class];
+}
+
+bool type_class_from_string(const char *str, TypeClass *type_class) {
+    for (size_t i = 0; i < sizeof(TYPE_CLASS_NAMES) / sizeof(TYPE_CLASS_NAMES[0]); i++) {
+        if (strcmp(str, TYPE_CLASS_NAMES[i]) == 0) {
+            *type_class = (TypeClass)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- Static Helper Function Implementations ---
+
+// Parses the (...) argument list after its '(' was consumed: string members
+// for ENUM/SET, precision and scale for DECIMAL/FLOAT, a length otherwise.
+static bool parse_type_arguments(SqlTokenizer *tz, ColumnTypeDesc *desc) {
+    SqlToken tok;
+    int numbers[2] = {-1, -1};
+    int number_count = 0;
+
+    while (sql_next_token(tz, &tok) && tok.type != SQL_TOK_RPAREN) {
+        if (tok.type == SQL_TOK_STRING) {
+            if (!append_enum_value(desc, tok.text)) return false;
+        } else if (tok.type == SQL_TOK_WORD && number_count < 2) {
+            numbers[number_count++] = (int)strtol(tok.text.ptr, NULL, 10);
+        }
+    }
+
+    if (desc->type_class == TYPE_CLASS_DECIMAL || desc->type_class == TYPE_CLASS_FLOAT) {
+        desc->precision = numbers[0];
+        desc->scale = numbers[1];
+    } else if (number_count > 0) {
+        desc->length = numbers[0];
+    }
+    return true;
+}
+
+// Appends an unquoted member; the array doubles whenever the count reaches a power of two.
+static bool append_enum_value(ColumnTypeDesc *desc, StrSpan literal) {
+    int count = desc->enum_value_count;
+    if (count == 0 || (count >= 4 && (count & (count - 1)) == 0)) {
+        int new_capacity = count == 0 ? 4 : count * 2;
+        char **new_values = mem_realloc(MEM_COLUMNS, desc->enum_values, new_capacity * sizeof(char *));
+        if (!new_values) {
+            perror("Failed to allocate memory for enum values");
+            return false;
+        }
+        desc->enum_values = new_values;
+    }
+    char **new_values = desc->enum_values;
+    new_values[desc->enum_value_count] = sql_unquote_string(literal);
+    if (!new_values[desc->enum_value_count]) {
+        perror("Failed to duplicate enum value");
+        return false;
+    }
+    desc->enum_value_count++;
+    return true;
+}
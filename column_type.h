@@ -0,0 +1,59 @@
+#ifndef COLUMN_TYPE_H
+#define COLUMN_TYPE_H
+
+#include <stdbool.h>
+
+// --- Type Class Enum ---
+// Broad family of a column type; decoders and exporters switch on this once
+// per column instead of re-parsing the type string for every value.
+typedef enum {
+    TYPE_CLASS_UNKNOWN,
+    TYPE_CLASS_INTEGER,     // TINYINT .. BIGINT, BOOL, SERIAL
+    TYPE_CLASS_DECIMAL,     // DECIMAL, NUMERIC
+    TYPE_CLASS_FLOAT,       // FLOAT, DOUBLE, REAL
+    TYPE_CLASS_BIT,
+    TYPE_CLASS_CHAR,        // CHAR, VARCHAR
+    TYPE_CLASS_BINARY,      // BINARY, VARBINARY
+    TYPE_CLASS_TEXT,        // TINYTEXT .. LONGTEXT
+    TYPE_CLASS_BLOB,        // TINYBLOB .. LONGBLOB
+    TYPE_CLASS_ENUM,
+    TYPE_CLASS_SET,
+    TYPE_CLASS_DATE,
+    TYPE_CLASS_TIME,
+    TYPE_CLASS_DATETIME,
+    TYPE_CLASS_TIMESTAMP,
+    TYPE_CLASS_YEAR,
+    TYPE_CLASS_JSON,
+    TYPE_CLASS_GEOMETRY     // GEOMETRY, POINT, POLYGON, ...
+} TypeClass;
+
+// --- Column Type Descriptor ---
+typedef struct {
+    TypeClass type_class;
+    int storage_bytes;      // Integer width (1,2,3,4,8) or TEXT/BLOB length-prefix width (1-4); 0 otherwise
+    int length;             // Declared M: chars, bytes, bits, display width or fractional seconds; -1 if absent
+    int precision;          // DECIMAL/FLOAT precision; -1 if absent
+    int scale;              // DECIMAL/FLOAT scale; -1 if absent
+    bool is_unsigned;
+    bool is_zerofill;
+    char *charset;          // Column-level CHARACTER SET; NULL if inherited from the table
+    char *collation;        // Column-level COLLATE; NULL if inherited from the table
+    char **enum_values;     // ENUM/SET members, unquoted, in declaration order
+    int enum_value_count;
+} ColumnTypeDesc;
+
+// --- Function Declarations ---
+
+// Fills desc from a type string such as "decimal(10,2) unsigned" or
+// "enum('a','b')". charset and collation are left untouched.
+// Returns false only on allocation failure; unknown types get TYPE_CLASS_UNKNOWN.
+bool parse_column_type(const char *type, ColumnTypeDesc *desc);
+
+// Frees the strings owned by the descriptor.
+void cleanup_column_type(ColumnTypeDesc *desc);
+
+// Conversion between type classes and their index file names, e.g. "DECIMAL"
+const char *type_class_to_string(TypeClass type_class);
+bool type_class_from_string(const char *str, TypeClass *type_class);
+
+#endif // COLUMN_TYPE_H
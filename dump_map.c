@@ -0,0 +1,250 @@
+#define _GNU_SOURCE // For copy_file_range, splice
+#include "dump_map.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DUMP_COPY_CHUNK (16 * 1024 * 1024)   // Largest single copy by a writer
+
+// --- Static Helper Function Declarations ---
+static bool map_anonymous(DumpMap *map, const char *sql_filename, const SqlIndex *index);
+static bool copy_range(DumpWriter *w, off_t start, off_t end);
+static bool write_all(int fd, const char *data, size_t len);
+
+// --- Function Implementations ---
+
+bool dump_map_open(DumpMap *map, const char *sql_filename, const SqlIndex *index) {
+    memset(map, 0, sizeof(*map));
+    map->fd = -1;
+    if (index->gzip.span > 0 || index->parts.count > 0 || is_sql_archive(sql_filename)) {
+        return map_anonymous(map, sql_filename, index);
+    }
+    map->fd = open(sql_filename, O_RDONLY);
+    if (map->fd < 0) {
+        fprintf(stderr, "Error opening file '%s': %s\n", sql_filename, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(map->fd, &st) != 0) {
+        perror("Error reading SQL file size");
+        return false;
+    }
+    map->size = st.st_size;
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, map->fd, 0);
+        if (data == MAP_FAILED) {
+            perror("Error mapping SQL file");
+            return false;
+        }
+        map->data = data;
+    }
+    return true;
+}
+
+bool dump_map_fill(DumpMap *map, off_t start, off_t end) {
+    if (end <= start) {
+        return true;
+    }
+    char *dst = (char *)map->data + start;
+    if (map->from_archive) {
+        return archive_read(&map->archive, start, dst, (size_t)(end - start));
+    }
+    if (map->gzip) {
+        return gzip_read(map->sql_filename, map->gzip, start, dst, (size_t)(end - start));
+    }
+    if (map->parts) {
+        return read_input_parts(map->parts, start, dst, (size_t)(end - start));
+    }
+    return true;
+}
+
+void dump_map_release(DumpMap *map, off_t start, off_t end) {
+    if (map->fd >= 0 || end <= start) {
+        return;
+    }
+    // Only whole pages inside the range; neighbours may still be in use
+    long page = sysconf(_SC_PAGESIZE);
+    off_t first = (start + page - 1) / page * page;
+    off_t last = end / page * page;
+    if (last > first) {
+        madvise((char *)map->data + first, (size_t)(last - first), MADV_DONTNEED);
+    }
+}
+
+void dump_map_close(DumpMap *map) {
+    if (map->data) {
+        munmap((void *)map->data, (size_t)map->size);
+    }
+    if (map->fd >= 0) {
+        close(map->fd);
+    }
+    if (map->from_archive) {
+        archive_close(&map->archive);
+    }
+    memset(map, 0, sizeof(*map));
+    map->fd = -1;
+}
+
+void dump_writer_init(DumpWriter *w, DumpMap *map, int fd, bool to_pipe) {
+    memset(w, 0, sizeof(*w));
+    w->map = map;
+    w->fd = fd;
+    w->to_pipe = to_pipe;
+    w->zero_copy = true;
+    w->ok = true;
+}
+
+void dump_writer_range(DumpWriter *w, off_t start, off_t end) {
+    if (end <= start) return;
+    if (w->pending_end == start && w->pending_end > w->pending_start) {
+        w->pending_end = end;
+        return;
+    }
+    dump_writer_flush(w);
+    w->pending_start = start;
+    w->pending_end = end;
+}
+
+void dump_writer_text(DumpWriter *w, const char *text, size_t len) {
+    dump_writer_flush(w);
+    if (w->ok) {
+        w->ok = write_all(w->fd, text, len);
+        w->bytes += len;
+    }
+}
+
+void dump_writer_file(DumpWriter *w, int fd, off_t size) {
+    dump_writer_flush(w);
+    off_t offset = 0;
+    while (w->ok && offset < size && w->zero_copy && !w->to_pipe) {
+        size_t len = size - offset < DUMP_COPY_CHUNK ? (size_t)(size - offset) : DUMP_COPY_CHUNK;
+        loff_t in_offset = offset;
+        ssize_t n = copy_file_range(fd, &in_offset, w->fd, NULL, len, 0);
+        if (n > 0) {
+            offset += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            DEBUG_PRINT("Kernel copy refused (%s); copying through user space.", strerror(errno));
+            w->zero_copy = false;
+        } else {
+            perror(n < 0 ? "Error copying file" : "Error copying file: unexpected end of file");
+            w->ok = false;
+        }
+    }
+    char buffer[64 * 1024];
+    while (w->ok && offset < size) {
+        size_t len = size - offset < (off_t)sizeof(buffer) ? (size_t)(size - offset) : sizeof(buffer);
+        ssize_t n = pread(fd, buffer, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror(n < 0 ? "Error copying file" : "Error copying file: unexpected end of file");
+            w->ok = false;
+            break;
+        }
+        w->ok = write_all(w->fd, buffer, (size_t)n);
+        offset += n;
+    }
+    w->bytes += (uint64_t)offset;
+}
+
+void dump_writer_flush(DumpWriter *w) {
+    if (w->pending_end > w->pending_start && w->ok) {
+        w->ok = copy_range(w, w->pending_start, w->pending_end);
+        w->bytes += (uint64_t)(w->pending_end - w->pending_start);
+    }
+    w->pending_start = w->pending_end = 0;
+}
+
+// --- Static Helper Function Implementations ---
+
+static bool map_anonymous(DumpMap *map, const char *sql_filename, const SqlIndex *index) {
+    if (index->parts.count > 0) {
+        map->parts = &index->parts;
+        map->size = input_parts_size(&index->parts);
+    } else if (index->gzip.span > 0) {
+        if (index->gzip.raw_size < 0) {
+            fprintf(stderr, "Error: The index of '%s' lacks its decompressed size; delete it to re-scan.\n",
+                    sql_filename);
+            return false;
+        }
+        map->gzip = &index->gzip;
+        map->sql_filename = sql_filename;
+        map->size = index->gzip.raw_size;
+    } else {
+        if (!archive_open(&map->archive, sql_filename)) {
+            return false;
+        }
+        map->from_archive = true;
+        map->size = map->archive.raw_size;
+    }
+    if (map->size > 0) {
+        void *data = mmap(NULL, (size_t)map->size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (data == MAP_FAILED) {
+            perror("Error mapping decompressed dump");
+            return false;
+        }
+        map->data = data;
+    }
+    return true;
+}
+
+// Copies dump bytes [start, end) to the writer's file, inside the kernel
+// when the dump is a plain file, else through the mapping one chunk at a time
+static bool copy_range(DumpWriter *w, off_t start, off_t end) {
+    DumpMap *map = w->map;
+    off_t offset = start;
+    if (map->fd >= 0 && w->zero_copy) {
+        while (offset < end) {
+            size_t len = end - offset < DUMP_COPY_CHUNK ? (size_t)(end - offset) : DUMP_COPY_CHUNK;
+            loff_t in_offset = offset;
+            ssize_t n = w->to_pipe ? splice(map->fd, &in_offset, w->fd, NULL, len, SPLICE_F_MORE)
+                                   : copy_file_range(map->fd, &in_offset, w->fd, NULL, len, 0);
+            if (n > 0) {
+                offset += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+                DEBUG_PRINT("Kernel copy refused (%s); copying through user space.", strerror(errno));
+                w->zero_copy = false;
+                break;
+            } else {
+                perror(n < 0 ? "Error copying dump data" : "Error copying dump data: unexpected end of file");
+                return false;
+            }
+        }
+    }
+    while (offset < end) {
+        off_t chunk_end = end - offset > DUMP_COPY_CHUNK ? offset + DUMP_COPY_CHUNK : end;
+        if (!w->shared && !dump_map_fill(map, offset, chunk_end)) {
+            return false;
+        }
+        if (!write_all(w->fd, map->data + offset, (size_t)(chunk_end - offset))) {
+            return false;
+        }
+        if (!w->shared) {
+            dump_map_release(map, offset, chunk_end);
+        }
+        offset = chunk_end;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            perror("Error writing dump data");
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
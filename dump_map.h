@@ -0,0 +1,71 @@
+#ifndef DUMP_MAP_H
+#define DUMP_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h> // For off_t
+#include "sql_indexer.h"
+#include "sql_archive.h"
+
+// --- Mapped Dumps ---
+// The whole dump as one read-only byte range. A plain SQL file is mapped
+// directly. An archive, a .sql.gz or a multi-part dump gets an anonymous
+// mapping of the dump's size that callers fill range by range, so only the
+// ranges they use are decompressed (or copied) and take memory.
+
+typedef struct {
+    const char *data;           // The whole dump
+    off_t size;
+    int fd;                     // The plain SQL file, for zero-copy reads; -1 otherwise
+    SqlArchive archive;         // Source of `data` when reading a packed archive
+    bool from_archive;
+    const GzipAccessIndex *gzip; // Source of `data` when reading a .sql.gz, else NULL
+    const InputParts *parts;    // Source of `data` when reading a multi-part dump, else NULL
+    const char *sql_filename;
+} DumpMap;
+
+// Writes dump ranges to a file descriptor, coalescing adjacent ones into
+// one copy. Ranges of a plain SQL file are copied without passing through
+// user space (copy_file_range, or splice into a pipe); others go through
+// the mapping, filled and released chunk by chunk unless `shared` is set.
+typedef struct {
+    DumpMap *map;
+    int fd;
+    bool to_pipe;               // fd is a FIFO: splice instead of copy_file_range
+    bool zero_copy;             // Cleared once the kernel refuses to copy between the files
+    bool shared;                // Ranges may be in use by other writers; don't fill or release them
+    off_t pending_start;
+    off_t pending_end;
+    uint64_t bytes;
+    bool ok;                    // Cleared on the first error; later writes are dropped
+} DumpWriter;
+
+// --- Function Declarations ---
+
+bool dump_map_open(DumpMap *map, const char *sql_filename, const SqlIndex *index);
+
+// Makes [start, end) of `data` valid. A no-op for plain files. Safe to
+// call from several threads for disjoint ranges.
+bool dump_map_fill(DumpMap *map, off_t start, off_t end);
+
+// Gives back the memory of a filled range that is no longer needed
+void dump_map_release(DumpMap *map, off_t start, off_t end);
+
+void dump_map_close(DumpMap *map);
+
+void dump_writer_init(DumpWriter *w, DumpMap *map, int fd, bool to_pipe);
+
+// Queues dump bytes [start, end) after whatever was written before
+void dump_writer_range(DumpWriter *w, off_t start, off_t end);
+
+// Writes bytes that are not in the dump
+void dump_writer_text(DumpWriter *w, const char *text, size_t len);
+
+// Writes the first `size` bytes of another file (fd's offset is unused)
+void dump_writer_file(DumpWriter *w, int fd, off_t size);
+
+// Copies the queued range. Check w->ok afterwards.
+void dump_writer_flush(DumpWriter *w);
+
+#endif // DUMP_MAP_H
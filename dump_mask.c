@@ -0,0 +1,804 @@
+#define _GNU_SOURCE // For fmemopen
+#include "dump_mask.h"
+#include "dump_map.h"
+#include "dump_regions.h"
+#include "sql_archive.h"
+#include "insert_parser.h"
+#include "sha256.h"
+#include "work_pool.h"
+#include "mem_stats.h"
+#include <cjson/cJSON.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // For strcasecmp
+#include <stddef.h> // For offsetof
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h> // For PRIu64
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MASK_OUTPUT_BUFFER (1024 * 1024)
+#define MASK_HASH_HEX (2 * SHA256_BLOCK_SIZE)
+// Hex digits of a key string's hash: 128 bits, so that hashes of distinct
+// keys do not collide in practice
+#define MASK_KEY_HASH_HEX 32
+
+typedef enum {
+    MASK_HASH,
+    MASK_FAKE,
+    MASK_NULL,
+    MASK_TRUNCATE
+} MaskMethod;
+
+typedef struct {
+    char *column;
+    MaskMethod method;
+    int length;                 // Characters kept, or of the hash; -1 for the column's length
+} MaskRule;
+
+typedef struct {
+    char *table;                // "t", "db.t" or "*"
+    MaskRule *rules;
+    int rule_count;
+    bool used;
+} MaskTableRules;
+
+typedef struct {
+    char *salt;
+    MaskTableRules *tables;
+    int table_count;
+} MaskRules;
+
+// Bytes drawn from the salted SHA256 of a value, rehashed as they run out
+typedef struct {
+    BYTE block[SHA256_BLOCK_SIZE];
+    int used;
+} MaskRandom;
+
+struct MaskJob;
+
+// The data of one table with rules, rewritten by a worker into a temporary file
+typedef struct {
+    struct MaskJob *job;
+    const DumpRegion *region;   // NULL if the region is copied as it is
+    const TableInfo *table_info; // Same table, with its columns loaded
+    const MaskRule **column_rules; // Per column; NULL leaves it alone
+    FILE *out;                  // The temporary file
+    off_t size;
+    off_t cursor;               // Dump bytes before this have been written
+    int *value_map;             // Column of each value of the current INSERT, or -1
+    int value_count;
+    int value_capacity;
+    char *text;                 // A masked value being encoded
+    size_t text_capacity;
+    uint64_t masked;            // Values rewritten
+    bool ok;
+} MaskTable;
+
+typedef struct MaskJob {
+    SqlIndex *index;
+    const char *sql_filename;
+    const MaskOptions *options;
+    MaskRules rules;
+    DumpMap dump;
+    DumpRegions regions;
+    MaskTable *tables;          // Per region
+} MaskJob;
+
+// --- Static Helper Function Declarations ---
+static bool load_rules(MaskRules *rules, const char *filename);
+static bool parse_table_rules(MaskTableRules *table, const cJSON *columns, const char *filename);
+static void cleanup_rules(MaskRules *rules);
+static bool resolve_table(MaskJob *job, MaskTable *table, const char *database);
+static bool apply_rules(MaskTableRules *rules, const TableInfo *table_info, const MaskRule **column_rules,
+                        bool warn);
+static bool is_key_column(const TableInfo *table_info, const char *column);
+static void mask_table_task(void *arg);
+static bool mask_table(MaskTable *table);
+static bool mask_row(void *data, const InsertState *insert, const SqlRow *row);
+static bool begin_insert(MaskTable *table, const InsertState *insert);
+static bool copy_through(MaskTable *table, off_t to);
+static bool write_masked(MaskTable *table, const MaskRule *rule, const ColumnInfo *column, const SqlValue *value);
+static size_t encode_hash(char *dst, const MaskRandom *random, char quote, int length);
+static size_t encode_fake_string(char *dst, MaskRandom *random, const char *p, const char *end);
+static size_t encode_truncated(char *dst, const char *p, const char *end, int length);
+static size_t encode_fake_digits(char *dst, MaskRandom *random, const char *p, const char *end, bool hex);
+static size_t encode_permuted(char *dst, const char *salt, const char *p, const char *end, const ColumnInfo *column);
+static uint64_t permute_below(const BYTE key[SHA256_BLOCK_SIZE], uint64_t x, uint64_t count);
+static void seed_random(MaskRandom *random, const char *salt, const char *text, size_t len);
+static unsigned next_random(MaskRandom *random);
+static int column_length(const ColumnInfo *column);
+
+// --- Function Implementations ---
+
+bool mask_dump(SqlIndex *index, const char *sql_filename, const MaskOptions *options) {
+    if (same_file(sql_filename, options->output_filename)) {
+        fprintf(stderr, "Error: The masked dump must not overwrite '%s'.\n", sql_filename);
+        return false;
+    }
+    MaskJob job = {0};
+    job.index = index;
+    job.sql_filename = sql_filename;
+    job.options = options;
+    if (!load_rules(&job.rules, options->rules_filename)) {
+        cleanup_rules(&job.rules);
+        return false;
+    }
+    if (!job.rules.salt || !job.rules.salt[0]) {
+        fprintf(stderr, "Warning: No \"salt\" in '%s'; hashed values of few possibilities can be guessed back.\n",
+                options->rules_filename);
+    }
+
+    bool ok = dump_map_open(&job.dump, sql_filename, index) && init_dump_regions(&job.regions, index, &job.dump) &&
+              classify_dump_regions(&job.regions, options->threads) && check_region_data(&job.regions);
+    DumpRegions *regions = &job.regions;
+    job.tables = ok ? mem_calloc(MEM_EXPORT, (size_t)regions->count, sizeof(MaskTable)) : NULL;
+    MaskTable **order = ok ? mem_malloc(MEM_EXPORT, (size_t)regions->count * sizeof(MaskTable *)) : NULL;
+    if (ok && (!job.tables || !order)) {
+        perror("Failed to allocate masked tables");
+        ok = false;
+    }
+
+    // The tables with rules and data, with their columns
+    int count = 0;
+    for (int i = 1; ok && i < regions->count; ++i) {
+        const DumpRegion *region = &regions->regions[i];
+        if (region->data_start < 0) continue;
+        char *database = region->use ? segment_name(&job.dump, region->use) : NULL;
+        MaskTable *table = &job.tables[i];
+        table->job = &job;
+        table->region = region;
+        ok = resolve_table(&job, table, database);
+        free(database);
+        if (ok && table->region) {
+            order[count++] = table;
+        }
+    }
+    for (int i = 0; ok && i < job.rules.table_count; ++i) {
+        if (!job.rules.tables[i].used && strcmp(job.rules.tables[i].table, "*") != 0) {
+            fprintf(stderr, "Warning: No data of table '%s' in the dump to mask.\n", job.rules.tables[i].table);
+        }
+    }
+
+    // Masked tables are rewritten in parallel, largest submitted last
+    if (ok && count > 0) {
+        WorkPool pool;
+        if (work_pool_start(&pool, options->threads > 0 ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN))) {
+            sort_by_data_size(order, count, offsetof(MaskTable, region));
+            for (int i = 0; i < count; ++i) {
+                if (!work_pool_submit(&pool, mask_table_task, order[i])) {
+                    order[i]->ok = false;
+                }
+            }
+            work_pool_stop(&pool);
+            for (int i = 0; i < count; ++i) {
+                ok = ok && order[i]->ok;
+            }
+        } else {
+            ok = false;
+        }
+    }
+
+    // Everything else is copied around them in dump order
+    int fd = ok ? open(options->output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666) : -1;
+    if (ok && fd < 0) {
+        fprintf(stderr, "Error opening '%s' for writing: %s\n", options->output_filename, strerror(errno));
+        ok = false;
+    }
+    uint64_t masked = 0;
+    if (ok) {
+        DumpWriter w;
+        dump_writer_init(&w, &job.dump, fd, false);
+        for (int i = 0; i < regions->count && w.ok; ++i) {
+            const DumpRegion *region = &regions->regions[i];
+            const MaskTable *table = &job.tables[i];
+            if (!table->region) {
+                dump_writer_range(&w, region->start, region->end);
+                continue;
+            }
+            dump_writer_range(&w, region->start, region->data_start);
+            dump_writer_file(&w, fileno(table->out), table->size);
+            dump_writer_range(&w, region->data_end, region->end);
+            masked += table->masked;
+        }
+        dump_writer_flush(&w);
+        ok = w.ok;
+        if (close(fd) != 0 && ok) {
+            fprintf(stderr, "Error writing '%s': %s\n", options->output_filename, strerror(errno));
+            ok = false;
+        }
+    }
+    if (ok) {
+        printf("Masked %" PRIu64 " values in %d tables into '%s'.\n", masked, count, options->output_filename);
+    }
+
+    for (int i = 0; job.tables && i < regions->count; ++i) {
+        MaskTable *table = &job.tables[i];
+        if (table->out) fclose(table->out);
+        free(table->column_rules);
+        free(table->value_map);
+        free(table->text);
+    }
+    free(job.tables);
+    free(order);
+    cleanup_dump_regions(regions);
+    dump_map_close(&job.dump);
+    cleanup_rules(&job.rules);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+static bool load_rules(MaskRules *rules, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error opening rules file '%s': %s\n", filename, strerror(errno));
+        return false;
+    }
+    char *text = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        text = mem_malloc(MEM_OTHER, (size_t)size + 1);
+    }
+    bool ok = text && fread(text, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Error reading rules file '%s'.\n", filename);
+        free(text);
+        return false;
+    }
+    text[size] = '\0';
+    cJSON *root = cJSON_Parse(text);
+    free(text);
+
+    const cJSON *salt = cJSON_GetObjectItemCaseSensitive(root, "salt");
+    const cJSON *tables = cJSON_GetObjectItemCaseSensitive(root, "tables");
+    if (!cJSON_IsObject(root) || !cJSON_IsObject(tables) || (salt && !cJSON_IsString(salt))) {
+        fprintf(stderr, "Error: '%s' is not a rules file: expected {\"salt\": \"...\", \"tables\": {...}}.\n",
+                filename);
+        cJSON_Delete(root);
+        return false;
+    }
+    rules->salt = mem_strdup(MEM_OTHER, salt ? salt->valuestring : "");
+    int count = cJSON_GetArraySize(tables);
+    rules->tables = mem_calloc(MEM_OTHER, (size_t)count + 1, sizeof(MaskTableRules));
+    ok = rules->salt && rules->tables;
+    if (!ok) {
+        perror("Failed to allocate masking rules");
+    }
+    const cJSON *columns;
+    cJSON_ArrayForEach(columns, tables) {
+        if (!ok) break;
+        MaskTableRules *table = &rules->tables[rules->table_count++];
+        table->table = mem_strdup(MEM_OTHER, columns->string);
+        ok = table->table && parse_table_rules(table, columns, filename);
+    }
+    cJSON_Delete(root);
+    return ok;
+}
+
+// {"column": "method" | {"method": "...", "length": n}, ...}
+static bool parse_table_rules(MaskTableRules *table, const cJSON *columns, const char *filename) {
+    if (!cJSON_IsObject(columns)) {
+        fprintf(stderr, "Error: Rules of table '%s' in '%s' must be an object of columns.\n", table->table, filename);
+        return false;
+    }
+    table->rules = mem_calloc(MEM_OTHER, (size_t)cJSON_GetArraySize(columns) + 1, sizeof(MaskRule));
+    if (!table->rules) {
+        perror("Failed to allocate masking rules");
+        return false;
+    }
+    const cJSON *spec;
+    cJSON_ArrayForEach(spec, columns) {
+        const cJSON *method = cJSON_IsObject(spec) ? cJSON_GetObjectItemCaseSensitive(spec, "method") : spec;
+        const cJSON *length = cJSON_IsObject(spec) ? cJSON_GetObjectItemCaseSensitive(spec, "length") : NULL;
+        const char *name = cJSON_IsString(method) ? method->valuestring : "";
+        MaskRule *rule = &table->rules[table->rule_count];
+        rule->length = length && cJSON_IsNumber(length) && length->valuedouble >= 0 ? (int)length->valuedouble : -1;
+        if (strcmp(name, "hash") == 0) {
+            rule->method = MASK_HASH;
+        } else if (strcmp(name, "fake") == 0) {
+            rule->method = MASK_FAKE;
+        } else if (strcmp(name, "null") == 0) {
+            rule->method = MASK_NULL;
+        } else if (strcmp(name, "truncate") == 0 && rule->length >= 0) {
+            rule->method = MASK_TRUNCATE;
+        } else {
+            fprintf(stderr, "Error: Bad rule for column '%s.%s' in '%s': expected hash, fake, null or "
+                            "{\"method\": \"truncate\", \"length\": n}.\n", table->table, spec->string, filename);
+            return false;
+        }
+        rule->column = mem_strdup(MEM_OTHER, spec->string);
+        if (!rule->column) {
+            perror("Failed to allocate masking rules");
+            return false;
+        }
+        table->rule_count++;
+    }
+    return true;
+}
+
+static void cleanup_rules(MaskRules *rules) {
+    for (int i = 0; i < rules->table_count; ++i) {
+        for (int j = 0; j < rules->tables[i].rule_count; ++j) {
+            free(rules->tables[i].rules[j].column);
+        }
+        free(rules->tables[i].rules);
+        free(rules->tables[i].table);
+    }
+    free(rules->tables);
+    free(rules->salt);
+    memset(rules, 0, sizeof(*rules));
+}
+
+// Collects the rules for the region's table: "*", then its name, then its
+// qualified name, later ones replacing earlier ones per column. Clears
+// table->region if no column is masked.
+static bool resolve_table(MaskJob *job, MaskTable *table, const char *database) {
+    const TableInfo *table_info = table->region->table_info;
+    MaskTableRules *matches[3] = {NULL, NULL, NULL};
+    for (int i = 0; i < job->rules.table_count; ++i) {
+        MaskTableRules *rules = &job->rules.tables[i];
+        const char *dot = strrchr(rules->table, '.');
+        if (strcmp(rules->table, "*") == 0) {
+            matches[0] = rules;
+        } else if (!dot && strcmp(rules->table, table_info->name) == 0) {
+            matches[1] = rules;
+        } else if (dot && database && strcmp(dot + 1, table_info->name) == 0 &&
+                   strlen(database) == (size_t)(dot - rules->table) &&
+                   strncmp(rules->table, database, (size_t)(dot - rules->table)) == 0) {
+            matches[2] = rules;
+        }
+    }
+    if (!matches[0] && !matches[1] && !matches[2]) {
+        table->region = NULL;
+        return true;
+    }
+
+    // Columns come from the CREATE TABLE; the index entry owns them
+    TableInfo *loaded = (TableInfo *)table_info;
+    if (!load_table_columns(job->index, loaded, job->sql_filename)) {
+        return false;
+    }
+    table->table_info = loaded;
+    table->column_rules = mem_calloc(MEM_EXPORT, (size_t)loaded->column_count + 1, sizeof(MaskRule *));
+    if (!table->column_rules) {
+        perror("Failed to allocate masked columns");
+        return false;
+    }
+    bool masked = false;
+    for (int m = 0; m < 3; ++m) {
+        if (matches[m]) {
+            matches[m]->used = true;
+            if (!apply_rules(matches[m], loaded, table->column_rules, m > 0)) {
+                return false;
+            }
+        }
+    }
+    for (int c = 0; c < loaded->column_count; ++c) {
+        masked = masked || table->column_rules[c];
+    }
+    if (!masked) {
+        table->region = NULL;
+    }
+    return true;
+}
+
+// Masked key columns must keep their values distinct, which only "hash"
+// of an integer or a string does
+static bool apply_rules(MaskTableRules *rules, const TableInfo *table_info, const MaskRule **column_rules,
+                        bool warn) {
+    for (int r = 0; r < rules->rule_count; ++r) {
+        const MaskRule *rule = &rules->rules[r];
+        int c = find_column_index(table_info, rule->column);
+        if (c < 0) {
+            if (warn) {
+                fprintf(stderr, "Warning: Table '%s' has no column '%s' to mask.\n", table_info->name, rule->column);
+            }
+            continue;
+        }
+        TypeClass type_class = table_info->columns[c].type_desc.type_class;
+        if (is_key_column(table_info, rule->column) &&
+            (rule->method != MASK_HASH || type_class == TYPE_CLASS_DECIMAL || type_class == TYPE_CLASS_FLOAT)) {
+            fprintf(stderr,
+                    "Error: Column '%s.%s' is part of a key; only \"hash\" of an integer or string keeps its "
+                    "values distinct.\n",
+                    table_info->name, rule->column);
+            return false;
+        }
+        // A string key's hash is cut to the column length like any other
+        int length = rule->length >= 0 ? rule->length : column_length(&table_info->columns[c]);
+        if (type_class != TYPE_CLASS_INTEGER && is_key_column(table_info, rule->column) && length >= 0 &&
+            length < MASK_KEY_HASH_HEX) {
+            fprintf(stderr,
+                    "Error: Column '%s.%s' is part of a key; \"hash\" keeps string keys distinct only with at "
+                    "least %d characters, not %d.\n",
+                    table_info->name, rule->column, MASK_KEY_HASH_HEX, length);
+            return false;
+        }
+        column_rules[c] = rule;
+    }
+    return true;
+}
+
+// Whether the column is in a PRIMARY, UNIQUE or FOREIGN key
+static bool is_key_column(const TableInfo *table_info, const char *column) {
+    for (int k = 0; k < table_info->key_count; ++k) {
+        const KeyInfo *key = &table_info->keys[k];
+        if (key->kind != KEY_PRIMARY && key->kind != KEY_UNIQUE && key->kind != KEY_FOREIGN) continue;
+        for (int i = 0; i < key->column_count; ++i) {
+            if (strcasecmp(key->columns[i], column) == 0) return true;
+        }
+    }
+    return false;
+}
+
+static void mask_table_task(void *arg) {
+    MaskTable *table = arg;
+    table->ok = mask_table(table);
+}
+
+// Parses the table's INSERTs and writes their bytes to a temporary file,
+// with the masked values replaced
+static bool mask_table(MaskTable *table) {
+    MaskJob *job = table->job;
+    DumpMap *dump = &job->dump;
+    const DumpRegion *region = table->region;
+    off_t start = region->data_start;
+    off_t end = region->data_end;
+    if (!dump_map_fill(dump, region->start, end)) {
+        return false;
+    }
+
+    // Beside the output, so the final copy stays within one file system
+    size_t len = strlen(job->options->output_filename) + 16;
+    char *path = mem_malloc(MEM_EXPORT, len);
+    int fd = -1;
+    if (path) {
+        snprintf(path, len, "%s.mask-XXXXXX", job->options->output_filename);
+        fd = mkstemp(path);
+        if (fd >= 0) {
+            unlink(path);
+        } else {
+            fprintf(stderr, "Error creating a temporary file beside '%s': %s\n", job->options->output_filename,
+                    strerror(errno));
+        }
+        free(path);
+    } else {
+        perror("Failed to allocate temporary file name");
+    }
+    table->out = fd >= 0 ? fdopen(fd, "w+b") : NULL;
+    if (!table->out) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    setvbuf(table->out, NULL, _IOFBF, MASK_OUTPUT_BUFFER);
+
+    FILE *in = fmemopen((void *)(dump->data + start), (size_t)(end - start), "rb");
+    if (!in) {
+        perror("Failed to open SQL file range");
+        return false;
+    }
+    ParsingContext ctx = {0};
+    bool ok = initialize_context_stream(&ctx, in);
+    if (ok) {
+        ctx.global_offset = start;
+        const char *last = NULL;
+        ctx.current_line = region->table_info->line_number +
+                           sql_count_newlines(dump->data + region->table_info->ddl_offset, dump->data + start, &last);
+        ctx.at_line_start = start == 0 || dump->data[start - 1] == '\n';
+        ctx.assume_mysqldump = job->options->assume_mysqldump;
+        ScanHooks hooks = {0};
+        hooks.data = table;
+        hooks.on_table = stop_at_table;
+        hooks.on_row = mask_row;
+        ctx.hooks = &hooks;
+        table->cursor = start;
+        table->ok = true;
+        ok = process_sql_file(&ctx) && !ctx.error_occurred && table->ok && copy_through(table, end) &&
+             fflush(table->out) == 0;
+    }
+    cleanup_context(&ctx); // Closes `in`
+    if (!ok) {
+        fprintf(stderr, "Error masking table '%s'.\n", region->table_info->name);
+    }
+    table->size = ftello(table->out);
+    dump_map_release(dump, region->start, end);
+    DEBUG_PRINT("Masked %" PRIu64 " values of table '%s'.", table->masked, region->table_info->name);
+    return ok && table->size >= 0;
+}
+
+static bool mask_row(void *data, const InsertState *insert, const SqlRow *row) {
+    MaskTable *table = data;
+    if (insert->row_count == 0 && !begin_insert(table, insert)) {
+        return table->ok = false;
+    }
+    for (int i = 0; i < row->count && i < table->value_count; ++i) {
+        int column = table->value_map[i];
+        const MaskRule *rule = column >= 0 ? table->column_rules[column] : NULL;
+        const SqlValue *value = &row->values[i];
+        if (!rule || value->kind == SQL_VALUE_NULL ||
+            ((value->kind == SQL_VALUE_BIT || value->kind == SQL_VALUE_EXPRESSION) && rule->method != MASK_NULL)) {
+            continue;
+        }
+        off_t value_start = insert->row_offset + (value->text.ptr - insert->row_text.ptr);
+        if (!copy_through(table, value_start)) {
+            return table->ok = false;
+        }
+        if (!write_masked(table, rule, &table->table_info->columns[column], value)) {
+            fprintf(stderr, "Error writing masked data: %s\n", strerror(errno));
+            return table->ok = false;
+        }
+        table->cursor = value_start + (off_t)value->text.len;
+        table->masked++;
+    }
+    return true;
+}
+
+// Maps the values of a new INSERT to columns: by its column list, or by
+// position in the table
+static bool begin_insert(MaskTable *table, const InsertState *insert) {
+    const TableInfo *table_info = table->table_info;
+    if (strcmp(insert->table_name, table_info->name) != 0) {
+        fprintf(stderr, "Error: INSERT INTO '%s' within the data of '%s' would be copied unmasked.\n",
+                insert->table_name, table_info->name);
+        return false;
+    }
+    const char *data = table->job->dump.data;
+    table->value_count = map_insert_columns(table_info, data + insert->start_offset, data + insert->values_offset,
+                                            &table->value_map, &table->value_capacity);
+    return table->value_count >= 0;
+}
+
+// Writes the dump bytes from the cursor up to `to` unchanged
+static bool copy_through(MaskTable *table, off_t to) {
+    size_t len = (size_t)(to - table->cursor);
+    if (to > table->cursor && fwrite(table->job->dump.data + table->cursor, 1, len, table->out) != len) {
+        fprintf(stderr, "Error writing masked data: %s\n", strerror(errno));
+        return false;
+    }
+    table->cursor = to > table->cursor ? to : table->cursor;
+    return true;
+}
+
+static bool write_masked(MaskTable *table, const MaskRule *rule, const ColumnInfo *column, const SqlValue *value) {
+    const char *p = value->text.ptr;
+    const char *end = p + value->text.len;
+    if (rule->method == MASK_NULL) {
+        const char *text = !column || !column->is_not_null ? "NULL" : value->kind == SQL_VALUE_STRING ? "''" : "0";
+        return fputs(text, table->out) >= 0;
+    }
+    if (rule->method == MASK_TRUNCATE && value->kind != SQL_VALUE_STRING) {
+        return fwrite(p, 1, value->text.len, table->out) == value->text.len;
+    }
+
+    // No encoding is longer than the value or a quoted digest
+    size_t need = value->text.len > MASK_HASH_HEX + 2 ? value->text.len : MASK_HASH_HEX + 2;
+    if (need > table->text_capacity) {
+        char *text = mem_realloc(MEM_EXPORT, table->text, need);
+        if (!text) {
+            perror("Failed to allocate masked value");
+            return false;
+        }
+        table->text = text;
+        table->text_capacity = need;
+    }
+    size_t len = 0;
+    if (rule->method == MASK_TRUNCATE) {
+        len = encode_truncated(table->text, p, end, rule->length);
+    } else if (rule->method == MASK_HASH && value->kind == SQL_VALUE_NUMBER) {
+        len = encode_permuted(table->text, table->job->rules.salt, p, end, column);
+    }
+    if (len == 0) {
+        MaskRandom random;
+        seed_random(&random, table->job->rules.salt, p, value->text.len);
+        if (value->kind == SQL_VALUE_STRING && rule->method == MASK_HASH) {
+            int length = rule->length >= 0 ? rule->length : column_length(column);
+            len = encode_hash(table->text, &random, *p, length);
+        } else if (value->kind == SQL_VALUE_STRING) {
+            len = encode_fake_string(table->text, &random, p, end);
+        } else {
+            len = encode_fake_digits(table->text, &random, p, end, value->kind == SQL_VALUE_HEX);
+        }
+    }
+    return fwrite(table->text, 1, len, table->out) == len;
+}
+
+// 'hex digest', at most `length` characters (the whole digest if negative)
+static size_t encode_hash(char *dst, const MaskRandom *random, char quote, int length) {
+    static const char hex[] = "0123456789abcdef";
+    if (length < 0 || length > MASK_HASH_HEX) length = MASK_HASH_HEX;
+    char *q = dst;
+    *q++ = quote;
+    for (int i = 0; i < length; ++i) {
+        BYTE b = random->block[i / 2];
+        *q++ = hex[i % 2 ? b & 0xF : b >> 4];
+    }
+    *q++ = quote;
+    return (size_t)(q - dst);
+}
+
+// Letters and digits replaced, escapes, doubled quotes and other
+// punctuation kept; a multi-byte UTF-8 character becomes one letter
+static size_t encode_fake_string(char *dst, MaskRandom *random, const char *p, const char *end) {
+    char quote = *p;
+    char *q = dst;
+    *q++ = quote;
+    for (p++, end--; p < end; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if ((c == '\\' || c == (unsigned char)quote) && p + 1 < end) {
+            *q++ = (char)c;
+            *q++ = *++p;
+        } else if (c >= 'a' && c <= 'z') {
+            *q++ = (char)('a' + next_random(random) % 26);
+        } else if (c >= 'A' && c <= 'Z') {
+            *q++ = (char)('A' + next_random(random) % 26);
+        } else if (c >= '0' && c <= '9') {
+            *q++ = (char)('0' + next_random(random) % 10);
+        } else if (c >= 0xC0) {
+            while (p + 1 < end && ((unsigned char)p[1] & 0xC0) == 0x80) p++;
+            *q++ = (char)('a' + next_random(random) % 26);
+        } else {
+            *q++ = (char)c;
+        }
+    }
+    *q++ = quote;
+    return (size_t)(q - dst);
+}
+
+// The first `length` characters of a quoted string; an escape or a
+// UTF-8 sequence counts as one
+static size_t encode_truncated(char *dst, const char *p, const char *end, int length) {
+    char quote = *p;
+    const char *q = p + 1;
+    for (int n = 0; n < length && q < end - 1; ++n) {
+        if ((*q == '\\' || *q == quote) && q + 1 < end - 1) {
+            q += 2;
+        } else if ((unsigned char)*q >= 0xC0) {
+            for (q++; q < end - 1 && ((unsigned char)*q & 0xC0) == 0x80; ++q) {
+            }
+        } else {
+            q++;
+        }
+    }
+    size_t len = (size_t)(q - p);
+    memcpy(dst, p, len);
+    dst[len] = quote;
+    return len + 1;
+}
+
+// Digits of a number (or hex literal) replaced; signs, points, exponents
+// and prefixes kept. A leading non-zero digit stays non-zero.
+static size_t encode_fake_digits(char *dst, MaskRandom *random, const char *p, const char *end, bool hex) {
+    static const char hex_digits[] = "0123456789abcdef";
+    char *q = dst;
+    if (hex && end - p > 2 && (p[1] == 'x' || p[1] == 'X' || p[1] == '\'')) {
+        *q++ = *p++;
+        *q++ = *p++;
+    }
+    bool leading = true;
+    for (; p < end; ++p) {
+        char c = *p;
+        if (!hex && (c == 'e' || c == 'E')) {
+            memcpy(q, p, (size_t)(end - p));
+            return (size_t)(q - dst) + (size_t)(end - p);
+        }
+        if (hex && isxdigit((unsigned char)c)) {
+            *q++ = hex_digits[next_random(random) % 16];
+        } else if (!hex && c >= '0' && c <= '9') {
+            *q++ = (char)(leading && c != '0' ? '1' + next_random(random) % 9 : '0' + next_random(random) % 10);
+            leading = false;
+        } else {
+            *q++ = c;
+            leading = leading && c != '.';
+        }
+    }
+    return (size_t)(q - dst);
+}
+
+// An integer mapped one-to-one onto another with as many digits and the
+// same sign, within the range of the column's type; 0 if the value is not
+// such an integer (e.g. 1.5, 007 or out of range)
+static size_t encode_permuted(char *dst, const char *salt, const char *p, const char *end, const ColumnInfo *column) {
+    bool negative = p < end && *p == '-';
+    const char *digits = p + negative;
+    int n = (int)(end - digits);
+    if (n < 1 || n > 20 || (n > 1 && *digits == '0')) return 0;
+    uint64_t value = 0;
+    for (const char *d = digits; d < end; ++d) {
+        if (*d < '0' || *d > '9') return 0;
+        unsigned digit = (unsigned)(*d - '0');
+        if (value > (UINT64_MAX - digit) / 10) return 0;
+        value = value * 10 + digit;
+    }
+
+    // The n-digit integers of that sign, other than -0, that the type holds
+    uint64_t low = 1;
+    for (int i = 1; i < n; ++i) low *= 10;
+    uint64_t high = n < 20 ? low * 10 - 1 : UINT64_MAX;
+    if (n == 1 && !negative) low = 0;
+    const ColumnTypeDesc *type = column ? &column->type_desc : NULL;
+    if (type && type->type_class == TYPE_CLASS_INTEGER && type->storage_bytes > 0) {
+        if (negative && type->is_unsigned) return 0;
+        int bits = 8 * type->storage_bytes - !type->is_unsigned;
+        if (bits < 64 && high > (UINT64_C(1) << bits) - !negative) {
+            high = (UINT64_C(1) << bits) - !negative;
+        }
+    }
+    if (value < low || value > high) return 0;
+
+    // Keyed by the salt and the range only, so equal values map equally anywhere
+    SHA256_CTX ctx;
+    BYTE key[SHA256_BLOCK_SIZE];
+    char range[48];
+    int range_len = snprintf(range, sizeof(range), "%c%" PRIu64 "..%" PRIu64, negative ? '-' : '+', low, high);
+    sha256_init(&ctx);
+    sha256_update(&ctx, (const BYTE *)salt, strlen(salt) + 1);
+    sha256_update(&ctx, (const BYTE *)range, (size_t)range_len);
+    sha256_final(&ctx, key);
+    value = low + permute_below(key, value - low, high - low + 1);
+
+    char *q = dst;
+    if (negative) *q++ = '-';
+    return (size_t)(q - dst) + (size_t)sprintf(q, "%" PRIu64, value);
+}
+
+// A permutation of [0, count): a four-round Feistel network over the
+// smallest even number of bits that holds count, applied again while the
+// result is not below count (cycle walking). Each round mixes one 64-bit
+// word of the key into the right half.
+static uint64_t permute_below(const BYTE key[SHA256_BLOCK_SIZE], uint64_t x, uint64_t count) {
+    uint64_t round_keys[4] = {0};
+    for (int i = 0; i < SHA256_BLOCK_SIZE; ++i) round_keys[i / 8] = round_keys[i / 8] << 8 | key[i];
+    int half = 1;
+    while (half < 32 && (UINT64_C(1) << (2 * half)) < count) half++;
+    uint64_t mask = (UINT64_C(1) << half) - 1;
+    do {
+        uint64_t left = x >> half;
+        uint64_t right = x & mask;
+        for (int round = 0; round < 4; ++round) {
+            uint64_t f = right ^ round_keys[round];
+            f = (f ^ (f >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+            f = (f ^ (f >> 27)) * UINT64_C(0x94d049bb133111eb);
+            f ^= f >> 31;
+            uint64_t next = left ^ (f & mask);
+            left = right;
+            right = next;
+        }
+        x = left << half | right;
+    } while (x >= count);
+    return x;
+}
+
+static void seed_random(MaskRandom *random, const char *salt, const char *text, size_t len) {
+    SHA256_CTX ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, (const BYTE *)salt, strlen(salt) + 1);
+    sha256_update(&ctx, (const BYTE *)text, len);
+    sha256_final(&ctx, random->block);
+    random->used = 0;
+}
+
+static unsigned next_random(MaskRandom *random) {
+    if (random->used == SHA256_BLOCK_SIZE) {
+        SHA256_CTX ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, random->block, SHA256_BLOCK_SIZE);
+        sha256_final(&ctx, random->block);
+        random->used = 0;
+    }
+    return random->block[random->used++];
+}
+
+// Declared length of a CHAR/VARCHAR/BINARY column; -1 for others
+static int column_length(const ColumnInfo *column) {
+    if (!column) return -1;
+    TypeClass type_class = column->type_desc.type_class;
+    if (type_class == TYPE_CLASS_CHAR || type_class == TYPE_CLASS_BINARY) {
+        return column->type_desc.length;
+    }
+    return -1;
+}
+
@@ -0,0 +1,59 @@
+#ifndef DUMP_MASK_H
+#define DUMP_MASK_H
+
+#include <stdbool.h>
+#include "sql_indexer.h"
+
+// --- Dump Masking ---
+// Copies a dump with selected columns of INSERT rows rewritten, for staging
+// copies of production data. The rules file is JSON:
+//
+//   {
+//     "salt": "staging-2026",
+//     "tables": {
+//       "users":      {"email": "hash", "name": "fake", "phone": "null",
+//                      "bio": {"method": "truncate", "length": 16}},
+//       "shop.orders": {"note": "null"},
+//       "*":          {"password": "null"}
+//     }
+//   }
+//
+// Tables are named as in the dump, optionally qualified by the database of
+// the USE in effect; "*" applies to every table with that column. Methods:
+//
+//   hash      strings become their salted SHA256 in hex, cut to the column
+//             length (or "length"); integers map one-to-one onto others
+//             with as many digits and the same sign that the column's
+//             type holds, by a permutation keyed by the salt; other
+//             numbers get digits drawn from the salted SHA256
+//   fake      letters and digits are replaced by others of the same kind,
+//             drawn from the salted SHA256; length and punctuation stay
+//   null      NULL ('' or 0 for a NOT NULL column)
+//   truncate  strings keep their first "length" characters
+//
+// Equal values mask to equal values, in every table, so keys still join.
+// Columns of PRIMARY, UNIQUE and FOREIGN keys only take "hash", and not
+// for DECIMAL or FLOAT columns, so masked keys stay distinct; string keys
+// need a length of at least 32 hex digits for that.
+// NULL, bit and expression values are left as they are.
+//
+// Only the masked values are re-encoded. Tables without rules and all
+// statements outside the masked tables' data are copied without passing
+// through user space when the dump is a plain SQL file; the data of
+// masked tables is rewritten in parallel into temporary files beside the
+// output and copied into place in dump order.
+
+typedef struct {
+    const char *rules_filename;
+    const char *output_filename; // Must not be the input
+    int threads;                // Workers; <= 0 for one per online CPU
+    bool assume_mysqldump;      // See ParsingContext.assume_mysqldump
+} MaskOptions;
+
+// --- Function Declarations ---
+
+// Loads the columns of the masked tables (which updates the index), then
+// writes the masked copy
+bool mask_dump(SqlIndex *index, const char *sql_filename, const MaskOptions *options);
+
+#endif // DUMP_MASK_H
@@ -0,0 +1,561 @@
+#define _GNU_SOURCE // For memmem and qsort_r
+#include "dump_regions.h"
+#include "insert_parser.h"
+#include "work_pool.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h> // For PRIu64
+#include <unistd.h>
+
+#define REGION_WINDOW (16 * 1024 * 1024)        // Bytes mapped ahead while classifying statements
+#define REGION_NAME_WINDOW 4096                 // Bytes of a USE, CREATE VIEW or trigger searched for its name
+
+// --- Static Helper Function Declarations ---
+static void classify_region_task(void *arg);
+static bool classify_region(DumpRegion *region);
+static bool statement_extent(const char *p, const char *end, bool at_end, SegmentKind *kind, const char **keyword,
+                             const char **stmt_end);
+static const char *skip_to_keyword(const char *p, const char *end);
+static bool starts_with_keyword(const char *p, const char *end, const char *keyword);
+static const char *find_word(const char *p, const char *end, const char *word, bool stop_at_paren);
+static const char *find_delimiter_end(const char *p, const char *end);
+static SegmentKind classify_statement(const char *keyword, const char *end);
+static uint64_t count_rows(const char *keyword, const char *end);
+static bool inserts_into(const char *keyword, const char *end, const char *table);
+static const char *parse_name(const char *p, const char *end, const char **name_end);
+static bool add_segment(DumpRegion *region, off_t start, off_t end, SegmentKind kind);
+static bool add_cut(DumpRegion *region, off_t offset);
+static void resolve_use(DumpRegions *regions);
+static int compare_by_size(const void *a, const void *b);
+static int compare_by_data_size(const void *a, const void *b, void *region_offset);
+
+// --- Function Implementations ---
+
+bool init_dump_regions(DumpRegions *regions, const SqlIndex *index, DumpMap *dump) {
+    memset(regions, 0, sizeof(*regions));
+    regions->dump = dump;
+    int table_count = 0;
+    for (int i = 0; i < index->count; ++i) {
+        if (index->entries[i].table_info) table_count++;
+    }
+    regions->regions = mem_calloc(MEM_EXPORT, (size_t)table_count + 1, sizeof(DumpRegion));
+    if (!regions->regions) {
+        perror("Failed to allocate dump regions");
+        return false;
+    }
+
+    // The preamble runs up to the first CREATE TABLE, each table up to the next
+    regions->regions[0].start = 0;
+    regions->count = 1;
+    for (int i = 0; i < index->count; ++i) {
+        const TableInfo *table_info = index->entries[i].table_info;
+        if (!table_info || table_info->ddl_offset < regions->regions[regions->count - 1].start) {
+            continue;
+        }
+        DumpRegion *region = &regions->regions[regions->count++];
+        region->table_info = table_info;
+        region->start = table_info->ddl_offset;
+    }
+    for (int i = 0; i < regions->count; ++i) {
+        DumpRegion *region = &regions->regions[i];
+        region->owner = regions;
+        region->end = i + 1 < regions->count ? regions->regions[i + 1].start : dump->size;
+    }
+    return true;
+}
+
+bool classify_dump_regions(DumpRegions *regions, int threads) {
+    DumpRegion **order = mem_malloc(MEM_EXPORT, (size_t)regions->count * sizeof(DumpRegion *));
+    if (!order) {
+        perror("Failed to allocate dump regions");
+        return false;
+    }
+    for (int i = 0; i < regions->count; ++i) {
+        order[i] = &regions->regions[i];
+    }
+
+    bool ok = true;
+    WorkPool pool;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (work_pool_start(&pool, threads)) {
+        // Workers run their newest task first, so the largest regions are submitted last
+        qsort(order, (size_t)regions->count, sizeof(DumpRegion *), compare_by_size);
+        for (int i = 0; i < regions->count; ++i) {
+            if (!work_pool_submit(&pool, classify_region_task, order[i])) {
+                order[i]->ok = false;
+            }
+        }
+        work_pool_stop(&pool);
+        DEBUG_PRINT("Classified %d regions on %d workers with %" PRIu64 " steals.", regions->count,
+                    pool.worker_count, pool.steals);
+        for (int i = 0; i < regions->count; ++i) {
+            ok = ok && regions->regions[i].ok;
+        }
+    } else {
+        ok = false;
+    }
+    free(order);
+    if (ok) {
+        resolve_use(regions);
+    }
+    return ok;
+}
+
+void sort_by_data_size(void *items, int count, size_t region_offset) {
+    qsort_r(items, (size_t)count, sizeof(void *), compare_by_data_size, &region_offset);
+}
+
+bool check_region_data(const DumpRegions *regions) {
+    for (int i = 1; i < regions->count; ++i) {
+        const DumpRegion *region = &regions->regions[i];
+        if (region->foreign_data >= 0) {
+            fprintf(stderr, "Error: The INSERT at offset %jd, after the CREATE TABLE of '%s', is for another table; "
+                    "each table's rows must follow its own definition.\n",
+                    (intmax_t)region->foreign_data, region->table_info->name);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool segment_in_data(const DumpRegion *region, const Segment *segment) {
+    return region->data_start >= 0 && segment->start >= region->data_start && segment->end <= region->data_end;
+}
+
+char *segment_name(DumpMap *dump, const Segment *segment) {
+    off_t end = segment->end - segment->start > REGION_NAME_WINDOW ? segment->start + REGION_NAME_WINDOW : segment->end;
+    if (!dump_map_fill(dump, segment->start, end)) {
+        return NULL;
+    }
+    const char *p = dump->data + segment->start;
+    const char *limit = dump->data + end;
+    const char *keyword = skip_to_keyword(p, limit);
+    const char *name = NULL;
+    const char *name_end = NULL;
+    if (keyword && segment->kind == SEG_USE) {
+        name = parse_name(keyword + strlen("USE"), limit, &name_end);
+    } else if (keyword && segment->kind == SEG_VIEW) {
+        const char *view = find_word(keyword, limit, "VIEW", true);
+        name = view ? parse_name(view, limit, &name_end) : NULL;
+    } else if (keyword && segment->kind == SEG_TRIGGER) {
+        // TRIGGER name {BEFORE | AFTER} event ON table
+        const char *trigger = find_word(keyword, limit, "TRIGGER", true);
+        const char *on = trigger ? find_word(trigger, limit, "ON", true) : NULL;
+        name = on ? parse_name(on, limit, &name_end) : NULL;
+    }
+    char *result = NULL;
+    if (name) {
+        result = mem_malloc(MEM_EXPORT, (size_t)(name_end - name) + 1);
+        if (result) {
+            // Quoted names double their backticks
+            size_t len = 0;
+            for (const char *q = name; q < name_end; ++q) {
+                result[len++] = *q;
+                if (*q == '`' && q + 1 < name_end && q[1] == '`') q++;
+            }
+            result[len] = '\0';
+        } else {
+            perror("Failed to allocate name");
+        }
+    }
+    dump_map_release(dump, segment->start, end);
+    return result;
+}
+
+void write_session_header(DumpWriter *w, const DumpRegions *regions) {
+    const DumpRegion *preamble = &regions->regions[0];
+    bool shared = w->shared;
+    dump_writer_flush(w);
+    w->shared = true;
+    for (int j = 0; j < preamble->segment_count; ++j) {
+        if (preamble->segments[j].kind == SEG_SET) {
+            dump_writer_range(w, preamble->segments[j].start, preamble->segments[j].end);
+        }
+    }
+    dump_writer_flush(w);
+    w->shared = shared;
+}
+
+void cleanup_dump_regions(DumpRegions *regions) {
+    for (int i = 0; i < regions->count; ++i) {
+        free(regions->regions[i].segments);
+        free(regions->regions[i].cuts);
+    }
+    free(regions->regions);
+    memset(regions, 0, sizeof(*regions));
+}
+
+// --- Static Helper Function Implementations ---
+
+static void classify_region_task(void *arg) {
+    DumpRegion *region = arg;
+    region->ok = classify_region(region);
+}
+
+// Walks the region's statements, mapping REGION_WINDOW bytes ahead (more
+// for a longer statement) and releasing what it has passed
+static bool classify_region(DumpRegion *region) {
+    const DumpRegions *owner = region->owner;
+    DumpMap *dump = owner->dump;
+    off_t page = sysconf(_SC_PAGESIZE);
+    off_t filled = region->start;
+    off_t released = region->start;
+    off_t cur = region->start;
+    off_t last_cut = -1;
+    uint64_t rows_since_cut = 0;
+    bool in_header = region->table_info == NULL;
+    region->data_start = region->data_end = region->foreign_data = -1;
+
+    while (cur < region->end) {
+        SegmentKind kind = SEG_SCHEMA;
+        const char *keyword = NULL;
+        const char *stmt_end = NULL;
+        for (off_t need = REGION_WINDOW;; need *= 2) {
+            off_t want = region->end - cur > need ? cur + need : region->end;
+            if (want > filled) {
+                if (!dump_map_fill(dump, filled, want)) {
+                    return false;
+                }
+                filled = want;
+            }
+            if (statement_extent(dump->data + cur, dump->data + filled, filled == region->end, &kind, &keyword,
+                                 &stmt_end)) {
+                break;
+            }
+        }
+        off_t next = stmt_end - dump->data;
+        // Only the SETs that open the dump are session settings
+        if (kind == SEG_SET && (region->table_info || !in_header)) {
+            kind = SEG_SCHEMA;
+        } else if (kind == SEG_DATA && !region->table_info) {
+            kind = SEG_SCHEMA; // No table to go with
+        }
+        in_header = in_header && kind == SEG_SET;
+        if (cur == region->start) {
+            region->ddl_end = next;
+        }
+        if (!add_segment(region, cur, next, kind)) {
+            return false;
+        }
+        if (kind == SEG_DATA) {
+            if (region->foreign_data < 0 && !inserts_into(keyword, stmt_end, region->table_info->name)) {
+                region->foreign_data = cur;
+            }
+            if (region->data_start < 0) {
+                region->data_start = last_cut = cur;
+            }
+            region->data_end = next;
+            if (owner->cut_rows > 0) {
+                uint64_t rows = count_rows(keyword, stmt_end);
+                region->rows += rows;
+                rows_since_cut += rows;
+            }
+            if ((owner->cut_interval > 0 && next - last_cut >= owner->cut_interval) ||
+                (owner->cut_rows > 0 && rows_since_cut >= owner->cut_rows)) {
+                if (!add_cut(region, next)) {
+                    return false;
+                }
+                last_cut = next;
+                rows_since_cut = 0;
+            }
+        }
+        cur = next;
+        if (cur - released >= REGION_WINDOW) {
+            dump_map_release(dump, released, cur);
+            released = cur - cur % page;
+        }
+    }
+    dump_map_release(dump, released, filled);
+    // A cut at the very end of the data would leave an empty piece
+    while (region->cut_count > 0 && region->cuts[region->cut_count - 1] >= region->data_end) {
+        region->cut_count--;
+    }
+    return true;
+}
+
+// Finds the end of the statement at p. False if [p, end) does not hold
+// all of it yet and more of the region follows (at_end is false).
+static bool statement_extent(const char *p, const char *end, bool at_end, SegmentKind *kind, const char **keyword,
+                             const char **stmt_end) {
+    *keyword = skip_to_keyword(p, end);
+    if (!*keyword || (!at_end && end - *keyword < 16)) {
+        if (!at_end) return false;
+        *kind = SEG_SCHEMA; // Trailing comments
+        *keyword = *stmt_end = end;
+        return true;
+    }
+    const char *found;
+    if (starts_with_keyword(*keyword, end, "DELIMITER")) {
+        found = find_delimiter_end(*keyword, end);
+        *kind = found && find_word(*keyword, found, "TRIGGER", true) ? SEG_TRIGGER : SEG_POST;
+    } else {
+        ParserState state = STATE_CODE;
+        found = find_statement_end(p, end, p, &state, NULL);
+        *kind = classify_statement(*keyword, found ? found : end);
+    }
+    if (!found) {
+        if (!at_end) return false;
+        found = end; // Unterminated last statement
+    }
+    *stmt_end = found;
+    return true;
+}
+
+// First byte of code after whitespace and comments. The body of a
+// versioned comment (/*!40101 ... */) is code. NULL if none in [p, end).
+static const char *skip_to_keyword(const char *p, const char *end) {
+    while (p < end) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+        } else if (*p == '#' || (*p == '-' && end - p > 2 && p[1] == '-' && isspace((unsigned char)p[2]))) {
+            p = memchr(p, '\n', (size_t)(end - p));
+            if (!p) return NULL;
+        } else if (*p == '/' && end - p > 2 && p[1] == '*' && p[2] == '!') {
+            p += 3;
+            while (p < end && isdigit((unsigned char)*p)) p++;
+        } else if (*p == '/' && end - p > 1 && p[1] == '*') {
+            p = memmem(p + 2, (size_t)(end - p - 2), "*/", 2);
+            if (!p) return NULL;
+            p += 2;
+        } else {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static bool starts_with_keyword(const char *p, const char *end, const char *keyword) {
+    size_t len = strlen(keyword);
+    if ((size_t)(end - p) < len || strncasecmp(p, keyword, len) != 0) return false;
+    return p + len == end || !(isalnum((unsigned char)p[len]) || p[len] == '_');
+}
+
+// The first `word` outside quotes in [p, end), or NULL; with stop_at_paren,
+// only before the first '('. Returns the byte after it.
+static const char *find_word(const char *p, const char *end, const char *word, bool stop_at_paren) {
+    const char *start = p;
+    while (p < end) {
+        char c = *p;
+        if (c == '`' || c == '\'' || c == '"') {
+            for (p++; p < end && *p != c; ++p) {
+                if (*p == '\\' && c != '`') p++;
+            }
+            p++;
+        } else if (c == '(' && stop_at_paren) {
+            return NULL;
+        } else if ((p == start || !(isalnum((unsigned char)p[-1]) || p[-1] == '_')) &&
+                   starts_with_keyword(p, end, word)) {
+            return p + strlen(word);
+        } else {
+            p++;
+        }
+    }
+    return NULL;
+}
+
+// A DELIMITER block runs from "DELIMITER ;;" through the line that sets
+// the delimiter back to ";". Returns the end of that line, or NULL if it is
+// not complete within [p, end).
+static const char *find_delimiter_end(const char *p, const char *end) {
+    const char *line = p;
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        if (!eol) return NULL;
+        const char *q = line;
+        while (q < eol && (*q == ' ' || *q == '\t')) q++;
+        if (starts_with_keyword(q, eol, "DELIMITER")) {
+            q += strlen("DELIMITER");
+            while (q < eol && (*q == ' ' || *q == '\t')) q++;
+            if (q < eol && *q == ';') {
+                q++;
+                while (q < eol && isspace((unsigned char)*q)) q++;
+                if (q == eol) return eol + 1;
+            }
+        }
+        line = eol + 1;
+    }
+    return NULL;
+}
+
+static SegmentKind classify_statement(const char *keyword, const char *end) {
+    if (starts_with_keyword(keyword, end, "INSERT") || starts_with_keyword(keyword, end, "REPLACE")) {
+        return SEG_DATA;
+    }
+    if (starts_with_keyword(keyword, end, "LOCK") || starts_with_keyword(keyword, end, "UNLOCK")) {
+        return SEG_SKIP;
+    }
+    if (starts_with_keyword(keyword, end, "ALTER")) {
+        // mysqldump's /*!40000 ALTER TABLE `t` DISABLE KEYS */
+        size_t len = (size_t)(end - keyword) < 256 ? (size_t)(end - keyword) : 256;
+        if (memmem(keyword, len, "ABLE KEYS", 9)) {
+            return SEG_SKIP;
+        }
+    }
+    if (starts_with_keyword(keyword, end, "CREATE")) {
+        // CREATE [OR REPLACE] [ALGORITHM=...] [DEFINER=...] [SQL SECURITY ...] VIEW;
+        // a table's columns start with '('
+        const char *limit = end - keyword > REGION_NAME_WINDOW ? keyword + REGION_NAME_WINDOW : end;
+        if (find_word(keyword, limit, "VIEW", true)) {
+            return SEG_VIEW;
+        }
+    }
+    if (starts_with_keyword(keyword, end, "USE")) {
+        return SEG_USE;
+    }
+    if (starts_with_keyword(keyword, end, "SET")) {
+        return SEG_SET;
+    }
+    return SEG_SCHEMA;
+}
+
+// Rows of the INSERT ... VALUES statement in [keyword, end); 0 for
+// INSERT ... SELECT. Stops at a malformed row.
+static uint64_t count_rows(const char *keyword, const char *end) {
+    const char *p = find_word(keyword, end, "VALUES", false);
+    if (!p) p = find_word(keyword, end, "VALUE", false);
+    uint64_t rows = 0;
+    while (p) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        const char *row_end = NULL;
+        if (p == end || *p != '(' || scan_insert_row(p, end, &row_end) != ROW_COMPLETE) {
+            break;
+        }
+        rows++;
+        p = row_end;
+        while (p < end && isspace((unsigned char)*p)) p++;
+        p = p < end && *p == ',' ? p + 1 : NULL;
+    }
+    return rows;
+}
+
+// Whether the INSERT or REPLACE at keyword names `table` (its last part if
+// qualified). A statement whose name cannot be found is taken to match.
+static bool inserts_into(const char *keyword, const char *end, const char *table) {
+    static const char *const MODIFIERS[] = {"LOW_PRIORITY", "DELAYED", "HIGH_PRIORITY", "IGNORE", "INTO"};
+    const char *p = keyword;
+    while (p < end && isalpha((unsigned char)*p)) p++; // INSERT or REPLACE
+    for (size_t i = 0; i < sizeof(MODIFIERS) / sizeof(MODIFIERS[0]); ++i) {
+        const char *q = skip_to_keyword(p, end);
+        if (q && starts_with_keyword(q, end, MODIFIERS[i])) {
+            p = q + strlen(MODIFIERS[i]);
+        }
+    }
+    const char *name_end = NULL;
+    const char *name = parse_name(p, end, &name_end);
+    if (!name) {
+        return true;
+    }
+    for (; name < name_end; ++name, ++table) {
+        if (*name != *table) return false;
+        if (*name == '`') name++; // Doubled in a quoted name
+    }
+    return *table == '\0';
+}
+
+// The last part of a possibly qualified, possibly quoted name at p (after
+// whitespace and versioned comment markers). NULL if there is none.
+static const char *parse_name(const char *p, const char *end, const char **name_end) {
+    const char *name = NULL;
+    for (;;) {
+        p = skip_to_keyword(p, end);
+        if (!p) return name;
+        if (*p == '`') {
+            const char *q = p + 1;
+            while (q < end && (*q != '`' || (q + 1 < end && q[1] == '`'))) {
+                q += *q == '`' ? 2 : 1;
+            }
+            if (q >= end) return name;
+            name = p + 1;
+            *name_end = q;
+            p = q + 1;
+        } else if (isalnum((unsigned char)*p) || *p == '_' || *p == '$') {
+            const char *q = p;
+            while (q < end && (isalnum((unsigned char)*q) || *q == '_' || *q == '$')) q++;
+            name = p;
+            *name_end = q;
+            p = q;
+        } else {
+            return name;
+        }
+        if (p >= end || *p != '.') {
+            return name;
+        }
+        p++;
+    }
+}
+
+static bool add_segment(DumpRegion *region, off_t start, off_t end, SegmentKind kind) {
+    Segment *last = region->segment_count > 0 ? &region->segments[region->segment_count - 1] : NULL;
+    // A USE stays on its own so it can be repeated before data, a view or trigger so it can be named
+    if (last && last->kind == kind && kind != SEG_USE && kind != SEG_VIEW && kind != SEG_TRIGGER &&
+        last->end == start) {
+        last->end = end;
+        return true;
+    }
+    if (region->segment_count == region->segment_capacity) {
+        int capacity = region->segment_capacity ? region->segment_capacity * 2 : 16;
+        Segment *segments = mem_realloc(MEM_EXPORT, region->segments, (size_t)capacity * sizeof(Segment));
+        if (!segments) {
+            perror("Failed to allocate dump segments");
+            return false;
+        }
+        region->segments = segments;
+        region->segment_capacity = capacity;
+    }
+    region->segments[region->segment_count++] = (Segment){start, end, kind};
+    return true;
+}
+
+static bool add_cut(DumpRegion *region, off_t offset) {
+    if (region->cut_count == region->cut_capacity) {
+        int capacity = region->cut_capacity ? region->cut_capacity * 2 : 16;
+        off_t *cuts = mem_realloc(MEM_EXPORT, region->cuts, (size_t)capacity * sizeof(off_t));
+        if (!cuts) {
+            perror("Failed to allocate cut points");
+            return false;
+        }
+        region->cuts = cuts;
+        region->cut_capacity = capacity;
+    }
+    region->cuts[region->cut_count++] = offset;
+    return true;
+}
+
+// The USE in effect at each table's data, or at its CREATE TABLE if it has
+// none: the last one before it in dump order
+static void resolve_use(DumpRegions *regions) {
+    const Segment *current = NULL;
+    for (int i = 0; i < regions->count; ++i) {
+        DumpRegion *region = &regions->regions[i];
+        region->use = current;
+        for (int j = 0; j < region->segment_count; ++j) {
+            const Segment *segment = &region->segments[j];
+            if (region->data_start >= 0 && segment->start == region->data_start) {
+                region->use = current;
+            }
+            if (segment->kind == SEG_USE && !segment_in_data(region, segment)) {
+                current = segment;
+            }
+        }
+    }
+}
+
+static int compare_by_size(const void *a, const void *b) {
+    const DumpRegion *ra = *(const DumpRegion *const *)a;
+    const DumpRegion *rb = *(const DumpRegion *const *)b;
+    off_t sa = ra->end - ra->start;
+    off_t sb = rb->end - rb->start;
+    return (sa > sb) - (sa < sb);
+}
+
+static int compare_by_data_size(const void *a, const void *b, void *region_offset) {
+    size_t offset = *(const size_t *)region_offset;
+    const DumpRegion *ra = *(const DumpRegion *const *)(*(const char *const *)a + offset);
+    const DumpRegion *rb = *(const DumpRegion *const *)(*(const char *const *)b + offset);
+    off_t sa = ra->data_end - ra->data_start;
+    off_t sb = rb->data_end - rb->data_start;
+    return (sa > sb) - (sa < sb);
+}
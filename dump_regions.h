@@ -0,0 +1,106 @@
+#ifndef DUMP_REGIONS_H
+#define DUMP_REGIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h> // For off_t
+#include "sql_indexer.h"
+#include "dump_map.h"
+
+// --- Dump Regions ---
+// A dump cut at its CREATE TABLE statements: the preamble up to the first
+// one, then each table up to the next. The statements of every region are
+// classified on worker threads by their leading keyword, without parsing
+// them, so a table's data can be moved around as byte ranges. Regions are
+// mapped a window at a time, so an archive or .sql.gz never holds more
+// than a window of a region in memory.
+
+// What a statement is
+typedef enum {
+    SEG_SCHEMA,     // DDL and everything else
+    SEG_USE,        // USE
+    SEG_SET,        // SET at the start of the dump: the session settings
+    SEG_DATA,       // INSERT or REPLACE
+    SEG_POST,       // DELIMITER block (routines, events)
+    SEG_TRIGGER,    // DELIMITER block creating a trigger
+    SEG_SKIP,       // LOCK/UNLOCK TABLES, ALTER TABLE ... DISABLE/ENABLE KEYS
+    SEG_VIEW        // CREATE ... VIEW
+} SegmentKind;
+
+// Consecutive statements of one kind. A USE, a view or a trigger's
+// DELIMITER block is always on its own.
+typedef struct {
+    off_t start;
+    off_t end;
+    SegmentKind kind;
+} Segment;
+
+struct DumpRegions;
+
+typedef struct {
+    const struct DumpRegions *owner;
+    const TableInfo *table_info; // NULL for the preamble
+    off_t start;
+    off_t end;
+    off_t ddl_end;              // After the CREATE TABLE statement, with its options
+    Segment *segments;
+    int segment_count;
+    int segment_capacity;
+    off_t data_start;           // First INSERT; -1 if the table has no data
+    off_t data_end;             // After the last INSERT
+    off_t foreign_data;         // First INSERT into another table; -1 if none
+    off_t *cuts;                // Statement ends in the data, see DumpRegions.cut_interval
+    int cut_count;
+    int cut_capacity;
+    uint64_t rows;              // Rows of the INSERTs; only counted with cut_rows set
+    const Segment *use;         // USE in effect at data_start (else at start), or NULL
+    bool ok;
+} DumpRegion;
+
+typedef struct DumpRegions {
+    DumpMap *dump;
+    DumpRegion *regions;        // In dump order; regions[0] is the preamble
+    int count;
+    // A cut is recorded at the first statement end in a table's data once
+    // cut_interval bytes or cut_rows rows have passed since the last one.
+    // 0 disables either limit.
+    off_t cut_interval;
+    uint64_t cut_rows;
+} DumpRegions;
+
+// --- Function Declarations ---
+
+// Splits the mapped dump into regions at the tables of the index. Set the
+// cut limits before classifying.
+bool init_dump_regions(DumpRegions *regions, const SqlIndex *index, DumpMap *dump);
+
+// Classifies every region on `threads` workers (<= 0 for one per online
+// CPU), then resolves the USE in effect for each
+bool classify_dump_regions(DumpRegions *regions, int threads);
+
+// Statements between a table's INSERTs travel with its data
+bool segment_in_data(const DumpRegion *region, const Segment *segment);
+
+// Fails, with a message, if a table's region holds INSERTs into another
+// table, as in a dump that creates every table before inserting any rows.
+// Their rows would move with the wrong table.
+bool check_region_data(const DumpRegions *regions);
+
+// Sorts an array of `count` pointers to structs that hold a `const
+// DumpRegion *` at byte offset region_offset, smallest data first. Workers
+// run their newest task first, so tasks submitted in this order start with
+// the largest tables.
+void sort_by_data_size(void *items, int count, size_t region_offset);
+
+// Database of a USE, view of a CREATE VIEW or table (after ON) of a
+// trigger, unquoted and without its qualifier. Returns a mem_strdup'd
+// string, or NULL if there is none.
+char *segment_name(DumpMap *dump, const Segment *segment);
+
+// Queues the session SETs of the preamble (character set, checks, time
+// zone). They must have been filled; the writer treats them as shared.
+void write_session_header(DumpWriter *w, const DumpRegions *regions);
+
+void cleanup_dump_regions(DumpRegions *regions);
+
+#endif // DUMP_REGIONS_H
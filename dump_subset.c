@@ -0,0 +1,846 @@
+#define _GNU_SOURCE // For fmemopen, open_memstream
+#include "dump_subset.h"
+#include "dump_map.h"
+#include "dump_regions.h"
+#include "sql_archive.h"
+#include "insert_parser.h"
+#include "work_pool.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h> // For PRIu64
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SUBSET_MIN_SLOTS 64
+
+// A set of byte strings: open addressing over their hashes, the keys
+// themselves length-prefixed in an arena
+typedef struct {
+    uint64_t *hashes;           // 0 marks an empty slot
+    size_t *offsets;            // Position of each slot's key in the arena
+    size_t slot_count;          // Power of two, or 0
+    size_t count;
+    char *arena;
+    size_t arena_len;
+    size_t arena_capacity;
+} KeySet;
+
+struct SubsetJob;
+struct SubsetTable;
+
+// A FOREIGN KEY between the data of two tables. Each set is written by
+// the scan of one table and read by the other's, so the sets a pass adds
+// to go to *_next and are merged once the pass is over.
+typedef struct {
+    struct SubsetTable *child;
+    struct SubsetTable *parent;
+    int *child_columns;         // The key's columns
+    int *parent_columns;        // The columns they reference
+    int column_count;
+    KeySet down;                // Parent keys of selected rows: child rows with them are selected
+    KeySet need;                // Child keys of included rows: parent rows with them are included
+    KeySet down_next;
+    KeySet need_next;
+} SubsetEdge;
+
+typedef struct SubsetTable {
+    struct SubsetJob *job;
+    const DumpRegion *region;
+    const TableInfo *table_info;
+    SubsetEdge **parents;       // Edges of the table's foreign keys
+    int parent_count;
+    SubsetEdge **children;      // Edges of the foreign keys referencing it
+    int child_count;
+    int *filter_columns;        // Per condition for a root table, else NULL
+    KeySet selected;            // Offsets of rows matching the filter or referencing selected rows
+    KeySet included;            // Offsets of rows in the subset: selected or referenced
+    uint64_t rows;              // Size of `included`
+    bool dirty;                 // Scan in the next pass
+    // Scan state
+    int *value_map;             // Column of each value of the current INSERT, or -1
+    int value_capacity;
+    int *column_values;         // Value of each column in the current INSERT, or -1
+    char *key;                  // Key being built
+    size_t key_len;
+    size_t key_capacity;
+    // Output state
+    FILE *out;                  // In-memory subset of the table's data
+    char *text;
+    size_t text_len;
+    off_t cursor;               // Dump bytes before this have been written or dropped
+    uint64_t statement_rows;    // Rows of the current INSERT written
+    bool ok;
+} SubsetTable;
+
+typedef struct {
+    char *column;
+    char *key;                  // Encoded as a one-column row key
+    size_t key_len;
+} SubsetCondition;
+
+typedef struct SubsetJob {
+    const SubsetOptions *options;
+    DumpMap dump;
+    DumpRegions regions;
+    SubsetTable *tables;        // Per region
+    SubsetEdge *edges;
+    int edge_count;
+    SubsetCondition *conditions;
+    int condition_count;
+} SubsetJob;
+
+// --- Static Helper Function Declarations ---
+static bool parse_filter(SubsetJob *job, const char *filter);
+static bool resolve_root(SubsetJob *job, int *root_count);
+static bool build_edges(SubsetJob *job);
+static bool link_edge(SubsetEdge *edge);
+static bool run_passes(SubsetJob *job, int *passes);
+static void scan_table_task(void *arg);
+static void emit_table_task(void *arg);
+static bool scan_table(SubsetTable *table, bool emit);
+static bool select_row(void *data, const InsertState *insert, const SqlRow *row);
+static bool begin_insert(SubsetTable *table, const InsertState *insert);
+static bool matches_filter(SubsetTable *table, const SqlRow *row);
+static int row_key(SubsetTable *table, const SqlRow *row, const int *columns, int count);
+static bool append_value_key(char **key, size_t *len, size_t *capacity, const SqlValue *value);
+static bool emit_row(void *data, const InsertState *insert, const SqlRow *row);
+static bool emit_insert_end(void *data, const InsertState *insert);
+static bool copy_through(SubsetTable *table, off_t to);
+static uint64_t hash_key(const char *key, size_t len);
+static int key_set_add(KeySet *set, const void *key, size_t len);
+static bool key_set_contains(const KeySet *set, const void *key, size_t len);
+static int64_t key_set_merge(KeySet *set, KeySet *pending);
+static bool key_set_grow(KeySet *set);
+static void cleanup_key_set(KeySet *set);
+
+// --- Function Implementations ---
+
+bool extract_subset(SqlIndex *index, const char *sql_filename, const SubsetOptions *options) {
+    if (same_file(sql_filename, options->output_filename)) {
+        fprintf(stderr, "Error: The subset must not overwrite '%s'.\n", sql_filename);
+        return false;
+    }
+    SubsetJob job = {0};
+    job.options = options;
+    int root_count = 0;
+    int passes = 0;
+    bool ok = parse_filter(&job, options->filter) && load_all_table_columns(index, sql_filename) &&
+              dump_map_open(&job.dump, sql_filename, index) && init_dump_regions(&job.regions, index, &job.dump) &&
+              classify_dump_regions(&job.regions, options->threads) && check_region_data(&job.regions);
+    DumpRegions *regions = &job.regions;
+    if (ok) {
+        job.tables = mem_calloc(MEM_EXPORT, (size_t)regions->count, sizeof(SubsetTable));
+        if (!job.tables) {
+            perror("Failed to allocate subset tables");
+            ok = false;
+        }
+    }
+    for (int i = 1; ok && i < regions->count; ++i) {
+        job.tables[i].job = &job;
+        job.tables[i].region = &regions->regions[i];
+        job.tables[i].table_info = regions->regions[i].table_info;
+        job.tables[i].ok = true;
+    }
+    ok = ok && resolve_root(&job, &root_count) && build_edges(&job) && run_passes(&job, &passes);
+
+    // Each table's included rows, in its statements, then the dump around them
+    if (ok) {
+        WorkPool pool;
+        ok = work_pool_start(&pool, options->threads > 0 ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN));
+        for (int i = 1; ok && i < regions->count; ++i) {
+            if (job.tables[i].rows > 0 && !work_pool_submit(&pool, emit_table_task, &job.tables[i])) {
+                job.tables[i].ok = false;
+            }
+        }
+        if (ok) {
+            work_pool_stop(&pool);
+        }
+        for (int i = 1; ok && i < regions->count; ++i) {
+            ok = job.tables[i].rows == 0 || job.tables[i].ok;
+        }
+    }
+    int fd = ok ? open(options->output_filename, O_WRONLY | O_CREAT | O_TRUNC, 0666) : -1;
+    if (ok && fd < 0) {
+        fprintf(stderr, "Error opening '%s' for writing: %s\n", options->output_filename, strerror(errno));
+        ok = false;
+    }
+    uint64_t rows = 0;
+    int table_count = 0;
+    if (ok) {
+        DumpWriter w;
+        dump_writer_init(&w, &job.dump, fd, false);
+        for (int i = 0; i < regions->count && w.ok; ++i) {
+            const DumpRegion *region = &regions->regions[i];
+            if (region->data_start < 0) {
+                dump_writer_range(&w, region->start, region->end);
+                continue;
+            }
+            const SubsetTable *table = &job.tables[i];
+            dump_writer_range(&w, region->start, region->data_start);
+            if (table->rows > 0) {
+                dump_writer_text(&w, table->text, table->text_len);
+                rows += table->rows;
+                table_count++;
+            }
+            dump_writer_range(&w, region->data_end, region->end);
+        }
+        dump_writer_flush(&w);
+        ok = w.ok;
+        if (close(fd) != 0 && ok) {
+            fprintf(stderr, "Error writing '%s': %s\n", options->output_filename, strerror(errno));
+            ok = false;
+        }
+    }
+    if (ok) {
+        printf("Wrote %" PRIu64 " rows of %d tables into '%s' after %d passes.\n", rows, table_count,
+               options->output_filename, passes);
+    }
+
+    for (int i = 0; job.tables && i < regions->count; ++i) {
+        SubsetTable *table = &job.tables[i];
+        cleanup_key_set(&table->selected);
+        cleanup_key_set(&table->included);
+        free(table->parents);
+        free(table->children);
+        free(table->filter_columns);
+        free(table->value_map);
+        free(table->column_values);
+        free(table->key);
+        if (table->out) fclose(table->out);
+        free(table->text);
+    }
+    for (int i = 0; i < job.edge_count; ++i) {
+        SubsetEdge *edge = &job.edges[i];
+        free(edge->child_columns);
+        free(edge->parent_columns);
+        cleanup_key_set(&edge->down);
+        cleanup_key_set(&edge->need);
+        cleanup_key_set(&edge->down_next);
+        cleanup_key_set(&edge->need_next);
+    }
+    for (int i = 0; i < job.condition_count; ++i) {
+        free(job.conditions[i].column);
+        free(job.conditions[i].key);
+    }
+    free(job.conditions);
+    free(job.edges);
+    free(job.tables);
+    cleanup_dump_regions(regions);
+    dump_map_close(&job.dump);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+// column=value [AND column=value ...], values being numbers or quoted strings
+static bool parse_filter(SubsetJob *job, const char *filter) {
+    const char *end = filter + strlen(filter);
+    SqlTokenizer tz;
+    SqlToken tok;
+    sql_tokenizer_init(&tz, filter, end);
+    bool ok = true;
+    while (ok) {
+        SqlToken name, equals;
+        if (!sql_next_token(&tz, &name) || !sql_token_is_identifier(&name) || !sql_next_token(&tz, &equals) ||
+            equals.type != SQL_TOK_OTHER || *equals.text.ptr != '=' || !sql_next_token(&tz, &tok) ||
+            tok.type == SQL_TOK_END || tok.type == SQL_TOK_QUOTED_IDENT) {
+            ok = false;
+            break;
+        }
+        SqlValue value = {SQL_VALUE_STRING, tok.text};
+        if (tok.type != SQL_TOK_STRING) {
+            // A number: everything up to the next space
+            const char *p = tok.text.ptr;
+            while (p < end && !isspace((unsigned char)*p)) p++;
+            value.kind = SQL_VALUE_NUMBER;
+            value.text.len = (size_t)(p - tok.text.ptr);
+            tz.pos = p;
+        }
+        SubsetCondition *conditions = mem_realloc(MEM_OTHER, job->conditions,
+                                                  (size_t)(job->condition_count + 1) * sizeof(SubsetCondition));
+        if (!conditions) {
+            perror("Failed to allocate subset filter");
+            return false;
+        }
+        job->conditions = conditions;
+        SubsetCondition *condition = &job->conditions[job->condition_count++];
+        memset(condition, 0, sizeof(*condition));
+        size_t capacity = 0;
+        condition->column = sql_unquote_identifier(name.text);
+        if (!condition->column || !append_value_key(&condition->key, &condition->key_len, &capacity, &value)) {
+            perror("Failed to allocate subset filter");
+            return false;
+        }
+        if (!sql_next_token(&tz, &tok)) {
+            break;
+        }
+        ok = sql_token_is_word(&tok, "AND");
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Bad subset filter '%s': expected column=value [AND column=value ...].\n", filter);
+    }
+    return ok;
+}
+
+// Marks the root tables and finds their filter columns
+static bool resolve_root(SubsetJob *job, int *root_count) {
+    const char *root = job->options->root_table;
+    const char *name = unqualified_name(root);
+    size_t database_len = name > root ? (size_t)(name - root - 1) : 0;
+    for (int i = 1; i < job->regions.count; ++i) {
+        SubsetTable *table = &job->tables[i];
+        if (strcmp(table->table_info->name, name) != 0) continue;
+        if (database_len > 0) {
+            const Segment *use = table->region->use;
+            char *database = use ? segment_name(&job->dump, use) : NULL;
+            bool same = database && strlen(database) == database_len && strncmp(database, root, database_len) == 0;
+            free(database);
+            if (!same) continue;
+        }
+        table->filter_columns = mem_malloc(MEM_OTHER, (size_t)job->condition_count * sizeof(int));
+        if (!table->filter_columns) {
+            perror("Failed to allocate subset filter");
+            return false;
+        }
+        for (int c = 0; c < job->condition_count; ++c) {
+            table->filter_columns[c] = find_column_index(table->table_info, job->conditions[c].column);
+            if (table->filter_columns[c] < 0) {
+                fprintf(stderr, "Error: Table '%s' has no column '%s'.\n", table->table_info->name,
+                        job->conditions[c].column);
+                return false;
+            }
+        }
+        table->dirty = table->region->data_start >= 0;
+        (*root_count)++;
+    }
+    if (*root_count == 0) {
+        fprintf(stderr, "Error: Table '%s' not found in the dump.\n", root);
+        return false;
+    }
+    return true;
+}
+
+// One edge per foreign key and table of the referenced name, between
+// tables that both have data
+static bool build_edges(SubsetJob *job) {
+    int capacity = 0;
+    for (int i = 1; i < job->regions.count; ++i) {
+        SubsetTable *child = &job->tables[i];
+        const TableInfo *table_info = child->table_info;
+        if (child->region->data_start < 0) continue;
+        for (int k = 0; k < table_info->key_count; ++k) {
+            const KeyInfo *key = &table_info->keys[k];
+            if (key->kind != KEY_FOREIGN || !key->ref_table || key->column_count != key->ref_column_count) continue;
+            const char *ref = unqualified_name(key->ref_table);
+            for (int j = 1; j < job->regions.count; ++j) {
+                SubsetTable *parent = &job->tables[j];
+                if (parent->region->data_start < 0 || strcmp(parent->table_info->name, ref) != 0) continue;
+                if (job->edge_count == capacity) {
+                    capacity = capacity ? capacity * 2 : 16;
+                    SubsetEdge *edges = mem_realloc(MEM_OTHER, job->edges, (size_t)capacity * sizeof(SubsetEdge));
+                    if (!edges) {
+                        perror("Failed to allocate foreign keys");
+                        return false;
+                    }
+                    job->edges = edges;
+                }
+                SubsetEdge *edge = &job->edges[job->edge_count];
+                memset(edge, 0, sizeof(*edge));
+                edge->child = child;
+                edge->parent = parent;
+                edge->child_columns = mem_malloc(MEM_OTHER, (size_t)key->column_count * sizeof(int));
+                edge->parent_columns = mem_malloc(MEM_OTHER, (size_t)key->column_count * sizeof(int));
+                job->edge_count++;
+                if (!edge->child_columns || !edge->parent_columns) {
+                    perror("Failed to allocate foreign keys");
+                    return false;
+                }
+                bool known = true;
+                for (int c = 0; c < key->column_count && known; ++c) {
+                    edge->child_columns[c] = find_column_index(child->table_info, key->columns[c]);
+                    edge->parent_columns[c] = find_column_index(parent->table_info, key->ref_columns[c]);
+                    known = edge->child_columns[c] >= 0 && edge->parent_columns[c] >= 0;
+                }
+                edge->column_count = key->column_count;
+                if (!known) {
+                    DEBUG_PRINT("Ignoring foreign key of '%s' to '%s': unknown columns.", table_info->name, ref);
+                    edge->column_count = 0;
+                }
+            }
+        }
+    }
+    // Pointers into the edge array only once it stops moving
+    for (int e = 0; e < job->edge_count; ++e) {
+        if (job->edges[e].column_count > 0 && !link_edge(&job->edges[e])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool link_edge(SubsetEdge *edge) {
+    SubsetTable *child = edge->child;
+    SubsetTable *parent = edge->parent;
+    SubsetEdge **parents = mem_realloc(MEM_OTHER, child->parents, (size_t)(child->parent_count + 1) * sizeof(SubsetEdge *));
+    if (parents) child->parents = parents;
+    SubsetEdge **children = mem_realloc(MEM_OTHER, parent->children, (size_t)(parent->child_count + 1) * sizeof(SubsetEdge *));
+    if (children) parent->children = children;
+    if (!parents || !children) {
+        perror("Failed to allocate foreign keys");
+        return false;
+    }
+    child->parents[child->parent_count++] = edge;
+    parent->children[parent->child_count++] = edge;
+    return true;
+}
+
+// Scans the dirty tables in parallel, then merges the keys they found;
+// a table whose input sets grew is dirty in the next pass
+static bool run_passes(SubsetJob *job, int *passes) {
+    WorkPool pool;
+    if (!work_pool_start(&pool, job->options->threads > 0 ? job->options->threads
+                                                          : (int)sysconf(_SC_NPROCESSORS_ONLN))) {
+        return false;
+    }
+    bool ok = true;
+    bool dirty = true;
+    while (ok && dirty) {
+        int scanned = 0;
+        for (int i = 1; i < job->regions.count; ++i) {
+            SubsetTable *table = &job->tables[i];
+            if (!table->dirty) continue;
+            table->dirty = false;
+            table->ok = true;
+            scanned++;
+            if (!work_pool_submit(&pool, scan_table_task, table)) {
+                table->ok = false;
+            }
+        }
+        work_pool_wait(&pool);
+        for (int i = 1; i < job->regions.count; ++i) {
+            ok = ok && job->tables[i].ok;
+        }
+
+        dirty = false;
+        uint64_t added = 0;
+        for (int e = 0; ok && e < job->edge_count; ++e) {
+            SubsetEdge *edge = &job->edges[e];
+            int64_t down = key_set_merge(&edge->down, &edge->down_next);
+            int64_t need = key_set_merge(&edge->need, &edge->need_next);
+            ok = down >= 0 && need >= 0;
+            if (down > 0) edge->child->dirty = dirty = true;
+            if (need > 0) edge->parent->dirty = dirty = true;
+            added += (uint64_t)(down > 0 ? down : 0) + (uint64_t)(need > 0 ? need : 0);
+        }
+        (*passes)++;
+        DEBUG_PRINT("Subset pass %d scanned %d tables and added %" PRIu64 " keys.", *passes, scanned, added);
+    }
+    work_pool_stop(&pool);
+    return ok;
+}
+
+static void scan_table_task(void *arg) {
+    SubsetTable *table = arg;
+    table->ok = scan_table(table, false);
+}
+
+static void emit_table_task(void *arg) {
+    SubsetTable *table = arg;
+    table->out = open_memstream(&table->text, &table->text_len);
+    if (!table->out) {
+        perror("Failed to open subset buffer");
+        table->ok = false;
+        return;
+    }
+    table->ok = scan_table(table, true) && fflush(table->out) == 0;
+}
+
+// Scans the table's INSERTs, either to select rows or to write the
+// included ones
+static bool scan_table(SubsetTable *table, bool emit) {
+    DumpMap *dump = &table->job->dump;
+    const DumpRegion *region = table->region;
+    off_t start = region->data_start;
+    off_t end = region->data_end;
+    if (!dump_map_fill(dump, region->start, end)) {
+        return false;
+    }
+    FILE *in = fmemopen((void *)(dump->data + start), (size_t)(end - start), "rb");
+    if (!in) {
+        perror("Failed to open SQL file range");
+        dump_map_release(dump, region->start, end);
+        return false;
+    }
+    ParsingContext ctx = {0};
+    bool ok = initialize_context_stream(&ctx, in);
+    if (ok) {
+        const char *last = NULL;
+        ctx.global_offset = start;
+        ctx.current_line = table->table_info->line_number +
+                           sql_count_newlines(dump->data + table->table_info->ddl_offset, dump->data + start, &last);
+        ctx.at_line_start = start == 0 || dump->data[start - 1] == '\n';
+        ctx.assume_mysqldump = table->job->options->assume_mysqldump;
+        ScanHooks hooks = {0};
+        hooks.data = table;
+        hooks.raw_rows = emit;
+        hooks.on_table = stop_at_table;
+        hooks.on_row = emit ? emit_row : select_row;
+        hooks.on_insert_end = emit ? emit_insert_end : NULL;
+        ctx.hooks = &hooks;
+        table->cursor = start;
+        table->statement_rows = 0;
+        ok = process_sql_file(&ctx) && !ctx.error_occurred && table->ok && (!emit || copy_through(table, end));
+    }
+    cleanup_context(&ctx); // Closes `in`
+    dump_map_release(dump, region->start, end);
+    if (!ok) {
+        fprintf(stderr, "Error scanning table '%s' for the subset.\n", table->table_info->name);
+    }
+    return ok;
+}
+
+// A row is selected if it matches the filter or references a selected
+// row, and included if it is selected or referenced by an included row.
+// Newly selected and included rows pass their keys on.
+static bool select_row(void *data, const InsertState *insert, const SqlRow *row) {
+    SubsetTable *table = data;
+    if (insert->row_count == 0 && !begin_insert(table, insert)) {
+        return table->ok = false;
+    }
+    off_t offset = insert->row_offset;
+    bool was_selected = key_set_contains(&table->selected, &offset, sizeof(offset));
+    bool was_included = was_selected || key_set_contains(&table->included, &offset, sizeof(offset));
+    bool selected = was_selected || (table->filter_columns && matches_filter(table, row));
+    for (int e = 0; !selected && e < table->parent_count; ++e) {
+        const SubsetEdge *edge = table->parents[e];
+        selected = row_key(table, row, edge->child_columns, edge->column_count) > 0 &&
+                   key_set_contains(&edge->down, table->key, table->key_len);
+    }
+    bool included = was_included || selected;
+    for (int e = 0; !included && e < table->child_count; ++e) {
+        const SubsetEdge *edge = table->children[e];
+        included = row_key(table, row, edge->parent_columns, edge->column_count) > 0 &&
+                   key_set_contains(&edge->need, table->key, table->key_len);
+    }
+
+    if (selected && !was_selected) {
+        if (key_set_add(&table->selected, &offset, sizeof(offset)) < 0) {
+            return table->ok = false;
+        }
+        for (int e = 0; e < table->child_count; ++e) {
+            SubsetEdge *edge = table->children[e];
+            int found = row_key(table, row, edge->parent_columns, edge->column_count);
+            if (found < 0 || (found > 0 && key_set_add(&edge->down_next, table->key, table->key_len) < 0)) {
+                return table->ok = false;
+            }
+        }
+    }
+    if (included && !was_included) {
+        if (key_set_add(&table->included, &offset, sizeof(offset)) < 0) {
+            return table->ok = false;
+        }
+        table->rows++;
+        for (int e = 0; e < table->parent_count; ++e) {
+            SubsetEdge *edge = table->parents[e];
+            int found = row_key(table, row, edge->child_columns, edge->column_count);
+            if (found < 0 || (found > 0 && key_set_add(&edge->need_next, table->key, table->key_len) < 0)) {
+                return table->ok = false;
+            }
+        }
+    }
+    return true;
+}
+
+// Maps the columns of a new INSERT to its values
+static bool begin_insert(SubsetTable *table, const InsertState *insert) {
+    const TableInfo *table_info = table->table_info;
+    if (strcmp(insert->table_name, table_info->name) != 0) {
+        fprintf(stderr, "Error: INSERT INTO '%s' within the data of '%s' would be left out.\n",
+                insert->table_name, table_info->name);
+        return false;
+    }
+    const char *data = table->job->dump.data;
+    int count = map_insert_columns(table_info, data + insert->start_offset, data + insert->values_offset,
+                                   &table->value_map, &table->value_capacity);
+    if (count < 0) {
+        return false;
+    }
+    if (!table->column_values) {
+        table->column_values = mem_malloc(MEM_EXPORT, ((size_t)table_info->column_count + 1) * sizeof(int));
+        if (!table->column_values) {
+            perror("Failed to allocate INSERT column map");
+            return false;
+        }
+    }
+    for (int c = 0; c < table_info->column_count; ++c) {
+        table->column_values[c] = -1;
+    }
+    for (int v = 0; v < count; ++v) {
+        if (table->value_map[v] >= 0) table->column_values[table->value_map[v]] = v;
+    }
+    return true;
+}
+
+static bool matches_filter(SubsetTable *table, const SqlRow *row) {
+    const SubsetJob *job = table->job;
+    for (int c = 0; c < job->condition_count; ++c) {
+        if (row_key(table, row, &table->filter_columns[c], 1) <= 0 || table->key_len != job->conditions[c].key_len ||
+            memcmp(table->key, job->conditions[c].key, table->key_len) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Builds the key of the row's values in `columns` into table->key.
+// Returns 1, 0 if one of them is NULL or missing, or -1 on allocation
+// failure.
+static int row_key(SubsetTable *table, const SqlRow *row, const int *columns, int count) {
+    table->key_len = 0;
+    for (int c = 0; c < count; ++c) {
+        int v = table->column_values[columns[c]];
+        if (v < 0 || v >= row->count || row->values[v].kind == SQL_VALUE_NULL) {
+            return 0;
+        }
+        if (!append_value_key(&table->key, &table->key_len, &table->key_capacity, &row->values[v])) {
+            perror("Failed to allocate row key");
+            return -1;
+        }
+    }
+    return 1;
+}
+
+// Appends the value's text, unescaped if it is a string, with its length
+// before it
+static bool append_value_key(char **key, size_t *len, size_t *capacity, const SqlValue *value) {
+    size_t need = *len + sizeof(uint32_t) + value->text.len;
+    if (need > *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 64;
+        while (grown < need) grown *= 2;
+        char *buffer = mem_realloc(MEM_EXPORT, *key, grown);
+        if (!buffer) {
+            return false;
+        }
+        *key = buffer;
+        *capacity = grown;
+    }
+    char *dst = *key + *len + sizeof(uint32_t);
+    char *q = dst;
+    const char *p = value->text.ptr;
+    const char *end = p + value->text.len;
+    if (value->kind == SQL_VALUE_STRING && value->text.len >= 2) {
+        char quote = *p;
+        for (p++, end--; p < end; ++p) {
+            if (*p == quote && p + 1 < end) {
+                *q++ = *++p;
+            } else if (*p == '\\' && p + 1 < end) {
+                switch (*++p) {
+                    case '0': *q++ = '\0'; break;
+                    case 'b': *q++ = '\b'; break;
+                    case 'n': *q++ = '\n'; break;
+                    case 'r': *q++ = '\r'; break;
+                    case 't': *q++ = '\t'; break;
+                    case 'Z': *q++ = '\x1a'; break;
+                    case '%': case '_': *q++ = '\\'; *q++ = *p; break;
+                    default: *q++ = *p; break;
+                }
+            } else {
+                *q++ = *p;
+            }
+        }
+    } else {
+        memcpy(q, p, value->text.len);
+        q += value->text.len;
+    }
+    uint32_t n = (uint32_t)(q - dst);
+    memcpy(*key + *len, &n, sizeof(n));
+    *len += sizeof(n) + n;
+    return true;
+}
+
+// Writes the statement's header before its first included row, then each
+// included row as written
+static bool emit_row(void *data, const InsertState *insert, const SqlRow *row) {
+    (void)row;
+    SubsetTable *table = data;
+    off_t offset = insert->row_offset;
+    if (!key_set_contains(&table->included, &offset, sizeof(offset))) {
+        return true;
+    }
+    const char *dump = table->job->dump.data;
+    bool ok;
+    if (table->statement_rows++ == 0) {
+        size_t len = (size_t)(insert->values_offset - insert->start_offset);
+        ok = copy_through(table, insert->start_offset) &&
+             fwrite(dump + insert->start_offset, 1, len, table->out) == len && fputc(' ', table->out) != EOF;
+    } else {
+        ok = fputc(',', table->out) != EOF;
+    }
+    ok = ok && fwrite(insert->row_text.ptr, 1, insert->row_text.len, table->out) == insert->row_text.len;
+    table->cursor = offset + (off_t)insert->row_text.len;
+    return table->ok = ok;
+}
+
+// Ends a statement with rows, or drops one without
+static bool emit_insert_end(void *data, const InsertState *insert) {
+    SubsetTable *table = data;
+    if (table->statement_rows > 0) {
+        table->statement_rows = 0;
+        if (!insert->complete) {
+            return true; // Its trailing clause follows the last row
+        }
+        table->cursor = insert->end_offset;
+        return table->ok = fputc(';', table->out) != EOF;
+    }
+    // With the line break before it, so no blank line is left
+    const char *dump = table->job->dump.data;
+    off_t start = insert->start_offset;
+    if (start > table->cursor && dump[start - 1] == '\n') start--;
+    if (!copy_through(table, start)) {
+        return table->ok = false;
+    }
+    off_t end = insert->end_offset;
+    if (!insert->complete) {
+        ParserState state = STATE_CODE;
+        const char *p = find_statement_end(dump + end, dump + table->region->data_end, dump + end, &state, NULL);
+        end = p ? p - dump : table->region->data_end;
+    }
+    table->cursor = end;
+    return true;
+}
+
+// Writes the dump bytes from the cursor up to `to` unchanged
+static bool copy_through(SubsetTable *table, off_t to) {
+    size_t len = (size_t)(to - table->cursor);
+    if (to > table->cursor && fwrite(table->job->dump.data + table->cursor, 1, len, table->out) != len) {
+        perror("Failed to write subset rows");
+        return false;
+    }
+    table->cursor = to > table->cursor ? to : table->cursor;
+    return true;
+}
+
+// FNV-1a, never 0
+static uint64_t hash_key(const char *key, size_t len) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash ? hash : 1;
+}
+
+// Returns 1 if the key was added, 0 if it was there, -1 on allocation failure
+static int key_set_add(KeySet *set, const void *key, size_t len) {
+    if ((set->count + 1) * 2 > set->slot_count && !key_set_grow(set)) {
+        return -1;
+    }
+    uint64_t hash = hash_key(key, len);
+    size_t mask = set->slot_count - 1;
+    size_t slot = (size_t)hash & mask;
+    while (set->hashes[slot] != 0) {
+        const char *stored = set->arena + set->offsets[slot];
+        uint32_t stored_len;
+        memcpy(&stored_len, stored, sizeof(stored_len));
+        if (set->hashes[slot] == hash && stored_len == len && memcmp(stored + sizeof(stored_len), key, len) == 0) {
+            return 0;
+        }
+        slot = (slot + 1) & mask;
+    }
+    size_t need = set->arena_len + sizeof(uint32_t) + len;
+    if (need > set->arena_capacity) {
+        size_t grown = set->arena_capacity ? set->arena_capacity * 2 : 4096;
+        while (grown < need) grown *= 2;
+        char *arena = mem_realloc(MEM_OTHER, set->arena, grown);
+        if (!arena) {
+            perror("Failed to allocate key set");
+            return -1;
+        }
+        set->arena = arena;
+        set->arena_capacity = grown;
+    }
+    uint32_t n = (uint32_t)len;
+    memcpy(set->arena + set->arena_len, &n, sizeof(n));
+    memcpy(set->arena + set->arena_len + sizeof(n), key, len);
+    set->hashes[slot] = hash;
+    set->offsets[slot] = set->arena_len;
+    set->arena_len = need;
+    set->count++;
+    return 1;
+}
+
+static bool key_set_contains(const KeySet *set, const void *key, size_t len) {
+    if (set->count == 0) {
+        return false;
+    }
+    uint64_t hash = hash_key(key, len);
+    size_t mask = set->slot_count - 1;
+    for (size_t slot = (size_t)hash & mask; set->hashes[slot] != 0; slot = (slot + 1) & mask) {
+        const char *stored = set->arena + set->offsets[slot];
+        uint32_t stored_len;
+        memcpy(&stored_len, stored, sizeof(stored_len));
+        if (set->hashes[slot] == hash && stored_len == len && memcmp(stored + sizeof(stored_len), key, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Adds the pending keys to the set and empties them. Returns the number
+// of keys that were new, or -1 on allocation failure.
+static int64_t key_set_merge(KeySet *set, KeySet *pending) {
+    int64_t added = 0;
+    for (size_t pos = 0; pos < pending->arena_len;) {
+        uint32_t len;
+        memcpy(&len, pending->arena + pos, sizeof(len));
+        int result = key_set_add(set, pending->arena + pos + sizeof(len), len);
+        if (result < 0) {
+            return -1;
+        }
+        added += result;
+        pos += sizeof(len) + len;
+    }
+    if (pending->count > 0) {
+        memset(pending->hashes, 0, pending->slot_count * sizeof(uint64_t));
+        pending->count = 0;
+        pending->arena_len = 0;
+    }
+    return added;
+}
+
+// Doubles the slots and re-inserts the keys from the arena
+static bool key_set_grow(KeySet *set) {
+    size_t slot_count = set->slot_count ? set->slot_count * 2 : SUBSET_MIN_SLOTS;
+    uint64_t *hashes = mem_calloc(MEM_OTHER, slot_count, sizeof(uint64_t));
+    size_t *offsets = mem_malloc(MEM_OTHER, slot_count * sizeof(size_t));
+    if (!hashes || !offsets) {
+        perror("Failed to allocate key set");
+        free(hashes);
+        free(offsets);
+        return false;
+    }
+    for (size_t i = 0; i < set->slot_count; ++i) {
+        if (set->hashes[i] == 0) continue;
+        size_t slot = (size_t)set->hashes[i] & (slot_count - 1);
+        while (hashes[slot] != 0) slot = (slot + 1) & (slot_count - 1);
+        hashes[slot] = set->hashes[i];
+        offsets[slot] = set->offsets[i];
+    }
+    free(set->hashes);
+    free(set->offsets);
+    set->hashes = hashes;
+    set->offsets = offsets;
+    set->slot_count = slot_count;
+    return true;
+}
+
+static void cleanup_key_set(KeySet *set) {
+    free(set->hashes);
+    free(set->offsets);
+    free(set->arena);
+    memset(set, 0, sizeof(*set));
+}
@@ -0,0 +1,42 @@
+#ifndef DUMP_SUBSET_H
+#define DUMP_SUBSET_H
+
+#include <stdbool.h>
+#include "sql_indexer.h"
+
+// --- Referential Subsets ---
+// Copies a dump with only the rows of a root table that match a filter,
+// the rows that reference them through FOREIGN KEYs (transitively), and
+// the rows those rows reference in turn, so the copy loads with foreign
+// key checks on:
+//
+//   --subset customers "id=42" --subset-output customer42.sql
+//
+// The filter is one or more column=value conditions joined by AND; values
+// are numbers or quoted strings. Keys compare by their unescaped text, so
+// '42' matches 42.
+//
+// The closure is computed in passes. Each pass re-scans, in parallel, the
+// tables whose inputs grew in the previous one: a table scan selects rows
+// whose foreign keys hit the key set of selected parent rows and includes
+// rows whose keys are in the set referenced by included child rows, adding
+// its own keys to the sets of its neighbours. Passes stop once no set
+// grows. Every statement outside the table data is kept, so the copy has
+// the whole schema; INSERTs keep their header and only the included rows,
+// copied as written.
+
+typedef struct {
+    const char *root_table;     // Table name, optionally qualified by the database of its USE
+    const char *filter;         // e.g. "id=42" or "tenant='acme' AND id=7"
+    const char *output_filename; // Must not be the input
+    int threads;                // Workers; <= 0 for one per online CPU
+    bool assume_mysqldump;      // See ParsingContext.assume_mysqldump
+} SubsetOptions;
+
+// --- Function Declarations ---
+
+// Loads the columns and keys of every table (which updates the index),
+// then writes the subset
+bool extract_subset(SqlIndex *index, const char *sql_filename, const SubsetOptions *options);
+
+#endif // DUMP_SUBSET_H
@@ -0,0 +1,507 @@
+#define _GNU_SOURCE // For fopencookie
+#include "gzip_input.h"
+#include "mem_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define GZIP_INPUT_SIZE 65536
+
+#ifdef HAVE_ZLIB
+// Inflates a dump sequentially, keeping the latest 32 KiB of output
+typedef struct {
+    FILE *in;
+    z_stream strm;
+    bool started;               // strm is initialized
+    bool raw;                   // Raw deflate data, after starting from an access point
+    bool at_end;                // All output produced
+    bool failed;
+    unsigned char *input;       // GZIP_INPUT_SIZE bytes
+    unsigned char *window;      // GZIP_WINDOW_SIZE bytes, circular; output goes to window_pos
+    size_t window_pos;
+    size_t pending_start;       // Output of the last inflate call not returned yet
+    size_t pending_len;
+    off_t in_offset;            // Compressed bytes consumed
+    off_t out_offset;           // Uncompressed bytes produced
+    const GzipAccessIndex *access;
+    GzipAccessIndex *record;    // Receives new access points; NULL when only reading
+} GzipReader;
+
+// --- Static Helper Function Declarations ---
+static GzipReader *reader_open(const char *filename, const GzipAccessIndex *access, GzipAccessIndex *record);
+static void reader_close(GzipReader *r);
+static bool reader_restart(GzipReader *r, const GzipAccessPoint *point);
+static bool reader_fill(GzipReader *r);
+static size_t reader_read(GzipReader *r, char *dst, size_t len);
+static bool reader_seek(GzipReader *r, off_t target);
+static bool next_member(GzipReader *r);
+static bool ensure_input(GzipReader *r, size_t n);
+static bool skip_input(GzipReader *r, size_t n);
+static bool add_access_point(GzipReader *r);
+static const GzipAccessPoint *find_access_point(const GzipAccessIndex *access, off_t offset);
+static ssize_t stream_read(void *cookie, char *buf, size_t size);
+static int stream_seek(void *cookie, off64_t *offset, int whence);
+static int stream_close(void *cookie);
+static bool append_access_point(GzipAccessIndex *access, const GzipAccessPoint *point);
+#endif
+
+// --- Function Implementations ---
+
+bool is_gzip_file(const char *filename) {
+    unsigned char magic[2];
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        return false;
+    }
+    bool gzip = fread(magic, 1, 2, fp) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+    fclose(fp);
+    return gzip;
+}
+
+FILE *gzip_open_stream(const char *filename, const GzipAccessIndex *access, GzipAccessIndex *record) {
+#ifdef HAVE_ZLIB
+    GzipReader *r = reader_open(filename, access, record);
+    if (!r) {
+        return NULL;
+    }
+    cookie_io_functions_t io = {stream_read, NULL, stream_seek, stream_close};
+    FILE *fp = fopencookie(r, "r", io);
+    if (!fp) {
+        perror("Failed to open gzip stream");
+        reader_close(r);
+    }
+    return fp;
+#else
+    (void)filename;
+    (void)access;
+    (void)record;
+    fprintf(stderr, "Error: gzip input is not available; rebuild with zlib installed.\n");
+    errno = ENOTSUP;
+    return NULL;
+#endif
+}
+
+bool gzip_read(const char *filename, const GzipAccessIndex *access, off_t offset, char *dst, size_t len) {
+#ifdef HAVE_ZLIB
+    GzipReader *r = reader_open(filename, access, NULL);
+    if (!r) {
+        return false;
+    }
+    bool ok = reader_seek(r, offset) && reader_read(r, dst, len) == len;
+    if (!ok && !r->failed) {
+        fprintf(stderr, "Error: '%s' ends before offset %jd.\n", filename, (intmax_t)(offset + (off_t)len));
+    }
+    reader_close(r);
+    return ok;
+#else
+    (void)filename;
+    (void)access;
+    (void)offset;
+    (void)dst;
+    (void)len;
+    fprintf(stderr, "Error: gzip input is not available; rebuild with zlib installed.\n");
+    return false;
+#endif
+}
+
+void write_gzip_access_records(FILE *fp, const GzipAccessIndex *access) {
+    if (access->span == 0) {
+        return;
+    }
+    fprintf(fp, "GZIP,%jd,%jd\n", (intmax_t)access->raw_size, (intmax_t)access->span);
+#ifdef HAVE_ZLIB
+    // Windows of SQL text deflate to a fraction of their size
+    uLongf bound = compressBound(GZIP_WINDOW_SIZE);
+    unsigned char *packed = mem_malloc(MEM_BUFFERS, bound);
+    if (!packed) {
+        perror("Failed to allocate gzip window buffer");
+        return;
+    }
+    for (int i = 0; i < access->count; ++i) {
+        const GzipAccessPoint *point = &access->points[i];
+        uLongf packed_len = bound;
+        if (compress2(packed, &packed_len, point->window, GZIP_WINDOW_SIZE, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            continue; // Reads start from the previous point instead
+        }
+        fprintf(fp, "GZPOINT,%jd,%jd,%d,", (intmax_t)point->raw_offset, (intmax_t)point->compressed_offset,
+                point->bits);
+        for (uLongf j = 0; j < packed_len; ++j) {
+            fprintf(fp, "%02x", packed[j]);
+        }
+        fputc('\n', fp);
+    }
+    free(packed);
+#endif
+}
+
+bool read_gzip_access_record(GzipAccessIndex *access, char **fields, int field_count) {
+    if (strcmp(fields[0], "GZIP") == 0) {
+        if (field_count < 3) {
+            return false;
+        }
+        access->raw_size = (off_t)strtoll(fields[1], NULL, 10);
+        access->span = (off_t)strtoll(fields[2], NULL, 10);
+        return access->span > 0;
+    }
+    if (field_count < 5) {
+        return false;
+    }
+    GzipAccessPoint point;
+    point.raw_offset = (off_t)strtoll(fields[1], NULL, 10);
+    point.compressed_offset = (off_t)strtoll(fields[2], NULL, 10);
+    point.bits = atoi(fields[3]);
+    if (point.bits < 0 || point.bits > 7 || point.compressed_offset < 0 ||
+        (access->count > 0 && point.raw_offset <= access->points[access->count - 1].raw_offset)) {
+        return false;
+    }
+#ifdef HAVE_ZLIB
+    size_t hex_len = strlen(fields[4]);
+    unsigned char *packed = mem_malloc(MEM_BUFFERS, hex_len / 2 + 1);
+    point.window = mem_malloc(MEM_INDEX, GZIP_WINDOW_SIZE);
+    bool ok = packed && point.window && hex_len % 2 == 0;
+    for (size_t i = 0; ok && i < hex_len / 2; ++i) {
+        unsigned int byte;
+        ok = sscanf(fields[4] + 2 * i, "%2x", &byte) == 1;
+        packed[i] = (unsigned char)byte;
+    }
+    uLongf window_len = GZIP_WINDOW_SIZE;
+    ok = ok && uncompress(point.window, &window_len, packed, (uLong)(hex_len / 2)) == Z_OK &&
+         window_len == GZIP_WINDOW_SIZE && append_access_point(access, &point);
+    free(packed);
+    if (!ok) {
+        free(point.window);
+    }
+    return ok;
+#else
+    return true; // Points are of no use without zlib
+#endif
+}
+
+void cleanup_gzip_access(GzipAccessIndex *access) {
+    for (int i = 0; i < access->count; ++i) {
+        free(access->points[i].window);
+    }
+    free(access->points);
+    access->points = NULL;
+    access->count = 0;
+    access->capacity = 0;
+}
+
+// --- Static Helper Function Implementations ---
+
+#ifdef HAVE_ZLIB
+
+static bool append_access_point(GzipAccessIndex *access, const GzipAccessPoint *point) {
+    if (access->count == access->capacity) {
+        int new_capacity = access->capacity == 0 ? 64 : access->capacity * 2;
+        GzipAccessPoint *new_points = mem_realloc(MEM_INDEX, access->points, (size_t)new_capacity * sizeof(GzipAccessPoint));
+        if (!new_points) {
+            perror("Failed to allocate gzip access points");
+            return false;
+        }
+        access->points = new_points;
+        access->capacity = new_capacity;
+    }
+    access->points[access->count++] = *point;
+    return true;
+}
+
+static GzipReader *reader_open(const char *filename, const GzipAccessIndex *access, GzipAccessIndex *record) {
+    GzipReader *r = mem_calloc(MEM_BUFFERS, 1, sizeof(GzipReader));
+    if (!r) {
+        perror("Failed to allocate gzip reader");
+        return NULL;
+    }
+    r->access = access;
+    r->record = record;
+    r->input = mem_malloc(MEM_BUFFERS, GZIP_INPUT_SIZE);
+    r->window = mem_malloc(MEM_BUFFERS, GZIP_WINDOW_SIZE);
+    r->in = fopen(filename, "rb");
+    if (!r->input || !r->window || !r->in) {
+        fprintf(stderr, "Error opening gzip file '%s': %s\n", filename, strerror(errno));
+        reader_close(r);
+        return NULL;
+    }
+    if (!reader_restart(r, NULL)) {
+        reader_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+static void reader_close(GzipReader *r) {
+    if (r->started) {
+        inflateEnd(&r->strm);
+    }
+    if (r->in) {
+        fclose(r->in);
+    }
+    free(r->input);
+    free(r->window);
+    free(r);
+}
+
+// Restarts at the beginning of the dump, or at an access point: raw
+// inflate primed with the boundary bits and the window as dictionary
+static bool reader_restart(GzipReader *r, const GzipAccessPoint *point) {
+    if (r->started) {
+        inflateEnd(&r->strm);
+        r->started = false;
+    }
+    memset(&r->strm, 0, sizeof(r->strm));
+    r->pending_len = 0;
+    r->window_pos = 0;
+    r->at_end = false;
+    r->failed = true; // Until the restart succeeds
+
+    off_t seek_to = point ? point->compressed_offset - (point->bits ? 1 : 0) : 0;
+    if (inflateInit2(&r->strm, point ? -15 : 15 + 32) != Z_OK) { // 15 + 32: gzip or zlib header
+        fprintf(stderr, "Error: Cannot start gzip decompression.\n");
+        return false;
+    }
+    r->started = true;
+    if (fseeko(r->in, seek_to, SEEK_SET) != 0) {
+        perror("Error seeking in gzip file");
+        return false;
+    }
+    r->raw = point != NULL;
+    r->in_offset = point ? point->compressed_offset : 0;
+    r->out_offset = point ? point->raw_offset : 0;
+    if (point) {
+        if (point->bits) {
+            int c = getc(r->in);
+            if (c == EOF || inflatePrime(&r->strm, point->bits, c >> (8 - point->bits)) != Z_OK) {
+                fprintf(stderr, "Error: Cannot resume gzip decompression at offset %jd.\n", (intmax_t)seek_to);
+                return false;
+            }
+        }
+        if (inflateSetDictionary(&r->strm, point->window, GZIP_WINDOW_SIZE) != Z_OK) {
+            fprintf(stderr, "Error: Cannot resume gzip decompression at offset %jd.\n", (intmax_t)seek_to);
+            return false;
+        }
+        // Points recorded from here on need the output before the restart too
+        memcpy(r->window, point->window, GZIP_WINDOW_SIZE);
+    } else {
+        memset(r->window, 0, GZIP_WINDOW_SIZE);
+    }
+    r->failed = false;
+    return true;
+}
+
+// Inflates until there is pending output or the dump ends. Stops at every
+// deflate block boundary, where `record` may take an access point.
+static bool reader_fill(GzipReader *r) {
+    while (r->pending_len == 0 && !r->at_end && !r->failed) {
+        if (r->strm.avail_in == 0 && !ensure_input(r, 1)) {
+            if (!r->failed) {
+                fprintf(stderr, "Error: Unexpected end of gzip data at offset %jd.\n", (intmax_t)r->in_offset);
+            }
+            r->failed = true;
+            break;
+        }
+        if (r->window_pos == GZIP_WINDOW_SIZE) {
+            r->window_pos = 0;
+        }
+        r->strm.next_out = r->window + r->window_pos;
+        r->strm.avail_out = (uInt)(GZIP_WINDOW_SIZE - r->window_pos);
+        uInt avail_in = r->strm.avail_in;
+        uInt avail_out = r->strm.avail_out;
+        int ret = inflate(&r->strm, Z_BLOCK);
+        size_t produced = avail_out - r->strm.avail_out;
+        r->in_offset += avail_in - r->strm.avail_in;
+        r->pending_start = r->window_pos;
+        r->pending_len = produced;
+        r->window_pos += produced;
+        r->out_offset += (off_t)produced;
+
+        if (ret == Z_STREAM_END) {
+            next_member(r);
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            fprintf(stderr, "Error: Corrupt gzip data at offset %jd (%s).\n", (intmax_t)r->in_offset,
+                    r->strm.msg ? r->strm.msg : "inflate failed");
+            r->failed = true;
+        } else if (r->record && (r->strm.data_type & 128) && !(r->strm.data_type & 64)) {
+            if (!add_access_point(r)) r->failed = true;
+        }
+    }
+    return !r->failed;
+}
+
+static size_t reader_read(GzipReader *r, char *dst, size_t len) {
+    size_t done = 0;
+    while (done < len && reader_fill(r) && r->pending_len > 0) {
+        size_t n = r->pending_len < len - done ? r->pending_len : len - done;
+        memcpy(dst + done, r->window + r->pending_start, n);
+        r->pending_start += n;
+        r->pending_len -= n;
+        done += n;
+    }
+    return done;
+}
+
+// Goes back to the nearest access point when the target is behind, or
+// when a point lies between the position and the target; then inflates
+// forward, dropping the output.
+static bool reader_seek(GzipReader *r, off_t target) {
+    off_t position = r->out_offset - (off_t)r->pending_len;
+    const GzipAccessPoint *point = find_access_point(r->access, target);
+    if (target < position || (point && point->raw_offset > position)) {
+        if (!reader_restart(r, point)) {
+            return false;
+        }
+        position = r->out_offset;
+    }
+    while (position < target && reader_fill(r) && r->pending_len > 0) {
+        size_t n = (off_t)r->pending_len < target - position ? r->pending_len : (size_t)(target - position);
+        r->pending_start += n;
+        r->pending_len -= n;
+        position += (off_t)n;
+    }
+    return !r->failed;
+}
+
+// Called at the end of a gzip member: continues with the next member, or
+// ends the dump if none follows (trailing padding is ignored)
+static bool next_member(GzipReader *r) {
+    // Raw inflate stops before the member's CRC32 and size trailer
+    if (r->raw && !skip_input(r, 8)) {
+        fprintf(stderr, "Error: Unexpected end of gzip data at offset %jd.\n", (intmax_t)r->in_offset);
+        r->failed = true;
+        return false;
+    }
+    if (!ensure_input(r, 2) || r->strm.next_in[0] != 0x1f || r->strm.next_in[1] != 0x8b) {
+        r->at_end = !r->failed;
+        if (r->at_end && r->record) {
+            r->record->raw_size = r->out_offset;
+        }
+        return !r->failed;
+    }
+    if (r->raw) {
+        inflateReset2(&r->strm, 15 + 16);
+        r->raw = false;
+    } else {
+        inflateReset(&r->strm);
+    }
+    return true;
+}
+
+// Makes at least n bytes available at next_in unless the file ends first
+static bool ensure_input(GzipReader *r, size_t n) {
+    if (r->strm.avail_in >= n) {
+        return true;
+    }
+    if (r->strm.avail_in > 0) {
+        memmove(r->input, r->strm.next_in, r->strm.avail_in);
+    }
+    size_t got = fread(r->input + r->strm.avail_in, 1, GZIP_INPUT_SIZE - r->strm.avail_in, r->in);
+    if (got == 0 && ferror(r->in)) {
+        perror("Error reading gzip file");
+        r->failed = true;
+    }
+    r->strm.next_in = r->input;
+    r->strm.avail_in += (uInt)got;
+    return r->strm.avail_in >= n;
+}
+
+static bool skip_input(GzipReader *r, size_t n) {
+    while (n > 0) {
+        if (r->strm.avail_in == 0 && !ensure_input(r, 1)) {
+            return false;
+        }
+        size_t k = r->strm.avail_in < n ? r->strm.avail_in : n;
+        r->strm.next_in += k;
+        r->strm.avail_in -= (uInt)k;
+        r->in_offset += (off_t)k;
+        n -= k;
+    }
+    return true;
+}
+
+// Records the current block boundary if it is the first point or at
+// least `span` bytes past the previous one
+static bool add_access_point(GzipReader *r) {
+    GzipAccessIndex *access = r->record;
+    if (access->span <= 0) {
+        return true;
+    }
+    if (access->count == 0 ? r->out_offset != 0
+                           : r->out_offset < access->points[access->count - 1].raw_offset + access->span) {
+        return true;
+    }
+    GzipAccessPoint point;
+    point.raw_offset = r->out_offset;
+    point.compressed_offset = r->in_offset;
+    point.bits = r->strm.data_type & 7;
+    point.window = mem_malloc(MEM_INDEX, GZIP_WINDOW_SIZE);
+    if (!point.window) {
+        perror("Failed to allocate gzip access point");
+        return false;
+    }
+    // Oldest bytes first: those after window_pos, then those before it
+    size_t tail = GZIP_WINDOW_SIZE - r->window_pos;
+    memcpy(point.window, r->window + r->window_pos, tail);
+    memcpy(point.window + tail, r->window, r->window_pos);
+    if (!append_access_point(access, &point)) {
+        free(point.window);
+        return false;
+    }
+    return true;
+}
+
+// Last point at or before offset; NULL if there is none
+static const GzipAccessPoint *find_access_point(const GzipAccessIndex *access, off_t offset) {
+    if (!access || access->count == 0 || access->points[0].raw_offset > offset) {
+        return NULL;
+    }
+    int low = 0;
+    int high = access->count - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (access->points[mid].raw_offset <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return &access->points[low];
+}
+
+static ssize_t stream_read(void *cookie, char *buf, size_t size) {
+    GzipReader *r = cookie;
+    size_t done = reader_read(r, buf, size);
+    if (done == 0 && r->failed) {
+        errno = EIO;
+        return -1;
+    }
+    return (ssize_t)done;
+}
+
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+    GzipReader *r = cookie;
+    off64_t base = 0;
+    if (whence == SEEK_CUR) {
+        base = r->out_offset - (off_t)r->pending_len;
+    } else if (whence == SEEK_END) {
+        if (!r->access || r->access->raw_size < 0) {
+            errno = ESPIPE;
+            return -1;
+        }
+        base = r->access->raw_size;
+    }
+    if (base + *offset < 0 || !reader_seek(r, base + *offset)) {
+        return -1;
+    }
+    *offset = base + *offset;
+    return 0;
+}
+
+static int stream_close(void *cookie) {
+    reader_close(cookie);
+    return 0;
+}
+
+#endif // HAVE_ZLIB
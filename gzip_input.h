@@ -0,0 +1,61 @@
+#ifndef GZIP_INPUT_H
+#define GZIP_INPUT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h> // For off_t
+
+// --- Gzip Input ---
+// .sql.gz dumps are read through a decompressing stream. While the first
+// scan inflates the dump it records access points at deflate block
+// boundaries every `span` uncompressed bytes (the zran technique): the
+// compressed offset, the bits of the boundary byte and the last 32 KiB of
+// output, which is all inflate needs to resume there. The points are saved
+// in the index, so later reads of a table start from the nearest point
+// before it instead of inflating from byte 0. Concatenated gzip members
+// (pigz, --output-compress gzip) are read as one dump. Needs zlib (HAVE_ZLIB).
+
+#define GZIP_WINDOW_SIZE 32768
+#define GZIP_DEFAULT_SPAN_MIB 16
+
+typedef struct {
+    off_t raw_offset;           // Uncompressed offset of the block boundary
+    off_t compressed_offset;    // First whole byte after the boundary
+    int bits;                   // Bits of the byte before compressed_offset that follow the boundary (0-7)
+    unsigned char *window;      // GZIP_WINDOW_SIZE bytes of output before raw_offset
+} GzipAccessPoint;
+
+typedef struct {
+    GzipAccessPoint *points;    // In increasing offset order
+    int count;
+    int capacity;
+    off_t span;                 // Uncompressed bytes between points; 0 if the dump is not gzip
+    off_t raw_size;             // Size of the decompressed dump; -1 until a scan reaches the end
+} GzipAccessIndex;
+
+// --- Function Declarations ---
+
+// True if the file starts with the gzip magic bytes
+bool is_gzip_file(const char *filename);
+
+// Opens a read-only, seekable stream over the decompressed dump. Seeks
+// resume from the nearest point of `access` (may be NULL) at or before the
+// target. With `record` set, reads add the points they pass to it and set
+// its raw_size at the end of the dump. NULL on failure.
+FILE *gzip_open_stream(const char *filename, const GzipAccessIndex *access, GzipAccessIndex *record);
+
+// Decompresses [offset, offset + len) of the dump into dst, starting from
+// the nearest access point. Safe to call from several threads at once.
+bool gzip_read(const char *filename, const GzipAccessIndex *access, off_t offset, char *dst, size_t len);
+
+// Index file records (see write_index_to_file):
+//   GZIP,RAW_SIZE,SPAN
+//   GZPOINT,RAW_OFFSET,COMPRESSED_OFFSET,BITS,<hex of the deflated window>
+void write_gzip_access_records(FILE *fp, const GzipAccessIndex *access);
+// Parses the fields of one GZIP or GZPOINT record. Returns false if malformed.
+bool read_gzip_access_record(GzipAccessIndex *access, char **fields, int field_count);
+
+void cleanup_gzip_access(GzipAccessIndex *access);
+
+#endif // GZIP_INPUT_H
@@ -0,0 +1,550 @@
+#define _GNU_SOURCE // For fopencookie
+#include "input_parts.h"
+#include "sql_archive.h"
+#include "gzip_input.h"
+#include "work_pool.h"
+#include "sha256.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define PART_HASH_BUFFER_SIZE ((size_t)1024 * 1024)
+
+// Cookie of the stream returned by open_parts_stream
+typedef struct {
+    const InputParts *input;
+    off_t size;
+    off_t position;
+    int part;                   // Part open in `file`; -1 if none
+    FILE *file;
+    bool needs_seek;            // `file` is not at `position`
+} PartsStream;
+
+// One part hashed by hash_input_parts
+typedef struct {
+    const InputPart *part;
+    BYTE hash[SHA256_BLOCK_SIZE];
+    uint64_t lines;
+    bool ok;
+} PartHash;
+
+// A mydumper file name split for ordering, see classify_dump_file
+typedef struct {
+    char *name;
+    size_t stem_len;
+    int rank;
+} DumpFile;
+
+// --- Static Helper Function Declarations ---
+static void classify_dump_file(DumpFile *file);
+static int compare_dump_files(const void *a, const void *b);
+static bool has_suffix(const char *name, const char *suffix);
+static bool is_index_file(const char *path);
+static void hash_part_task(void *arg);
+static ssize_t stream_read(void *cookie, char *buf, size_t size);
+static int stream_seek(void *cookie, off64_t *offset, int whence);
+static int stream_close(void *cookie);
+
+// --- Function Implementations ---
+
+bool add_input_part(InputParts *input, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Error opening file '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fprintf(stderr, "Error: '%s' is not a regular file.\n", path);
+        return false;
+    }
+    if (is_gzip_file(path) || is_sql_archive(path)) {
+        fprintf(stderr, "Error: '%s' is compressed; parts of a dump must be plain SQL files.\n", path);
+        return false;
+    }
+    // A glob over the parts also matches an index or checkpoint written beside them
+    if (is_index_file(path)) {
+        fprintf(stderr, "Warning: Skipping '%s', an index or checkpoint file rather than a part of the dump.\n", path);
+        return true;
+    }
+    if (input->count == input->capacity) {
+        int new_capacity = input->capacity == 0 ? 16 : input->capacity * 2;
+        InputPart *new_parts = mem_realloc(MEM_INDEX, input->parts, (size_t)new_capacity * sizeof(InputPart));
+        if (!new_parts) {
+            perror("Failed to allocate input parts");
+            return false;
+        }
+        input->parts = new_parts;
+        input->capacity = new_capacity;
+    }
+    InputPart *part = &input->parts[input->count];
+    part->path = mem_strdup(MEM_INDEX, path);
+    if (!part->path) {
+        perror("Failed to allocate input part");
+        return false;
+    }
+    part->offset = input_parts_size(input);
+    part->size = st.st_size;
+    part->first_line = 1; // Set by hash_input_parts
+    input->count++;
+    return true;
+}
+
+bool add_input_directory(InputParts *input, const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "Error opening directory '%s': %s\n", dir, strerror(errno));
+        return false;
+    }
+    DumpFile *files = NULL;
+    int count = 0;
+    int capacity = 0;
+    bool ok = true;
+    struct dirent *de;
+    while (ok && (de = readdir(d)) != NULL) {
+        if (has_suffix(de->d_name, ".sql.gz") || has_suffix(de->d_name, ".sql.zst")) {
+            fprintf(stderr, "Error: '%s/%s' is compressed; decompress the directory first.\n", dir, de->d_name);
+            ok = false;
+        }
+        if (!ok || !has_suffix(de->d_name, ".sql")) {
+            continue; // metadata and other files
+        }
+        if (count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            DumpFile *new_files = mem_realloc(MEM_BUFFERS, files, (size_t)capacity * sizeof(DumpFile));
+            if (!new_files) {
+                perror("Failed to list directory");
+                ok = false;
+                break;
+            }
+            files = new_files;
+        }
+        files[count].name = mem_strdup(MEM_BUFFERS, de->d_name);
+        if (!files[count].name) {
+            perror("Failed to list directory");
+            ok = false;
+            break;
+        }
+        classify_dump_file(&files[count]);
+        count++;
+    }
+    closedir(d);
+
+    if (ok && count == 0) {
+        fprintf(stderr, "Error: No .sql files in directory '%s'.\n", dir);
+        ok = false;
+    }
+    if (ok) {
+        qsort(files, (size_t)count, sizeof(DumpFile), compare_dump_files);
+    }
+    size_t dir_len = strlen(dir);
+    while (dir_len > 1 && dir[dir_len - 1] == '/') dir_len--;
+    for (int i = 0; ok && i < count; ++i) {
+        char *path = mem_malloc(MEM_BUFFERS, dir_len + strlen(files[i].name) + 2);
+        if (!path) {
+            perror("Failed to allocate path");
+            ok = false;
+            break;
+        }
+        sprintf(path, "%.*s/%s", (int)dir_len, dir, files[i].name);
+        ok = add_input_part(input, path);
+        free(path);
+    }
+    for (int i = 0; i < count; ++i) {
+        free(files[i].name);
+    }
+    free(files);
+    input->independent = true;
+    return ok;
+}
+
+size_t input_parts_base_length(const InputParts *input, const char *path) {
+    size_t len = strlen(path);
+    if (input->count == 0 || input->independent) {
+        return len;
+    }
+    // The last ".part-" of the file name, followed by the split suffix only
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    const char *part = NULL;
+    for (const char *p = strstr(name, ".part-"); p; p = strstr(p + 1, ".part-")) {
+        part = p;
+    }
+    if (!part || part == name || part[6] == '\0') {
+        return len;
+    }
+    for (const char *p = part + 6; *p; ++p) {
+        if (!isalnum((unsigned char)*p)) return len;
+    }
+    return (size_t)(part - path);
+}
+
+off_t input_parts_size(const InputParts *input) {
+    if (input->count == 0) {
+        return 0;
+    }
+    const InputPart *last = &input->parts[input->count - 1];
+    return last->offset + last->size;
+}
+
+int find_input_part(const InputParts *input, off_t offset) {
+    int low = 0;
+    int high = input->count - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (input->parts[mid].offset <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+int find_input_part_by_line(const InputParts *input, uint64_t line) {
+    int low = 0;
+    int high = input->count - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (input->parts[mid].first_line <= line) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+FILE *open_parts_stream(const InputParts *input) {
+    PartsStream *stream = mem_calloc(MEM_BUFFERS, 1, sizeof(PartsStream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->input = input;
+    stream->size = input_parts_size(input);
+    stream->part = -1;
+    cookie_io_functions_t io = {stream_read, NULL, stream_seek, stream_close};
+    FILE *fp = fopencookie(stream, "r", io);
+    if (!fp) {
+        stream_close(stream);
+    }
+    return fp;
+}
+
+bool read_input_parts(const InputParts *input, off_t offset, char *dst, size_t len) {
+    off_t end = offset + (off_t)len;
+    for (int i = len > 0 ? find_input_part(input, offset) : input->count; i < input->count; ++i) {
+        const InputPart *part = &input->parts[i];
+        if (part->offset >= end) {
+            break;
+        }
+        off_t from = offset > part->offset ? offset : part->offset;
+        off_t to = end < part->offset + part->size ? end : part->offset + part->size;
+        int fd = open(part->path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Error opening file '%s': %s\n", part->path, strerror(errno));
+            return false;
+        }
+        while (from < to) {
+            ssize_t got = pread(fd, dst + (from - offset), (size_t)(to - from), from - part->offset);
+            if (got <= 0) {
+                fprintf(stderr, "Error reading '%s': %s\n", part->path, got < 0 ? strerror(errno) : "file shrank");
+                close(fd);
+                return false;
+            }
+            from += got;
+        }
+        close(fd);
+    }
+    return true;
+}
+
+bool hash_input_parts(InputParts *input, int threads, char *hash_buffer) {
+    PartHash *hashes = mem_calloc(MEM_BUFFERS, input->count > 0 ? (size_t)input->count : 1, sizeof(PartHash));
+    if (!hashes) {
+        perror("Failed to allocate part hashes");
+        return false;
+    }
+    TRACE_BEGIN(hash_start);
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    WorkPool pool;
+    bool ok = work_pool_start(&pool, threads < input->count ? threads : input->count);
+    if (ok) {
+        for (int i = 0; i < input->count; ++i) {
+            hashes[i].part = &input->parts[i];
+            if (!work_pool_submit(&pool, hash_part_task, &hashes[i])) {
+                ok = false;
+            }
+        }
+        work_pool_stop(&pool);
+    }
+
+    // The digest of the part digests, so the parts can be hashed in parallel
+    SHA256_CTX ctx;
+    sha256_init(&ctx);
+    uint64_t line = 1;
+    for (int i = 0; ok && i < input->count; ++i) {
+        ok = hashes[i].ok;
+        input->parts[i].first_line = line;
+        line += hashes[i].lines;
+        char hex[65];
+        for (int k = 0; k < SHA256_BLOCK_SIZE; k++) {
+            sprintf(hex + (k * 2), "%02x", hashes[i].hash[k]);
+        }
+        sha256_update(&ctx, (const BYTE *)hex, 64);
+    }
+    if (ok) {
+        BYTE hash[SHA256_BLOCK_SIZE];
+        sha256_final(&ctx, hash);
+        for (int k = 0; k < SHA256_BLOCK_SIZE; k++) {
+            sprintf(hash_buffer + (k * 2), "%02x", hash[k]);
+        }
+        hash_buffer[64] = '\0';
+    }
+    free(hashes);
+    TRACE_END(hash_start, "hash", "hash parts", input->count > 0 ? input->parts[0].path : "");
+    return ok;
+}
+
+bool same_input_parts(const InputParts *a, const InputParts *b) {
+    if (a->count != b->count || a->independent != b->independent) {
+        return false;
+    }
+    for (int i = 0; i < a->count; ++i) {
+        if (a->parts[i].size != b->parts[i].size || strcmp(a->parts[i].path, b->parts[i].path) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool read_input_part_record(InputParts *input, char **fields, int field_count) {
+    if (field_count < 6 || atoi(fields[1]) != input->count) {
+        return false;
+    }
+    if (input->count == input->capacity) {
+        int new_capacity = input->capacity == 0 ? 16 : input->capacity * 2;
+        InputPart *new_parts = mem_realloc(MEM_INDEX, input->parts, (size_t)new_capacity * sizeof(InputPart));
+        if (!new_parts) {
+            perror("Failed to allocate input parts");
+            return false;
+        }
+        input->parts = new_parts;
+        input->capacity = new_capacity;
+    }
+    InputPart *part = &input->parts[input->count];
+    part->path = mem_strdup(MEM_INDEX, fields[5]);
+    if (!part->path) {
+        perror("Failed to allocate input part");
+        return false;
+    }
+    part->offset = input_parts_size(input);
+    part->size = (off_t)strtoll(fields[2], NULL, 10);
+    part->first_line = strtoull(fields[3], NULL, 10);
+    input->independent = atoi(fields[4]) != 0;
+    input->count++;
+    return true;
+}
+
+bool copy_input_parts(InputParts *dst, const InputParts *src) {
+    memset(dst, 0, sizeof(*dst));
+    if (src->count == 0) {
+        return true;
+    }
+    dst->parts = mem_calloc(MEM_INDEX, (size_t)src->count, sizeof(InputPart));
+    if (!dst->parts) {
+        perror("Failed to allocate input parts");
+        return false;
+    }
+    dst->capacity = src->count;
+    dst->independent = src->independent;
+    for (int i = 0; i < src->count; ++i) {
+        dst->parts[i] = src->parts[i];
+        dst->parts[i].path = mem_strdup(MEM_INDEX, src->parts[i].path);
+        if (!dst->parts[i].path) {
+            perror("Failed to allocate input parts");
+            cleanup_input_parts(dst);
+            return false;
+        }
+        dst->count++;
+    }
+    return true;
+}
+
+void cleanup_input_parts(InputParts *input) {
+    for (int i = 0; i < input->count; ++i) {
+        free(input->parts[i].path);
+    }
+    free(input->parts);
+    memset(input, 0, sizeof(*input));
+}
+
+// --- Static Helper Function Implementations ---
+
+// mydumper names its files <db>-schema-create.sql, <db>.<table>-schema.sql
+// and <db>.<table>[.<chunk>...].sql (plus -schema-view, -schema-triggers
+// and -schema-post files). The stem is the name without those suffixes;
+// ordering by stem, then rank, puts a table's data right after its schema.
+static void classify_dump_file(DumpFile *file) {
+    static const struct {
+        const char *suffix;
+        int rank;
+    } suffixes[] = {
+        {"-schema-create", 0}, {"-schema-sequence", 1}, {"-schema-view", 3},
+        {"-schema-triggers", 3}, {"-schema-post", 3}, {"-schema", 1},
+    };
+    size_t len = strlen(file->name) - 4; // Without ".sql"
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i) {
+        size_t suffix_len = strlen(suffixes[i].suffix);
+        if (len > suffix_len && memcmp(file->name + len - suffix_len, suffixes[i].suffix, suffix_len) == 0) {
+            file->stem_len = len - suffix_len;
+            file->rank = suffixes[i].rank;
+            return;
+        }
+    }
+    // Data file: drop the chunk numbers
+    for (;;) {
+        size_t dot = len;
+        while (dot > 0 && isdigit((unsigned char)file->name[dot - 1])) dot--;
+        if (dot == len || dot < 2 || file->name[dot - 1] != '.') {
+            break;
+        }
+        len = dot - 1;
+    }
+    file->stem_len = len;
+    file->rank = 2;
+}
+
+static int compare_dump_files(const void *a, const void *b) {
+    const DumpFile *fa = a;
+    const DumpFile *fb = b;
+    size_t n = fa->stem_len < fb->stem_len ? fa->stem_len : fb->stem_len;
+    int cmp = memcmp(fa->name, fb->name, n);
+    if (cmp != 0) return cmp;
+    if (fa->stem_len != fb->stem_len) return fa->stem_len < fb->stem_len ? -1 : 1;
+    if (fa->rank != fb->rank) return fa->rank < fb->rank ? -1 : 1;
+    return strcmp(fa->name, fb->name);
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+// By name, or by the first record of an index (SHA256/FORMAT) or checkpoint
+static bool is_index_file(const char *path) {
+    if (has_suffix(path, ".index") || has_suffix(path, ".checkpoint")) {
+        return true;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return false;
+    }
+    char head[16];
+    size_t len = fread(head, 1, sizeof(head), fp);
+    fclose(fp);
+    static const char *const headers[] = {"SHA256:", "FORMAT:", "CHECKPOINT:"};
+    for (size_t i = 0; i < sizeof(headers) / sizeof(headers[0]); ++i) {
+        size_t header_len = strlen(headers[i]);
+        if (len >= header_len && memcmp(head, headers[i], header_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void hash_part_task(void *arg) {
+    PartHash *hash = arg;
+    FILE *file = fopen(hash->part->path, "rb");
+    unsigned char *buf = mem_malloc(MEM_BUFFERS, PART_HASH_BUFFER_SIZE);
+    if (!file || !buf) {
+        fprintf(stderr, "Error hashing '%s': %s\n", hash->part->path, strerror(errno));
+        if (file) fclose(file);
+        free(buf);
+        return;
+    }
+    SHA256_CTX ctx;
+    sha256_init(&ctx);
+    size_t got;
+    while ((got = fread(buf, 1, PART_HASH_BUFFER_SIZE, file)) > 0) {
+        sha256_update(&ctx, buf, got);
+        for (const unsigned char *p = buf; (p = memchr(p, '\n', got - (size_t)(p - buf))) != NULL; p++) {
+            hash->lines++;
+        }
+    }
+    hash->ok = !ferror(file);
+    if (!hash->ok) {
+        fprintf(stderr, "Error hashing '%s': %s\n", hash->part->path, strerror(errno));
+    }
+    sha256_final(&ctx, hash->hash);
+    fclose(file);
+    free(buf);
+}
+
+static ssize_t stream_read(void *cookie, char *buf, size_t size) {
+    PartsStream *stream = cookie;
+    size_t done = 0;
+    while (done < size && stream->position < stream->size) {
+        int i = find_input_part(stream->input, stream->position);
+        const InputPart *part = &stream->input->parts[i];
+        if (i != stream->part) {
+            if (stream->file) fclose(stream->file);
+            stream->file = fopen(part->path, "rb");
+            stream->part = stream->file ? i : -1;
+            stream->needs_seek = true;
+            if (!stream->file) {
+                fprintf(stderr, "Error opening file '%s': %s\n", part->path, strerror(errno));
+                break;
+            }
+        }
+        if (stream->needs_seek && fseeko(stream->file, stream->position - part->offset, SEEK_SET) != 0) {
+            break;
+        }
+        stream->needs_seek = false;
+        off_t left = part->offset + part->size - stream->position;
+        size_t want = (off_t)(size - done) < left ? size - done : (size_t)left;
+        size_t got = fread(buf + done, 1, want, stream->file);
+        if (got == 0) {
+            fprintf(stderr, "Error reading '%s': %s\n", part->path, ferror(stream->file) ? strerror(errno) : "file shrank");
+            break;
+        }
+        done += got;
+        stream->position += (off_t)got;
+    }
+    if (done == 0 && stream->position < stream->size) {
+        errno = EIO;
+        return -1;
+    }
+    return (ssize_t)done;
+}
+
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+    PartsStream *stream = cookie;
+    off64_t base = whence == SEEK_CUR ? stream->position : whence == SEEK_END ? stream->size : 0;
+    if (base + *offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    stream->position = base + *offset;
+    stream->needs_seek = true;
+    *offset = stream->position;
+    return 0;
+}
+
+static int stream_close(void *cookie) {
+    PartsStream *stream = cookie;
+    if (stream->file) {
+        fclose(stream->file);
+    }
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef INPUT_PARTS_H
+#define INPUT_PARTS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h> // For off_t
+
+// --- Multi-Part Input ---
+// A dump given as several files is read as their concatenation: either the
+// pieces of a split dump (dump.sql.part-aa, -ab, ...) in the order given,
+// or a mydumper directory, whose files are complete dumps of one schema or
+// table chunk and are indexed in parallel. Offsets and line numbers in the
+// index refer to the concatenation; each entry also records the part it
+// was found in, see IndexEntry.file_id.
+
+typedef struct {
+    char *path;
+    off_t offset;               // Offset of the part's first byte in the concatenation
+    off_t size;
+    uint64_t first_line;        // Line of the concatenation the part starts on
+} InputPart;
+
+typedef struct {
+    InputPart *parts;
+    int count;                  // 0 for a single-file dump
+    int capacity;
+    bool independent;           // Every part is a complete dump (mydumper directory)
+} InputParts;
+
+// --- Function Declarations ---
+
+// Appends a plain SQL file; compressed files and archives are rejected.
+// Index and checkpoint files (by name or first record) are skipped with a
+// warning, since a glob over the parts may match them.
+bool add_input_part(InputParts *input, const char *path);
+
+// Length of the name a split dump's index is named after: the first part's
+// path without a trailing ".part-<suffix>" (the index is then
+// "dump.sql.parts.index", which "dump.sql.part-*" does not match). The
+// whole path for other inputs.
+size_t input_parts_base_length(const InputParts *input, const char *path);
+
+// Appends the .sql files of a mydumper directory, each table's schema file
+// followed by its data chunks, and marks the input independent
+bool add_input_directory(InputParts *input, const char *dir);
+
+// Size of the concatenation
+off_t input_parts_size(const InputParts *input);
+
+// Part holding the byte at `offset`, or the line `line`
+int find_input_part(const InputParts *input, off_t offset);
+int find_input_part_by_line(const InputParts *input, uint64_t line);
+
+// Opens a read-only, seekable stream over the concatenation. NULL on failure.
+FILE *open_parts_stream(const InputParts *input);
+
+// Reads bytes [offset, offset + len) of the concatenation into dst. Safe
+// to call from several threads at once.
+bool read_input_parts(const InputParts *input, off_t offset, char *dst, size_t len);
+
+// Hashes every part on `threads` workers (0 = one per CPU) and writes the
+// SHA256 of the parts' digests to hash_buffer (65 bytes). Also counts the
+// lines of each part to set first_line.
+bool hash_input_parts(InputParts *input, int threads, char *hash_buffer);
+
+// True if both list the same paths with the same sizes
+bool same_input_parts(const InputParts *a, const InputParts *b);
+
+// Index file record: PART,ID,SIZE,FIRST_LINE,INDEPENDENT,PATH (parts in order)
+bool read_input_part_record(InputParts *input, char **fields, int field_count);
+
+// Copies src into dst (which must be empty)
+bool copy_input_parts(InputParts *dst, const InputParts *src);
+
+void cleanup_input_parts(InputParts *input);
+
+#endif // INPUT_PARTS_H
@@ -0,0 +1,182 @@
+#include "insert_parser.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char *const VALUE_KIND_NAMES[] = {
+    "NULL", "NUMBER", "STRING", "HEX", "BIT", "EXPRESSION"
+};
+
+// --- Static Helper Function Declarations ---
+static SqlValue classify_value(const SqlToken *first, const SqlToken *last, int token_count);
+static bool append_value(SqlRow *row, SqlValue value);
+
+// --- Function Implementations ---
+
+// Values are split at top-level commas; each value is classified from its
+// first and last token, so only the tokenizer ever touches the bytes.
+RowParseResult parse_insert_row(const char *p, const char *end, SqlRow *row, const char **row_end) {
+    SqlTokenizer tz;
+    SqlToken tok;
+    SqlToken first = {SQL_TOK_END, {NULL, 0}};
+    SqlToken last = first;
+    int token_count = 0;
+    int depth = 0;
+
+    if (p >= end || *p != '(') {
+        return ROW_MALFORMED;
+    }
+    row->count = 0;
+    sql_tokenizer_init(&tz, p + 1, end);
+
+    while (sql_next_token(&tz, &tok)) {
+        if (depth == 0 && (tok.type == SQL_TOK_COMMA || tok.type == SQL_TOK_RPAREN)) {
+            if (token_count == 0) {
+                // "()" is an empty row; an empty value anywhere else is an error
+                if (tok.type == SQL_TOK_RPAREN && row->count == 0) {
+                    *row_end = tok.text.ptr + 1;
+                    return ROW_COMPLETE;
+                }
+                return ROW_MALFORMED;
+            }
+            if (!append_value(row, classify_value(&first, &last, token_count))) {
+                return ROW_ERROR;
+            }
+            if (tok.type == SQL_TOK_RPAREN) {
+                *row_end = tok.text.ptr + 1;
+                return ROW_COMPLETE;
+            }
+            token_count = 0;
+            continue;
+        }
+
+        if (tok.type == SQL_TOK_LPAREN) {
+            depth++;
+        } else if (tok.type == SQL_TOK_RPAREN) {
+            depth--;
+        } else if (tok.type == SQL_TOK_SEMICOLON) {
+            return ROW_MALFORMED; // Statement ended inside the row
+        }
+        if (token_count++ == 0) {
+            first = tok;
+        }
+        last = tok;
+    }
+    return ROW_INCOMPLETE; // Ran out of input (or inside a quoted value) before ')'
+}
+
+// Quoted values are skipped with memchr (the closing quote, then any
+// backslash before it), so this costs little more than reading the row.
+RowParseResult scan_insert_row(const char *p, const char *end, const char **row_end) {
+    int depth = 0;
+
+    if (p >= end || *p != '(') {
+        return ROW_MALFORMED;
+    }
+    while (p < end) {
+        char c = *p++;
+        if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            if (--depth == 0) {
+                *row_end = p;
+                return ROW_COMPLETE;
+            }
+        } else if (c == '\'' || c == '"' || c == '`') {
+            while (true) {
+                const char *quote = memchr(p, c, (size_t)(end - p));
+                if (!quote) {
+                    return ROW_INCOMPLETE;
+                }
+                // Identifiers have no escapes
+                const char *escape = c == '`' ? NULL : memchr(p, '\\', (size_t)(quote - p));
+                if (escape) {
+                    p = escape + 2; // Escaped character, possibly the quote
+                    continue;
+                }
+                // A doubled quote stays inside; the quote's successor decides
+                if (quote + 1 >= end) {
+                    return ROW_INCOMPLETE;
+                }
+                p = quote + 1;
+                if (*p == c) {
+                    p++;
+                    continue;
+                }
+                break;
+            }
+        } else if (c == ';') {
+            return ROW_MALFORMED; // Statement ended inside the row
+        }
+    }
+    return ROW_INCOMPLETE;
+}
+
+void cleanup_sql_row(SqlRow *row) {
+    free(row->values);
+    row->values = NULL;
+    row->count = 0;
+    row->capacity = 0;
+}
+
+const char *sql_value_kind_to_string(SqlValueKind kind) {
+    return VALUE_KIND_NAMES[kind];
+}
+
+// --- Static Helper Function Implementations ---
+
+static SqlValue classify_value(const SqlToken *first, const SqlToken *last, int token_count) {
+    SqlValue value;
+    value.kind = SQL_VALUE_EXPRESSION;
+    value.text.ptr = first->text.ptr;
+    value.text.len = (size_t)(last->text.ptr + last->text.len - first->text.ptr);
+
+    if (token_count == 1) {
+        StrSpan t = first->text;
+        if (first->type == SQL_TOK_STRING) {
+            value.kind = SQL_VALUE_STRING;
+        } else if (first->type == SQL_TOK_WORD && sql_span_equals_ci(t, "NULL")) {
+            value.kind = SQL_VALUE_NULL;
+        } else if (first->type == SQL_TOK_WORD && t.len > 2 && t.ptr[0] == '0' && (t.ptr[1] == 'x' || t.ptr[1] == 'X')) {
+            value.kind = SQL_VALUE_HEX;
+        } else if (first->type == SQL_TOK_WORD && t.len > 2 && t.ptr[0] == '0' && (t.ptr[1] == 'b' || t.ptr[1] == 'B')) {
+            value.kind = SQL_VALUE_BIT;
+        } else if (first->type == SQL_TOK_WORD && isdigit((unsigned char)t.ptr[0])) {
+            value.kind = SQL_VALUE_NUMBER;
+        }
+    } else if (token_count == 2) {
+        StrSpan t = first->text;
+        if (first->type == SQL_TOK_OTHER && t.len == 1 && (t.ptr[0] == '-' || t.ptr[0] == '+') &&
+            last->type == SQL_TOK_WORD && isdigit((unsigned char)last->text.ptr[0])) {
+            value.kind = SQL_VALUE_NUMBER; // Signed number
+        } else if (first->type == SQL_TOK_WORD && last->type == SQL_TOK_STRING && last->text.ptr[0] == '\'') {
+            if (t.len == 1 && (t.ptr[0] == 'x' || t.ptr[0] == 'X')) {
+                value.kind = SQL_VALUE_HEX;
+            } else if (t.len == 1 && (t.ptr[0] == 'b' || t.ptr[0] == 'B')) {
+                value.kind = SQL_VALUE_BIT;
+            } else if (t.len > 1 && t.ptr[0] == '_') {
+                value.kind = SQL_VALUE_STRING; // _binary 'abc', _utf8mb4 '...'
+                value.text = last->text;
+            }
+        }
+    }
+    return value;
+}
+
+// Appends a value, doubling the array when full.
+static bool append_value(SqlRow *row, SqlValue value) {
+    if (row->count >= row->capacity) {
+        int new_capacity = row->capacity == 0 ? 16 : row->capacity * 2;
+        SqlValue *new_values = mem_realloc(MEM_ROWS, row->values, new_capacity * sizeof(SqlValue));
+        if (!new_values) {
+            perror("Failed to allocate memory for row values");
+            return false;
+        }
+        row->values = new_values;
+        row->capacity = new_capacity;
+    }
+    row->values[row->count++] = value;
+    return true;
+}
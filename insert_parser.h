@@ -0,0 +1,55 @@
+#ifndef INSERT_PARSER_H
+#define INSERT_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sql_tokenizer.h"
+
+// --- Value Kinds ---
+// Literal kinds found in an INSERT ... VALUES row. Spans point into the
+// caller's buffer and keep their original quoting and escapes.
+typedef enum {
+    SQL_VALUE_NULL,         // NULL
+    SQL_VALUE_NUMBER,       // 42, -1.5, 1e10
+    SQL_VALUE_STRING,       // '...' or "..." including the quotes; _charset introducers are dropped
+    SQL_VALUE_HEX,          // 0xABCD or X'ABCD'
+    SQL_VALUE_BIT,          // 0b0101 or b'0101'
+    SQL_VALUE_EXPRESSION    // Anything else, e.g. a function call
+} SqlValueKind;
+
+typedef struct {
+    SqlValueKind kind;
+    StrSpan text;
+} SqlValue;
+
+// Growable array of the values of one row, reused from row to row.
+typedef struct {
+    SqlValue *values;
+    int count;
+    int capacity;
+} SqlRow;
+
+typedef enum {
+    ROW_COMPLETE,           // *row_end points after the closing ')'
+    ROW_INCOMPLETE,         // The row continues past `end`
+    ROW_MALFORMED,          // Not a parenthesised value list
+    ROW_ERROR               // Allocation failure
+} RowParseResult;
+
+// --- Function Declarations ---
+
+// Parses one "(v1, v2, ...)" row starting at `p`, which must point at '('.
+// Replaces row's values on success.
+RowParseResult parse_insert_row(const char *p, const char *end, SqlRow *row, const char **row_end);
+
+// Finds the end of the row starting at `p` ('(') without splitting its
+// values: only quotes and nested parentheses are tracked.
+RowParseResult scan_insert_row(const char *p, const char *end, const char **row_end);
+
+// Frees the value array.
+void cleanup_sql_row(SqlRow *row);
+
+// Returns the name of a value kind, e.g. "STRING"
+const char *sql_value_kind_to_string(SqlValueKind kind);
+
+#endif // INSERT_PARSER_H
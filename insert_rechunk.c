@@ -0,0 +1,236 @@
+#define _GNU_SOURCE // For fileno
+#include "insert_rechunk.h"
+#include "sql_archive.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h> // For PRIu64
+#include <unistd.h>
+
+#define RECHUNK_COPY_BUFFER (1024 * 1024)
+
+// The scan finds the rows; the bytes are copied from a second stream over
+// the same input that trails it, so `src` always sits at `cursor`.
+typedef struct {
+    const RechunkOptions *options;
+    FILE *src;
+    FILE *out;
+    off_t cursor;               // Input before this has been written or dropped
+    char *copy_buffer;
+    char *header;               // The current statement up to and including VALUES
+    size_t header_len;
+    size_t header_capacity;
+    off_t statement_start;
+    off_t statement_out;        // Output offset of the current statement
+    off_t batch_start;          // First row of the batch being collected
+    off_t batch_end;            // After its last row
+    uint64_t batch_rows;
+    int batches;                // Batches of the current statement written so far
+    uint64_t split_statements;
+    uint64_t written_statements;
+    uint64_t kept_statements;   // Split, then written back unchanged
+    bool ok;
+} Rechunker;
+
+// --- Static Helper Function Declarations ---
+static bool rechunk_row(void *data, const InsertState *insert, const SqlRow *row);
+static bool rechunk_insert_end(void *data, const InsertState *insert);
+static bool begin_statement(Rechunker *r, const InsertState *insert);
+static bool write_batch(Rechunker *r, const char *terminator);
+static bool copy_input(Rechunker *r, off_t to);
+static bool skip_input(Rechunker *r, off_t to);
+
+// --- Function Implementations ---
+
+bool rechunk_inserts(const SqlIndex *index, const char *sql_filename, const RechunkOptions *options) {
+    if (same_file(sql_filename, options->output_filename)) {
+        fprintf(stderr, "Error: The re-chunked dump must not overwrite '%s'.\n", sql_filename);
+        return false;
+    }
+
+    Rechunker r = {0};
+    r.options = options;
+    r.ok = true;
+    r.copy_buffer = mem_malloc(MEM_BUFFERS, RECHUNK_COPY_BUFFER);
+    if (!r.copy_buffer) {
+        perror("Failed to allocate copy buffer");
+        return false;
+    }
+    FILE *in = open_sql_input(sql_filename, index);
+    r.src = open_sql_input(sql_filename, index);
+    r.out = fopen(options->output_filename, "wb");
+    if (!in || !r.src || !r.out) {
+        fprintf(stderr, "Error opening '%s': %s\n", !in || !r.src ? sql_filename : options->output_filename,
+                strerror(errno));
+        if (in) fclose(in);
+        if (r.src) fclose(r.src);
+        if (r.out) fclose(r.out);
+        free(r.copy_buffer);
+        return false;
+    }
+
+    ParsingContext ctx = {0};
+    bool ok = initialize_context_stream(&ctx, in);
+    if (ok) {
+        ctx.assume_mysqldump = options->assume_mysqldump;
+        ScanHooks hooks = {0};
+        hooks.data = &r;
+        hooks.raw_rows = true;
+        hooks.on_row = rechunk_row;
+        hooks.on_insert_end = rechunk_insert_end;
+        ctx.hooks = &hooks;
+        ok = process_sql_file(&ctx) && !ctx.error_occurred && r.ok;
+        // Everything after the last statement
+        while (ok && !feof(r.src)) {
+            size_t n = fread(r.copy_buffer, 1, RECHUNK_COPY_BUFFER, r.src);
+            ok = !ferror(r.src) && fwrite(r.copy_buffer, 1, n, r.out) == n;
+        }
+        if (!ok && r.ok) {
+            fprintf(stderr, "Error re-chunking '%s'.\n", sql_filename);
+        }
+    }
+    cleanup_context(&ctx); // Closes `in`
+
+    if (fclose(r.out) != 0 && ok) {
+        fprintf(stderr, "Error writing '%s': %s\n", options->output_filename, strerror(errno));
+        ok = false;
+    }
+    fclose(r.src);
+    free(r.copy_buffer);
+    free(r.header);
+    if (ok) {
+        printf("Split %" PRIu64 " INSERT statements into %" PRIu64 " in '%s'.\n", r.split_statements - r.kept_statements,
+               r.written_statements, options->output_filename);
+        if (r.kept_statements > 0) {
+            printf("Kept %" PRIu64 " oversized statements with a trailing clause or malformed rows as they were.\n",
+                   r.kept_statements);
+        }
+    }
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+// Collects rows into the open batch and writes the batch out once the next
+// row would take it past a limit. A batch always holds at least one row.
+static bool rechunk_row(void *data, const InsertState *insert, const SqlRow *row) {
+    (void)row;
+    Rechunker *r = data;
+    if (insert->row_count == 0 && !begin_statement(r, insert)) {
+        return r->ok = false;
+    }
+    const RechunkOptions *options = r->options;
+    off_t row_end = insert->row_offset + (off_t)insert->row_text.len;
+    if (r->batch_rows > 0 &&
+        ((options->max_rows > 0 && r->batch_rows >= options->max_rows) ||
+         (options->max_bytes > 0 && r->header_len + (size_t)(row_end - r->batch_start) + 1 > options->max_bytes))) {
+        if (!write_batch(r, ";\n")) {
+            return r->ok = false;
+        }
+        r->batch_start = insert->row_offset;
+        r->batch_rows = 0;
+    }
+    r->batch_end = row_end;
+    r->batch_rows++;
+    return true;
+}
+
+static bool rechunk_insert_end(void *data, const InsertState *insert) {
+    Rechunker *r = data;
+    if (insert->row_count == 0) {
+        return true; // No rows; copied with the surrounding bytes
+    }
+    if (r->batches == 0) {
+        // Within the limits: the statement goes out as it is
+        r->cursor = insert->values_offset;
+        return r->ok = fwrite(r->header, 1, r->header_len - 1, r->out) == r->header_len - 1;
+    }
+    r->split_statements++;
+    if (insert->complete) {
+        if (!write_batch(r, ";")) {
+            return r->ok = false;
+        }
+        return r->ok = skip_input(r, insert->end_offset);
+    }
+
+    // The batches lack the trailing clause; take them back
+    DEBUG_PRINT("Keeping the INSERT at offset %jd unchanged: it does not end after its rows.",
+                (intmax_t)r->statement_start);
+    r->kept_statements++;
+    r->written_statements -= (uint64_t)r->batches;
+    if (fflush(r->out) != 0 || ftruncate(fileno(r->out), r->statement_out) != 0 ||
+        fseeko(r->out, r->statement_out, SEEK_SET) != 0 || fseeko(r->src, r->statement_start, SEEK_SET) != 0) {
+        fprintf(stderr, "Error rewinding '%s' to keep an INSERT unchanged: %s\n", r->options->output_filename,
+                strerror(errno));
+        return r->ok = false;
+    }
+    r->cursor = r->statement_start;
+    return true;
+}
+
+// Copies the input up to the statement and keeps its header
+static bool begin_statement(Rechunker *r, const InsertState *insert) {
+    if (!copy_input(r, insert->start_offset)) {
+        return false;
+    }
+    size_t len = (size_t)(insert->values_offset - insert->start_offset);
+    if (len + 1 > r->header_capacity) {
+        char *header = mem_realloc(MEM_BUFFERS, r->header, len + 1);
+        if (!header) {
+            perror("Failed to allocate INSERT header");
+            return false;
+        }
+        r->header = header;
+        r->header_capacity = len + 1;
+    }
+    if (fread(r->header, 1, len, r->src) != len) {
+        fprintf(stderr, "Error reading INSERT at offset %jd.\n", (intmax_t)insert->start_offset);
+        return false;
+    }
+    r->header[len] = ' ';
+    r->header_len = len + 1;
+    r->cursor = insert->values_offset;
+    r->statement_start = insert->start_offset;
+    r->statement_out = ftello(r->out);
+    r->batch_start = insert->row_offset;
+    r->batch_rows = 0;
+    r->batches = 0;
+    return r->statement_out >= 0;
+}
+
+// Header, the batch's rows as written, terminator
+static bool write_batch(Rechunker *r, const char *terminator) {
+    if (fwrite(r->header, 1, r->header_len, r->out) != r->header_len ||
+        !skip_input(r, r->batch_start) || !copy_input(r, r->batch_end) || fputs(terminator, r->out) == EOF) {
+        return false;
+    }
+    r->batches++;
+    r->written_statements++;
+    return true;
+}
+
+static bool copy_input(Rechunker *r, off_t to) {
+    while (r->cursor < to) {
+        size_t len = to - r->cursor < RECHUNK_COPY_BUFFER ? (size_t)(to - r->cursor) : RECHUNK_COPY_BUFFER;
+        size_t n = fread(r->copy_buffer, 1, len, r->src);
+        if (n == 0 || fwrite(r->copy_buffer, 1, n, r->out) != n) {
+            fprintf(stderr, "Error copying the dump at offset %jd.\n", (intmax_t)r->cursor);
+            return false;
+        }
+        r->cursor += (off_t)n;
+    }
+    return true;
+}
+
+static bool skip_input(Rechunker *r, off_t to) {
+    if (to > r->cursor) {
+        if (fseeko(r->src, to, SEEK_SET) != 0) {
+            perror("Error seeking in the dump");
+            return false;
+        }
+        r->cursor = to;
+    }
+    return true;
+}
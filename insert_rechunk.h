@@ -0,0 +1,31 @@
+#ifndef INSERT_RECHUNK_H
+#define INSERT_RECHUNK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sql_indexer.h"
+
+// --- INSERT Re-chunking ---
+// Rewrites a dump with every INSERT/REPLACE ... VALUES statement of more
+// than max_rows rows or max_bytes bytes split into several statements that
+// repeat its header ("INSERT INTO `t` (cols) VALUES "). Rows are copied as
+// written, never decoded; everything else, including statements within the
+// limits, is copied unchanged. A split statement with a clause after its
+// VALUES list (ON DUPLICATE KEY UPDATE) or a malformed row is written back
+// unchanged as well.
+
+#define RECHUNK_DEFAULT_BATCH_KIB 1024
+
+typedef struct {
+    const char *output_filename; // Must be a regular file other than the input
+    uint64_t max_rows;          // 0 for no row limit
+    size_t max_bytes;           // Statement size limit including the header; 0 for none
+    bool assume_mysqldump;      // See ParsingContext.assume_mysqldump
+} RechunkOptions;
+
+// --- Function Declarations ---
+
+bool rechunk_inserts(const SqlIndex *index, const char *sql_filename, const RechunkOptions *options);
+
+#endif // INSERT_RECHUNK_H
@@ -1,32 +1,140 @@
 #include "sql_indexer.h"
+#include "table_export.h"
+#include "restore_plan.h"
+#include "insert_rechunk.h"
+#include "mydumper_export.h"
+#include "dump_mask.h"
+#include "dump_subset.h"
+#include "sql_archive.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "mem_stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <stdbool.h> // For bool type
 #include <unistd.h> // For access()
+#include <sys/stat.h> // For stat() in progress reports
 
-// --- Global Verbose Flag Definition ---
-bool verbose_mode = false;
+#define DEFAULT_CHECKPOINT_INTERVAL_MIB 1024
+#define DEFAULT_RESTORE_STREAMS 4
 
 // --- Static Helper Function Declarations ---
+static void phase_begin(PerfCounters *perf, const char *phase);
+static void phase_end(PerfCounters *perf, uint64_t bytes);
+static bool select_tables(const SqlIndex *index, const char *list, bool *selected);
+static bool hash_input(const char *sql_filename, InputParts *parts, int threads, char *hash_buffer);
+
 // Function to print usage instructions
 void print_usage(const char *prog_name) {
-    fprintf(stderr, "Usage: %s [-v] [--dump-table <name>] <sql_file>\n", prog_name);
+    fprintf(stderr, "Usage: %s [-v] [--dump-table <name>] [--list-tables] [--schemas] [--assume-mysqldump] [--resume] [--checkpoint-interval <MiB>]\n"
+                    "          [--dump-tables <t1,t2,...> | --dump-all] [--output-dir <dir>] [--threads <n>] [--split-size <MiB>]\n"
+                    "          [--output-compress <gzip|zstd>[:level]] [--gzip-span <MiB>]\n"
+                    "          [--plan-restore [-j <streams>] [--fifo]]\n"
+                    "          [--rechunk <out.sql> [--batch-rows <n>] [--batch-size <KiB>]]\n"
+                    "          [--to-mydumper <dir> [--chunk-rows <n>] [--chunk-size <MiB>] [--database <name>]]\n"
+                    "          [--mask <rules.json> --mask-output <out.sql>]\n"
+                    "          [--subset <table> <column=value> --subset-output <out.sql>]\n"
+                    "          [--progress] [--progress-fd <fd>] [--trace <out.json>]\n"
+                    "          [--perf-counters] [--mem-stats] <sql_file>... | <dump_dir>\n"
+                    "       %s --pack [--output-compress zstd[:level]] [--threads <n>] <sql_file> <archive>\n", prog_name, prog_name);
     fprintf(stderr, "Options:\n");
-    fprintf(stderr, "  <sql_file>        : Path to the SQL file to process.\n");
+    fprintf(stderr, "  <sql_file>        : Path to the SQL file to process, a gzip-compressed one, or an\n");
+    fprintf(stderr, "                      archive made by --pack. Several files are read as the parts\n");
+    fprintf(stderr, "                      of one split dump, in the order given.\n");
+    fprintf(stderr, "  <dump_dir>        : A mydumper directory; its .sql files are indexed in parallel\n");
+    fprintf(stderr, "                      into one index, '<dump_dir>.index'.\n");
     fprintf(stderr, "  -v, --verbose     : Enable verbose debug messages.\n");
-    fprintf(stderr, "  --dump-table <name> : Dump a specific table to JSON and exit.\n\n");
+    fprintf(stderr, "  --dump-table <name> : Write a table to stdout as JSON, as --dump-tables writes it.\n");
+    fprintf(stderr, "  --dump-tables <t1,t2,...> : Export the rows of the listed tables in parallel, one\n");
+    fprintf(stderr, "                      '<table>.json' per table in the output directory.\n");
+    fprintf(stderr, "  --dump-all        : Same as --dump-tables for every table.\n");
+    fprintf(stderr, "  --output-dir <dir> : Directory for --dump-tables/--dump-all/--plan-restore (default '.').\n");
+    fprintf(stderr, "  --threads <n>     : Export worker threads (default: one per CPU).\n");
+    fprintf(stderr, "  --split-size <MiB> : Export tables with more data in pieces of about this size\n");
+    fprintf(stderr, "                      in parallel (default %d, 0 never splits).\n", EXPORT_DEFAULT_PIECE_MIB);
+    fprintf(stderr, "  --output-compress <gzip|zstd>[:level] : Compress exported JSON in independent 1 MiB\n");
+    fprintf(stderr, "                      frames on the worker threads; zstd output carries a seek table.\n");
+    fprintf(stderr, "  --plan-restore    : Write restore-schema.sql, restore-<k>.sql streams to load\n");
+    fprintf(stderr, "                      concurrently and restore-post.sql to the output directory.\n");
+    fprintf(stderr, "  -j <streams>      : Number of --plan-restore streams (default %d).\n", DEFAULT_RESTORE_STREAMS);
+    fprintf(stderr, "  --fifo            : Make the --plan-restore streams FIFOs, written as they are read.\n");
+    fprintf(stderr, "  --rechunk <out.sql> : Copy the dump to <out.sql> with INSERTs of more than\n");
+    fprintf(stderr, "                      --batch-rows rows (default: no limit) or --batch-size KiB\n");
+    fprintf(stderr, "                      (default %d) split into several; rows are copied as written.\n",
+            RECHUNK_DEFAULT_BATCH_KIB);
+    fprintf(stderr, "  --to-mydumper <dir> : Convert the dump into a mydumper directory for myloader, with\n");
+    fprintf(stderr, "                      each table's INSERTs in files of --chunk-rows rows (default: no\n");
+    fprintf(stderr, "                      limit) or --chunk-size MiB (default %d, 0 for no limit).\n",
+            MYDUMPER_DEFAULT_CHUNK_MIB);
+    fprintf(stderr, "  --database <name> : Database of the tables before any USE (default: the file name).\n");
+    fprintf(stderr, "  --mask <rules.json> : Copy the dump to --mask-output with the columns named in the\n");
+    fprintf(stderr, "                      rules hashed, faked, nulled or truncated (see dump_mask.h).\n");
+    fprintf(stderr, "  --subset <table> <column=value> : Copy the dump to --subset-output with only the rows\n");
+    fprintf(stderr, "                      of <table> matching the filter, the rows referencing them through\n");
+    fprintf(stderr, "                      foreign keys, and the rows those reference.\n");
+    fprintf(stderr, "  --pack            : Recompress <sql_file> into a seekable zstd <archive> that embeds\n");
+    fprintf(stderr, "                      the index; pass the archive as <sql_file> to read from it.\n");
+    fprintf(stderr, "  --list-tables     : List tables with their DDL span without parsing columns.\n");
+    fprintf(stderr, "  --schemas         : List distinct table definitions and the tables sharing them.\n");
+    fprintf(stderr, "  --assume-mysqldump : Only inspect line starts when scanning (statements begin\n");
+    fprintf(stderr, "                      on a new line); falls back to a full scan where they don't.\n");
+    fprintf(stderr, "  --gzip-span <MiB> : For a .sql.gz, record an inflate access point about every <MiB>\n");
+    fprintf(stderr, "                      while indexing (default %d), so reads start near the data.\n",
+            GZIP_DEFAULT_SPAN_MIB);
+    fprintf(stderr, "  --resume          : Continue an interrupted indexing run from '<sql_file>.checkpoint'.\n");
+    fprintf(stderr, "  --checkpoint-interval <MiB> : Save a checkpoint every <MiB> scanned (default %d, 0 disables).\n",
+            DEFAULT_CHECKPOINT_INTERVAL_MIB);
+    fprintf(stderr, "  --progress        : Report bytes scanned, tables found, throughput and ETA on stderr.\n");
+    fprintf(stderr, "  --progress-fd <fd> : Report progress as JSON lines to file descriptor <fd>.\n");
+    fprintf(stderr, "  --trace <out.json> : Record timed phases in Chrome trace format (open in Perfetto).\n");
+    fprintf(stderr, "  --perf-counters   : Print cycles, instructions, IPC, bytes/cycle, branch and cache\n");
+    fprintf(stderr, "                      misses and page faults per phase (Linux perf_event_open).\n");
+    fprintf(stderr, "  --mem-stats       : Print allocations and bytes per subsystem and the peak RSS at exit\n");
+    fprintf(stderr, "                      (counters need a build with -DSQLINDEXER_MEM_STATS=ON).\n\n");
     fprintf(stderr, "Indexing Behavior:\n");
     fprintf(stderr, "  - Automatically loads '<sql_file>.index' if it exists and SHA256 matches.\n");
     fprintf(stderr, "  - Automatically saves index to '<sql_file>.index' after parsing.\n");
+    fprintf(stderr, "  - Table columns are parsed when first needed and cached in the index.\n");
+    fprintf(stderr, "  - Saves '<sql_file>.checkpoint' periodically while parsing; removed once done.\n");
+    fprintf(stderr, "  - Archives carry their own index; no '.index' file is read or written for them.\n");
+    fprintf(stderr, "  - A split dump 'dump.sql.part-aa ...' is indexed to 'dump.sql.parts.index'; index\n");
+    fprintf(stderr, "    and checkpoint files among the parts given are skipped.\n");
 }
 
 int main(int argc, char *argv[]) {
     const char *sql_filename = NULL;
+    const char *pack_filename = NULL;
+    char **input_files = argv + 1;   // Positional arguments, gathered at the front of argv
+    int input_count = 0;
+    InputParts parts = {0};          // Set for a split dump or a dump directory
+    bool pack = false;
+    bool from_archive = false;
     char *index_filename = NULL; // Dynamically allocated
     bool load_from_index = false;
     bool write_to_index = false;
     const char *dump_table_name = NULL;
+    const char *dump_table_list = NULL;
+    bool dump_all = false;
+    bool restore_plan = false;
+    RestoreOptions restore_options = {".", DEFAULT_RESTORE_STREAMS, 0, false};
+    RechunkOptions rechunk_options = {NULL, 0, (size_t)RECHUNK_DEFAULT_BATCH_KIB * 1024, false};
+    MydumperOptions mydumper_options = {NULL, NULL, (off_t)MYDUMPER_DEFAULT_CHUNK_MIB * 1024 * 1024, 0, 0};
+    MaskOptions mask_options = {NULL, NULL, 0, false};
+    SubsetOptions subset_options = {NULL, NULL, NULL, 0, false};
+    ExportOptions export_options = {".", 0, (size_t)EXPORT_DEFAULT_PIECE_MIB * 1024 * 1024, false, {COMPRESS_NONE, 0, 0}};
+    bool list_schemas = false;
+    bool list_tables = false;
+    bool assume_mysqldump = false;
+    bool resume = false;
+    long checkpoint_interval_mib = DEFAULT_CHECKPOINT_INTERVAL_MIB;
+    long gzip_span_mib = GZIP_DEFAULT_SPAN_MIB;
+    bool show_progress = false;
+    int progress_fd = -1;
+    const char *trace_filename = NULL;
+    bool perf_counters = false;
+    bool mem_stats = false;
 
     // --- Argument Parsing ---
     for (int i = 1; i < argc; ++i) {
@@ -39,20 +147,222 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Error: --dump-table requires a table name.\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "--dump-tables") == 0) {
+            if (i + 1 < argc) {
+                dump_table_list = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --dump-tables requires a comma-separated list of tables.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--pack") == 0) {
+            pack = true;
+        } else if (strcmp(argv[i], "--dump-all") == 0) {
+            dump_all = true;
+        } else if (strcmp(argv[i], "--plan-restore") == 0) {
+            restore_plan = true;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            char *end = NULL;
+            if (i + 1 < argc) {
+                restore_options.streams = (int)strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || restore_options.streams < 1) {
+                fprintf(stderr, "Error: -j requires a positive number of streams.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--rechunk") == 0) {
+            if (i + 1 < argc) {
+                rechunk_options.output_filename = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --rechunk requires an output file.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--batch-rows") == 0) {
+            char *end = NULL;
+            long long rows = -1;
+            if (i + 1 < argc) {
+                rows = strtoll(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || rows < 0) {
+                fprintf(stderr, "Error: --batch-rows requires a number of rows.\n");
+                return 1;
+            }
+            rechunk_options.max_rows = (uint64_t)rows;
+        } else if (strcmp(argv[i], "--batch-size") == 0) {
+            char *end = NULL;
+            long batch_kib = -1;
+            if (i + 1 < argc) {
+                batch_kib = strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || batch_kib < 0) {
+                fprintf(stderr, "Error: --batch-size requires a size in KiB.\n");
+                return 1;
+            }
+            rechunk_options.max_bytes = (size_t)batch_kib * 1024;
+        } else if (strcmp(argv[i], "--to-mydumper") == 0) {
+            if (i + 1 < argc) {
+                mydumper_options.output_dir = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --to-mydumper requires a directory.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--chunk-rows") == 0) {
+            char *end = NULL;
+            long long rows = -1;
+            if (i + 1 < argc) {
+                rows = strtoll(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || rows < 0) {
+                fprintf(stderr, "Error: --chunk-rows requires a number of rows.\n");
+                return 1;
+            }
+            mydumper_options.chunk_rows = (uint64_t)rows;
+        } else if (strcmp(argv[i], "--chunk-size") == 0) {
+            char *end = NULL;
+            long chunk_mib = -1;
+            if (i + 1 < argc) {
+                chunk_mib = strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || chunk_mib < 0) {
+                fprintf(stderr, "Error: --chunk-size requires a size in MiB.\n");
+                return 1;
+            }
+            mydumper_options.chunk_bytes = (off_t)chunk_mib * 1024 * 1024;
+        } else if (strcmp(argv[i], "--database") == 0) {
+            if (i + 1 < argc) {
+                mydumper_options.database = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --database requires a name.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--mask") == 0) {
+            if (i + 1 < argc) {
+                mask_options.rules_filename = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --mask requires a rules file.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--mask-output") == 0) {
+            if (i + 1 < argc) {
+                mask_options.output_filename = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --mask-output requires an output file.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--subset") == 0) {
+            if (i + 2 < argc) {
+                subset_options.root_table = argv[++i];
+                subset_options.filter = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --subset requires a table and a filter such as \"id=42\".\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--subset-output") == 0) {
+            if (i + 1 < argc) {
+                subset_options.output_filename = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --subset-output requires an output file.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fifo") == 0) {
+            restore_options.fifo = true;
+        } else if (strcmp(argv[i], "--output-dir") == 0) {
+            if (i + 1 < argc) {
+                export_options.output_dir = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --output-dir requires a directory.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            char *end = NULL;
+            if (i + 1 < argc) {
+                export_options.threads = (int)strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || export_options.threads < 1) {
+                fprintf(stderr, "Error: --threads requires a positive number.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--output-compress") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --output-compress requires gzip or zstd.\n");
+                return 1;
+            }
+            if (!parse_compress_option(argv[++i], &export_options.compress)) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--split-size") == 0) {
+            char *end = NULL;
+            long split_mib = -1;
+            if (i + 1 < argc) {
+                split_mib = strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || split_mib < 0) {
+                fprintf(stderr, "Error: --split-size requires a size in MiB.\n");
+                return 1;
+            }
+            export_options.piece_size = (size_t)split_mib * 1024 * 1024;
+        } else if (strcmp(argv[i], "--schemas") == 0) {
+            list_schemas = true;
+        } else if (strcmp(argv[i], "--list-tables") == 0) {
+            list_tables = true;
+        } else if (strcmp(argv[i], "--assume-mysqldump") == 0) {
+            assume_mysqldump = true;
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            resume = true;
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0) {
+            char *end = NULL;
+            if (i + 1 < argc) {
+                checkpoint_interval_mib = strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || checkpoint_interval_mib < 0) {
+                fprintf(stderr, "Error: --checkpoint-interval requires a size in MiB.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--gzip-span") == 0) {
+            char *end = NULL;
+            if (i + 1 < argc) {
+                gzip_span_mib = strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || gzip_span_mib <= 0) {
+                fprintf(stderr, "Error: --gzip-span requires a size in MiB.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--progress") == 0) {
+            show_progress = true;
+        } else if (strcmp(argv[i], "--progress-fd") == 0) {
+            char *end = NULL;
+            if (i + 1 < argc) {
+                progress_fd = (int)strtol(argv[++i], &end, 10);
+            }
+            if (!end || *end != '\0' || progress_fd < 0) {
+                fprintf(stderr, "Error: --progress-fd requires a file descriptor number.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            mem_stats = true;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            perf_counters = true;
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            if (i + 1 < argc) {
+                trace_filename = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --trace requires an output file.\n");
+                return 1;
+            }
         } else if (argv[i][0] == '-') {
             fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
             print_usage(argv[0]);
             return 1;
         } else {
-            if (sql_filename == NULL) {
-                sql_filename = argv[i];
-            } else {
-                fprintf(stderr, "Error: Multiple SQL files specified ('%s' and '%s'). Only one is allowed.\n", sql_filename, argv[i]);
-                print_usage(argv[0]);
-                return 1;
-            }
+            input_files[input_count++] = argv[i]; // Never past i, so no argument is overwritten unread
         }
     }
+    // --pack takes the archive last
+    if (pack && input_count > 1) {
+        pack_filename = input_files[--input_count];
+    }
+    if (input_count > 0) {
+        sql_filename = input_files[0];
+    }
 
     if (verbose_mode) {
         DEBUG_PRINT("Verbose mode enabled.");
@@ -64,27 +374,152 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (pack && pack_filename == NULL) {
+        fprintf(stderr, "Error: --pack requires a SQL file and an archive file.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Each run performs one action
+    int actions = pack + (rechunk_options.output_filename != NULL) + (mydumper_options.output_dir != NULL) +
+                  (mask_options.rules_filename != NULL) + (subset_options.root_table != NULL) + restore_plan +
+                  (dump_table_list != NULL || dump_all) + (dump_table_name != NULL) + list_tables + list_schemas;
+    if (actions > 1) {
+        fprintf(stderr, "Error: Only one of --pack, --rechunk, --to-mydumper, --mask, --subset, --plan-restore,\n"
+                        "       --dump-tables/--dump-all, --dump-table, --list-tables and --schemas can be given.\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    if (mask_options.rules_filename && mask_options.output_filename == NULL) {
+        fprintf(stderr, "Error: --mask requires --mask-output <out.sql>.\n");
+        return 1;
+    }
+    if (subset_options.root_table && subset_options.output_filename == NULL) {
+        fprintf(stderr, "Error: --subset requires --subset-output <out.sql>.\n");
+        return 1;
+    }
+
+    // Several files, or a directory, form one multi-part dump
+    struct stat input_st;
+    if (input_count > 1) {
+        for (int i = 0; i < input_count; ++i) {
+            if (!add_input_part(&parts, input_files[i])) {
+                cleanup_input_parts(&parts);
+                return 1;
+            }
+        }
+        if (parts.count == 0) {
+            fprintf(stderr, "Error: None of the files given is a part of the dump.\n");
+            cleanup_input_parts(&parts);
+            return 1;
+        }
+        sql_filename = parts.parts[0].path; // Skipped files may come first
+    } else if (stat(sql_filename, &input_st) == 0 && S_ISDIR(input_st.st_mode) && !add_input_directory(&parts, sql_filename)) {
+        cleanup_input_parts(&parts);
+        return 1;
+    }
+    bool multi_part = parts.count > 0;
+    if (pack && multi_part) {
+        fprintf(stderr, "Error: Only a single SQL file can be packed.\n");
+        cleanup_input_parts(&parts);
+        return 1;
+    }
+    if (pack && export_options.compress.format == COMPRESS_GZIP) {
+        fprintf(stderr, "Error: Archives are written with zstd only.\n");
+        return 1;
+    }
+    if (pack && export_options.compress.format == COMPRESS_NONE && !parse_compress_option("zstd", &export_options.compress)) {
+        return 1;
+    }
+
+    if (dump_table_name && export_options.compress.format != COMPRESS_NONE && isatty(STDOUT_FILENO)) {
+        fprintf(stderr, "Error: Not writing compressed data to a terminal; redirect stdout.\n");
+        cleanup_input_parts(&parts);
+        return 1;
+    }
+    export_options.compress.threads = export_options.threads;
+
+    if (trace_filename) {
+#ifdef SQLINDEXER_TRACE
+        if (!trace_start(trace_filename)) {
+            cleanup_input_parts(&parts);
+            return 1;
+        }
+#else
+        fprintf(stderr, "Error: --trace is not available; rebuild with -DSQLINDEXER_TRACE=ON.\n");
+        cleanup_input_parts(&parts);
+        return 1;
+#endif
+    }
+
+    mem_stats_init();
+
     // --- Determine Index Filename ---
-    size_t sql_len = strlen(sql_filename);
-    index_filename = malloc(sql_len + 7); // + ".index" + null terminator
+    // "dump.sql.part-aa ..." indexes to "dump.sql.parts.index", which the parts' glob does not match
+    size_t sql_len = input_parts_base_length(&parts, sql_filename);
+    while (sql_len > 1 && sql_filename[sql_len - 1] == '/') sql_len--; // "dump/" indexes to "dump.index"
+    const char *split_suffix = multi_part && !parts.independent ? ".parts" : "";
+    index_filename = malloc(sql_len + 13); // + ".parts" + ".index" + null terminator
     if (!index_filename) {
         perror("Error allocating memory for index filename");
+        cleanup_input_parts(&parts);
+        return 1;
+    }
+    sprintf(index_filename, "%.*s%s.index", (int)sql_len, sql_filename, split_suffix);
+    char *checkpoint_filename = malloc(sql_len + 18); // + ".parts" + ".checkpoint" + null terminator
+    if (!checkpoint_filename) {
+        perror("Error allocating memory for checkpoint filename");
+        free(index_filename);
+        cleanup_input_parts(&parts);
         return 1;
     }
-    sprintf(index_filename, "%s.index", sql_filename);
+    sprintf(checkpoint_filename, "%.*s%s.checkpoint", (int)sql_len, sql_filename, split_suffix);
 
     ParsingContext ctx = {0};
     SqlIndex index = {0};
+    ProgressReporter progress;
+    PerfCounters perf_storage;
+    PerfCounters *perf = NULL;
+    off_t file_size = 0;
     bool success = true;
 
+    if (perf_counters) {
+        struct stat st;
+        if (!perf_counters_open(&perf_storage)) {
+            fprintf(stderr, "Warning: No performance counters available (see /proc/sys/kernel/perf_event_paranoid).\n");
+        }
+        perf = &perf_storage;
+        file_size = multi_part ? input_parts_size(&parts) : stat(sql_filename, &st) == 0 ? st.st_size : 0;
+    }
+
     // --- Index Loading/Parsing Logic ---
     char current_sha[65] = {0};
 
-    if (access(index_filename, F_OK) == 0) {
+    if (!multi_part && is_sql_archive(sql_filename)) {
+        from_archive = true;
+        if (read_index_from_archive(&index, sql_filename)) {
+            fprintf(dump_table_name ? stderr : stdout, "Successfully loaded %d entries from archive '%s'.\n",
+                    index.count, sql_filename);
+            load_from_index = true;
+        } else {
+            success = false;
+        }
+    } else if (access(index_filename, F_OK) == 0) {
         DEBUG_PRINT("Index file '%s' exists. Attempting to load.", index_filename);
         if (read_index_from_file(&index, index_filename)) {
-            if (index.sql_file_sha256[0] != '\0') {
-                if (calculate_sha256(sql_filename, current_sha)) {
+            // stdout carries the table data with --dump-table
+            fprintf(dump_table_name ? stderr : stdout, "Successfully loaded %d entries from index file '%s'.\n",
+                    index.count, index_filename);
+            if (!same_input_parts(&index.parts, &parts)) {
+                DEBUG_PRINT("Input files changed. Re-parsing.");
+                cleanup_index(&index);
+                write_to_index = true;
+            } else if (index.sql_file_sha256[0] != '\0') {
+                phase_begin(perf, "hash");
+                bool hashed = hash_input(sql_filename, &parts, export_options.threads, current_sha);
+                phase_end(perf, (uint64_t)file_size);
+                if (hashed) {
                     if (strcmp(index.sql_file_sha256, current_sha) == 0) {
                         DEBUG_PRINT("SHA256 match. Using existing index.");
                         load_from_index = true;
@@ -111,34 +546,76 @@ int main(int argc, char *argv[]) {
         write_to_index = true;
     }
 
-    if (!load_from_index) {
+    // Parts are hashed up front, which also numbers their lines
+    if (success && !load_from_index && multi_part && current_sha[0] == '\0') {
+        phase_begin(perf, "hash");
+        success = hash_input_parts(&parts, export_options.threads, current_sha);
+        phase_end(perf, (uint64_t)file_size);
+    }
+
+    if (success && !load_from_index && parts.independent) {
+        // Dump directory: one scan per file, merged into one index
+        TRACE_BEGIN(scan_start);
+        phase_begin(perf, "scan");
+        success = index_input_parts(&index, &parts, export_options.threads, assume_mysqldump);
+        phase_end(perf, (uint64_t)file_size);
+        TRACE_END(scan_start, "scan", "index directory", sql_filename);
+    } else if (success && !load_from_index) {
         DEBUG_PRINT("Initializing context for parsing %s", sql_filename);
-        if (!initialize_context(&ctx, sql_filename)) {
+        FILE *parts_stream = multi_part ? open_parts_stream(&parts) : NULL;
+        if (multi_part ? !parts_stream || !initialize_context_stream(&ctx, parts_stream)
+                       : !initialize_context(&ctx, sql_filename)) {
             fprintf(stderr, "Error initializing context for file '%s'.\n", sql_filename);
             success = false;
         } else {
+            ctx.assume_mysqldump = assume_mysqldump;
+            // Saves a second pass over the file for the index SHA256. A .sql.gz
+            // is hashed as stored and split parts one by one; neither stream
+            // can be checkpointed.
+            bool plain_file = !ctx.gzip_input && !multi_part;
+            ctx.hash_input = plain_file;
+            if (ctx.gzip_input) {
+                ctx.index.gzip.span = (off_t)gzip_span_mib * 1024 * 1024;
+            } else if (plain_file && checkpoint_interval_mib > 0) {
+                ctx.checkpoint_filename = checkpoint_filename;
+                ctx.checkpoint_interval = (off_t)checkpoint_interval_mib * 1024 * 1024;
+            }
+            if (resume && plain_file && !resume_from_checkpoint(&ctx, checkpoint_filename)) {
+                DEBUG_PRINT("No usable checkpoint. Scanning from the start.");
+            }
+            // JSON lines to a descriptor take precedence over the text report
+            FILE *progress_out = NULL;
+            if (progress_fd >= 0 && !(progress_out = fdopen(progress_fd, "w"))) {
+                fprintf(stderr, "Warning: Cannot report progress to fd %d: %s\n", progress_fd, strerror(errno));
+            }
+            if (progress_out || show_progress) {
+                struct stat st;
+                // Scanned bytes of a .sql.gz are decompressed ones; its total is unknown
+                off_t total_bytes = multi_part ? input_parts_size(&parts)
+                                    : !ctx.gzip_input && stat(sql_filename, &st) == 0 ? st.st_size : 0;
+                progress_start(&progress, progress_out ? progress_out : stderr,
+                               progress_out ? PROGRESS_JSON : PROGRESS_TEXT, total_bytes, ctx.global_offset);
+                ctx.progress = &progress;
+            }
             DEBUG_PRINT("Context initialized. Starting file processing.");
-            if (!process_sql_file(&ctx)) {
+            off_t scan_offset = ctx.global_offset;
+            TRACE_BEGIN(scan_start);
+            phase_begin(perf, "scan");
+            bool scanned = process_sql_file(&ctx);
+            phase_end(perf, (uint64_t)(ctx.global_offset - scan_offset));
+            TRACE_END(scan_start, "scan", "index file", sql_filename);
+            if (!scanned) {
                 fprintf(stderr, "Error processing SQL file '%s'.\n", sql_filename);
                 success = false;
             } else {
                 DEBUG_PRINT("File processing finished. Index count: %d", ctx.index.count);
+                get_scan_sha256(&ctx, current_sha);
+                remove_checkpoint(checkpoint_filename);
                 index = ctx.index;
-                ctx.index.entries = NULL; // Prevent double free
-                ctx.index.count = 0;
-                ctx.index.capacity = 0;
-
-                if (write_to_index) {
-                    DEBUG_PRINT("Writing index to %s", index_filename);
-                    // Calculate hash if not already calculated
-                    if (current_sha[0] == '\0') {
-                        calculate_sha256(sql_filename, current_sha);
-                    }
-                    if (!write_index_to_file(&index, index_filename, current_sha)) {
-                        fprintf(stderr, "Error writing index file '%s'.\n", index_filename);
-                    } else {
-                        DEBUG_PRINT("Index written successfully.");
-                    }
+                ctx.index = (SqlIndex){0}; // Prevent double free
+                if (multi_part) {
+                    success = copy_input_parts(&index.parts, &parts);
+                    assign_entry_parts(&index);
                 }
             }
             cleanup_context(&ctx);
@@ -146,19 +623,121 @@ int main(int argc, char *argv[]) {
     }
 
     if (success) {
-        if (dump_table_name) {
+        if (pack) {
+            if (from_archive) {
+                fprintf(stderr, "Error: '%s' is already a packed archive.\n", sql_filename);
+                success = false;
+            } else {
+                // The archive's index carries every table's columns
+                phase_begin(perf, "columns");
+                success = load_all_table_columns(&index, sql_filename);
+                phase_end(perf, 0);
+                if (current_sha[0] == '\0') {
+                    hash_input(sql_filename, &parts, export_options.threads, current_sha);
+                }
+                TRACE_BEGIN(pack_start);
+                phase_begin(perf, "pack");
+                if (success && !pack_sql_file(&index, sql_filename, current_sha, pack_filename, &export_options.compress)) {
+                    success = false;
+                }
+                phase_end(perf, (uint64_t)file_size);
+                TRACE_END(pack_start, "pack", "pack archive", pack_filename);
+            }
+        } else if (rechunk_options.output_filename) {
+            rechunk_options.assume_mysqldump = assume_mysqldump;
+            TRACE_BEGIN(rechunk_start);
+            phase_begin(perf, "rechunk");
+            success = rechunk_inserts(&index, sql_filename, &rechunk_options);
+            phase_end(perf, (uint64_t)file_size);
+            TRACE_END(rechunk_start, "rechunk", "rechunk inserts", rechunk_options.output_filename);
+        } else if (mydumper_options.output_dir) {
+            mydumper_options.threads = export_options.threads;
+            TRACE_BEGIN(mydumper_start);
+            phase_begin(perf, "mydumper");
+            success = export_mydumper(&index, sql_filename, &mydumper_options);
+            phase_end(perf, (uint64_t)file_size);
+            TRACE_END(mydumper_start, "mydumper", "convert to mydumper", mydumper_options.output_dir);
+        } else if (mask_options.rules_filename) {
+            mask_options.threads = export_options.threads;
+            mask_options.assume_mysqldump = assume_mysqldump;
+            TRACE_BEGIN(mask_start);
+            phase_begin(perf, "mask");
+            success = mask_dump(&index, sql_filename, &mask_options);
+            phase_end(perf, (uint64_t)file_size);
+            TRACE_END(mask_start, "mask", "mask columns", mask_options.output_filename);
+        } else if (subset_options.root_table) {
+            subset_options.threads = export_options.threads;
+            subset_options.assume_mysqldump = assume_mysqldump;
+            TRACE_BEGIN(subset_start);
+            phase_begin(perf, "subset");
+            success = extract_subset(&index, sql_filename, &subset_options);
+            phase_end(perf, (uint64_t)file_size);
+            TRACE_END(subset_start, "subset", "extract subset", subset_options.output_filename);
+        } else if (restore_plan) {
+            restore_options.output_dir = export_options.output_dir;
+            restore_options.threads = export_options.threads;
+            TRACE_BEGIN(restore_start);
+            phase_begin(perf, "restore");
+            success = plan_restore(&index, sql_filename, &restore_options);
+            phase_end(perf, (uint64_t)file_size);
+            TRACE_END(restore_start, "restore", "plan restore", export_options.output_dir);
+        } else if (dump_table_list || dump_all) {
+            bool *selected = mem_calloc(MEM_EXPORT, index.count > 0 ? (size_t)index.count : 1, sizeof(bool));
+            if (!selected) {
+                perror("Failed to allocate table selection");
+                success = false;
+            } else {
+                success = select_tables(&index, dump_all ? NULL : dump_table_list, selected);
+                export_options.assume_mysqldump = assume_mysqldump;
+                TRACE_BEGIN(export_start);
+                phase_begin(perf, "export");
+                if (!export_tables(&index, sql_filename, selected, &export_options)) {
+                    success = false;
+                }
+                phase_end(perf, (uint64_t)file_size);
+                TRACE_END(export_start, "export", "dump tables", export_options.output_dir);
+                free(selected);
+            }
+        } else if (dump_table_name) {
             DEBUG_PRINT("Dumping table '%s' as JSON.", dump_table_name);
-            dump_table_as_json(&index, dump_table_name, sql_filename);
+            // The first table of that name, exported like --dump-tables but to stdout
+            int entry = -1;
+            for (int i = 0; i < index.count && entry < 0; ++i) {
+                if (index.entries[i].table_info && strcmp(index.entries[i].name, dump_table_name) == 0) {
+                    entry = i;
+                }
+            }
+            if (entry < 0) {
+                fprintf(stderr, "Table '%s' not found in index.\n", dump_table_name);
+                success = false;
+            } else {
+                export_options.assume_mysqldump = assume_mysqldump;
+                TRACE_BEGIN(export_start);
+                phase_begin(perf, "export");
+                success = export_table_stream(&index, sql_filename, entry, stdout, &export_options);
+                phase_end(perf, 0);
+                TRACE_END(export_start, "export", "dump table", dump_table_name);
+            }
+        } else if (list_tables) {
+            print_table_list(&index);
+        } else if (list_schemas) {
+            phase_begin(perf, "columns");
+            success = load_all_table_columns(&index, sql_filename);
+            phase_end(perf, 0);
+            print_schemas(&index);
         } else {
             DEBUG_PRINT("Printing results.");
+            phase_begin(perf, "columns");
+            success = load_all_table_columns(&index, sql_filename);
+            phase_end(perf, 0);
             print_results(&index);
 
             // --- Example: Get sample for the first table ---
             if (index.count > 0 && index.entries[0].table_info && sql_filename) {
                  DEBUG_PRINT("Attempting to get sample row for table: %s", index.entries[0].table_info->name);
-                 char* sample = get_first_row_sample(sql_filename, index.entries[0].table_info->end_offset, index.entries[0].table_info->name);
+                 char* sample = get_first_row_sample(&index, sql_filename, index.entries[0].table_info->end_offset, index.entries[0].table_info->name);
                  if (sample) {
-                     printf("\n--- Sample First Row for %s (Offset: %ld) ---\n", index.entries[0].table_info->name, index.entries[0].table_info->end_offset);
+                     printf("\n--- Sample First Row for %s (Offset: %jd) ---\n", index.entries[0].table_info->name, (intmax_t)index.entries[0].table_info->end_offset);
                      printf("%s\n", sample);
                      printf("------------------------------------------\n");
                      free(sample);
@@ -171,15 +750,99 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Save a fresh index, or one that gained lazily parsed columns
+    if (success && !from_archive && (write_to_index || index.modified)) {
+        DEBUG_PRINT("Writing index to %s", index_filename);
+        // Calculate hash if not already calculated
+        if (current_sha[0] == '\0') {
+            hash_input(sql_filename, &parts, export_options.threads, current_sha);
+        }
+        if (!write_index_to_file(&index, index_filename, current_sha)) {
+            fprintf(stderr, "Error writing index file '%s'.\n", index_filename);
+        } else {
+            DEBUG_PRINT("Index written successfully.");
+        }
+    }
+
     // Cleanup the index structure (if loaded or successfully parsed)
     DEBUG_PRINT("Cleaning up index structure.");
     cleanup_index(&index);
+    cleanup_input_parts(&parts);
 
-    // Free the dynamically allocated index filename
+    // Free the dynamically allocated filenames
     free(index_filename);
+    free(checkpoint_filename);
+
+    if (perf) {
+        perf_counters_print(perf, stderr);
+        perf_counters_close(perf);
+    }
+    if (mem_stats) {
+        mem_stats_print(stderr);
+    }
+
+#ifdef SQLINDEXER_TRACE
+    if (trace_filename && !trace_stop()) {
+        success = false;
+    }
+#endif
 
     DEBUG_PRINT("Exiting %s.", success ? "successfully" : "with errors");
     return success ? 0 : 1;
 }
 
-// --- Static Helper Function Implementations ---
\ No newline at end of file
+// --- Static Helper Function Implementations ---
+
+static void phase_begin(PerfCounters *perf, const char *phase) {
+    if (perf) {
+        perf_counters_begin(perf, phase);
+    }
+}
+
+static void phase_end(PerfCounters *perf, uint64_t bytes) {
+    if (perf) {
+        perf_counters_end(perf, bytes);
+    }
+}
+
+// SHA256 of the SQL file, or of the parts of a multi-part dump
+static bool hash_input(const char *sql_filename, InputParts *parts, int threads, char *hash_buffer) {
+    if (parts->count > 0) {
+        return hash_input_parts(parts, threads, hash_buffer);
+    }
+    return calculate_sha256(sql_filename, hash_buffer);
+}
+
+// Marks every table named in the comma-separated list (all tables of a
+// repeated name), or all tables if list is NULL. Unknown names are reported
+// and make the result false; the known ones stay selected.
+static bool select_tables(const SqlIndex *index, const char *list, bool *selected) {
+    bool ok = true;
+    if (!list) {
+        for (int i = 0; i < index->count; ++i) {
+            selected[i] = index->entries[i].table_info != NULL;
+        }
+        return true;
+    }
+    const char *name = list;
+    while (true) {
+        size_t len = strcspn(name, ",");
+        if (len > 0) {
+            bool found = false;
+            for (int i = 0; i < index->count; ++i) {
+                const char *entry_name = index->entries[i].name;
+                if (index->entries[i].table_info && strncmp(entry_name, name, len) == 0 && entry_name[len] == '\0') {
+                    selected[i] = true;
+                    found = true;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "Table '%.*s' not found in index.\n", (int)len, name);
+                ok = false;
+            }
+        }
+        if (name[len] == '\0') break;
+        name += len + 1;
+    }
+    return ok;
+}
@@ -0,0 +1,129 @@
+#include "mem_stats.h"
+#include <stdint.h>
+#include <sys/resource.h> // For getrusage
+#ifdef SQLINDEXER_MEM_STATS
+#include <stdatomic.h>
+#include <cjson/cJSON.h>
+#if defined(__GLIBC__)
+#include <malloc.h> // For malloc_usable_size
+#endif
+#endif
+
+static const char *const SUBSYSTEM_NAMES[MEM_SUBSYSTEM_COUNT] = {
+    "index", "columns", "buffers", "rows", "export", "other"
+};
+
+#ifdef SQLINDEXER_MEM_STATS
+
+// Relaxed atomics: totals only need to be exact once the work is done
+typedef struct {
+    atomic_uint_fast64_t allocations;   // malloc, calloc, strdup, and realloc of NULL
+    atomic_uint_fast64_t reallocations; // realloc of an existing block
+    atomic_uint_fast64_t bytes;         // Bytes requested, counting only the growth of reallocs
+    atomic_uint_fast64_t largest;       // Largest single request
+} MemCounters;
+
+static MemCounters counters[MEM_SUBSYSTEM_COUNT];
+
+// --- Static Helper Function Declarations ---
+static void count_allocation(MemSubsystem subsystem, size_t bytes, size_t request, bool reallocation);
+static void *cjson_malloc(size_t size);
+
+// --- Function Implementations ---
+
+void *mem_malloc(MemSubsystem subsystem, size_t size) {
+    void *ptr = malloc(size);
+    if (ptr) count_allocation(subsystem, size, size, false);
+    return ptr;
+}
+
+void *mem_calloc(MemSubsystem subsystem, size_t n, size_t size) {
+    void *ptr = calloc(n, size);
+    if (ptr) count_allocation(subsystem, n * size, n * size, false);
+    return ptr;
+}
+
+void *mem_realloc(MemSubsystem subsystem, void *ptr, size_t size) {
+    size_t old_size = 0;
+#if defined(__GLIBC__)
+    old_size = ptr ? malloc_usable_size(ptr) : 0;
+#endif
+    void *new_ptr = realloc(ptr, size);
+    if (new_ptr) count_allocation(subsystem, size > old_size ? size - old_size : 0, size, ptr != NULL);
+    return new_ptr;
+}
+
+char *mem_strdup(MemSubsystem subsystem, const char *s) {
+    char *copy = strdup(s);
+    if (copy) {
+        size_t size = strlen(s) + 1;
+        count_allocation(subsystem, size, size, false);
+    }
+    return copy;
+}
+
+void mem_stats_init(void) {
+    cJSON_Hooks hooks = {cjson_malloc, free};
+    cJSON_InitHooks(&hooks);
+}
+
+#endif // SQLINDEXER_MEM_STATS
+
+void mem_stats_totals(MemTotals *totals) {
+    memset(totals, 0, sizeof(*totals));
+#ifdef SQLINDEXER_MEM_STATS
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; ++i) {
+        totals->allocations += atomic_load_explicit(&counters[i].allocations, memory_order_relaxed);
+        totals->reallocations += atomic_load_explicit(&counters[i].reallocations, memory_order_relaxed);
+        totals->bytes += atomic_load_explicit(&counters[i].bytes, memory_order_relaxed);
+    }
+#endif
+}
+
+void mem_stats_print(FILE *out) {
+    fprintf(out, "\nMemory:\n");
+#ifdef SQLINDEXER_MEM_STATS
+    fprintf(out, "%-10s %12s %12s %14s %14s\n", "Subsystem", "Allocs", "Reallocs", "Bytes", "Largest");
+    uint64_t total_allocs = 0, total_reallocs = 0, total_bytes = 0;
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; ++i) {
+        uint64_t allocs = atomic_load_explicit(&counters[i].allocations, memory_order_relaxed);
+        uint64_t reallocs = atomic_load_explicit(&counters[i].reallocations, memory_order_relaxed);
+        uint64_t bytes = atomic_load_explicit(&counters[i].bytes, memory_order_relaxed);
+        uint64_t largest = atomic_load_explicit(&counters[i].largest, memory_order_relaxed);
+        fprintf(out, "%-10s %12llu %12llu %14llu %14llu\n", SUBSYSTEM_NAMES[i], (unsigned long long)allocs,
+                (unsigned long long)reallocs, (unsigned long long)bytes, (unsigned long long)largest);
+        total_allocs += allocs;
+        total_reallocs += reallocs;
+        total_bytes += bytes;
+    }
+    fprintf(out, "%-10s %12llu %12llu %14llu\n", "total", (unsigned long long)total_allocs,
+            (unsigned long long)total_reallocs, (unsigned long long)total_bytes);
+#else
+    (void)SUBSYSTEM_NAMES;
+    fprintf(out, "(allocation counters not built in; configure with -DSQLINDEXER_MEM_STATS=ON)\n");
+#endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        fprintf(out, "Peak RSS: %.1f MiB\n", (double)usage.ru_maxrss / 1024.0); // ru_maxrss is in KiB on Linux
+    }
+}
+
+#ifdef SQLINDEXER_MEM_STATS
+
+// --- Static Helper Function Implementations ---
+
+static void count_allocation(MemSubsystem subsystem, size_t bytes, size_t request, bool reallocation) {
+    MemCounters *c = &counters[subsystem];
+    atomic_fetch_add_explicit(reallocation ? &c->reallocations : &c->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->bytes, bytes, memory_order_relaxed);
+    uint_fast64_t largest = atomic_load_explicit(&c->largest, memory_order_relaxed);
+    while (request > largest &&
+           !atomic_compare_exchange_weak_explicit(&c->largest, &largest, request, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void *cjson_malloc(size_t size) {
+    return mem_malloc(MEM_EXPORT, size);
+}
+
+#endif // SQLINDEXER_MEM_STATS
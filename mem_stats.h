@@ -0,0 +1,57 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Allocation Accounting ---
+// The indexer allocates through these wrappers, tagged with the subsystem
+// the memory belongs to. With the SQLINDEXER_MEM_STATS CMake option they
+// count calls, bytes requested and realloc growth per subsystem; without it
+// they are plain malloc/calloc/realloc/strdup. Memory is always released
+// with free().
+
+typedef enum {
+    MEM_INDEX,              // Index entries, table records and schemas
+    MEM_COLUMNS,            // Parsed column and key definitions
+    MEM_BUFFERS,            // Read buffers and index-file line buffers
+    MEM_ROWS,               // INSERT row values streamed to hooks
+    MEM_EXPORT,             // JSON export, including cJSON's own allocations
+    MEM_OTHER,
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+#ifdef SQLINDEXER_MEM_STATS
+
+void *mem_malloc(MemSubsystem subsystem, size_t size);
+void *mem_calloc(MemSubsystem subsystem, size_t count, size_t size);
+void *mem_realloc(MemSubsystem subsystem, void *ptr, size_t size);
+char *mem_strdup(MemSubsystem subsystem, const char *s);
+
+// Routes cJSON's allocations through MEM_EXPORT
+void mem_stats_init(void);
+
+#else
+
+#define mem_malloc(subsystem, size) malloc(size)
+#define mem_calloc(subsystem, count, size) calloc(count, size)
+#define mem_realloc(subsystem, ptr, size) realloc(ptr, size)
+#define mem_strdup(subsystem, s) strdup(s)
+#define mem_stats_init() ((void)0)
+
+#endif // SQLINDEXER_MEM_STATS
+
+// Sums over all subsystems; all zero unless built in
+typedef struct {
+    unsigned long long allocations;
+    unsigned long long reallocations;
+    unsigned long long bytes;
+} MemTotals;
+void mem_stats_totals(MemTotals *totals);
+
+// Prints the counters (if built in) and the peak RSS of the process
+void mem_stats_print(FILE *out);
+
+#endif // MEM_STATS_H
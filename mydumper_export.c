@@ -0,0 +1,512 @@
+#include "mydumper_export.h"
+#include "dump_map.h"
+#include "dump_regions.h"
+#include "work_pool.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h> // For offsetof
+#include <errno.h>
+#include <inttypes.h> // For PRIu64
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef struct {
+    char *name;
+    bool has_post;              // <db>-schema-post.sql has been started
+} MydumperDatabase;
+
+typedef struct {
+    const char *database;
+    char *name;
+} MydumperView;
+
+struct MydumperJob;
+
+typedef struct {
+    struct MydumperJob *job;
+    const DumpRegion *region;
+    const char *database;
+    const Segment **triggers;   // Triggers ON the table, wherever the dump has them
+    int trigger_count;
+    int trigger_capacity;
+    int chunks;                 // Data files written
+    bool ok;
+} MydumperTable;
+
+typedef struct MydumperJob {
+    const MydumperOptions *options;
+    DumpMap dump;
+    DumpRegions regions;
+    MydumperDatabase *databases;
+    int database_count;
+    int database_capacity;
+    MydumperView *views;
+    int view_count;
+    int view_capacity;
+    MydumperTable *tables;
+    int table_count;
+    char *default_database;     // For tables before any USE
+} MydumperJob;
+
+// --- Static Helper Function Declarations ---
+static char *file_stem(const char *path);
+static bool write_schema_files(MydumperJob *job);
+static const char *use_database(MydumperJob *job, const char *name);
+static MydumperDatabase *find_database(MydumperJob *job, const char *name);
+static bool add_view(MydumperJob *job, const char *database, char *name);
+static bool is_view(const MydumperJob *job, const char *database, const char *name);
+static MydumperTable *find_table(MydumperJob *job, const char *database, const char *name);
+static bool add_trigger(MydumperTable *table, const Segment *segment);
+static void write_table_task(void *arg);
+static bool write_table(MydumperTable *table);
+static bool write_file(MydumperJob *job, const char *path, off_t start, off_t end);
+static char *mydumper_path(const char *output_dir, const char *database, const char *name, const char *suffix);
+static int open_output(const char *path, bool append);
+static bool close_output(int fd, const char *path, bool ok);
+static bool write_metadata(const char *output_dir, time_t started, time_t finished);
+
+// --- Function Implementations ---
+
+bool export_mydumper(const SqlIndex *index, const char *sql_filename, const MydumperOptions *options) {
+    time_t started = time(NULL);
+    MydumperJob job = {0};
+    job.options = options;
+    if (mkdir(options->output_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating output directory '%s': %s\n", options->output_dir, strerror(errno));
+        return false;
+    }
+    if (!dump_map_open(&job.dump, sql_filename, index) || !init_dump_regions(&job.regions, index, &job.dump)) {
+        dump_map_close(&job.dump);
+        return false;
+    }
+    DumpRegions *regions = &job.regions;
+    job.default_database = options->database ? mem_strdup(MEM_EXPORT, options->database) : file_stem(sql_filename);
+    regions->cut_interval = options->chunk_bytes;
+    regions->cut_rows = options->chunk_rows;
+
+    bool ok = job.default_database && classify_dump_regions(regions, options->threads) && check_region_data(regions);
+    job.tables = mem_calloc(MEM_EXPORT, (size_t)regions->count, sizeof(MydumperTable));
+    MydumperTable **order = mem_malloc(MEM_EXPORT, (size_t)regions->count * sizeof(MydumperTable *));
+    if (ok && (!job.tables || !order)) {
+        perror("Failed to allocate mydumper tables");
+        ok = false;
+    }
+    // The session SETs head every file, so they are filled once here
+    for (int j = 0; ok && j < regions->regions[0].segment_count; ++j) {
+        const Segment *segment = &regions->regions[0].segments[j];
+        if (segment->kind == SEG_SET) {
+            ok = dump_map_fill(&job.dump, segment->start, segment->end);
+        }
+    }
+    ok = ok && write_schema_files(&job);
+
+    int chunks = 0;
+    if (ok) {
+        WorkPool pool;
+        if (work_pool_start(&pool, options->threads > 0 ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN))) {
+            for (int i = 0; i < job.table_count; ++i) {
+                order[i] = &job.tables[i];
+            }
+            sort_by_data_size(order, job.table_count, offsetof(MydumperTable, region));
+            for (int i = 0; i < job.table_count; ++i) {
+                if (!work_pool_submit(&pool, write_table_task, order[i])) {
+                    order[i]->ok = false;
+                }
+            }
+            work_pool_stop(&pool);
+            for (int i = 0; i < job.table_count; ++i) {
+                ok = ok && job.tables[i].ok;
+                chunks += job.tables[i].chunks;
+            }
+        } else {
+            ok = false;
+        }
+    }
+
+    ok = ok && write_metadata(options->output_dir, started, time(NULL));
+    if (ok) {
+        printf("Wrote %d tables in %d data files, %d views and %d databases to '%s'.\n", job.table_count, chunks,
+               job.view_count, job.database_count, options->output_dir);
+    }
+
+    for (int i = 0; i < job.database_count; ++i) {
+        free(job.databases[i].name);
+    }
+    for (int i = 0; i < job.view_count; ++i) {
+        free(job.views[i].name);
+    }
+    for (int i = 0; job.tables && i < job.table_count; ++i) {
+        free(job.tables[i].triggers);
+    }
+    free(job.databases);
+    free(job.views);
+    free(job.default_database);
+    free(job.tables);
+    free(order);
+    cleanup_dump_regions(regions);
+    dump_map_close(&job.dump);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+// "/backups/shop.sql.gz" -> "shop", "/backups/shop/" -> "shop"
+static char *file_stem(const char *path) {
+    size_t end = strlen(path);
+    while (end > 1 && path[end - 1] == '/') end--;
+    size_t start = end;
+    while (start > 0 && path[start - 1] != '/') start--;
+    size_t len = start;
+    while (len < end && path[len] != '.') len++;
+    len -= start;
+    char *stem = mem_malloc(MEM_EXPORT, len + 1);
+    if (!stem) {
+        perror("Failed to allocate database name");
+        return NULL;
+    }
+    memcpy(stem, path + start, len);
+    stem[len] = '\0';
+    return stem;
+}
+
+// Walks the statements outside the data in dump order, following USE:
+// assigns every table its database and its triggers (by the table named
+// after ON, in the current database) and writes the views, routines and
+// CREATE DATABASE files. Tables are left to the workers.
+static bool write_schema_files(MydumperJob *job) {
+    const MydumperOptions *options = job->options;
+    DumpRegions *regions = &job->regions;
+    char *use = NULL;
+    bool ok = true;
+    for (int i = 0; i < regions->count && ok; ++i) {
+        const DumpRegion *region = &regions->regions[i];
+        const char *current = use ? use : job->default_database;
+        if (region->table_info) {
+            MydumperTable *table = &job->tables[job->table_count++];
+            table->job = job;
+            table->region = region;
+            ok = (table->database = use_database(job, current)) != NULL;
+        }
+        for (int j = 0; j < region->segment_count && ok; ++j) {
+            const Segment *segment = &region->segments[j];
+            if (segment_in_data(region, segment)) continue;
+            if (segment->kind == SEG_USE) {
+                char *name = segment_name(&job->dump, segment);
+                if (name) {
+                    free(use);
+                    use = name;
+                    current = use;
+                }
+            } else if (segment->kind == SEG_VIEW) {
+                char *name = segment_name(&job->dump, segment);
+                const char *database = name ? use_database(job, current) : NULL;
+                char *path = database ? mydumper_path(options->output_dir, database, name, "-schema-view") : NULL;
+                if (!name) {
+                    fprintf(stderr, "Error: Cannot find the name of the view at offset %jd.\n",
+                            (intmax_t)segment->start);
+                }
+                // A later definition replaces mysqldump's stand-in for the view
+                ok = path && write_file(job, path, segment->start, segment->end);
+                if (ok) {
+                    ok = add_view(job, database, name);
+                } else {
+                    free(name);
+                }
+                free(path);
+            } else if (segment->kind == SEG_POST || segment->kind == SEG_TRIGGER) {
+                if (segment->kind == SEG_TRIGGER) {
+                    // A trigger can only be created on a table that exists, so one earlier in the dump
+                    char *name = segment_name(&job->dump, segment);
+                    const char *database = name ? use_database(job, current) : NULL;
+                    MydumperTable *table = database ? find_table(job, database, name) : NULL;
+                    free(name);
+                    if (table) {
+                        ok = add_trigger(table, segment);
+                        continue;
+                    }
+                }
+                // Routines, events and triggers of unknown tables
+                const char *database = use_database(job, current);
+                MydumperDatabase *db = database ? find_database(job, database) : NULL;
+                char *path = db ? mydumper_path(options->output_dir, NULL, database, "-schema-post") : NULL;
+                int fd = path ? open_output(path, db->has_post) : -1;
+                if (fd >= 0) {
+                    DumpWriter w;
+                    dump_writer_init(&w, &job->dump, fd, false);
+                    if (!db->has_post) {
+                        write_session_header(&w, regions);
+                    }
+                    dump_writer_text(&w, "\n", 1);
+                    dump_writer_range(&w, segment->start, segment->end);
+                    dump_writer_flush(&w);
+                    db->has_post = true;
+                    ok = close_output(fd, path, w.ok);
+                } else {
+                    ok = false;
+                }
+                free(path);
+            }
+        }
+    }
+    free(use);
+
+    for (int i = 0; i < job->database_count && ok; ++i) {
+        char *path = mydumper_path(options->output_dir, NULL, job->databases[i].name, "-schema-create");
+        int fd = path ? open_output(path, false) : -1;
+        if (fd >= 0) {
+            // `name` with its backticks doubled
+            size_t len = strlen(job->databases[i].name);
+            char *statement = mem_malloc(MEM_EXPORT, 2 * len + 64);
+            DumpWriter w;
+            dump_writer_init(&w, &job->dump, fd, false);
+            if (statement) {
+                char *q = statement + sprintf(statement, "CREATE DATABASE IF NOT EXISTS `");
+                for (const char *p = job->databases[i].name; *p; ++p) {
+                    if (*p == '`') *q++ = '`';
+                    *q++ = *p;
+                }
+                q += sprintf(q, "`;\n");
+                dump_writer_text(&w, statement, (size_t)(q - statement));
+                free(statement);
+            } else {
+                perror("Failed to allocate CREATE DATABASE");
+                w.ok = false;
+            }
+            ok = close_output(fd, path, w.ok);
+        } else {
+            ok = false;
+        }
+        free(path);
+    }
+    return ok;
+}
+
+// The database's entry, added on first use. NULL if it cannot be a file name.
+static const char *use_database(MydumperJob *job, const char *name) {
+    MydumperDatabase *db = find_database(job, name);
+    if (db) {
+        return db->name;
+    }
+    if (name[0] == '\0' || strchr(name, '/') || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+        fprintf(stderr, "Error: Database name '%s' cannot be used as a file name.\n", name);
+        return NULL;
+    }
+    if (job->database_count == job->database_capacity) {
+        int capacity = job->database_capacity ? job->database_capacity * 2 : 8;
+        MydumperDatabase *databases = mem_realloc(MEM_EXPORT, job->databases, (size_t)capacity * sizeof(MydumperDatabase));
+        if (!databases) {
+            perror("Failed to allocate databases");
+            return NULL;
+        }
+        job->databases = databases;
+        job->database_capacity = capacity;
+    }
+    db = &job->databases[job->database_count];
+    db->name = mem_strdup(MEM_EXPORT, name);
+    db->has_post = false;
+    if (!db->name) {
+        perror("Failed to allocate database name");
+        return NULL;
+    }
+    job->database_count++;
+    return db->name;
+}
+
+static MydumperDatabase *find_database(MydumperJob *job, const char *name) {
+    for (int i = 0; i < job->database_count; ++i) {
+        if (strcmp(job->databases[i].name, name) == 0) {
+            return &job->databases[i];
+        }
+    }
+    return NULL;
+}
+
+// Takes ownership of `name`
+static bool add_view(MydumperJob *job, const char *database, char *name) {
+    if (is_view(job, database, name)) {
+        free(name);
+        return true;
+    }
+    if (job->view_count == job->view_capacity) {
+        int capacity = job->view_capacity ? job->view_capacity * 2 : 8;
+        MydumperView *views = mem_realloc(MEM_EXPORT, job->views, (size_t)capacity * sizeof(MydumperView));
+        if (!views) {
+            perror("Failed to allocate views");
+            free(name);
+            return false;
+        }
+        job->views = views;
+        job->view_capacity = capacity;
+    }
+    job->views[job->view_count++] = (MydumperView){database, name};
+    return true;
+}
+
+static bool is_view(const MydumperJob *job, const char *database, const char *name) {
+    for (int i = 0; i < job->view_count; ++i) {
+        if (job->views[i].database == database && strcmp(job->views[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The latest table of that name in the database, or NULL
+static MydumperTable *find_table(MydumperJob *job, const char *database, const char *name) {
+    for (int i = job->table_count - 1; i >= 0; --i) {
+        MydumperTable *table = &job->tables[i];
+        if (table->database == database && strcmp(table->region->table_info->name, name) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
+
+static bool add_trigger(MydumperTable *table, const Segment *segment) {
+    if (table->trigger_count == table->trigger_capacity) {
+        int capacity = table->trigger_capacity ? table->trigger_capacity * 2 : 4;
+        const Segment **triggers = mem_realloc(MEM_EXPORT, table->triggers, (size_t)capacity * sizeof(Segment *));
+        if (!triggers) {
+            perror("Failed to allocate triggers");
+            return false;
+        }
+        table->triggers = triggers;
+        table->trigger_capacity = capacity;
+    }
+    table->triggers[table->trigger_count++] = segment;
+    return true;
+}
+
+static void write_table_task(void *arg) {
+    MydumperTable *table = arg;
+    table->ok = write_table(table);
+}
+
+// The schema file, the data in chunks between the recorded cuts, and the
+// triggers. A table standing in for a view (MariaDB's mysqldump) gets no
+// schema file.
+static bool write_table(MydumperTable *table) {
+    MydumperJob *job = table->job;
+    const DumpRegion *region = table->region;
+    const char *output_dir = job->options->output_dir;
+    const char *name = region->table_info->name;
+    if (name[0] == '\0' || strchr(name, '/')) {
+        fprintf(stderr, "Error: Table name '%s' cannot be used as a file name.\n", name);
+        return false;
+    }
+
+    bool ok = true;
+    if (!is_view(job, table->database, name)) {
+        char *path = mydumper_path(output_dir, table->database, name, "-schema");
+        ok = path && write_file(job, path, region->start, region->ddl_end);
+        free(path);
+    }
+
+    off_t start = region->data_start;
+    for (int c = 0; ok && start >= 0 && c <= region->cut_count; ++c) {
+        off_t end = c < region->cut_count ? region->cuts[c] : region->data_end;
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%05d", table->chunks);
+        char *path = mydumper_path(output_dir, table->database, name, suffix);
+        ok = path && write_file(job, path, start, end);
+        free(path);
+        table->chunks++;
+        start = end;
+    }
+
+    if (ok && table->trigger_count > 0) {
+        char *path = mydumper_path(output_dir, table->database, name, "-schema-triggers");
+        int fd = path ? open_output(path, false) : -1;
+        if (fd >= 0) {
+            DumpWriter w;
+            dump_writer_init(&w, &job->dump, fd, false);
+            write_session_header(&w, &job->regions);
+            for (int j = 0; j < table->trigger_count; ++j) {
+                dump_writer_text(&w, "\n", 1);
+                dump_writer_range(&w, table->triggers[j]->start, table->triggers[j]->end);
+            }
+            dump_writer_flush(&w);
+            ok = close_output(fd, path, w.ok);
+        } else {
+            ok = false;
+        }
+        free(path);
+    }
+    DEBUG_PRINT("Wrote table '%s.%s' in %d data files.", table->database, name, table->chunks);
+    return ok;
+}
+
+// The session header, then dump bytes [start, end) on lines of their own
+static bool write_file(MydumperJob *job, const char *path, off_t start, off_t end) {
+    int fd = open_output(path, false);
+    if (fd < 0) {
+        return false;
+    }
+    DumpWriter w;
+    dump_writer_init(&w, &job->dump, fd, false);
+    write_session_header(&w, &job->regions);
+    dump_writer_text(&w, "\n", 1);
+    dump_writer_range(&w, start, end);
+    dump_writer_text(&w, "\n", 1);
+    return close_output(fd, path, w.ok);
+}
+
+// <dir>/<database>.<name><suffix>.sql, or <dir>/<name><suffix>.sql
+static char *mydumper_path(const char *output_dir, const char *database, const char *name, const char *suffix) {
+    size_t len = strlen(output_dir) + (database ? strlen(database) + 1 : 0) + strlen(name) + strlen(suffix) + 6;
+    char *path = mem_malloc(MEM_EXPORT, len);
+    if (!path) {
+        perror("Failed to allocate output path");
+        return NULL;
+    }
+    snprintf(path, len, "%s/%s%s%s%s.sql", output_dir, database ? database : "", database ? "." : "", name, suffix);
+    return path;
+}
+
+static int open_output(const char *path, bool append) {
+    int fd = open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening '%s' for writing: %s\n", path, strerror(errno));
+    }
+    return fd;
+}
+
+static bool close_output(int fd, const char *path, bool ok) {
+    if (close(fd) != 0 && ok) {
+        fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+        ok = false;
+    }
+    return ok;
+}
+
+// myloader requires the file; this is the format of mydumper before 0.12
+static bool write_metadata(const char *output_dir, time_t started, time_t finished) {
+    char *path = mydumper_path(output_dir, NULL, "metadata", "");
+    if (!path) {
+        return false;
+    }
+    path[strlen(path) - strlen(".sql")] = '\0';
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error opening '%s' for writing: %s\n", path, strerror(errno));
+        free(path);
+        return false;
+    }
+    char start_text[32], finish_text[32];
+    struct tm tm;
+    strftime(start_text, sizeof(start_text), "%Y-%m-%d %H:%M:%S", localtime_r(&started, &tm));
+    strftime(finish_text, sizeof(finish_text), "%Y-%m-%d %H:%M:%S", localtime_r(&finished, &tm));
+    fprintf(file, "Started dump at: %s\n", start_text);
+    fprintf(file, "Finished dump at: %s\n", finish_text);
+    bool ok = fclose(file) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+    }
+    free(path);
+    return ok;
+}
+
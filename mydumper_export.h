@@ -0,0 +1,42 @@
+#ifndef MYDUMPER_EXPORT_H
+#define MYDUMPER_EXPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h> // For off_t
+#include "sql_indexer.h"
+
+// --- mydumper Conversion ---
+// Writes a dump as a mydumper directory that myloader restores with
+// several threads:
+//
+//   <dir>/metadata                          start and finish time
+//   <dir>/<db>-schema-create.sql            CREATE DATABASE
+//   <dir>/<db>.<table>-schema.sql           the CREATE TABLE statement
+//   <dir>/<db>.<table>.<nnnnn>.sql          the table's INSERTs, in chunks
+//   <dir>/<db>.<table>-schema-triggers.sql  its triggers (DELIMITER blocks)
+//   <dir>/<db>.<view>-schema-view.sql       CREATE VIEW
+//   <dir>/<db>-schema-post.sql              other DELIMITER blocks (routines)
+//
+// Every file starts with the session SETs of the dump's preamble. The
+// database is the one of the USE in effect; tables before any USE belong
+// to `database`. A chunk ends at the first statement end after chunk_bytes
+// bytes or chunk_rows rows; INSERTs themselves are never split (see
+// --rechunk). Tables are written in parallel, and their bytes are copied
+// without passing through user space when the dump is a plain SQL file.
+
+#define MYDUMPER_DEFAULT_CHUNK_MIB 64
+
+typedef struct {
+    const char *output_dir;     // Created if missing
+    const char *database;       // Database of tables before any USE
+    off_t chunk_bytes;          // 0 for no size limit
+    uint64_t chunk_rows;        // 0 for no row limit
+    int threads;                // Workers; <= 0 for one per online CPU
+} MydumperOptions;
+
+// --- Function Declarations ---
+
+bool export_mydumper(const SqlIndex *index, const char *sql_filename, const MydumperOptions *options);
+
+#endif // MYDUMPER_EXPORT_H
@@ -0,0 +1,495 @@
+#define _GNU_SOURCE // For fopencookie
+#include "output_compress.h"
+#include "work_pool.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // For sysconf
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define GZIP_DEFAULT_LEVEL 6
+#define ZSTD_DEFAULT_LEVEL 3
+
+// zstd seekable format: a skippable frame holding the frame sizes, ending
+// with a footer that readers find from the end of the file
+#define SKIPPABLE_FRAME_MAGIC 0x184D2A5Eu
+#define SEEKABLE_MAGIC 0x8F92EAB1u
+#define SEEK_TABLE_FOOTER_SIZE 9
+
+// Frames in flight per worker in frame_writer_write_frames
+#define FRAMES_PER_WORKER 4
+
+// One frame of frame_writer_write_frames, compressed on a worker
+typedef struct {
+    const CompressOptions *options;
+    const char *data;
+    size_t len;
+    char *compressed;
+    size_t compressed_size;     // Allocated, kept across batches
+    size_t compressed_len;
+    bool failed;
+} FrameTask;
+
+// --- Static Helper Function Declarations ---
+static void *codec_create(const CompressOptions *options);
+static void codec_destroy(CompressFormat format, void *codec);
+static bool compress_frame(const CompressOptions *options, void *codec, const char *src, size_t len,
+                           char **dst, size_t *dst_size, size_t *out_len);
+static bool add_frame_entry(FrameWriter *writer, size_t compressed_size, size_t raw_size);
+static bool write_seek_table(FrameWriter *writer);
+static void put_le32(unsigned char *p, uint32_t value);
+static uint32_t get_le32(const unsigned char *p);
+static ssize_t stream_write(void *cookie, const char *buf, size_t size);
+static void compress_frame_task(void *arg);
+
+// --- Function Implementations ---
+
+bool parse_compress_option(const char *arg, CompressOptions *options) {
+    const char *colon = strchr(arg, ':');
+    size_t name_len = colon ? (size_t)(colon - arg) : strlen(arg);
+    int level = 0;
+    if (colon) {
+        char *end = NULL;
+        level = (int)strtol(colon + 1, &end, 10);
+        if (end == colon + 1 || *end != '\0') {
+            fprintf(stderr, "Error: Invalid compression level in '%s'.\n", arg);
+            return false;
+        }
+    }
+
+    if (name_len == 4 && strncmp(arg, "gzip", 4) == 0) {
+#ifdef HAVE_ZLIB
+        if (colon && (level < 1 || level > 9)) {
+            fprintf(stderr, "Error: gzip levels are 1 to 9.\n");
+            return false;
+        }
+        options->format = COMPRESS_GZIP;
+#else
+        fprintf(stderr, "Error: gzip output is not available; rebuild with zlib installed.\n");
+        return false;
+#endif
+    } else if (name_len == 4 && strncmp(arg, "zstd", 4) == 0) {
+#ifdef HAVE_ZSTD
+        if (colon && (level < 1 || level > ZSTD_maxCLevel())) {
+            fprintf(stderr, "Error: zstd levels are 1 to %d.\n", ZSTD_maxCLevel());
+            return false;
+        }
+        options->format = COMPRESS_ZSTD;
+#else
+        fprintf(stderr, "Error: zstd output is not available; rebuild with libzstd installed.\n");
+        return false;
+#endif
+    } else {
+        fprintf(stderr, "Error: Unknown compression '%s' (expected gzip[:level] or zstd[:level]).\n", arg);
+        return false;
+    }
+    options->level = level;
+    return true;
+}
+
+const char *compress_suffix(CompressFormat format) {
+    switch (format) {
+        case COMPRESS_GZIP: return ".gz";
+        case COMPRESS_ZSTD: return ".zst";
+        default:            return "";
+    }
+}
+
+bool frame_writer_init(FrameWriter *writer, FILE *out, const CompressOptions *options) {
+    memset(writer, 0, sizeof(*writer));
+    writer->out = out;
+    writer->options = *options;
+    if (options->format == COMPRESS_NONE) {
+        return true;
+    }
+    writer->buffer = mem_malloc(MEM_EXPORT, COMPRESS_FRAME_SIZE);
+    writer->codec = codec_create(options);
+    if (!writer->buffer || !writer->codec) {
+        perror("Failed to set up output compression");
+        frame_writer_cleanup(writer);
+        return false;
+    }
+    return true;
+}
+
+bool frame_writer_write(FrameWriter *writer, const void *data, size_t len) {
+    if (writer->options.format == COMPRESS_NONE) {
+        if (fwrite(data, 1, len, writer->out) != len) writer->failed = true;
+        return !writer->failed;
+    }
+    const char *p = data;
+    while (len > 0 && !writer->failed) {
+        size_t n = COMPRESS_FRAME_SIZE - writer->buffer_len;
+        if (n > len) n = len;
+        memcpy(writer->buffer + writer->buffer_len, p, n);
+        writer->buffer_len += n;
+        p += n;
+        len -= n;
+        if (writer->buffer_len == COMPRESS_FRAME_SIZE) {
+            frame_writer_flush(writer);
+        }
+    }
+    return !writer->failed;
+}
+
+bool frame_writer_flush(FrameWriter *writer) {
+    if (writer->options.format == COMPRESS_NONE || writer->buffer_len == 0 || writer->failed) {
+        return !writer->failed;
+    }
+    size_t compressed_len = 0;
+    if (!compress_frame(&writer->options, writer->codec, writer->buffer, writer->buffer_len,
+                        &writer->scratch, &writer->scratch_size, &compressed_len) ||
+        fwrite(writer->scratch, 1, compressed_len, writer->out) != compressed_len ||
+        !add_frame_entry(writer, compressed_len, writer->buffer_len)) {
+        writer->failed = true;
+    }
+    writer->buffer_len = 0;
+    return !writer->failed;
+}
+
+bool frame_writer_append(FrameWriter *writer, const FrameWriter *part, const void *bytes, size_t len) {
+    if (!frame_writer_flush(writer)) {
+        return false;
+    }
+    if (fwrite(bytes, 1, len, writer->out) != len) {
+        writer->failed = true;
+    }
+    for (int i = 0; i < part->frame_count && !writer->failed; ++i) {
+        if (!add_frame_entry(writer, part->frames[i].compressed_size, part->frames[i].raw_size)) {
+            writer->failed = true;
+        }
+    }
+    return !writer->failed;
+}
+
+bool frame_writer_finish(FrameWriter *writer, bool seek_table) {
+    frame_writer_flush(writer);
+    if (seek_table && writer->options.format == COMPRESS_ZSTD && !writer->failed && !write_seek_table(writer)) {
+        writer->failed = true;
+    }
+    return !writer->failed;
+}
+
+void frame_writer_cleanup(FrameWriter *writer) {
+    codec_destroy(writer->options.format, writer->codec);
+    free(writer->buffer);
+    free(writer->scratch);
+    free(writer->frames);
+    writer->codec = NULL;
+    writer->buffer = NULL;
+    writer->scratch = NULL;
+    writer->frames = NULL;
+}
+
+FILE *frame_writer_open_stream(FrameWriter *writer) {
+    cookie_io_functions_t io = {NULL, stream_write, NULL, NULL};
+    FILE *stream = fopencookie(writer, "w", io);
+    if (!stream) {
+        perror("Failed to open output stream");
+    }
+    return stream;
+}
+
+bool frame_writer_write_frames(FrameWriter *writer, const char *data, const size_t *frame_ends, int frame_count) {
+    if (!frame_writer_flush(writer) || frame_count == 0) {
+        return !writer->failed;
+    }
+    if (writer->options.format == COMPRESS_NONE) {
+        return frame_writer_write(writer, data, frame_ends[frame_count - 1]);
+    }
+
+    // Batches bound the compressed frames held before they are written
+    int threads = writer->options.threads > 0 ? writer->options.threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > frame_count) threads = frame_count;
+    if (threads < 1) threads = 1;
+    int batch = threads * FRAMES_PER_WORKER < frame_count ? threads * FRAMES_PER_WORKER : frame_count;
+    FrameTask *tasks = mem_calloc(MEM_EXPORT, (size_t)batch, sizeof(FrameTask));
+    WorkPool pool;
+    if (!tasks || !work_pool_start(&pool, threads)) {
+        if (!tasks) perror("Failed to allocate compression tasks");
+        free(tasks);
+        writer->failed = true;
+        return false;
+    }
+
+    size_t start = 0;
+    for (int first = 0; first < frame_count && !writer->failed; first += batch) {
+        int n = frame_count - first < batch ? frame_count - first : batch;
+        for (int i = 0; i < n; ++i) {
+            tasks[i].options = &writer->options;
+            tasks[i].data = data + start;
+            tasks[i].len = frame_ends[first + i] - start;
+            tasks[i].failed = false;
+            start = frame_ends[first + i];
+            if (!work_pool_submit(&pool, compress_frame_task, &tasks[i])) {
+                tasks[i].failed = true;
+            }
+        }
+        work_pool_wait(&pool);
+        for (int i = 0; i < n && !writer->failed; ++i) {
+            if (tasks[i].failed ||
+                fwrite(tasks[i].compressed, 1, tasks[i].compressed_len, writer->out) != tasks[i].compressed_len ||
+                !add_frame_entry(writer, tasks[i].compressed_len, tasks[i].len)) {
+                writer->failed = true;
+            }
+        }
+    }
+    work_pool_stop(&pool);
+
+    for (int i = 0; i < batch; ++i) {
+        free(tasks[i].compressed);
+    }
+    free(tasks);
+    return !writer->failed;
+}
+
+bool read_seek_table(int fd, off_t file_size, FrameEntry **frames, int *frame_count, off_t *table_offset) {
+    unsigned char footer[SEEK_TABLE_FOOTER_SIZE];
+    if (file_size < 8 + SEEK_TABLE_FOOTER_SIZE ||
+        pread(fd, footer, sizeof(footer), file_size - SEEK_TABLE_FOOTER_SIZE) != (ssize_t)sizeof(footer) ||
+        get_le32(footer + 5) != SEEKABLE_MAGIC || (footer[4] & 0x7C) != 0) {
+        return false;
+    }
+    uint32_t count = get_le32(footer);
+    size_t entry_size = footer[4] & 0x80 ? 12 : 8; // Entries carry a checksum when bit 7 is set
+    off_t table_size = 8 + (off_t)count * (off_t)entry_size + SEEK_TABLE_FOOTER_SIZE;
+    if (table_size > file_size) {
+        return false;
+    }
+    *table_offset = file_size - table_size;
+
+    size_t entries_size = (size_t)count * entry_size;
+    unsigned char *raw = mem_malloc(MEM_BUFFERS, entries_size + 8);
+    *frames = mem_malloc(MEM_INDEX, (count > 0 ? count : 1) * sizeof(FrameEntry));
+    bool ok = raw && *frames &&
+              pread(fd, raw, entries_size + 8, *table_offset) == (ssize_t)(entries_size + 8) &&
+              get_le32(raw) == SKIPPABLE_FRAME_MAGIC &&
+              get_le32(raw + 4) == (uint32_t)(table_size - 8);
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        (*frames)[i].compressed_size = get_le32(raw + 8 + i * entry_size);
+        (*frames)[i].raw_size = get_le32(raw + 12 + i * entry_size);
+    }
+    free(raw);
+    if (!ok) {
+        free(*frames);
+        *frames = NULL;
+        return false;
+    }
+    *frame_count = (int)count;
+    return true;
+}
+
+bool decompress_frame(CompressFormat format, const char *src, size_t len, char *dst, size_t raw_size) {
+#ifdef HAVE_ZSTD
+    if (format == COMPRESS_ZSTD) {
+        size_t result = ZSTD_decompress(dst, raw_size, src, len);
+        if (ZSTD_isError(result) || result != raw_size) {
+            fprintf(stderr, "Error: Corrupt zstd frame (%s).\n",
+                    ZSTD_isError(result) ? ZSTD_getErrorName(result) : "size mismatch");
+            return false;
+        }
+        return true;
+    }
+#endif
+#ifdef HAVE_ZLIB
+    if (format == COMPRESS_GZIP) {
+        z_stream strm = {0};
+        if (inflateInit2(&strm, 15 + 16) != Z_OK) {
+            fprintf(stderr, "Error: Cannot start gzip decompression.\n");
+            return false;
+        }
+        strm.next_in = (Bytef *)src;
+        strm.avail_in = (uInt)len;
+        strm.next_out = (Bytef *)dst;
+        strm.avail_out = (uInt)raw_size;
+        int result = inflate(&strm, Z_FINISH);
+        bool ok = result == Z_STREAM_END && strm.avail_out == 0;
+        inflateEnd(&strm);
+        if (!ok) {
+            fprintf(stderr, "Error: Corrupt gzip member.\n");
+        }
+        return ok;
+    }
+#endif
+    (void)src;
+    (void)len;
+    (void)dst;
+    (void)raw_size;
+    fprintf(stderr, "Error: %s input is not available; rebuild with %s installed.\n",
+            format == COMPRESS_GZIP ? "gzip" : "zstd", format == COMPRESS_GZIP ? "zlib" : "libzstd");
+    return false;
+}
+
+// --- Static Helper Function Implementations ---
+
+static void *codec_create(const CompressOptions *options) {
+    switch (options->format) {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP: {
+            z_stream *strm = mem_calloc(MEM_EXPORT, 1, sizeof(z_stream));
+            int level = options->level > 0 ? options->level : GZIP_DEFAULT_LEVEL;
+            // windowBits 15 + 16 selects the gzip wrapper
+            if (strm && deflateInit2(strm, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                free(strm);
+                strm = NULL;
+            }
+            return strm;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+            return ZSTD_createCCtx();
+#endif
+        default:
+            return NULL;
+    }
+}
+
+static void codec_destroy(CompressFormat format, void *codec) {
+    if (!codec) {
+        return;
+    }
+#ifdef HAVE_ZLIB
+    if (format == COMPRESS_GZIP) {
+        deflateEnd(codec);
+        free(codec);
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (format == COMPRESS_ZSTD) {
+        ZSTD_freeCCtx(codec);
+    }
+#endif
+    (void)format;
+}
+
+// Compresses [src, src + len) into one gzip member or zstd frame in *dst,
+// growing it to the format's bound as needed.
+static bool compress_frame(const CompressOptions *options, void *codec, const char *src, size_t len,
+                           char **dst, size_t *dst_size, size_t *out_len) {
+    size_t bound = 0;
+#ifdef HAVE_ZLIB
+    if (options->format == COMPRESS_GZIP) {
+        bound = deflateBound(codec, (uLong)len) + 32; // + gzip header and trailer
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (options->format == COMPRESS_ZSTD) {
+        bound = ZSTD_compressBound(len);
+    }
+#endif
+    if (bound > *dst_size) {
+        char *new_dst = mem_realloc(MEM_EXPORT, *dst, bound);
+        if (!new_dst) {
+            perror("Failed to allocate compression buffer");
+            return false;
+        }
+        *dst = new_dst;
+        *dst_size = bound;
+    }
+
+#ifdef HAVE_ZLIB
+    if (options->format == COMPRESS_GZIP) {
+        z_stream *strm = codec;
+        deflateReset(strm);
+        strm->next_in = (Bytef *)src;
+        strm->avail_in = (uInt)len;
+        strm->next_out = (Bytef *)*dst;
+        strm->avail_out = (uInt)*dst_size;
+        if (deflate(strm, Z_FINISH) != Z_STREAM_END) {
+            fprintf(stderr, "Error: gzip compression failed.\n");
+            return false;
+        }
+        *out_len = *dst_size - strm->avail_out;
+        return true;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (options->format == COMPRESS_ZSTD) {
+        int level = options->level > 0 ? options->level : ZSTD_DEFAULT_LEVEL;
+        size_t result = ZSTD_compressCCtx(codec, *dst, *dst_size, src, len, level);
+        if (ZSTD_isError(result)) {
+            fprintf(stderr, "Error: zstd compression failed: %s\n", ZSTD_getErrorName(result));
+            return false;
+        }
+        *out_len = result;
+        return true;
+    }
+#endif
+    (void)codec;
+    (void)src;
+    return false;
+}
+
+static bool add_frame_entry(FrameWriter *writer, size_t compressed_size, size_t raw_size) {
+    if (writer->frame_count == writer->frame_capacity) {
+        int new_capacity = writer->frame_capacity == 0 ? 64 : writer->frame_capacity * 2;
+        FrameEntry *new_frames = mem_realloc(MEM_EXPORT, writer->frames, (size_t)new_capacity * sizeof(FrameEntry));
+        if (!new_frames) {
+            perror("Failed to allocate seek table");
+            return false;
+        }
+        writer->frames = new_frames;
+        writer->frame_capacity = new_capacity;
+    }
+    writer->frames[writer->frame_count].compressed_size = (uint32_t)compressed_size;
+    writer->frames[writer->frame_count].raw_size = (uint32_t)raw_size;
+    writer->frame_count++;
+    return true;
+}
+
+// Skippable frame header, 8 bytes per frame (no checksums), then the footer:
+// frame count, descriptor byte and the seekable magic number
+static bool write_seek_table(FrameWriter *writer) {
+    size_t payload = (size_t)writer->frame_count * 8 + SEEK_TABLE_FOOTER_SIZE;
+    unsigned char *table = mem_malloc(MEM_EXPORT, payload + 8);
+    if (!table) {
+        perror("Failed to allocate seek table");
+        return false;
+    }
+    unsigned char *p = table;
+    put_le32(p, SKIPPABLE_FRAME_MAGIC);
+    put_le32(p + 4, (uint32_t)payload);
+    p += 8;
+    for (int i = 0; i < writer->frame_count; ++i, p += 8) {
+        put_le32(p, writer->frames[i].compressed_size);
+        put_le32(p + 4, writer->frames[i].raw_size);
+    }
+    put_le32(p, (uint32_t)writer->frame_count);
+    p[4] = 0; // Descriptor: no checksums
+    put_le32(p + 5, SEEKABLE_MAGIC);
+    bool ok = fwrite(table, 1, payload + 8, writer->out) == payload + 8;
+    free(table);
+    return ok;
+}
+
+static void put_le32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static ssize_t stream_write(void *cookie, const char *buf, size_t size) {
+    return frame_writer_write(cookie, buf, size) ? (ssize_t)size : -1;
+}
+
+static void compress_frame_task(void *arg) {
+    FrameTask *task = arg;
+    TRACE_BEGIN(compress_start);
+    void *codec = codec_create(task->options);
+    task->failed = !codec || !compress_frame(task->options, codec, task->data, task->len, &task->compressed,
+                                             &task->compressed_size, &task->compressed_len);
+    codec_destroy(task->options->format, codec);
+    TRACE_END(compress_start, "export", "compress", NULL);
+}
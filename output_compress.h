@@ -0,0 +1,91 @@
+#ifndef OUTPUT_COMPRESS_H
+#define OUTPUT_COMPRESS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h> // For off_t
+
+// --- Compressed Output ---
+// Export output is cut into frames of COMPRESS_FRAME_SIZE bytes that are
+// compressed independently: gzip members (concatenated members are a valid
+// .gz file) or zstd frames. zstd output ends with a seek table in a
+// skippable frame (the zstd "seekable format"), which plain zstd decoders
+// skip and seekable readers use to decompress any range on its own.
+// gzip needs zlib (HAVE_ZLIB) and zstd needs libzstd (HAVE_ZSTD); both are
+// optional at build time.
+
+#define COMPRESS_FRAME_SIZE ((size_t)1 << 20)
+
+typedef enum {
+    COMPRESS_NONE,
+    COMPRESS_GZIP,
+    COMPRESS_ZSTD
+} CompressFormat;
+
+typedef struct {
+    CompressFormat format;
+    int level;                  // 0 for the format's default
+    int threads;                // Workers for frame_writer_write_frames; <= 0 for one per online CPU
+} CompressOptions;
+
+// One frame of a seek table
+typedef struct {
+    uint32_t compressed_size;
+    uint32_t raw_size;
+} FrameEntry;
+
+// Sends written bytes to `out` in compressed frames and records the frames
+typedef struct {
+    FILE *out;
+    CompressOptions options;
+    char *buffer;               // Bytes of the frame being filled
+    size_t buffer_len;
+    char *scratch;              // Compressed frame
+    size_t scratch_size;
+    FrameEntry *frames;
+    int frame_count;
+    int frame_capacity;
+    void *codec;                // ZSTD_CCtx or z_stream, reused across frames
+    bool failed;
+} FrameWriter;
+
+// --- Function Declarations ---
+
+// Parses "gzip", "zstd", "gzip:<level>" or "zstd:<level>". Prints an error
+// and returns false if the format is unknown or not built in.
+bool parse_compress_option(const char *arg, CompressOptions *options);
+
+// File name suffix for the format: "", ".gz" or ".zst"
+const char *compress_suffix(CompressFormat format);
+
+// Starts a writer on `out`, which the writer does not close
+bool frame_writer_init(FrameWriter *writer, FILE *out, const CompressOptions *options);
+bool frame_writer_write(FrameWriter *writer, const void *data, size_t len);
+// Ends the current frame, so the next bytes start a new one
+bool frame_writer_flush(FrameWriter *writer);
+// Copies the output of another finished writer (bytes it wrote to its own
+// stream) as whole frames, keeping their seek entries
+bool frame_writer_append(FrameWriter *writer, const FrameWriter *part, const void *bytes, size_t len);
+// Flushes the last frame and, for zstd with seek_table set, writes the seek table
+bool frame_writer_finish(FrameWriter *writer, bool seek_table);
+void frame_writer_cleanup(FrameWriter *writer);
+
+// Returns a write-only stream whose bytes go to the writer; fclose it
+// before frame_writer_finish. NULL on failure.
+FILE *frame_writer_open_stream(FrameWriter *writer);
+
+// Writes data as one frame per [frame_ends[i - 1], frame_ends[i]) (from 0
+// for the first), compressed on options.threads workers and written in order.
+bool frame_writer_write_frames(FrameWriter *writer, const char *data, const size_t *frame_ends, int frame_count);
+
+// Reads the seek table at the end of a seekable zstd file. Returns false,
+// without a message, if the file does not end with one. *frames is
+// allocated; *table_offset is where the seek table's skippable frame starts.
+bool read_seek_table(int fd, off_t file_size, FrameEntry **frames, int *frame_count, off_t *table_offset);
+
+// Decompresses one complete frame (gzip member or zstd frame) of raw_size bytes
+bool decompress_frame(CompressFormat format, const char *src, size_t len, char *dst, size_t raw_size);
+
+#endif // OUTPUT_COMPRESS_H
@@ -0,0 +1,189 @@
+#include "perf_counters.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+static const char *const COUNTER_NAMES[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "page-faults"
+};
+
+// --- Static Helper Function Declarations ---
+static double monotonic_seconds(void);
+static int open_counter(PerfCounterId id);
+static int find_or_add_phase(PerfCounters *pc, const char *name);
+
+// --- Function Implementations ---
+
+bool perf_counters_open(PerfCounters *pc) {
+    bool any = false;
+    memset(pc, 0, sizeof(*pc));
+    pc->current = -1;
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        pc->fds[i] = open_counter((PerfCounterId)i);
+        any = any || pc->fds[i] >= 0;
+    }
+    return any;
+}
+
+void perf_counters_close(PerfCounters *pc) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fds[i] >= 0) {
+            close(pc->fds[i]);
+            pc->fds[i] = -1;
+        }
+    }
+}
+
+void perf_counters_begin(PerfCounters *pc, const char *phase) {
+    pc->current = find_or_add_phase(pc, phase);
+    pc->start_time = monotonic_seconds();
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fds[i] >= 0) {
+            ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void perf_counters_end(PerfCounters *pc, uint64_t bytes) {
+    if (pc->current < 0) {
+        return;
+    }
+    PerfPhase *phase = &pc->phases[pc->current];
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fds[i] < 0) {
+            continue;
+        }
+        ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        // value, time enabled, time running; scaled up when the PMU multiplexed the counter
+        uint64_t data[3];
+        if (read(pc->fds[i], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] > 0) {
+            phase->counts[i] += data[2] < data[1] ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+        }
+    }
+#endif
+    phase->seconds += monotonic_seconds() - pc->start_time;
+    phase->bytes += bytes;
+    phase->runs++;
+    pc->current = -1;
+}
+
+void perf_counters_print(const PerfCounters *pc, FILE *out) {
+    fprintf(out, "\nPerformance counters (user mode):\n");
+    fprintf(out, "%-10s %10s %14s %14s %6s %9s %12s %12s %12s %10s %9s\n", "Phase", "MiB", "Cycles",
+            "Instructions", "IPC", "B/cycle", "Br-misses", "L1d-misses", "LLC-misses", "Faults", "Seconds");
+    for (int p = 0; p < pc->phase_count; ++p) {
+        const PerfPhase *phase = &pc->phases[p];
+        char cells[PERF_COUNTER_COUNT][24];
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+            if (pc->fds[i] >= 0) {
+                snprintf(cells[i], sizeof(cells[i]), "%llu", (unsigned long long)phase->counts[i]);
+            } else {
+                snprintf(cells[i], sizeof(cells[i]), "n/a");
+            }
+        }
+        uint64_t cycles = phase->counts[PERF_CYCLES];
+        char ipc[16] = "n/a";
+        char bytes_per_cycle[16] = "n/a";
+        if (pc->fds[PERF_CYCLES] >= 0 && cycles > 0) {
+            if (pc->fds[PERF_INSTRUCTIONS] >= 0) {
+                snprintf(ipc, sizeof(ipc), "%.2f", (double)phase->counts[PERF_INSTRUCTIONS] / (double)cycles);
+            }
+            if (phase->bytes > 0) {
+                snprintf(bytes_per_cycle, sizeof(bytes_per_cycle), "%.3f", (double)phase->bytes / (double)cycles);
+            }
+        }
+        fprintf(out, "%-10s %10.1f %14s %14s %6s %9s %12s %12s %12s %10s %9.3f\n", phase->name,
+                (double)phase->bytes / (1024.0 * 1024.0), cells[PERF_CYCLES], cells[PERF_INSTRUCTIONS], ipc,
+                bytes_per_cycle, cells[PERF_BRANCH_MISSES], cells[PERF_L1D_MISSES], cells[PERF_LLC_MISSES],
+                cells[PERF_PAGE_FAULTS], phase->seconds);
+    }
+    const char *separator = "Unavailable on this system: ";
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (pc->fds[i] < 0) {
+            fprintf(out, "%s%s", separator, COUNTER_NAMES[i]);
+            separator = ", ";
+        }
+    }
+    if (separator[0] == ',') {
+        fputc('\n', out);
+    }
+}
+
+// --- Static Helper Function Implementations ---
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Returns a disabled counter for this process on any CPU, or -1
+static int open_counter(PerfCounterId id) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (id) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_BRANCH_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PERF_L1D_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_LL | read_miss;
+            break;
+        case PERF_PAGE_FAULTS:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+            break;
+        default:
+            return -1;
+    }
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)id;
+    return -1;
+#endif
+}
+
+// Phases are few, so a linear search by name is enough
+static int find_or_add_phase(PerfCounters *pc, const char *name) {
+    for (int i = 0; i < pc->phase_count; ++i) {
+        if (strcmp(pc->phases[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (pc->phase_count >= PERF_MAX_PHASES) {
+        return PERF_MAX_PHASES - 1; // Folded into the last phase rather than lost
+    }
+    pc->phases[pc->phase_count].name = name;
+    return pc->phase_count++;
+}
@@ -0,0 +1,55 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// --- Hardware Performance Counters ---
+// Per-phase cycles, instructions, branch misses, cache misses and page
+// faults via Linux perf_event_open, counted for this process in user mode.
+// Counters the kernel or PMU refuses (other platforms, containers,
+// perf_event_paranoid > 2) are reported as n/a.
+
+typedef enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,            // L1 data cache read misses
+    PERF_LLC_MISSES,            // Last level cache read misses
+    PERF_PAGE_FAULTS,
+    PERF_COUNTER_COUNT
+} PerfCounterId;
+
+#define PERF_MAX_PHASES 8
+
+typedef struct {
+    const char *name;           // String literal, e.g. "scan"
+    int runs;
+    uint64_t bytes;             // Input bytes processed, for bytes/cycle; 0 if not meaningful
+    double seconds;
+    uint64_t counts[PERF_COUNTER_COUNT];
+} PerfPhase;
+
+typedef struct {
+    int fds[PERF_COUNTER_COUNT]; // -1 if unavailable
+    PerfPhase phases[PERF_MAX_PHASES];
+    int phase_count;
+    int current;                // Phase being measured, or -1
+    double start_time;
+} PerfCounters;
+
+// Opens the counters. Returns false if none is available; the other calls
+// are still safe and the report then says so.
+bool perf_counters_open(PerfCounters *pc);
+void perf_counters_close(PerfCounters *pc);
+
+// Measures the code between begin and end and adds it to the named phase.
+// Phases do not nest.
+void perf_counters_begin(PerfCounters *pc, const char *phase);
+void perf_counters_end(PerfCounters *pc, uint64_t bytes);
+
+// Prints one row per phase with IPC and bytes/cycle
+void perf_counters_print(const PerfCounters *pc, FILE *out);
+
+#endif // PERF_COUNTERS_H
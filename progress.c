@@ -0,0 +1,97 @@
+#include "progress.h"
+#include <time.h>
+#include <unistd.h> // For isatty
+
+// Bytes between clock reads; a report can be at most this late
+#define PROGRESS_CHECK_BYTES ((off_t)1 << 20)
+
+// --- Static Helper Function Declarations ---
+static double monotonic_seconds(void);
+static void format_duration(char *buf, size_t size, double seconds);
+
+// --- Function Implementations ---
+
+void progress_start(ProgressReporter *progress, FILE *out, ProgressFormat format, off_t total_bytes, off_t start_offset) {
+    progress->out = out;
+    progress->format = format;
+    progress->redraw = format == PROGRESS_TEXT && isatty(fileno(out));
+    progress->interval = progress->redraw ? 0.25 : 1.0;
+    progress->total_bytes = total_bytes;
+    progress->start_offset = start_offset;
+    progress->next_check = start_offset + PROGRESS_CHECK_BYTES;
+    progress->start_time = monotonic_seconds();
+    progress->last_time = progress->start_time;
+    progress->last_offset = start_offset;
+    progress->finished = false;
+}
+
+// The current rate covers the bytes since the previous report; the ETA uses
+// the average since the start, which is steadier across INSERT-heavy stretches.
+void progress_report(ProgressReporter *progress, off_t offset, int tables, bool done) {
+    progress->next_check = offset + PROGRESS_CHECK_BYTES;
+    if (progress->finished) {
+        return;
+    }
+    progress->finished = done;
+    double now = monotonic_seconds();
+    if (!done && now - progress->last_time < progress->interval) {
+        return;
+    }
+
+    double elapsed = now - progress->start_time;
+    double window = now - progress->last_time;
+    double rate = window > 0 ? (double)(offset - progress->last_offset) / window : 0;
+    double average = elapsed > 0 ? (double)(offset - progress->start_offset) / elapsed : 0;
+    double eta = -1;
+    if (done) {
+        eta = 0;
+    } else if (progress->total_bytes > 0 && average > 0) {
+        eta = (double)(progress->total_bytes - offset) / average;
+    }
+    progress->last_time = now;
+    progress->last_offset = offset;
+
+    if (progress->format == PROGRESS_JSON) {
+        fprintf(progress->out, "{\"bytes\":%jd,\"total_bytes\":%jd,\"tables\":%d,\"bytes_per_sec\":%.0f,"
+                "\"elapsed_sec\":%.1f,\"eta_sec\":%.1f,\"done\":%s}\n",
+                (intmax_t)offset, (intmax_t)progress->total_bytes, tables, done ? average : rate,
+                elapsed, eta, done ? "true" : "false");
+        fflush(progress->out);
+        return;
+    }
+
+    char eta_text[32];
+    char percent_text[16] = "";
+    if (eta >= 0) {
+        format_duration(eta_text, sizeof(eta_text), done ? elapsed : eta);
+    } else {
+        snprintf(eta_text, sizeof(eta_text), "--:--");
+    }
+    if (progress->total_bytes > 0) {
+        snprintf(percent_text, sizeof(percent_text), " (%.1f%%)", 100.0 * (double)offset / (double)progress->total_bytes);
+    }
+    fprintf(progress->out, "%s%.1f / %.1f MiB%s, %d tables, %.1f MiB/s, %s %s%s",
+            progress->redraw ? "\r" : "",
+            (double)offset / (1024.0 * 1024.0), (double)progress->total_bytes / (1024.0 * 1024.0), percent_text,
+            tables, (done ? average : rate) / (1024.0 * 1024.0), done ? "took" : "ETA", eta_text,
+            progress->redraw && !done ? "   " : "\n");
+    fflush(progress->out);
+}
+
+// --- Static Helper Function Implementations ---
+
+static double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// H:MM:SS, or M:SS under an hour
+static void format_duration(char *buf, size_t size, double seconds) {
+    long total = (long)(seconds + 0.5);
+    if (total >= 3600) {
+        snprintf(buf, size, "%ld:%02ld:%02ld", total / 3600, (total / 60) % 60, total % 60);
+    } else {
+        snprintf(buf, size, "%ld:%02ld", total / 60, total % 60);
+    }
+}
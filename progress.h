@@ -0,0 +1,42 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h> // For off_t
+
+// --- Progress Reporting ---
+// Periodic "bytes done / tables found / throughput / ETA" reports for long
+// scans. The clock is only read every PROGRESS_CHECK_BYTES of input, and a
+// report is only written once per interval, so the per-chunk cost is one
+// comparison.
+
+typedef enum {
+    PROGRESS_TEXT,          // One human-readable line, redrawn in place on a TTY
+    PROGRESS_JSON           // One JSON object per line, for monitoring tools
+} ProgressFormat;
+
+typedef struct {
+    FILE *out;
+    ProgressFormat format;
+    bool redraw;                // out is a TTY: overwrite the line with '\r'
+    double interval;            // Minimum seconds between reports
+    off_t total_bytes;          // Input size, 0 if unknown
+    off_t start_offset;         // Offset the scan started at (non-zero when resuming)
+    off_t next_check;           // Offset at which the clock is read again
+    double start_time;
+    double last_time;           // Time and offset of the previous report
+    off_t last_offset;
+    bool finished;              // The final report was written; later ones are dropped
+} ProgressReporter;
+
+// Reports to `out` in the given format. total_bytes may be 0 if unknown.
+void progress_start(ProgressReporter *progress, FILE *out, ProgressFormat format, off_t total_bytes, off_t start_offset);
+
+// Writes a report if the interval has passed, or unconditionally when done.
+// Scanners call it once `offset` reaches next_check, and once with done set
+// at the end; only the first done report is written.
+void progress_report(ProgressReporter *progress, off_t offset, int tables, bool done);
+
+#endif // PROGRESS_H
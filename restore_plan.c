@@ -0,0 +1,517 @@
+#include "restore_plan.h"
+#include "dump_map.h"
+#include "dump_regions.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h> // For PRIu64
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define RESTORE_MIN_CUT (1024 * 1024)
+#define RESTORE_MAX_CUT (64 * 1024 * 1024)
+#define RESTORE_MAX_FK_PASSES 64                // Bounds the depth of foreign key cycles
+
+// A data range loaded by one stream
+typedef struct {
+    const DumpRegion *region;
+    int depth;                  // Longest chain of foreign keys from the table to others
+    off_t start;
+    off_t end;
+    int stream;
+} RestoreItem;
+
+typedef struct RestoreJob {
+    const RestoreOptions *options;
+    DumpMap dump;
+    DumpRegions regions;
+    int *depths;                // Per region
+    RestoreItem *items;
+    int item_count;
+} RestoreJob;
+
+typedef struct {
+    RestoreJob *job;
+    int stream;
+    char *path;
+    RestoreItem **items;
+    int count;
+    uint64_t bytes;
+    pthread_t thread;
+    bool ok;
+} StreamWriter;
+
+// --- Static Helper Function Declarations ---
+static bool prepare_output_dir(const char *output_dir);
+static char *output_path(const char *output_dir, const char *name);
+static bool remove_stale_scripts(const char *output_dir, int streams, bool has_post);
+static bool compute_depths(RestoreJob *job);
+static int compare_region_names(const void *a, const void *b);
+static bool build_items(RestoreJob *job, off_t cut_interval);
+static void assign_streams(RestoreJob *job, uint64_t *stream_bytes);
+static int compare_by_size_desc(const void *a, const void *b);
+static int compare_by_depth(const void *a, const void *b);
+static bool write_schema(RestoreJob *job, const char *path, uint64_t *bytes);
+static bool write_post(RestoreJob *job, const char *path, uint64_t *bytes);
+static void *write_stream(void *arg);
+static int open_script(const char *path, bool fifo);
+static bool close_script(int fd, const char *path, bool ok);
+
+// --- Function Implementations ---
+
+bool plan_restore(SqlIndex *index, const char *sql_filename, const RestoreOptions *options) {
+    // Foreign keys come from the parsed columns, which update the shared index
+    if (!load_all_table_columns(index, sql_filename)) {
+        return false;
+    }
+
+    RestoreJob job = {0};
+    job.options = options;
+    if (!dump_map_open(&job.dump, sql_filename, index) || !prepare_output_dir(options->output_dir) ||
+        !init_dump_regions(&job.regions, index, &job.dump)) {
+        dump_map_close(&job.dump);
+        return false;
+    }
+    DumpRegions *regions = &job.regions;
+
+    // Cut points every 1/8 of a stream's share of the data, within bounds
+    off_t data_bytes = job.dump.size - regions->regions[0].end;
+    regions->cut_interval = data_bytes / (8 * (off_t)options->streams);
+    if (regions->cut_interval < RESTORE_MIN_CUT) regions->cut_interval = RESTORE_MIN_CUT;
+    if (regions->cut_interval > RESTORE_MAX_CUT) regions->cut_interval = RESTORE_MAX_CUT;
+
+    bool ok = classify_dump_regions(regions, options->threads) && compute_depths(&job) &&
+              build_items(&job, regions->cut_interval);
+    uint64_t *stream_bytes = mem_calloc(MEM_EXPORT, (size_t)options->streams, sizeof(uint64_t));
+    StreamWriter *writers = mem_calloc(MEM_EXPORT, (size_t)options->streams, sizeof(StreamWriter));
+    RestoreItem **stream_items = mem_malloc(MEM_EXPORT, ((size_t)job.item_count + 1) * sizeof(RestoreItem *));
+    if (ok && (!stream_bytes || !writers || !stream_items)) {
+        perror("Failed to allocate restore streams");
+        ok = false;
+    }
+
+    char *schema_path = ok ? output_path(options->output_dir, "restore-schema.sql") : NULL;
+    char *post_path = ok ? output_path(options->output_dir, "restore-post.sql") : NULL;
+    ok = ok && schema_path && post_path;
+    bool has_post = false;
+    if (ok) {
+        assign_streams(&job, stream_bytes);
+
+        // Each stream's items, parents before the tables referencing them
+        int n = 0;
+        for (int s = 0; s < options->streams && ok; ++s) {
+            StreamWriter *writer = &writers[s];
+            writer->job = &job;
+            writer->stream = s;
+            writer->items = &stream_items[n];
+            for (int i = 0; i < job.item_count; ++i) {
+                if (job.items[i].stream == s) {
+                    stream_items[n++] = &job.items[i];
+                }
+            }
+            writer->count = (int)(&stream_items[n] - writer->items);
+            qsort(writer->items, (size_t)writer->count, sizeof(RestoreItem *), compare_by_depth);
+            char name[32];
+            snprintf(name, sizeof(name), "restore-%d.sql", s + 1);
+            ok = (writer->path = output_path(options->output_dir, name)) != NULL;
+        }
+        for (int i = 0; i < regions->count && !has_post; ++i) {
+            for (int j = 0; j < regions->regions[i].segment_count; ++j) {
+                const Segment *segment = &regions->regions[i].segments[j];
+                if ((segment->kind == SEG_POST || segment->kind == SEG_TRIGGER) &&
+                    !segment_in_data(&regions->regions[i], segment)) {
+                    has_post = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Scripts of an earlier plan with more streams, or a post script, must not be loaded with these
+    ok = ok && remove_stale_scripts(options->output_dir, options->streams, has_post);
+
+    if (ok) {
+        printf("Restore plan: %d streams, %d tables, %d data pieces.\n", options->streams, regions->count - 1,
+               job.item_count);
+        printf("  1. %s\n", schema_path);
+        for (int s = 0; s < options->streams; ++s) {
+            printf("  2. %s (%" PRIu64 " bytes of data in %d pieces)\n", writers[s].path, stream_bytes[s],
+                   writers[s].count);
+        }
+        if (has_post) {
+            printf("  3. %s\n", post_path);
+        }
+        printf("Load %s first, then the streams concurrently%s.\n", schema_path,
+               has_post ? ", then the post script" : "");
+        fflush(stdout);
+
+        uint64_t schema_bytes = 0;
+        uint64_t post_bytes = 0;
+        ok = write_schema(&job, schema_path, &schema_bytes) && (!has_post || write_post(&job, post_path, &post_bytes));
+        DEBUG_PRINT("Wrote %" PRIu64 " bytes of schema and %" PRIu64 " bytes of post script.", schema_bytes, post_bytes);
+    }
+
+    if (ok) {
+        if (options->fifo) {
+            // A client that goes away must fail its writer, not end the process
+            signal(SIGPIPE, SIG_IGN);
+            fprintf(stderr, "Waiting for a reader on each of the %d FIFOs...\n", options->streams);
+        }
+        // Shared ranges (preamble SETs, USE) are filled once here so the
+        // writers only read them
+        for (int i = 0; i < regions->count && ok; ++i) {
+            for (int j = 0; j < regions->regions[i].segment_count; ++j) {
+                const Segment *segment = &regions->regions[i].segments[j];
+                if ((segment->kind == SEG_USE || (i == 0 && segment->kind == SEG_SET)) &&
+                    !dump_map_fill(&job.dump, segment->start, segment->end)) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        int started = 0;
+        for (int s = 0; s < options->streams && ok; ++s) {
+            if (pthread_create(&writers[s].thread, NULL, write_stream, &writers[s]) != 0) {
+                perror("Failed to start restore stream writer");
+                ok = false;
+                break;
+            }
+            started++;
+        }
+        for (int s = 0; s < started; ++s) {
+            pthread_join(writers[s].thread, NULL);
+            ok = ok && writers[s].ok;
+        }
+        if (ok) {
+            printf("Wrote %d restore streams to '%s'.\n", options->streams, options->output_dir);
+        }
+    }
+
+    for (int s = 0; writers && s < options->streams; ++s) {
+        free(writers[s].path);
+    }
+    free(writers);
+    free(stream_items);
+    free(stream_bytes);
+    free(schema_path);
+    free(post_path);
+    free(job.items);
+    free(job.depths);
+    cleanup_dump_regions(regions);
+    dump_map_close(&job.dump);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+static bool prepare_output_dir(const char *output_dir) {
+    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating output directory '%s': %s\n", output_dir, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static char *output_path(const char *output_dir, const char *name) {
+    size_t len = strlen(output_dir) + strlen(name) + 2;
+    char *path = mem_malloc(MEM_EXPORT, len);
+    if (!path) {
+        perror("Failed to allocate output path");
+        return NULL;
+    }
+    snprintf(path, len, "%s/%s", output_dir, name);
+    return path;
+}
+
+// Removes restore-<k>.sql for k > streams and, without has_post,
+// restore-post.sql, whether files or FIFOs
+static bool remove_stale_scripts(const char *output_dir, int streams, bool has_post) {
+    DIR *dir = opendir(output_dir);
+    if (!dir) {
+        fprintf(stderr, "Error opening output directory '%s': %s\n", output_dir, strerror(errno));
+        return false;
+    }
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        bool stale = false;
+        if (strcmp(name, "restore-post.sql") == 0) {
+            stale = !has_post;
+        } else if (strncmp(name, "restore-", 8) == 0 && name[8] >= '1' && name[8] <= '9') {
+            char *end;
+            long k = strtol(name + 8, &end, 10);
+            stale = strcmp(end, ".sql") == 0 && k > streams;
+        }
+        if (!stale) {
+            continue;
+        }
+        char *path = output_path(output_dir, name);
+        if (!path) {
+            ok = false;
+        } else if (unlink(path) != 0 && errno != ENOENT) {
+            fprintf(stderr, "Error removing stale restore script '%s': %s\n", path, strerror(errno));
+            ok = false;
+        } else {
+            DEBUG_PRINT("Removed stale restore script '%s'.", path);
+        }
+        free(path);
+    }
+    closedir(dir);
+    return ok;
+}
+
+// depth(t) = 1 + the largest depth of the tables t references. Tables are
+// matched by name, so a name repeated across databases shares constraints;
+// cycles stop growing after RESTORE_MAX_FK_PASSES.
+static bool compute_depths(RestoreJob *job) {
+    const DumpRegions *regions = &job->regions;
+    job->depths = mem_calloc(MEM_EXPORT, (size_t)regions->count, sizeof(int));
+    if (!job->depths) {
+        perror("Failed to allocate restore plan");
+        return false;
+    }
+    int count = regions->count - 1;
+    if (count <= 0) return true;
+    const DumpRegion **by_name = mem_malloc(MEM_EXPORT, (size_t)count * sizeof(DumpRegion *));
+    if (!by_name) {
+        DEBUG_PRINT("No memory to order tables by foreign keys; keeping dump order.");
+        return true;
+    }
+    for (int i = 0; i < count; ++i) {
+        by_name[i] = &regions->regions[i + 1];
+    }
+    qsort(by_name, (size_t)count, sizeof(DumpRegion *), compare_region_names);
+
+    bool changed = true;
+    for (int pass = 0; pass < RESTORE_MAX_FK_PASSES && changed; ++pass) {
+        changed = false;
+        for (int i = 1; i < regions->count; ++i) {
+            const TableInfo *table_info = regions->regions[i].table_info;
+            for (int k = 0; k < table_info->key_count; ++k) {
+                const KeyInfo *key = &table_info->keys[k];
+                if (key->kind != KEY_FOREIGN || !key->ref_table) continue;
+                const char *ref = unqualified_name(key->ref_table);
+                if (strcmp(ref, table_info->name) == 0) continue; // Self reference
+                // First table of that name, then all of them
+                int lo = 0, hi = count;
+                while (lo < hi) {
+                    int mid = lo + (hi - lo) / 2;
+                    if (strcmp(by_name[mid]->table_info->name, ref) < 0) lo = mid + 1; else hi = mid;
+                }
+                for (int j = lo; j < count && strcmp(by_name[j]->table_info->name, ref) == 0; ++j) {
+                    int ref_depth = job->depths[by_name[j] - regions->regions];
+                    if (ref_depth + 1 > job->depths[i]) {
+                        job->depths[i] = ref_depth + 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    free(by_name);
+    return true;
+}
+
+static int compare_region_names(const void *a, const void *b) {
+    const DumpRegion *ra = *(const DumpRegion *const *)a;
+    const DumpRegion *rb = *(const DumpRegion *const *)b;
+    return strcmp(ra->table_info->name, rb->table_info->name);
+}
+
+// One item per table's data, or several for a table with more than its
+// share: pieces of at least `target` bytes, cut at the recorded points.
+static bool build_items(RestoreJob *job, off_t cut_interval) {
+    const DumpRegions *regions = &job->regions;
+    off_t total = 0;
+    int capacity = 0;
+    for (int i = 0; i < regions->count; ++i) {
+        const DumpRegion *region = &regions->regions[i];
+        if (region->data_start >= 0) {
+            total += region->data_end - region->data_start;
+            capacity += region->cut_count + 1;
+        }
+    }
+    off_t target = total / (2 * (off_t)job->options->streams);
+    if (target < cut_interval) target = cut_interval;
+
+    job->items = mem_malloc(MEM_EXPORT, ((size_t)capacity + 1) * sizeof(RestoreItem));
+    if (!job->items) {
+        perror("Failed to allocate restore pieces");
+        return false;
+    }
+    for (int i = 0; i < regions->count; ++i) {
+        const DumpRegion *region = &regions->regions[i];
+        if (region->data_start < 0) continue;
+        off_t start = region->data_start;
+        for (int c = 0; c < region->cut_count; ++c) {
+            off_t cut = region->cuts[c];
+            if (cut - start >= target && region->data_end - cut >= cut_interval) {
+                job->items[job->item_count++] = (RestoreItem){region, job->depths[i], start, cut, 0};
+                start = cut;
+            }
+        }
+        job->items[job->item_count++] = (RestoreItem){region, job->depths[i], start, region->data_end, 0};
+    }
+    return true;
+}
+
+// Longest processing time first: the largest remaining piece goes to the
+// stream with the least data so far
+static void assign_streams(RestoreJob *job, uint64_t *stream_bytes) {
+    RestoreItem **sorted = mem_malloc(MEM_EXPORT, ((size_t)job->item_count + 1) * sizeof(RestoreItem *));
+    if (!sorted) {
+        // Round robin still gives every stream work
+        for (int i = 0; i < job->item_count; ++i) {
+            job->items[i].stream = i % job->options->streams;
+            stream_bytes[job->items[i].stream] += (uint64_t)(job->items[i].end - job->items[i].start);
+        }
+        return;
+    }
+    for (int i = 0; i < job->item_count; ++i) {
+        sorted[i] = &job->items[i];
+    }
+    qsort(sorted, (size_t)job->item_count, sizeof(RestoreItem *), compare_by_size_desc);
+    for (int i = 0; i < job->item_count; ++i) {
+        int best = 0;
+        for (int s = 1; s < job->options->streams; ++s) {
+            if (stream_bytes[s] < stream_bytes[best]) best = s;
+        }
+        sorted[i]->stream = best;
+        stream_bytes[best] += (uint64_t)(sorted[i]->end - sorted[i]->start);
+    }
+    free(sorted);
+}
+
+static int compare_by_size_desc(const void *a, const void *b) {
+    const RestoreItem *ia = *(const RestoreItem *const *)a;
+    const RestoreItem *ib = *(const RestoreItem *const *)b;
+    off_t sa = ia->end - ia->start;
+    off_t sb = ib->end - ib->start;
+    if (sa != sb) return (sa < sb) - (sa > sb);
+    return (ia->start > ib->start) - (ia->start < ib->start);
+}
+
+// Referenced tables first, then dump order
+static int compare_by_depth(const void *a, const void *b) {
+    const RestoreItem *ia = *(const RestoreItem *const *)a;
+    const RestoreItem *ib = *(const RestoreItem *const *)b;
+    if (ia->depth != ib->depth) return (ia->depth > ib->depth) - (ia->depth < ib->depth);
+    return (ia->start > ib->start) - (ia->start < ib->start);
+}
+
+// The preamble and every statement outside the data, in dump order
+static bool write_schema(RestoreJob *job, const char *path, uint64_t *bytes) {
+    int fd = open_script(path, false);
+    if (fd < 0) return false;
+    DumpWriter w;
+    dump_writer_init(&w, &job->dump, fd, false);
+    for (int i = 0; i < job->regions.count; ++i) {
+        const DumpRegion *region = &job->regions.regions[i];
+        for (int j = 0; j < region->segment_count; ++j) {
+            const Segment *segment = &region->segments[j];
+            if ((segment->kind == SEG_SCHEMA || segment->kind == SEG_VIEW || segment->kind == SEG_USE ||
+                 segment->kind == SEG_SET) && !segment_in_data(region, segment)) {
+                dump_writer_range(&w, segment->start, segment->end);
+            }
+        }
+    }
+    dump_writer_flush(&w);
+    *bytes = w.bytes;
+    return close_script(fd, path, w.ok);
+}
+
+// The preamble's SETs, then each DELIMITER block after the USE in effect there
+static bool write_post(RestoreJob *job, const char *path, uint64_t *bytes) {
+    int fd = open_script(path, false);
+    if (fd < 0) return false;
+    DumpWriter w;
+    dump_writer_init(&w, &job->dump, fd, false);
+    write_session_header(&w, &job->regions);
+    const Segment *current = NULL;
+    const Segment *written = NULL;
+    for (int i = 0; i < job->regions.count; ++i) {
+        const DumpRegion *region = &job->regions.regions[i];
+        for (int j = 0; j < region->segment_count; ++j) {
+            const Segment *segment = &region->segments[j];
+            if (segment_in_data(region, segment)) continue;
+            if (segment->kind == SEG_USE) {
+                current = segment;
+            } else if (segment->kind == SEG_POST || segment->kind == SEG_TRIGGER) {
+                if (current != written && current) {
+                    dump_writer_range(&w, current->start, current->end);
+                    written = current;
+                }
+                dump_writer_range(&w, segment->start, segment->end);
+            }
+        }
+    }
+    dump_writer_flush(&w);
+    *bytes = w.bytes;
+    return close_script(fd, path, w.ok);
+}
+
+static void *write_stream(void *arg) {
+    StreamWriter *writer = arg;
+    RestoreJob *job = writer->job;
+    bool fifo = job->options->fifo;
+    int fd = open_script(writer->path, fifo);
+    if (fd < 0) {
+        writer->ok = false;
+        return NULL;
+    }
+    DumpWriter w;
+    dump_writer_init(&w, &job->dump, fd, fifo);
+    write_session_header(&w, &job->regions);
+    const Segment *written = NULL;
+    for (int i = 0; i < writer->count && w.ok; ++i) {
+        const RestoreItem *item = writer->items[i];
+        if (item->region->use && item->region->use != written) {
+            dump_writer_flush(&w);
+            w.shared = true;
+            dump_writer_range(&w, item->region->use->start, item->region->use->end);
+            dump_writer_flush(&w);
+            w.shared = false;
+            written = item->region->use;
+        }
+        dump_writer_range(&w, item->start, item->end);
+    }
+    dump_writer_flush(&w);
+    writer->bytes = w.bytes;
+    writer->ok = close_script(fd, writer->path, w.ok);
+    return NULL;
+}
+
+// A FIFO is (re)created and opened for writing, which waits for a reader
+static int open_script(const char *path, bool fifo) {
+    if (fifo) {
+        struct stat st;
+        if (lstat(path, &st) == 0 && !S_ISFIFO(st.st_mode) && unlink(path) != 0) {
+            fprintf(stderr, "Error replacing '%s' with a FIFO: %s\n", path, strerror(errno));
+            return -1;
+        }
+        if (mkfifo(path, 0666) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Error creating FIFO '%s': %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    int fd = open(path, fifo ? O_WRONLY : O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening '%s' for writing: %s\n", path, strerror(errno));
+    }
+    return fd;
+}
+
+static bool close_script(int fd, const char *path, bool ok) {
+    if (close(fd) != 0 && ok) {
+        fprintf(stderr, "Error writing '%s': %s\n", path, strerror(errno));
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,49 @@
+#ifndef RESTORE_PLAN_H
+#define RESTORE_PLAN_H
+
+#include <stdbool.h>
+#include "sql_indexer.h"
+
+// --- Parallel Restore Plan ---
+// Splits a dump into scripts that restore it with several concurrent
+// clients instead of one `mysql < dump.sql`:
+//
+//   <output_dir>/restore-schema.sql  every statement except the table data,
+//                                    in dump order; load it first
+//   <output_dir>/restore-<k>.sql     k = 1..streams: the session SETs of the
+//                                    dump's preamble, then a share of the
+//                                    INSERTs; load these concurrently
+//   <output_dir>/restore-post.sql    DELIMITER blocks (triggers, routines);
+//                                    load it last. Only written if the dump
+//                                    has any.
+//
+// Scripts an earlier plan left in output_dir that this one does not write
+// (restore-<k>.sql beyond `streams`, restore-post.sql) are removed.
+//
+// Each table's INSERTs, from its first to its last, form one data range.
+// Ranges of more than about 1/(2*streams) of all data are cut at statement
+// ends into pieces. Pieces are assigned to streams largest first, each to
+// the least loaded stream (LPT); within a stream, tables referenced by
+// foreign keys come before the tables referencing them. A piece is preceded
+// by the USE statement in effect at its position. LOCK/UNLOCK TABLES and
+// ALTER TABLE ... DISABLE/ENABLE KEYS around the data are dropped, since
+// they would serialize the streams.
+//
+// Streams are written from the dump without passing through user space
+// (copy_file_range, or splice for FIFOs) when it is a plain SQL file. With
+// fifo set, the streams are named pipes written as the clients read them.
+
+typedef struct {
+    const char *output_dir;     // Created if missing
+    int streams;                // Number of data streams (>= 1)
+    int threads;                // Workers classifying statements; <= 0 for one per online CPU
+    bool fifo;                  // Make the streams FIFOs instead of files
+} RestoreOptions;
+
+// --- Function Declarations ---
+
+// Plans the restore and writes the scripts, loading every table's columns
+// first (which updates the index). Prints the plan on stdout.
+bool plan_restore(SqlIndex *index, const char *sql_filename, const RestoreOptions *options);
+
+#endif // RESTORE_PLAN_H
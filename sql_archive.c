@@ -0,0 +1,498 @@
+#define _GNU_SOURCE // For fopencookie, fmemopen, open_memstream
+#include "sql_archive.h"
+#include "mem_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Skippable frame holding the index; the seek table uses 0x184D2A5E
+#define ARCHIVE_INDEX_MAGIC 0x184D2A51u
+#define ARCHIVE_INDEX_TAG "SQLINDEX"
+#define ARCHIVE_INDEX_TAG_LEN 8
+// Skippable frame header, tag and the index text's size
+#define ARCHIVE_INDEX_HEADER_SIZE (8 + ARCHIVE_INDEX_TAG_LEN + 4)
+
+// Frames end at the first top-level ';' past COMPRESS_FRAME_SIZE; a
+// statement longer than this is cut inside it
+#define ARCHIVE_MAX_FRAME (64 * COMPRESS_FRAME_SIZE)
+// A CREATE TABLE closer than this to the last one stays in its frame, so
+// thousands of tiny tables do not become thousands of tiny frames
+#define ARCHIVE_MIN_TABLE_FRAME ((off_t)64 * 1024)
+
+// Frame ends planned by pack_sql_file
+typedef struct {
+    size_t *ends;
+    int count;
+    int capacity;
+} FramePlan;
+
+// Cookie of the stream returned by open_sql_input for archives
+typedef struct {
+    SqlArchive archive;
+    off_t position;
+    int frame;                  // Frame held in `data`; -1 if none
+    char *data;
+    size_t data_size;
+} ArchiveStream;
+
+// --- Static Helper Function Declarations ---
+static bool locate_archive(SqlArchive *archive);
+static int find_frame(const SqlArchive *archive, off_t offset);
+static bool read_frame(const SqlArchive *archive, int frame, char *dst);
+static bool plan_frames(const SqlIndex *index, const char *map, off_t size, FramePlan *plan);
+static bool plan_region(const char *map, off_t start, off_t end, FramePlan *plan);
+static bool add_frame_end(FramePlan *plan, size_t end);
+static bool write_index_frame(FILE *out, const SqlIndex *index, const char *sql_file_sha256,
+                              const CompressOptions *options);
+static void put_le32(unsigned char *p, uint32_t value);
+static uint32_t get_le32(const unsigned char *p);
+static ssize_t stream_read(void *cookie, char *buf, size_t size);
+static int stream_seek(void *cookie, off64_t *offset, int whence);
+static int stream_close(void *cookie);
+
+// --- Function Implementations ---
+
+bool is_sql_archive(const char *filename) {
+    SqlArchive archive;
+    memset(&archive, 0, sizeof(archive));
+    archive.fd = open(filename, O_RDONLY);
+    if (archive.fd < 0) {
+        return false;
+    }
+    bool found = locate_archive(&archive);
+    archive_close(&archive);
+    return found;
+}
+
+bool archive_open(SqlArchive *archive, const char *filename) {
+    memset(archive, 0, sizeof(*archive));
+    archive->fd = open(filename, O_RDONLY);
+    if (archive->fd < 0) {
+        fprintf(stderr, "Error opening archive '%s': %s\n", filename, strerror(errno));
+        return false;
+    }
+    if (!locate_archive(archive)) {
+        fprintf(stderr, "Error: '%s' is not a packed SQL archive.\n", filename);
+        archive_close(archive);
+        return false;
+    }
+    return true;
+}
+
+void archive_close(SqlArchive *archive) {
+    if (archive->fd >= 0) {
+        close(archive->fd);
+    }
+    free(archive->frames);
+    free(archive->frame_offsets);
+    free(archive->raw_offsets);
+    memset(archive, 0, sizeof(*archive));
+    archive->fd = -1;
+}
+
+bool read_index_from_archive(SqlIndex *index, const char *archive_filename) {
+    SqlArchive archive;
+    if (!archive_open(&archive, archive_filename)) {
+        return false;
+    }
+    char *packed = mem_malloc(MEM_BUFFERS, archive.index_size > 0 ? archive.index_size : 1);
+    char *text = mem_malloc(MEM_BUFFERS, archive.index_raw_size > 0 ? archive.index_raw_size : 1);
+    bool ok = packed && text &&
+              pread(archive.fd, packed, archive.index_size, archive.index_offset) == (ssize_t)archive.index_size;
+    if (!ok) {
+        perror("Error reading archive index");
+    } else if ((ok = decompress_frame(COMPRESS_ZSTD, packed, archive.index_size, text, archive.index_raw_size))) {
+        FILE *fp = fmemopen(text, archive.index_raw_size, "r");
+        ok = fp && read_index_from_stream(index, fp, archive_filename);
+        if (fp) fclose(fp);
+    }
+    free(packed);
+    free(text);
+    archive_close(&archive);
+    return ok;
+}
+
+bool archive_read(const SqlArchive *archive, off_t offset, char *dst, size_t len) {
+    if (offset < 0 || offset + (off_t)len > archive->raw_size) {
+        fprintf(stderr, "Error: Archive read past the end of the dump.\n");
+        return false;
+    }
+    char *frame_data = NULL;
+    size_t frame_data_size = 0;
+    bool ok = true;
+    off_t end = offset + (off_t)len;
+    for (int i = len > 0 ? find_frame(archive, offset) : archive->frame_count; ok && i < archive->frame_count; ++i) {
+        off_t frame_start = archive->raw_offsets[i];
+        off_t frame_end = archive->raw_offsets[i + 1];
+        if (frame_start >= end) {
+            break;
+        }
+        if (frame_start >= offset && frame_end <= end) {
+            ok = read_frame(archive, i, dst + (frame_start - offset)); // Whole frame, straight into dst
+            continue;
+        }
+        // Only the first and last frames can be partial
+        size_t raw_size = archive->frames[i].raw_size;
+        if (raw_size > frame_data_size) {
+            char *new_data = mem_realloc(MEM_BUFFERS, frame_data, raw_size);
+            if (!new_data) {
+                perror("Failed to allocate archive frame");
+                free(frame_data);
+                return false;
+            }
+            frame_data = new_data;
+            frame_data_size = raw_size;
+        }
+        ok = read_frame(archive, i, frame_data);
+        if (ok) {
+            off_t from = offset > frame_start ? offset : frame_start;
+            off_t to = end < frame_end ? end : frame_end;
+            memcpy(dst + (from - offset), frame_data + (from - frame_start), (size_t)(to - from));
+        }
+    }
+    free(frame_data);
+    return ok;
+}
+
+bool same_file(const char *a, const char *b) {
+    struct stat sa, sb;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+FILE *open_sql_input(const char *filename, const SqlIndex *index) {
+    if (index && index->parts.count > 0) {
+        return open_parts_stream(&index->parts);
+    }
+    if (is_gzip_file(filename)) {
+        return gzip_open_stream(filename, index ? &index->gzip : NULL, NULL);
+    }
+    if (!is_sql_archive(filename)) {
+        return fopen(filename, "rb");
+    }
+    ArchiveStream *stream = mem_calloc(MEM_BUFFERS, 1, sizeof(ArchiveStream));
+    if (!stream) {
+        return NULL;
+    }
+    if (!archive_open(&stream->archive, filename)) {
+        free(stream);
+        errno = EINVAL;
+        return NULL;
+    }
+    stream->frame = -1;
+    cookie_io_functions_t io = {stream_read, NULL, stream_seek, stream_close};
+    FILE *fp = fopencookie(stream, "r", io);
+    if (!fp) {
+        stream_close(stream);
+    }
+    return fp;
+}
+
+bool pack_sql_file(const SqlIndex *index, const char *sql_filename, const char *sql_file_sha256,
+                   const char *archive_filename, const CompressOptions *options) {
+    if (same_file(sql_filename, archive_filename)) {
+        fprintf(stderr, "Error: The archive must not overwrite '%s'.\n", sql_filename);
+        return false;
+    }
+    if (options->format != COMPRESS_ZSTD) {
+        fprintf(stderr, "Error: Archives are written with zstd only.\n");
+        return false;
+    }
+    if (index->gzip.span > 0) {
+        fprintf(stderr, "Error: '%s' is gzip-compressed; decompress it before packing.\n", sql_filename);
+        return false;
+    }
+    int fd = open(sql_filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening file '%s': %s\n", sql_filename, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Error reading SQL file size");
+        close(fd);
+        return false;
+    }
+    const char *map = NULL;
+    if (st.st_size > 0) {
+        void *mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            perror("Error mapping SQL file");
+            close(fd);
+            return false;
+        }
+        map = mapping;
+        madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+    }
+    close(fd); // The mapping stays valid
+
+    FramePlan plan = {0};
+    bool ok = plan_frames(index, map, st.st_size, &plan);
+    FILE *out = ok ? fopen(archive_filename, "wb") : NULL;
+    if (ok && !out) {
+        fprintf(stderr, "Error creating '%s': %s\n", archive_filename, strerror(errno));
+        ok = false;
+    }
+
+    FrameWriter writer;
+    if (out && frame_writer_init(&writer, out, options)) {
+        ok = frame_writer_write_frames(&writer, map, plan.ends, plan.count) &&
+             write_index_frame(out, index, sql_file_sha256, options) &&
+             frame_writer_finish(&writer, true);
+        frame_writer_cleanup(&writer);
+    } else {
+        ok = false;
+    }
+    off_t archive_size = out ? ftello(out) : 0;
+    if (out && fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok && out) {
+        fprintf(stderr, "Error writing archive '%s'.\n", archive_filename);
+        remove(archive_filename); // A partial archive has no seek table to find
+    }
+    if (ok) {
+        printf("Packed '%s' (%jd bytes) into '%s' (%jd bytes, %d frames).\n", sql_filename, (intmax_t)st.st_size,
+               archive_filename, (intmax_t)archive_size, plan.count);
+    }
+
+    free(plan.ends);
+    if (map) munmap((void *)map, (size_t)st.st_size);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+// Reads the seek table and checks that the index frame sits between the
+// last data frame and the seek table.
+static bool locate_archive(SqlArchive *archive) {
+    struct stat st;
+    off_t table_offset = 0;
+    if (fstat(archive->fd, &st) != 0 ||
+        !read_seek_table(archive->fd, st.st_size, &archive->frames, &archive->frame_count, &table_offset)) {
+        return false;
+    }
+
+    int count = archive->frame_count;
+    archive->frame_offsets = mem_malloc(MEM_INDEX, (size_t)(count + 1) * sizeof(off_t));
+    archive->raw_offsets = mem_malloc(MEM_INDEX, (size_t)(count + 1) * sizeof(off_t));
+    if (!archive->frame_offsets || !archive->raw_offsets) {
+        return false;
+    }
+    off_t compressed = 0;
+    off_t raw = 0;
+    for (int i = 0; i < count; ++i) {
+        archive->frame_offsets[i] = compressed;
+        archive->raw_offsets[i] = raw;
+        compressed += archive->frames[i].compressed_size;
+        raw += archive->frames[i].raw_size;
+    }
+    archive->frame_offsets[count] = compressed;
+    archive->raw_offsets[count] = raw;
+    archive->raw_size = raw;
+
+    unsigned char header[ARCHIVE_INDEX_HEADER_SIZE];
+    if (compressed + (off_t)sizeof(header) > table_offset ||
+        pread(archive->fd, header, sizeof(header), compressed) != (ssize_t)sizeof(header) ||
+        get_le32(header) != ARCHIVE_INDEX_MAGIC ||
+        memcmp(header + 8, ARCHIVE_INDEX_TAG, ARCHIVE_INDEX_TAG_LEN) != 0 ||
+        compressed + 8 + (off_t)get_le32(header + 4) != table_offset) {
+        return false;
+    }
+    archive->index_offset = compressed + (off_t)sizeof(header);
+    archive->index_size = (size_t)(table_offset - archive->index_offset);
+    archive->index_raw_size = get_le32(header + 8 + ARCHIVE_INDEX_TAG_LEN);
+    return true;
+}
+
+// Last frame starting at or before offset
+static int find_frame(const SqlArchive *archive, off_t offset) {
+    int low = 0;
+    int high = archive->frame_count - 1;
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+        if (archive->raw_offsets[mid] <= offset) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+static bool read_frame(const SqlArchive *archive, int frame, char *dst) {
+    size_t compressed_size = archive->frames[frame].compressed_size;
+    char *src = mem_malloc(MEM_BUFFERS, compressed_size > 0 ? compressed_size : 1);
+    if (!src) {
+        perror("Failed to allocate archive frame");
+        return false;
+    }
+    bool ok = pread(archive->fd, src, compressed_size, archive->frame_offsets[frame]) == (ssize_t)compressed_size;
+    if (!ok) {
+        fprintf(stderr, "Error reading archive frame %d.\n", frame);
+    } else {
+        ok = decompress_frame(COMPRESS_ZSTD, src, compressed_size, dst, archive->frames[frame].raw_size);
+    }
+    free(src);
+    return ok;
+}
+
+// One region before the first CREATE TABLE and one from each CREATE TABLE
+// to the next (small tables share one), each cut into frames at statement ends
+static bool plan_frames(const SqlIndex *index, const char *map, off_t size, FramePlan *plan) {
+    off_t region_start = 0;
+    for (int i = 0; i < index->count; ++i) {
+        const TableInfo *table_info = index->entries[i].table_info;
+        if (!table_info || table_info->ddl_offset - region_start < ARCHIVE_MIN_TABLE_FRAME ||
+            table_info->ddl_offset >= size) {
+            continue;
+        }
+        if (!plan_region(map, region_start, table_info->ddl_offset, plan)) {
+            return false;
+        }
+        region_start = table_info->ddl_offset;
+    }
+    return plan_region(map, region_start, size, plan);
+}
+
+static bool plan_region(const char *map, off_t start, off_t end, FramePlan *plan) {
+    const char *p = map + start;
+    const char *region_end = map + end;
+    ParserState state = STATE_CODE;
+    while (p < region_end) {
+        const char *limit = region_end - p > (off_t)ARCHIVE_MAX_FRAME ? p + ARCHIVE_MAX_FRAME : region_end;
+        const char *cut = find_statement_end(p, limit, p + COMPRESS_FRAME_SIZE, &state, NULL);
+        if (!cut) {
+            cut = limit; // End of the region, or inside an overlong statement
+        }
+        if (!add_frame_end(plan, (size_t)(cut - map))) {
+            return false;
+        }
+        p = cut;
+    }
+    return true;
+}
+
+static bool add_frame_end(FramePlan *plan, size_t end) {
+    if (plan->count == plan->capacity) {
+        int new_capacity = plan->capacity == 0 ? 256 : plan->capacity * 2;
+        size_t *new_ends = mem_realloc(MEM_BUFFERS, plan->ends, (size_t)new_capacity * sizeof(size_t));
+        if (!new_ends) {
+            perror("Failed to allocate archive frame list");
+            return false;
+        }
+        plan->ends = new_ends;
+        plan->capacity = new_capacity;
+    }
+    plan->ends[plan->count++] = end;
+    return true;
+}
+
+// Header, then the index text as zstd frames (it compresses as well as the dump)
+static bool write_index_frame(FILE *out, const SqlIndex *index, const char *sql_file_sha256,
+                              const CompressOptions *options) {
+    char *text = NULL;
+    size_t len = 0;
+    char *packed = NULL;
+    size_t packed_len = 0;
+    FILE *mem = open_memstream(&text, &len);
+    bool ok = mem && write_index_to_stream(index, mem, sql_file_sha256);
+    if (mem && fclose(mem) != 0) {
+        ok = false;
+    }
+
+    FILE *sink = ok ? open_memstream(&packed, &packed_len) : NULL;
+    FrameWriter writer;
+    if (sink && frame_writer_init(&writer, sink, options)) {
+        ok = frame_writer_write(&writer, text, len) && frame_writer_finish(&writer, false);
+        frame_writer_cleanup(&writer);
+    } else {
+        ok = false;
+    }
+    if (sink && fclose(sink) != 0) {
+        ok = false;
+    }
+
+    if (ok && (len > UINT32_MAX || packed_len > UINT32_MAX - ARCHIVE_INDEX_HEADER_SIZE)) {
+        fprintf(stderr, "Error: Index too large for an archive.\n");
+        ok = false;
+    }
+    if (ok) {
+        unsigned char header[ARCHIVE_INDEX_HEADER_SIZE];
+        put_le32(header, ARCHIVE_INDEX_MAGIC);
+        put_le32(header + 4, (uint32_t)(ARCHIVE_INDEX_HEADER_SIZE - 8 + packed_len));
+        memcpy(header + 8, ARCHIVE_INDEX_TAG, ARCHIVE_INDEX_TAG_LEN);
+        put_le32(header + 8 + ARCHIVE_INDEX_TAG_LEN, (uint32_t)len);
+        ok = fwrite(header, 1, sizeof(header), out) == sizeof(header) && fwrite(packed, 1, packed_len, out) == packed_len;
+    }
+    free(text);
+    free(packed);
+    return ok;
+}
+
+static void put_le32(unsigned char *p, uint32_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static uint32_t get_le32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Serves reads from the frame holding the position, decompressing each
+// frame once while reads stay inside it
+static ssize_t stream_read(void *cookie, char *buf, size_t size) {
+    ArchiveStream *stream = cookie;
+    const SqlArchive *archive = &stream->archive;
+    size_t done = 0;
+    while (done < size && stream->position < archive->raw_size) {
+        int frame = find_frame(archive, stream->position);
+        if (frame != stream->frame) {
+            size_t raw_size = archive->frames[frame].raw_size;
+            if (raw_size > stream->data_size) {
+                char *new_data = mem_realloc(MEM_BUFFERS, stream->data, raw_size);
+                if (!new_data) {
+                    return -1;
+                }
+                stream->data = new_data;
+                stream->data_size = raw_size;
+            }
+            stream->frame = -1;
+            if (!read_frame(archive, frame, stream->data)) {
+                return -1;
+            }
+            stream->frame = frame;
+        }
+        off_t in_frame = stream->position - archive->raw_offsets[frame];
+        size_t n = archive->frames[frame].raw_size - (size_t)in_frame;
+        if (n > size - done) n = size - done;
+        memcpy(buf + done, stream->data + in_frame, n);
+        done += n;
+        stream->position += (off_t)n;
+    }
+    return (ssize_t)done;
+}
+
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+    ArchiveStream *stream = cookie;
+    off64_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? stream->position : stream->archive.raw_size;
+    if (base + *offset < 0) {
+        return -1;
+    }
+    stream->position = base + *offset;
+    *offset = stream->position;
+    return 0;
+}
+
+static int stream_close(void *cookie) {
+    ArchiveStream *stream = cookie;
+    archive_close(&stream->archive);
+    free(stream->data);
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#ifndef SQL_ARCHIVE_H
+#define SQL_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h> // For off_t
+#include "sql_indexer.h"
+#include "output_compress.h"
+
+// --- Packed SQL Archives ---
+// A dump recompressed by --pack into one seekable zstd file:
+//   [zstd frames of the SQL file]
+//   [skippable frame: ARCHIVE_INDEX_TAG, then the index in index-file
+//    format as zstd frames]
+//   [seek table (zstd seekable format)]
+// Each CREATE TABLE starts a new frame (unless the previous table was
+// smaller than 64 KiB) and the other frames end after a top-level ';', so
+// a table's DDL and rows decompress without touching the frames of large
+// tables around it. Plain zstd decoders skip both skippable frames
+// and restore the original dump; offsets in the embedded index refer to it.
+
+typedef struct {
+    int fd;
+    FrameEntry *frames;
+    int frame_count;
+    off_t *frame_offsets;       // Compressed offset of each frame
+    off_t *raw_offsets;         // Uncompressed offset of each frame, plus the total at [frame_count]
+    off_t raw_size;             // Size of the original dump
+    off_t index_offset;         // Embedded index, compressed
+    size_t index_size;
+    size_t index_raw_size;      // Size of the index text
+} SqlArchive;
+
+// --- Function Declarations ---
+
+// True if the file ends with a seek table preceded by an embedded index
+bool is_sql_archive(const char *filename);
+
+bool archive_open(SqlArchive *archive, const char *filename);
+void archive_close(SqlArchive *archive);
+
+// Loads the embedded index into *index
+bool read_index_from_archive(SqlIndex *index, const char *archive_filename);
+
+// Decompresses the dump's bytes [offset, offset + len) into dst,
+// decompressing only the frames that overlap them. Safe to call from
+// several threads at once.
+bool archive_read(const SqlArchive *archive, off_t offset, char *dst, size_t len);
+
+// Opens the dump for reading: a seekable stream over the decompressed
+// dump for archives and .sql.gz files, or over the concatenated parts of
+// a multi-part index, the file itself otherwise. Gzip streams seek via
+// index->gzip when index is not NULL. NULL with errno set on failure.
+FILE *open_sql_input(const char *filename, const SqlIndex *index);
+
+// Returns true if both paths name the same existing file, so that writing
+// one would destroy the other
+bool same_file(const char *a, const char *b);
+
+// Writes sql_filename, cut at statement boundaries, and its index (whose
+// columns should be loaded) to archive_filename. options->format must be
+// COMPRESS_ZSTD.
+bool pack_sql_file(const SqlIndex *index, const char *sql_filename, const char *sql_file_sha256,
+                   const char *archive_filename, const CompressOptions *options);
+
+#endif // SQL_ARCHIVE_H
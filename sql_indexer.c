@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // For fseeko, fileno and strdup
 #include "sql_indexer.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,25 +7,19 @@
 #include <stdbool.h>
 #include <errno.h> // Include for errno
 #include <strings.h> // Include for strncasecmp
+#include <inttypes.h> // For PRIx64
+#include <limits.h> // For INT_MAX
+#include <sys/stat.h> // For fstat in checkpoints
+#include <unistd.h> // For sysconf
 #include <cjson/cJSON.h>
 #include "sha256.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include "sql_archive.h"
+#include "work_pool.h"
 
-#if defined(_WIN32) || defined(_WIN64) || defined(__MSYS__)
-// Windows/MSYS2 doesn't have strcasestr, so we provide one.
-// This is a simple implementation using strncasecmp.
-char *strcasestr(const char *haystack, const char *needle) {
-    if (!needle || *needle == '\0') {
-        return (char *)haystack;
-    }
-    size_t needle_len = strlen(needle);
-    for (; *haystack; ++haystack) {
-        if (strncasecmp(haystack, needle, needle_len) == 0) {
-            return (char *)haystack;
-        }
-    }
-    return NULL;
-}
-#endif
+// --- Global Verbose Flag Definition ---
+bool verbose_mode = false;
 
 // --- Constants ---
 const char *CREATE_TABLE_KEYWORD = "CREATE TABLE";
@@ -32,19 +27,111 @@ const size_t CREATE_TABLE_LEN = 12; // strlen("CREATE TABLE")
 const size_t CHUNK_SIZE = 4096; // Read file in 4KB chunks
 const size_t BUFFER_EXTRA_MARGIN = 256; // Extra space for potential overflows
 
+// --- Index File Format ---
+// Bumped whenever the layout of index records changes; older files are re-parsed.
+#define INDEX_FORMAT_VERSION 10
+
+// Distinct table names shown per definition by --schemas
+#define SCHEMA_NAMES_LISTED 8
+
+// Bytes at the end of a skipped line searched for "; CREATE" by --assume-mysqldump
+#define DUMP_LINE_TAIL_SCAN 4096
+
+// Outcome of handling a statement that may extend past the current buffer
+typedef enum {
+    STMT_COMPLETE,
+    STMT_NEED_MORE_DATA,
+    STMT_ERROR
+} StatementResult;
+
+// --- Scan Tracing ---
+// Per-chunk spans would swamp a trace, so process_sql_file groups chunks into
+// one "scan block" span per TRACE_SCAN_BLOCK bytes whose detail splits the
+// time into reading, scanning and hashing. Reads slower than
+// TRACE_SLOW_READ_US get a span of their own so that I/O stalls stand out.
+#ifdef SQLINDEXER_TRACE
+#define TRACE_SCAN_BLOCK ((off_t)16 << 20)
+#define TRACE_SLOW_READ_US 1000
+
+typedef struct {
+    uint64_t block_start;       // 0 when not tracing
+    off_t block_offset;
+    uint64_t mark;              // End of the previous step
+    uint64_t read_us, scan_us, hash_us;
+} ScanTrace;
+
+static void scan_trace_step(ScanTrace *trace, uint64_t *total, bool is_read);
+static void scan_trace_block(ScanTrace *trace, off_t offset, bool last);
+
+#define SCAN_TRACE_INIT(t, offset) ScanTrace t = {trace_enabled ? trace_now() : 0, offset, 0, 0, 0, 0}
+#define SCAN_TRACE_MARK(t) do { if (t.block_start) t.mark = trace_now(); } while (0)
+#define SCAN_TRACE_READ(t) do { if (t.block_start) scan_trace_step(&t, &t.read_us, true); } while (0)
+#define SCAN_TRACE_STEP(t, field) do { if (t.block_start) scan_trace_step(&t, &t.field, false); } while (0)
+#define SCAN_TRACE_BLOCK(t, offset, last) do { if (t.block_start) scan_trace_block(&t, offset, last); } while (0)
+#else
+#define SCAN_TRACE_INIT(t, offset) ((void)0)
+#define SCAN_TRACE_MARK(t) ((void)0)
+#define SCAN_TRACE_READ(t) ((void)0)
+#define SCAN_TRACE_STEP(t, field) ((void)0)
+#define SCAN_TRACE_BLOCK(t, offset, last) ((void)0)
+#endif
+
 // --- Static Helper Function Declarations ---
 static bool ensure_buffer_capacity(ParsingContext *ctx, size_t required_size);
-static bool add_index_entry(SqlIndex *index, const char *type, const char *name, int line_number);
-static bool add_table_entry(SqlIndex *index, const char *name, int line_number);
+static bool add_index_entry(SqlIndex *index, const char *type, const char *name, uint64_t line_number);
+static bool add_table_entry(SqlIndex *index, const char *name, uint64_t line_number);
 // Updated signature for process_chunk
 static size_t process_chunk(ParsingContext *ctx);
-static const char* find_next_token(const char *ptr, const char *end);
-static size_t get_token_length(const char *token_start);
-static bool add_column_to_table(TableInfo *table_info, const char *name, const char *type, bool is_primary_key, 
-                               bool is_not_null, bool is_auto_increment, const char *default_value);
-static const char* find_table_body_start(const char *ptr, const char *end);
-static const char* find_table_body_end(const char *ptr, const char *end);
+static StatementResult handle_create_table(ParsingContext *ctx, const char *stmt_start, const char *end, const char **stmt_end);
+static void count_lines(ParsingContext *ctx, const char *from, const char *to);
+static size_t finish_chunk(ParsingContext *ctx, const char *ptr);
+static bool wants_insert_rows(const ParsingContext *ctx);
+static StatementResult handle_insert(ParsingContext *ctx, const char *stmt_start, const char *end, const char **values_start);
+static StatementResult continue_insert(ParsingContext *ctx, const char **ptr, const char *end);
+static void end_insert(ParsingContext *ctx);
+static DumpLineKind classify_dump_line(const char *p, const char *end);
+static bool starts_with_word(const char *p, const char *end, const char *keyword);
+static void remember_line_tail(ParsingContext *ctx, const char *from, const char *to);
+static bool dump_line_is_complete(const ParsingContext *ctx);
+static bool line_ends_with_semicolon(const ParsingContext *ctx, const char *from, const char *to);
+static bool create_follows_semicolon(const ParsingContext *ctx, const char *from, const char *to);
+static bool find_create_after_semicolon(const char *p, const char *end);
+static void disable_fast_path(ParsingContext *ctx);
+static const char *skip_dump_line(ParsingContext *ctx, const char *line_start, const char *from, const char *end);
+static ColumnInfo *append_column(TableInfo *table_info);
+static bool parse_column_definition(SqlTokenizer *tz, TableInfo *table_info, const SqlToken *name_tok);
+static KeyInfo *append_key(TableInfo *table_info, KeyKind kind);
+static bool append_name(char ***names, int *count, const char *name);
+static bool parse_key_definition(SqlTokenizer *tz, TableInfo *table_info, const SqlToken *first_tok);
+static bool parse_key_parts(SqlTokenizer *tz, char ***names, int *count);
+static char *read_referential_action(SqlTokenizer *tz);
+static void mark_primary_key_columns(TableInfo *table_info, const KeyInfo *key);
+static bool build_column_hash(TableInfo *table_info);
+static uint64_t column_name_hash(const char *name, size_t len);
+static bool is_key_definition_start(const SqlToken *tok);
+static bool parse_key_kind(const char *str, KeyKind *kind);
+static void cleanup_key_info(KeyInfo *key);
+static StrSpan read_value_span(SqlTokenizer *tz);
+static void skip_definition(SqlTokenizer *tz);
+static bool peek_token(const SqlTokenizer *tz, SqlToken *tok);
 static void cleanup_table_info(TableInfo *table_info);
+static void free_column_array(ColumnInfo *columns, int count);
+static void free_key_array(KeyInfo *keys, int count);
+static bool intern_table_schema(SqlIndex *index, TableInfo *table_info);
+static int add_schema(SqlIndex *index, uint64_t fingerprint, TableInfo *owner);
+static void attach_schema(SqlIndex *index, TableInfo *table_info, int schema_id);
+static uint64_t compute_schema_fingerprint(const ColumnInfo *columns, int column_count, const KeyInfo *keys, int key_count);
+static bool schema_matches(const SchemaDef *schema, const TableInfo *table_info);
+static int compare_name_ptrs(const void *a, const void *b);
+static bool write_checkpoint(const ParsingContext *ctx);
+static char *checkpoint_index_filename(const char *checkpoint_filename);
+static bool read_checkpoint_state(FILE *fp, ParsingContext *state, off_t *file_size, int64_t *file_mtime, int *entry_count);
+static int decode_hex(const char *hex, unsigned char *out, int max_len);
+static void scan_part_task(void *arg);
+static int compare_part_size(const void *a, const void *b);
+static bool merge_part_index(SqlIndex *index, const SqlIndex *part_index, int file_id, const InputPart *part);
+static uint64_t entry_part_line(const SqlIndex *index, const IndexEntry *entry, uint64_t line);
+static void print_entry_part(const SqlIndex *index, const IndexEntry *entry);
 // --- SHA256 Calculation ---
 // Calculates the SHA256 hash of a file using the embedded sha256 implementation.
 // Returns true on success and populates the `hash_buffer` (must be 65 bytes).
@@ -56,6 +143,7 @@ bool calculate_sha256(const char *filename, char *hash_buffer) {
         return false;
     }
 
+    TRACE_BEGIN(hash_start);
     SHA256_CTX ctx;
     sha256_init(&ctx);
 
@@ -80,19 +168,35 @@ bool calculate_sha256(const char *filename, char *hash_buffer) {
     hash_buffer[64] = '\0';
 
     fclose(file);
+    TRACE_END(hash_start, "hash", "hash file", filename);
     return true;
 }
 // --- Function Implementations ---
 
 bool initialize_context(ParsingContext *ctx, const char *filename) {
-    ctx->file = fopen(filename, "rb"); // Use file instead of fp
-    if (!ctx->file) { // Use file instead of fp
+    if (is_gzip_file(filename)) {
+        // The scan records access points into the index it builds
+        FILE *file = gzip_open_stream(filename, NULL, &ctx->index.gzip);
+        if (!file || !initialize_context_stream(ctx, file)) {
+            return false;
+        }
+        ctx->gzip_input = true;
+        ctx->index.gzip.span = (off_t)GZIP_DEFAULT_SPAN_MIB * 1024 * 1024;
+        ctx->index.gzip.raw_size = -1;
+        return true;
+    }
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
         fprintf(stderr, "Error opening file '%s': %s\n", filename, strerror(errno));
         return false;
     }
+    return initialize_context_stream(ctx, file);
+}
 
+bool initialize_context_stream(ParsingContext *ctx, FILE *file) {
+    ctx->file = file; // Owned from here on, even on failure
     ctx->buffer_size = CHUNK_SIZE + BUFFER_EXTRA_MARGIN; // Use buffer_size
-    ctx->buffer = malloc(ctx->buffer_size); // Use buffer_size
+    ctx->buffer = mem_malloc(MEM_BUFFERS, ctx->buffer_size); // Use buffer_size
     if (!ctx->buffer) {
         perror("Failed to allocate read buffer");
         // ctx->file is open, cleanup will handle it
@@ -105,7 +209,21 @@ bool initialize_context(ParsingContext *ctx, const char *filename) {
     ctx->current_line = 1;
     ctx->last_newline_offset = -1; // Start before the file begins
     ctx->state = STATE_CODE;
-    ctx->index = (SqlIndex){"", NULL, 0, 0}; // Use SqlIndex, correct initialization
+    ctx->eof_reached = false;
+    ctx->assume_mysqldump = false;
+    ctx->at_line_start = true;
+    ctx->dump_line_kind = DUMP_LINE_NONE;
+    ctx->line_tail_len = 0;
+    ctx->hooks = NULL;
+    ctx->insert = (InsertState){0};
+    ctx->stop_requested = false;
+    ctx->hash_input = false;
+    ctx->gzip_input = false;
+    sha256_init(&ctx->sha);
+    ctx->checkpoint_filename = NULL;
+    ctx->checkpoint_interval = 0;
+    ctx->progress = NULL;
+    ctx->index = (SqlIndex){0}; // Empty hash, no entries, schemas, gzip points or parts
     ctx->error_occurred = false;
 
     return true;
@@ -118,6 +236,9 @@ void cleanup_context(ParsingContext *ctx) {
     }
     free(ctx->buffer);
     ctx->buffer = NULL;
+    free(ctx->insert.table_name);
+    ctx->insert.table_name = NULL;
+    cleanup_sql_row(&ctx->insert.row);
 
     // Free index data
     cleanup_index(&ctx->index);
@@ -142,25 +263,93 @@ void cleanup_index(SqlIndex *index) {
         index->count = 0;
         index->capacity = 0;
     }
+    if (index && index->schemas) {
+        for (int i = 0; i < index->schema_count; ++i) {
+            free_column_array(index->schemas[i].columns, index->schemas[i].column_count);
+            free_key_array(index->schemas[i].keys, index->schemas[i].key_count);
+            free(index->schemas[i].column_slots);
+        }
+        free(index->schemas);
+        free(index->schema_slots);
+        index->schemas = NULL;
+        index->schema_slots = NULL;
+        index->schema_count = 0;
+        index->schema_capacity = 0;
+        index->schema_slot_count = 0;
+    }
+    if (index) {
+        cleanup_gzip_access(&index->gzip);
+        cleanup_input_parts(&index->parts);
+    }
 }
 
 static void cleanup_table_info(TableInfo *table_info) {
     if (table_info) {
         free(table_info->name);
-        
-        if (table_info->columns) {
-            for (int i = 0; i < table_info->column_count; i++) {
-                free(table_info->columns[i].name);
-                free(table_info->columns[i].type);
-                free(table_info->columns[i].default_value); // May be NULL, free handles NULL
-            }
-            free(table_info->columns);
+
+        // Shared definitions are freed with the index
+        if (table_info->schema_id < 0) {
+            free_table_definition(table_info);
+        }
+    }
+}
+
+// Frees the columns, keys and column hash owned by a table and clears them.
+void free_table_definition(TableInfo *table_info) {
+    free_column_array(table_info->columns, table_info->column_count);
+    free_key_array(table_info->keys, table_info->key_count);
+    free(table_info->column_slots);
+    table_info->columns = NULL;
+    table_info->column_count = 0;
+    table_info->column_capacity = 0;
+    table_info->keys = NULL;
+    table_info->key_count = 0;
+    table_info->key_capacity = 0;
+    table_info->column_slots = NULL;
+    table_info->column_slot_count = 0;
+}
+
+static void free_column_array(ColumnInfo *columns, int count) {
+    if (columns) {
+        for (int i = 0; i < count; i++) {
+            free(columns[i].name);
+            free(columns[i].type);
+            free(columns[i].default_value); // May be NULL, free handles NULL
+            free(columns[i].comment);
+            cleanup_column_type(&columns[i].type_desc);
+        }
+        free(columns);
+    }
+}
+
+static void free_key_array(KeyInfo *keys, int count) {
+    if (keys) {
+        for (int i = 0; i < count; i++) {
+            cleanup_key_info(&keys[i]);
         }
+        free(keys);
     }
 }
 
+static void cleanup_key_info(KeyInfo *key) {
+    free(key->name);
+    for (int i = 0; i < key->column_count; i++) {
+        free(key->columns[i]);
+    }
+    free(key->columns);
+    free(key->ref_table);
+    for (int i = 0; i < key->ref_column_count; i++) {
+        free(key->ref_columns[i]);
+    }
+    free(key->ref_columns);
+    free(key->on_delete);
+    free(key->on_update);
+}
+
 bool process_sql_file(ParsingContext *ctx) {
     size_t bytes_read;
+    off_t next_checkpoint = ctx->global_offset + ctx->checkpoint_interval;
+    SCAN_TRACE_INIT(trace, ctx->global_offset);
 
     while (true) {
         // Ensure buffer has space for next chunk
@@ -170,7 +359,9 @@ bool process_sql_file(ParsingContext *ctx) {
         }
 
         // Read next chunk
+        SCAN_TRACE_MARK(trace);
         bytes_read = fread(ctx->buffer + ctx->buffer_data_len, 1, CHUNK_SIZE, ctx->file); // Use file, buffer_data_len
+        SCAN_TRACE_READ(trace);
 
         if (bytes_read == 0) {
             if (ferror(ctx->file)) { // Use file
@@ -179,20 +370,33 @@ bool process_sql_file(ParsingContext *ctx) {
             }
             // Break if EOF or error, but process any remaining data first
             if (ctx->buffer_data_len == 0) break; // Nothing left to process
-             // else proceed to process the final partial buffer
+            // Statements still open at this point run to the end of the file
+            ctx->eof_reached = true;
         }
 
         ctx->buffer_data_len += bytes_read; // Use buffer_data_len
 
         // Process the data currently in the buffer
         size_t processed_len = process_chunk(ctx); // Updated call
+        SCAN_TRACE_STEP(trace, scan_us);
 
         if (ctx->error_occurred) {
             return false; // Stop processing on fatal error (e.g., alloc failure)
         }
 
+        // Only processed bytes are hashed so that `sha` always matches global_offset
+        if (ctx->hash_input) {
+            sha256_update(&ctx->sha, (const BYTE *)ctx->buffer, processed_len);
+            SCAN_TRACE_STEP(trace, hash_us);
+        }
+
         // Update global offset based on processed data
-        ctx->global_offset += processed_len; // Use global_offset
+        ctx->global_offset += (off_t)processed_len; // Use global_offset
+        // The last chunk is covered by the final report
+        if (ctx->progress && !ctx->eof_reached && ctx->global_offset >= ctx->progress->next_check) {
+            progress_report(ctx->progress, ctx->global_offset, ctx->index.count, false);
+        }
+        SCAN_TRACE_BLOCK(trace, ctx->global_offset, false);
 
         // Shift remaining unprocessed data to the beginning
         if (processed_len < ctx->buffer_data_len) { // Use buffer_data_len
@@ -203,20 +407,81 @@ bool process_sql_file(ParsingContext *ctx) {
             ctx->buffer_data_len = 0; // All data processed // Use buffer_data_len
         }
 
-        // If we hit EOF in the read above and processed everything, we're done.
-        if (bytes_read == 0 && ctx->buffer_data_len == 0) { // Use buffer_data_len
+        // process_chunk consumes everything once EOF is reached, so we're done.
+        if (ctx->eof_reached || ctx->stop_requested) {
             break;
         }
-    }
-    // Process any final remaining data in the buffer if EOF was reached before processing
-    if (ctx->buffer_data_len > 0 && !ctx->error_occurred) {
-        process_chunk(ctx);
-        ctx->buffer_data_len = 0; // Mark as processed
+
+        // An INSERT being streamed to hooks cannot be restored, so wait for it to end
+        if (ctx->checkpoint_filename && ctx->global_offset >= next_checkpoint && !ctx->insert.active) {
+            TRACE_BEGIN(checkpoint_start);
+            bool saved = write_checkpoint(ctx);
+            TRACE_END(checkpoint_start, "index", "checkpoint", NULL);
+            if (!saved) {
+                fprintf(stderr, "Warning: Could not write checkpoint '%s'. Continuing without checkpoints.\n", ctx->checkpoint_filename);
+                ctx->checkpoint_filename = NULL;
+            }
+            next_checkpoint = ctx->global_offset + ctx->checkpoint_interval;
+        }
     }
 
+    SCAN_TRACE_BLOCK(trace, ctx->global_offset, true);
+    if (ctx->progress && !ctx->error_occurred) {
+        progress_report(ctx->progress, ctx->global_offset, ctx->index.count, true);
+    }
     return !ctx->error_occurred;
 }
 
+bool stop_at_table(void *data, int entry, TableInfo *table_info) {
+    (void)data;
+    (void)entry;
+    (void)table_info;
+    return false;
+}
+
+#ifdef SQLINDEXER_TRACE
+// Adds the time since the previous mark to *total
+static void scan_trace_step(ScanTrace *trace, uint64_t *total, bool is_read) {
+    uint64_t now = trace_now();
+    *total += now - trace->mark;
+    if (is_read && now - trace->mark > TRACE_SLOW_READ_US) {
+        trace_complete("io", "slow read", trace->mark, NULL);
+    }
+    trace->mark = now;
+}
+
+// Closes the current scan block once it is large enough, or at the end of the scan
+static void scan_trace_block(ScanTrace *trace, off_t offset, bool last) {
+    if (offset - trace->block_offset < TRACE_SCAN_BLOCK && !(last && offset > trace->block_offset)) {
+        return;
+    }
+    char detail[112];
+    snprintf(detail, sizeof(detail), "offset %jd, %jd bytes; read %.1f ms, scan %.1f ms, hash %.1f ms",
+             (intmax_t)trace->block_offset, (intmax_t)(offset - trace->block_offset),
+             trace->read_us / 1000.0, trace->scan_us / 1000.0, trace->hash_us / 1000.0);
+    trace_complete("scan", "scan block", trace->block_start, detail);
+    trace->block_start = trace_now();
+    trace->block_offset = offset;
+    trace->read_us = trace->scan_us = trace->hash_us = 0;
+}
+#endif
+
+bool get_scan_sha256(ParsingContext *ctx, char *hash_buffer) {
+    if (!ctx->hash_input || ctx->stop_requested || ctx->error_occurred || !feof(ctx->file)) {
+        return false;
+    }
+
+    BYTE hash[SHA256_BLOCK_SIZE];
+    sha256_final(&ctx->sha, hash);
+    ctx->hash_input = false; // The context is finalized
+
+    for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+        sprintf(hash_buffer + (i * 2), "%02x", hash[i]);
+    }
+    hash_buffer[64] = '\0';
+    return true;
+}
+
 // Print the indexed results
 void print_results(const SqlIndex *index) {
     printf("Indexed Objects:\n");
@@ -226,10 +491,11 @@ void print_results(const SqlIndex *index) {
     if (index->count > 0) {
         for (int i = 0; i < index->count; ++i) {
             // Use line_number, type, name from IndexEntry
-            printf("%-10d %-10s %s\n",
-                   index->entries[i].line_number,
+            printf("%-10" PRIu64 " %-10s %s",
+                   entry_part_line(index, &index->entries[i], index->entries[i].line_number),
                    index->entries[i].type,
                    index->entries[i].name);
+            print_entry_part(index, &index->entries[i]);
                    
             // Print columns if this is a table and has column information
             if (strcmp(index->entries[i].type, "TABLE") == 0 && 
@@ -246,9 +512,33 @@ void print_results(const SqlIndex *index) {
                     if (col->is_not_null) printf(" NOT NULL");
                     if (col->is_auto_increment) printf(" AUTO_INCREMENT");
                     if (col->default_value) printf(" DEFAULT %s", col->default_value);
+                    if (col->comment) printf(" COMMENT '%s'", col->comment);
                     
                     printf("\n");
                 }
+
+                const TableInfo *table = index->entries[i].table_info;
+                if (table->key_count > 0) {
+                    printf("   Keys:\n");
+                    for (int j = 0; j < table->key_count; j++) {
+                        const KeyInfo *key = &table->keys[j];
+                        printf("     %-8s %s (", key_kind_to_string(key->kind), key->name ? key->name : "-");
+                        for (int k = 0; k < key->column_count; k++) {
+                            printf("%s%s", k ? ", " : "", key->columns[k]);
+                        }
+                        printf(")");
+                        if (key->kind == KEY_FOREIGN && key->ref_table) {
+                            printf(" REFERENCES %s (", key->ref_table);
+                            for (int k = 0; k < key->ref_column_count; k++) {
+                                printf("%s%s", k ? ", " : "", key->ref_columns[k]);
+                            }
+                            printf(")");
+                            if (key->on_delete) printf(" ON DELETE %s", key->on_delete);
+                            if (key->on_update) printf(" ON UPDATE %s", key->on_update);
+                        }
+                        printf("\n");
+                    }
+                }
                 printf("\n");
             }
         }
@@ -259,30 +549,231 @@ void print_results(const SqlIndex *index) {
 
 // --- Index File I/O ---
 
-// Format: TYPE,NAME,LINE\n
-// Helper to read a line, handling potential buffer overflows
-static char* read_line_from_index(FILE *fp, char *buffer, size_t buffer_size) {
-    if (fgets(buffer, buffer_size, fp) == NULL) {
-        return NULL; // EOF or error
-    }
-    // Check if the whole line was read
-    size_t len = strlen(buffer);
-    if (len > 0 && buffer[len - 1] != '\n') {
-        // Line was too long for the buffer or EOF without newline
-        if (!feof(fp)) {
-            fprintf(stderr, "Warning: Line in index file exceeds buffer size (%zu)\n", buffer_size);
-            // Consume rest of the line
-            int ch;
-            while ((ch = fgetc(fp)) != '\n' && ch != EOF);
-            // Mark buffer as potentially incomplete by ensuring null termination
-            // (though fgets should already do this)
-            buffer[buffer_size - 1] = '\0';
-        } // else: EOF reached after partial line read, which is okay
-    } else if (len > 0) {
-        // Remove trailing newline
-        buffer[len - 1] = '\0';
-    }
-    return buffer;
+// Format (one record per line, fields separated by ','):
+//   SHA256:<hex>
+//   FORMAT:<version>
+//   SCHEMA,SCHEMA_ID,FINGERPRINT         (starts a block of COLUMN/KEY records)
+//   COLUMN,SCHEMA_ID,COLUMN_NAME,TYPE,IS_PK,IS_NOT_NULL,IS_AUTO_INC,DEFAULT,COMMENT,
+//          TYPE_CLASS,STORAGE_BYTES,LENGTH,PRECISION,SCALE,IS_UNSIGNED,IS_ZEROFILL,
+//          CHARSET,COLLATION,N,ENUM_VALUE_1..ENUM_VALUE_N
+//   KEY,SCHEMA_ID,KIND,NAME,N,COL_1..COL_N[,REF_TABLE,ON_DELETE,ON_UPDATE,REF_COL_1..REF_COL_M]
+//   TYPE,NAME,LINE[,END_OFFSET,SCHEMA_ID,DDL_OFFSET,BODY_OFFSET,BODY_LENGTH,COLUMNS_LOADED,DDL_END_OFFSET]
+// Identical table definitions are written once and shared by SCHEMA_ID.
+// Tables whose columns were never requested have COLUMNS_LOADED 0 and no schema.
+// Field values escape '\', ',', CR and LF with a backslash so that ENUM lists,
+// defaults and comments round-trip unchanged.
+
+// Helper to read a line of any length into *buffer, growing it as needed.
+// The trailing newline is removed. Returns NULL on EOF or error.
+static char* read_line_from_index(FILE *fp, char **buffer, size_t *buffer_size) {
+    size_t len = 0;
+
+    if (*buffer == NULL) {
+        *buffer_size = 1024;
+        *buffer = mem_malloc(MEM_BUFFERS, *buffer_size);
+        if (!*buffer) {
+            perror("Failed to allocate index line buffer");
+            return NULL;
+        }
+    }
+
+    while (fgets(*buffer + len, (int)(*buffer_size - len), fp) != NULL) {
+        len += strlen(*buffer + len);
+        if (len > 0 && (*buffer)[len - 1] == '\n') {
+            (*buffer)[--len] = '\0';
+            if (len > 0 && (*buffer)[len - 1] == '\r') (*buffer)[--len] = '\0';
+            return *buffer;
+        }
+        if (feof(fp)) break; // Last line without newline
+        // Line longer than the buffer: grow and keep reading
+        char *new_buffer = mem_realloc(MEM_BUFFERS, *buffer, *buffer_size * 2);
+        if (!new_buffer) {
+            perror("Failed to grow index line buffer");
+            return NULL;
+        }
+        *buffer = new_buffer;
+        *buffer_size *= 2;
+    }
+    return len > 0 ? *buffer : NULL;
+}
+
+// Splits an index line into fields in place, resolving escape sequences.
+// *fields is grown as needed (ENUM tables and key column lists have no fixed
+// length). Returns the number of fields, or -1 on allocation failure.
+static int split_index_fields(char *line, char ***fields, int *field_capacity) {
+    int count = 0;
+    char *r = line;
+    char *w = line;
+
+    for (;;) {
+        if (count >= *field_capacity) {
+            int new_capacity = *field_capacity == 0 ? 32 : *field_capacity * 2;
+            char **new_fields = mem_realloc(MEM_BUFFERS, *fields, new_capacity * sizeof(char *));
+            if (!new_fields) {
+                perror("Failed to allocate index field array");
+                return -1;
+            }
+            *fields = new_fields;
+            *field_capacity = new_capacity;
+        }
+        (*fields)[count++] = w;
+
+        while (*r && *r != ',') {
+            if (*r == '\\' && r[1] != '\0') {
+                r++;
+                *w++ = (*r == 'n') ? '\n' : (*r == 'r') ? '\r' : *r;
+                r++;
+            } else {
+                *w++ = *r++;
+            }
+        }
+        if (*r == '\0') break;
+        *w++ = '\0'; // Terminate field at the separator
+        r++;
+    }
+    *w = '\0';
+    return count;
+}
+
+// Writes one field value, escaping characters that are special in the index format.
+static void write_index_field(FILE *fp, const char *value) {
+    const char *p = value ? value : "";
+    while (*p) {
+        size_t run = strcspn(p, "\\,\n\r");
+        fwrite(p, 1, run, fp);
+        p += run;
+        if (*p) {
+            fputc('\\', fp);
+            fputc(*p == '\n' ? 'n' : *p == '\r' ? 'r' : *p, fp);
+            p++;
+        }
+    }
+}
+
+// Writes the type descriptor fields of a COLUMN record (each preceded by ',').
+static void write_column_type_fields(FILE *fp, const ColumnTypeDesc *desc) {
+    fprintf(fp, ",%s,%d,%d,%d,%d,%d,%d,",
+            type_class_to_string(desc->type_class), desc->storage_bytes,
+            desc->length, desc->precision, desc->scale,
+            desc->is_unsigned ? 1 : 0, desc->is_zerofill ? 1 : 0);
+    write_index_field(fp, desc->charset);
+    fputc(',', fp);
+    write_index_field(fp, desc->collation);
+    fprintf(fp, ",%d", desc->enum_value_count);
+    for (int i = 0; i < desc->enum_value_count; i++) {
+        fputc(',', fp);
+        write_index_field(fp, desc->enum_values[i]);
+    }
+}
+
+// Reads the type descriptor fields written by write_column_type_fields.
+// Returns false if they are missing or malformed.
+static bool read_column_type_fields(ColumnTypeDesc *desc, char **fields, int field_count) {
+    if (field_count < 10 || !type_class_from_string(fields[0], &desc->type_class)) {
+        return false;
+    }
+    desc->storage_bytes = atoi(fields[1]);
+    desc->length = atoi(fields[2]);
+    desc->precision = atoi(fields[3]);
+    desc->scale = atoi(fields[4]);
+    desc->is_unsigned = atoi(fields[5]) != 0;
+    desc->is_zerofill = atoi(fields[6]) != 0;
+    desc->charset = fields[7][0] ? mem_strdup(MEM_COLUMNS, fields[7]) : NULL;
+    desc->collation = fields[8][0] ? mem_strdup(MEM_COLUMNS, fields[8]) : NULL;
+
+    int n = atoi(fields[9]);
+    if (n < 0 || 10 + n > field_count) {
+        return false;
+    }
+    if (n > 0) {
+        desc->enum_values = mem_malloc(MEM_COLUMNS, n * sizeof(char *));
+        if (!desc->enum_values) return false;
+        for (int i = 0; i < n; i++) {
+            desc->enum_values[i] = mem_strdup(MEM_COLUMNS, fields[10 + i]);
+            if (!desc->enum_values[i]) return false;
+            desc->enum_value_count++;
+        }
+    }
+    return true;
+}
+
+// Writes one SCHEMA block: the header followed by its COLUMN, NAMEHASH and KEY records.
+static void write_schema_records(FILE *fp, int schema_id, const SchemaDef *schema) {
+    fprintf(fp, "SCHEMA,%d,%016" PRIx64 "\n", schema_id, schema->fingerprint);
+
+    for (int j = 0; j < schema->column_count; j++) {
+        const ColumnInfo *col = &schema->columns[j];
+        fprintf(fp, "COLUMN,%d,", schema_id);
+        write_index_field(fp, col->name);
+        fputc(',', fp);
+        write_index_field(fp, col->type);
+        fprintf(fp, ",%d,%d,%d,",
+                col->is_primary_key ? 1 : 0,
+                col->is_not_null ? 1 : 0,
+                col->is_auto_increment ? 1 : 0);
+        write_index_field(fp, col->default_value);
+        fputc(',', fp);
+        write_index_field(fp, col->comment);
+        write_column_type_fields(fp, &col->type_desc);
+        fputc('\n', fp);
+    }
+
+    // Persist the column-name hash so loading the index does not rehash every name
+    if (schema->column_slot_count > 0) {
+        fprintf(fp, "NAMEHASH,%d,%d", schema_id, schema->column_slot_count);
+        for (int j = 0; j < schema->column_slot_count; j++) {
+            fprintf(fp, ",%d", schema->column_slots[j]);
+        }
+        fputc('\n', fp);
+    }
+
+    // Write index and constraint definitions
+    for (int j = 0; j < schema->key_count; j++) {
+        const KeyInfo *key = &schema->keys[j];
+        fprintf(fp, "KEY,%d,%s,", schema_id, key_kind_to_string(key->kind));
+        write_index_field(fp, key->name);
+        fprintf(fp, ",%d", key->column_count);
+        for (int k = 0; k < key->column_count; k++) {
+            fputc(',', fp);
+            write_index_field(fp, key->columns[k]);
+        }
+        if (key->kind == KEY_FOREIGN) {
+            fputc(',', fp);
+            write_index_field(fp, key->ref_table);
+            fputc(',', fp);
+            write_index_field(fp, key->on_delete);
+            fputc(',', fp);
+            write_index_field(fp, key->on_update);
+            for (int k = 0; k < key->ref_column_count; k++) {
+                fputc(',', fp);
+                write_index_field(fp, key->ref_columns[k]);
+            }
+        }
+        fputc('\n', fp);
+    }
+}
+
+// Moves the columns, keys and column hash collected for a SCHEMA block into
+// the index. The block's id must be the next free schema id.
+static bool flush_pending_schema(SqlIndex *index, TableInfo *pending, int schema_id, uint64_t fingerprint) {
+    if (schema_id < 0) {
+        return true; // No block open
+    }
+    if (schema_id != index->schema_count) {
+        fprintf(stderr, "Warning: Schema %d in index file is out of order.\n", schema_id);
+        free_table_definition(pending);
+        return false;
+    }
+    // Rebuild the column hash if the block had none (or one too small to terminate probes)
+    if (pending->column_slot_count <= pending->column_count && !build_column_hash(pending)) {
+        free_table_definition(pending);
+        return false;
+    }
+    if (add_schema(index, fingerprint, pending) < 0) {
+        free_table_definition(pending);
+        return false;
+    }
+    return true;
 }
 
 bool read_index_from_file(SqlIndex *index, const char *index_filename) {
@@ -291,116 +782,255 @@ bool read_index_from_file(SqlIndex *index, const char *index_filename) {
         perror("Error opening index file for reading");
         return false;
     }
+    bool ok = read_index_from_stream(index, fp, index_filename);
+    fclose(fp);
+    return ok;
+}
 
+bool read_index_from_stream(SqlIndex *index, FILE *fp, const char *index_filename) {
     // Initialize index structure
-    index->entries = NULL;
-    index->count = 0;
-    index->capacity = 0;
-    memset(index->sql_file_sha256, 0, sizeof(index->sql_file_sha256));
-
-    char line_buffer[1024]; // Buffer for reading lines
-
-    // Read the SHA256 hash from the first line
-    if (read_line_from_index(fp, line_buffer, sizeof(line_buffer))) {
+    memset(index, 0, sizeof(*index));
+    TRACE_BEGIN(read_start);
+
+    char *line_buffer = NULL; // Grown by read_line_from_index
+    size_t line_buffer_size = 0;
+    char **fields = NULL; // Grown by split_index_fields
+    int field_capacity = 0;
+    int format_version = 0;
+    TableInfo pending = {0}; // Collects COLUMN/KEY records of the open SCHEMA block
+    int pending_id = -1;
+    uint64_t pending_fingerprint = 0;
+    bool ok = true;
+
+    while (ok && read_line_from_index(fp, &line_buffer, &line_buffer_size)) {
+        // Header lines
         if (strncmp(line_buffer, "SHA256:", 7) == 0) {
             strncpy(index->sql_file_sha256, line_buffer + 7, 64);
             index->sql_file_sha256[64] = '\0';
-        } else {
-            fprintf(stderr, "Warning: Index file does not contain SHA256 hash.\n");
-            // Rewind to process the line as a regular entry
-            fseek(fp, 0, SEEK_SET);
+            continue;
+        }
+        if (strncmp(line_buffer, "FORMAT:", 7) == 0) {
+            format_version = atoi(line_buffer + 7);
+            continue;
+        }
+        if (line_buffer[0] == '\0') {
+            continue; // Avoid warning on empty lines
+        }
+        if (format_version != INDEX_FORMAT_VERSION) {
+            fprintf(stderr, "Warning: Index file '%s' uses an outdated format.\n", index_filename);
+            ok = false;
+            break;
+        }
+
+        int field_count = split_index_fields(line_buffer, &fields, &field_capacity);
+        if (field_count < 0) {
+            ok = false;
+            break;
+        }
+
+        // SCHEMA starts a block of COLUMN and KEY records
+        if (strcmp(fields[0], "SCHEMA") == 0) {
+            if (!flush_pending_schema(index, &pending, pending_id, pending_fingerprint)) {
+                ok = false;
+                break;
+            }
+            pending_id = field_count >= 3 ? atoi(fields[1]) : -1;
+            pending_fingerprint = field_count >= 3 ? strtoull(fields[2], NULL, 16) : 0;
+            continue;
         }
-    }
-    char type_buffer[256];
-    char name_buffer[512];
-    int line_number;
-    int read_count = 0;
 
-    while (read_line_from_index(fp, line_buffer, sizeof(line_buffer))) {
         // Check for COLUMN lines first
-        if (strncmp(line_buffer, "COLUMN,", 7) == 0) {
-            // Parse column info: COLUMN,TABLE_NAME,COLUMN_NAME,TYPE,IS_PK,IS_NOT_NULL,IS_AUTO_INC,DEFAULT
-            char table_name[256], col_name[256], col_type[256], default_val[256];
-            bool is_pk, is_nn, is_ai;
-            int is_pk_int, is_nn_int, is_ai_int;
-            int vals_read = sscanf(line_buffer, "COLUMN,%255[^,],%255[^,],%255[^,],%d,%d,%d,%255[^\n]", 
-                                table_name, col_name, col_type, &is_pk_int, &is_nn_int, &is_ai_int, default_val);
-            is_pk = is_pk_int;
-            is_nn = is_nn_int;
-            is_ai = is_ai_int;
-            
-            // Ensure we read at least the table, column name, and type
-            if (vals_read >= 3 && strcmp(table_name, name_buffer) == 0) {
-                // Find the table entry we just added
-                IndexEntry *entry = &index->entries[index->count - 1];
-                if (entry->table_info == NULL) {
-                    // Should never happen if add_table_entry worked properly
-                    fprintf(stderr, "Error: Table entry has no table_info structure.\n");
-                    fclose(fp);
-                    cleanup_index(index);
-                    return false;
-                }
-                
-                // Add the column
-                if (!add_column_to_table(entry->table_info, col_name, col_type, 
-                                      is_pk, is_nn, is_ai, 
-                                      (vals_read >= 7 && default_val[0] != '\0') ? default_val : NULL)) {
-                    fprintf(stderr, "Error adding column info for %s.%s\n", name_buffer, col_name);
-                    fclose(fp);
-                    cleanup_index(index);
-                    return false;
-                }
-            } else {
-                // Malformed column line or different table
-                fprintf(stderr, "Warning: Malformed column entry in index file: %s\n", line_buffer);
+        if (strcmp(fields[0], "COLUMN") == 0) {
+            // Ensure we read at least the schema, column name, and type
+            if (field_count < 4 || pending_id < 0 || atoi(fields[1]) != pending_id) {
+                // Malformed column line or different schema
+                fprintf(stderr, "Warning: Malformed column entry in index file for schema '%s'\n", fields[1]);
+                continue; // Move to the next line
+            }
+
+            ColumnInfo *col = append_column(&pending);
+            if (!col) {
+                fprintf(stderr, "Error adding column info for schema %d column %s\n", pending_id, fields[2]);
+                ok = false;
+                break;
+            }
+            col->name = mem_strdup(MEM_COLUMNS, fields[2]);
+            col->type = mem_strdup(MEM_COLUMNS, fields[3]);
+            col->is_primary_key = field_count > 4 && atoi(fields[4]);
+            col->is_not_null = field_count > 5 && atoi(fields[5]);
+            col->is_auto_increment = field_count > 6 && atoi(fields[6]);
+            col->default_value = (field_count > 7 && fields[7][0] != '\0') ? mem_strdup(MEM_COLUMNS, fields[7]) : NULL;
+            col->comment = (field_count > 8 && fields[8][0] != '\0') ? mem_strdup(MEM_COLUMNS, fields[8]) : NULL;
+            if (!col->name || !col->type) {
+                perror("Failed to duplicate column name or type");
+                ok = false;
+            } else if (!read_column_type_fields(&col->type_desc, fields + 9, field_count - 9)) {
+                // Descriptor missing or malformed: derive it from the type string
+                cleanup_column_type(&col->type_desc);
+                ok = parse_column_type(col->type, &col->type_desc);
+            }
+            continue;
+        }
+
+        if (strcmp(fields[0], "NAMEHASH") == 0) {
+            // NAMEHASH,SCHEMA_ID,SLOT_COUNT,SLOT... follows the block's COLUMN records
+            int slot_count = field_count >= 3 ? atoi(fields[2]) : -1;
+            if (pending_id < 0 || atoi(fields[1]) != pending_id || slot_count <= 0 ||
+                (slot_count & (slot_count - 1)) != 0 || field_count != 3 + slot_count) {
+                fprintf(stderr, "Warning: Malformed column hash in index file for schema '%s'\n", fields[1]);
+                continue;
+            }
+            int *slots = mem_malloc(MEM_COLUMNS, (size_t)slot_count * sizeof(int));
+            if (!slots) {
+                perror("Failed to allocate column hash");
+                ok = false;
+                break;
             }
-            continue; // Move to the next line
+            bool valid = true;
+            for (int k = 0; k < slot_count && valid; k++) {
+                slots[k] = atoi(fields[3 + k]);
+                valid = slots[k] >= 0 && slots[k] <= pending.column_count;
+            }
+            if (!valid) {
+                free(slots); // Rebuilt when the block is flushed
+                continue;
+            }
+            free(pending.column_slots);
+            pending.column_slots = slots;
+            pending.column_slot_count = slot_count;
+            continue;
         }
 
-        // Parse main entry: TYPE,NAME,LINE[,END_OFFSET]
-        long end_offset = -1;
-        read_count = sscanf(line_buffer, "%255[^,],%511[^,],%d,%ld", type_buffer, name_buffer, &line_number, &end_offset);
+        if (strcmp(fields[0], "PART") == 0) {
+            if (!read_input_part_record(&index->parts, fields, field_count)) {
+                fprintf(stderr, "Warning: Malformed part in index file '%s'\n", index_filename);
+                ok = false;
+                break;
+            }
+            continue;
+        }
 
-        if (read_count >= 3) { // Need at least TYPE, NAME, LINE
-            if (strcmp(type_buffer, "TABLE") == 0) {
-                if (!add_table_entry(index, name_buffer, line_number)) {
-                    fprintf(stderr, "Error adding table entry while reading index file.\n");
-                    fclose(fp);
-                    cleanup_index(index);
-                    return false;
-                }
-                // If end_offset was read (read_count == 4), store it
-                if (read_count == 4 && index->count > 0) {
-                    index->entries[index->count - 1].table_info->end_offset = end_offset;
-                }
-            } else {
-                // Non-table entry
-                if (!add_index_entry(index, type_buffer, name_buffer, line_number)) {
-                    fprintf(stderr, "Error adding entry while reading index file.\n");
-                    fclose(fp);
-                    cleanup_index(index); // Clean up partially read index
-                    return false;
+        if (strcmp(fields[0], "GZIP") == 0 || strcmp(fields[0], "GZPOINT") == 0) {
+            if (!read_gzip_access_record(&index->gzip, fields, field_count)) {
+                fprintf(stderr, "Warning: Malformed gzip access point in index file '%s'\n", index_filename);
+            }
+            continue;
+        }
+
+        if (strcmp(fields[0], "KEY") == 0) {
+            KeyKind kind;
+            int n = field_count >= 5 ? atoi(fields[4]) : -1;
+            if (pending_id < 0 || atoi(fields[1]) != pending_id ||
+                !parse_key_kind(fields[2], &kind) || n < 0 || 5 + n > field_count) {
+                fprintf(stderr, "Warning: Malformed key entry in index file for schema '%s'\n", fields[1]);
+                continue;
+            }
+
+            KeyInfo *key = append_key(&pending, kind);
+            if (!key) {
+                ok = false;
+                break;
+            }
+            if (fields[3][0] != '\0' && !(key->name = mem_strdup(MEM_COLUMNS, fields[3]))) ok = false;
+            for (int k = 0; ok && k < n; k++) {
+                ok = append_name(&key->columns, &key->column_count, fields[5 + k]);
+            }
+            int ref = 5 + n; // Foreign key tail
+            if (ok && field_count >= ref + 3) {
+                key->ref_table = mem_strdup(MEM_COLUMNS, fields[ref]);
+                key->on_delete = fields[ref + 1][0] ? mem_strdup(MEM_COLUMNS, fields[ref + 1]) : NULL;
+                key->on_update = fields[ref + 2][0] ? mem_strdup(MEM_COLUMNS, fields[ref + 2]) : NULL;
+                ok = key->ref_table != NULL;
+                for (int k = ref + 3; ok && k < field_count; k++) {
+                    ok = append_name(&key->ref_columns, &key->ref_column_count, fields[k]);
                 }
             }
-        } else if (strlen(line_buffer) > 0) { // Avoid warning on empty lines
-             fprintf(stderr, "Warning: Malformed line in index file: %s\n", line_buffer);
-             // Decide if you want to stop or continue on malformed lines
-             // continue;
-             // fclose(fp);
-             // cleanup_index(index);
-             // return false; // Uncomment to be strict
+            if (!ok) {
+                fprintf(stderr, "Error adding key info for schema %d\n", pending_id);
+            }
+            continue;
+        }
+
+        // Any other record closes the open SCHEMA block
+        if (!flush_pending_schema(index, &pending, pending_id, pending_fingerprint)) {
+            ok = false;
+            break;
+        }
+        pending_id = -1;
+
+        // Parse main entry: TYPE,NAME,LINE[,END_OFFSET,SCHEMA_ID,...][,FILE_ID]
+        if (field_count < 3) { // Need at least TYPE, NAME, LINE
+            fprintf(stderr, "Warning: Malformed line in index file: %s\n", fields[0]);
+            continue;
+        }
+        uint64_t line_number = strtoull(fields[2], NULL, 10);
+        if (strcmp(fields[0], "TABLE") == 0) {
+            if (!add_table_entry(index, fields[1], line_number)) {
+                fprintf(stderr, "Error adding table entry while reading index file.\n");
+                ok = false;
+                break;
+            }
+            TableInfo *table_info = index->entries[index->count - 1].table_info;
+            // If end_offset was written, store it
+            if (field_count >= 4) {
+                table_info->end_offset = (off_t)strtoll(fields[3], NULL, 10);
+            }
+            int schema_id = field_count >= 5 ? atoi(fields[4]) : -1;
+            if (schema_id >= 0 && schema_id < index->schema_count) {
+                attach_schema(index, table_info, schema_id);
+            }
+            if (field_count >= 9) {
+                table_info->ddl_offset = (off_t)strtoll(fields[5], NULL, 10);
+                table_info->body_offset = (off_t)strtoll(fields[6], NULL, 10);
+                table_info->body_length = (size_t)strtoull(fields[7], NULL, 10);
+                table_info->columns_loaded = atoi(fields[8]) != 0;
+            }
+            if (field_count >= 10) {
+                table_info->ddl_end_offset = (off_t)strtoll(fields[9], NULL, 10);
+            }
+            if (field_count >= 11) {
+                index->entries[index->count - 1].file_id = atoi(fields[10]);
+            }
+        } else {
+            // Non-table entry
+            if (!add_index_entry(index, fields[0], fields[1], line_number)) {
+                fprintf(stderr, "Error adding entry while reading index file.\n");
+                ok = false;
+                break;
+            }
+            if (field_count >= 4) {
+                index->entries[index->count - 1].file_id = atoi(fields[3]);
+            }
         }
     }
 
-    if (ferror(fp)) {
+    if (ok && ferror(fp)) {
         perror("Error reading from index file");
-        fclose(fp);
-        cleanup_index(index);
-        return false;
+        ok = false;
+    }
+    if (ok) {
+        ok = flush_pending_schema(index, &pending, pending_id, pending_fingerprint);
+    } else {
+        free_table_definition(&pending);
+    }
+    if (ok && format_version != INDEX_FORMAT_VERSION) {
+        fprintf(stderr, "Warning: Index file '%s' uses an outdated format.\n", index_filename);
+        ok = false;
+    }
+    for (int i = 0; ok && i < index->count; ++i) {
+        if (index->entries[i].file_id < 0 || index->entries[i].file_id >= (index->parts.count > 0 ? index->parts.count : 1)) {
+            fprintf(stderr, "Warning: Index file '%s' refers to a missing part.\n", index_filename);
+            ok = false;
+        }
     }
 
-    fclose(fp);
-    printf("Successfully loaded %d entries from index file '%s'.\n", index->count, index_filename);
+    free(line_buffer);
+    free(fields);
+    if (!ok) {
+        cleanup_index(index); // Clean up partially read index
+        return false;
+    }
+    TRACE_END(read_start, "index", "read index", index_filename);
     return true;
 }
 
@@ -410,61 +1040,77 @@ bool write_index_to_file(const SqlIndex *index, const char *index_filename, cons
         perror("Error opening index file for writing");
         return false;
     }
+    TRACE_BEGIN(write_start);
+
+    if (!write_index_to_stream(index, fp, sql_file_sha256)) {
+        perror("Error writing to index file");
+        fclose(fp);
+        // Optionally remove the partially written file
+        // remove(index_filename);
+        return false;
+    }
+
+    if (fclose(fp) != 0) {
+        perror("Error closing index file after writing");
+        return false;
+    }
+
+    TRACE_END(write_start, "index", "write index", index_filename);
+    return true;
+}
+
+bool write_index_to_stream(const SqlIndex *index, FILE *fp, const char *sql_file_sha256) {
 
     // Write SHA256 hash if provided
     if (sql_file_sha256) {
-        if (fprintf(fp, "SHA256:%s\n", sql_file_sha256) < 0) {
-            perror("Error writing SHA256 to index file");
-            fclose(fp);
-            return false;
-        }
+        fprintf(fp, "SHA256:%s\n", sql_file_sha256);
+    }
+    fprintf(fp, "FORMAT:%d\n", INDEX_FORMAT_VERSION);
+
+    // Files of a multi-part dump, in concatenation order
+    for (int i = 0; i < index->parts.count; ++i) {
+        const InputPart *part = &index->parts.parts[i];
+        fprintf(fp, "PART,%d,%jd,%" PRIu64 ",%d,", i, (intmax_t)part->size, part->first_line,
+                index->parts.independent ? 1 : 0);
+        write_index_field(fp, part->path);
+        fputc('\n', fp);
+    }
+
+    // Shared table definitions come first so TABLE records can refer to them
+    for (int i = 0; i < index->schema_count; ++i) {
+        write_schema_records(fp, i, &index->schemas[i]);
     }
 
     for (int i = 0; i < index->count; ++i) {
+        const IndexEntry *entry = &index->entries[i];
+
         // Write main entry
-        if (strcmp(index->entries[i].type, "TABLE") == 0 && index->entries[i].table_info) {
-            // Table entry: include end_offset
-            if (fprintf(fp, "%s,%s,%d,%ld\n", index->entries[i].type, index->entries[i].name, index->entries[i].line_number, index->entries[i].table_info->end_offset) < 0) {
-                perror("Error writing to index file");
-                fclose(fp);
-                // Optionally remove the partially written file
-                // remove(index_filename);
-                return false;
-            }
-            // Write column information for this table
-            TableInfo *table = index->entries[i].table_info;
-            for (int j = 0; j < table->column_count; j++) {
-                ColumnInfo *col = &table->columns[j];
-                // Write column entry: COLUMN,TABLE_NAME,COLUMN_NAME,TYPE,IS_PK,IS_NOT_NULL,IS_AUTO_INC,DEFAULT
-                if (fprintf(fp, "COLUMN,%s,%s,%s,%d,%d,%d,%s\n", 
-                           table->name, col->name, col->type,
-                           col->is_primary_key ? 1 : 0, 
-                           col->is_not_null ? 1 : 0,
-                           col->is_auto_increment ? 1 : 0,
-                           col->default_value ? col->default_value : "") < 0) {
-                    perror("Error writing column info to index file");
-                    fclose(fp);
-                    return false;
-                }
-            }
+        write_index_field(fp, entry->type);
+        fputc(',', fp);
+        write_index_field(fp, entry->name);
+        if (strcmp(entry->type, "TABLE") == 0 && entry->table_info) {
+            // Table entry: include end_offset, its schema and the DDL span
+            const TableInfo *table_info = entry->table_info;
+            fprintf(fp, ",%" PRIu64 ",%jd,%d,%jd,%jd,%zu,%d,%jd", entry->line_number,
+                    (intmax_t)table_info->end_offset, table_info->schema_id,
+                    (intmax_t)table_info->ddl_offset, (intmax_t)table_info->body_offset,
+                    table_info->body_length, table_info->columns_loaded ? 1 : 0,
+                    (intmax_t)table_info->ddl_end_offset);
         } else {
             // Non-table entry: TYPE,NAME,LINE
-            if (fprintf(fp, "%s,%s,%d\n", index->entries[i].type, index->entries[i].name, index->entries[i].line_number) < 0) {
-                perror("Error writing to index file");
-                fclose(fp);
-                // Optionally remove the partially written file
-                // remove(index_filename);
-                return false;
-            }
+            fprintf(fp, ",%" PRIu64, entry->line_number);
         }
+        // Multi-part dumps add the entry's part
+        if (index->parts.count > 0) {
+            fprintf(fp, ",%d", entry->file_id);
+        }
+        fputc('\n', fp);
     }
 
-    if (fclose(fp) != 0) {
-        perror("Error closing index file after writing");
-        return false;
-    }
+    // Access points for reading a gzip dump from the middle
+    write_gzip_access_records(fp, &index->gzip);
 
-    return true;
+    return !ferror(fp);
 }
 
 // --- Static Helper Function Implementations ---
@@ -482,7 +1128,7 @@ static bool ensure_buffer_capacity(ParsingContext *ctx, size_t required_size) {
                  return false;
             }
         }
-        char *new_buffer = realloc(ctx->buffer, new_size);
+        char *new_buffer = mem_realloc(MEM_BUFFERS, ctx->buffer, new_size);
         if (!new_buffer) {
             perror("Failed to reallocate buffer");
             ctx->error_occurred = true;
@@ -494,15 +1140,15 @@ static bool ensure_buffer_capacity(ParsingContext *ctx, size_t required_size) {
     return true;
 }
 
-static bool add_index_entry(SqlIndex *index, const char *type, const char *name, int line_number) {
+static bool add_index_entry(SqlIndex *index, const char *type, const char *name, uint64_t line_number) {
     if (index->count >= index->capacity) {
-        size_t new_capacity = index->capacity == 0 ? 16 : index->capacity * 2;
-        if (new_capacity < index->capacity) {
+        if (index->capacity > INT_MAX / 2) {
              fprintf(stderr, "Error: Index capacity overflow\n");
              return false;
         }
+        int new_capacity = index->capacity == 0 ? 16 : index->capacity * 2;
         // Use IndexEntry instead of SqlEntry
-        IndexEntry *new_entries = realloc(index->entries, new_capacity * sizeof(IndexEntry));
+        IndexEntry *new_entries = mem_realloc(MEM_INDEX, index->entries, new_capacity * sizeof(IndexEntry));
         if (!new_entries) {
             perror("Failed to reallocate memory for index entries");
             return false;
@@ -512,8 +1158,8 @@ static bool add_index_entry(SqlIndex *index, const char *type, const char *name,
     }
 
     // Check for allocation failures for strdup
-    char *type_copy = strdup(type);
-    char *name_copy = strdup(name);
+    char *type_copy = mem_strdup(MEM_INDEX, type);
+    char *name_copy = mem_strdup(MEM_INDEX, name);
     if (!type_copy || !name_copy) {
         perror("Failed to duplicate string for index entry");
         free(type_copy); // free if one succeeded but the other failed
@@ -524,26 +1170,18 @@ static bool add_index_entry(SqlIndex *index, const char *type, const char *name,
     index->entries[index->count].type = type_copy;
     index->entries[index->count].name = name_copy;
     index->entries[index->count].line_number = line_number;
+    index->entries[index->count].file_id = 0;
     index->entries[index->count].table_info = NULL; // Initialize table_info to NULL
     index->count++;
     return true;
 }
 
-static bool add_table_entry(SqlIndex *index, const char *name, int line_number) {
-    // First, check if this table already exists in the index.
-    // This can happen if a CREATE TABLE statement spans multiple chunks.
-    for (int i = 0; i < index->count; ++i) {
-        if (strcmp(index->entries[i].type, "TABLE") == 0 && strcmp(index->entries[i].name, name) == 0) {
-            // Table already exists, no need to add it again.
-            // We can assume we're now processing the complete statement.
-            return true;
-        }
-    }
-
-    // If it doesn't exist, add it.
+static bool add_table_entry(SqlIndex *index, const char *name, uint64_t line_number) {
+    // CREATE TABLE statements split across chunks are only handled once the
+    // whole statement is buffered, so every call adds a new entry.
     if (index->count >= index->capacity) {
         size_t new_capacity = index->capacity == 0 ? 16 : index->capacity * 2;
-        IndexEntry *new_entries = realloc(index->entries, new_capacity * sizeof(IndexEntry));
+        IndexEntry *new_entries = mem_realloc(MEM_INDEX, index->entries, new_capacity * sizeof(IndexEntry));
         if (!new_entries) {
             perror("Failed to reallocate memory for index entries");
             return false;
@@ -553,8 +1191,8 @@ static bool add_table_entry(SqlIndex *index, const char *name, int line_number)
     }
 
     // Check for allocation failures for strdup
-    char *type_copy = strdup("TABLE");
-    char *name_copy = strdup(name);
+    char *type_copy = mem_strdup(MEM_INDEX, "TABLE");
+    char *name_copy = mem_strdup(MEM_INDEX, name);
     if (!type_copy || !name_copy) {
         perror("Failed to duplicate string for table entry");
         free(type_copy);
@@ -563,7 +1201,7 @@ static bool add_table_entry(SqlIndex *index, const char *name, int line_number)
     }
 
     // Create and initialize the TableInfo structure
-    TableInfo *table_info = (TableInfo *)calloc(1, sizeof(TableInfo));
+    TableInfo *table_info = (TableInfo *)mem_calloc(MEM_INDEX, 1, sizeof(TableInfo));
     if (!table_info) {
         perror("Failed to allocate memory for table info");
         free(type_copy);
@@ -571,7 +1209,7 @@ static bool add_table_entry(SqlIndex *index, const char *name, int line_number)
         return false;
     }
     
-    table_info->name = strdup(name);
+    table_info->name = mem_strdup(MEM_INDEX, name);
     if (!table_info->name) {
         perror("Failed to duplicate table name for table info");
         free(type_copy);
@@ -585,369 +1223,1953 @@ static bool add_table_entry(SqlIndex *index, const char *name, int line_number)
     table_info->column_capacity = 0;
     table_info->line_number = line_number;
     table_info->end_offset = -1; // Initialize end_offset
+    table_info->ddl_offset = -1;
+    table_info->ddl_end_offset = -1;
+    table_info->body_offset = -1;
+    table_info->body_length = 0;
+    table_info->columns_loaded = false;
+    table_info->schema_id = -1;
     
     // Now populate the entry
     index->entries[index->count].type = type_copy;
     index->entries[index->count].name = name_copy;
     index->entries[index->count].line_number = line_number;
+    index->entries[index->count].file_id = 0;
     index->entries[index->count].table_info = table_info;
     index->count++;
     
     return true;
 }
 
-static bool add_column_to_table(TableInfo *table_info, const char *name, const char *type, 
-                              bool is_primary_key, bool is_not_null, bool is_auto_increment, 
-                              const char *default_value) {
-    if (!table_info) return false;
+// Appends a zeroed column slot to the table and returns it, or NULL on allocation failure.
+static ColumnInfo *append_column(TableInfo *table_info) {
+    if (!table_info) return NULL;
     
     // Ensure we have capacity
     if (table_info->column_count >= table_info->column_capacity) {
         int new_capacity = table_info->column_capacity == 0 ? 8 : table_info->column_capacity * 2;
-        ColumnInfo *new_columns = realloc(table_info->columns, new_capacity * sizeof(ColumnInfo));
+        ColumnInfo *new_columns = mem_realloc(MEM_COLUMNS, table_info->columns, new_capacity * sizeof(ColumnInfo));
         if (!new_columns) {
             perror("Failed to allocate memory for columns");
-            return false;
+            return NULL;
         }
         table_info->columns = new_columns;
         table_info->column_capacity = new_capacity;
     }
-    
-    // Initialize the column
-    ColumnInfo *col = &table_info->columns[table_info->column_count];
-    
-    col->name = strdup(name);
-    col->type = strdup(type);
-    if (!col->name || !col->type) {
-        perror("Failed to duplicate column name or type");
-        free(col->name); // These may be NULL, but that's okay
-        free(col->type);
+    
+    ColumnInfo *col = &table_info->columns[table_info->column_count++];
+    memset(col, 0, sizeof(*col));
+    return col;
+}
+
+// Scans the buffer with a state machine that tracks comments, strings and
+// quoted identifiers, so CREATE TABLE is only recognised in code.
+// With assume_mysqldump, each line is first classified by its leading bytes;
+// lines that cannot start a CREATE TABLE are skipped with memchr.
+static size_t process_chunk(ParsingContext *ctx) {
+    const char *ptr = ctx->buffer;
+    const char *end = ctx->buffer + ctx->buffer_data_len;
+    const char *chunk_start = ctx->buffer;
+    const char *rescan_line = NULL; // Line handed back to the state machine by the fast path
+
+    while (ptr < end && !ctx->stop_requested) {
+        // Finish a long line the fast path started in an earlier chunk
+        if (ctx->dump_line_kind != DUMP_LINE_NONE) {
+            ptr = skip_dump_line(ctx, NULL, ptr, end);
+            continue;
+        }
+
+        // Stream the rows of an INSERT whose VALUES list has started
+        if (ctx->insert.active) {
+            StatementResult result = continue_insert(ctx, &ptr, end);
+            if (result == STMT_ERROR) {
+                ctx->error_occurred = true;
+            }
+            if (result != STMT_COMPLETE) {
+                return finish_chunk(ctx, ptr);
+            }
+            continue;
+        }
+
+        // Keep a possibly split keyword for the next read
+        if (!ctx->eof_reached && (size_t)(end - ptr) <= CREATE_TABLE_LEN) {
+            break;
+        }
+
+        // --- mysqldump Fast Path ---
+        if (ctx->assume_mysqldump && ctx->state == STATE_CODE && ptr != rescan_line &&
+            (ptr == chunk_start ? ctx->at_line_start : ptr[-1] == '\n')) {
+            DumpLineKind kind = classify_dump_line(ptr, end);
+            if (kind != DUMP_LINE_UNKNOWN && kind != DUMP_LINE_CREATE_TABLE &&
+                !(kind == DUMP_LINE_INSERT && wants_insert_rows(ctx))) {
+                ctx->dump_line_kind = kind;
+                const char *next = skip_dump_line(ctx, ptr, ptr, end);
+                if (next) {
+                    ptr = next;
+                } else {
+                    rescan_line = ptr; // Heuristic violated: scan this line byte by byte
+                }
+                continue;
+            }
+        }
+
+        // --- State Machine ---
+
+        // Track line numbers
+        if (*ptr == '\n') {
+            ctx->current_line++;
+            ctx->last_newline_offset = ctx->global_offset + (ptr - chunk_start);
+        }
+
+        switch (ctx->state) {
+            case STATE_CODE:
+                // "CREATE TABLE" (case-insensitive) followed by whitespace or end of buffer
+                if ((size_t)(end - ptr) >= CREATE_TABLE_LEN &&
+                    strncasecmp(ptr, CREATE_TABLE_KEYWORD, CREATE_TABLE_LEN) == 0 &&
+                    (ptr + CREATE_TABLE_LEN == end || isspace((unsigned char)ptr[CREATE_TABLE_LEN]))) {
+                    const char *stmt_end = NULL;
+                    StatementResult result = handle_create_table(ctx, ptr, end, &stmt_end);
+                    if (result == STMT_ERROR) {
+                        ctx->error_occurred = true;
+                        return finish_chunk(ctx, ptr); // Stop processing on error
+                    }
+                    if (result == STMT_NEED_MORE_DATA) {
+                        // The CREATE TABLE statement is split across chunks.
+                        return finish_chunk(ctx, ptr); // Return, so the buffer can be refilled
+                    }
+                    // Move past the table definition, counting the lines it spans
+                    count_lines(ctx, ptr, stmt_end);
+                    ptr = stmt_end;
+                    continue;
+                }
+                // INSERT/REPLACE ... VALUES, when a hook wants the rows
+                if ((*ptr == 'I' || *ptr == 'i' || *ptr == 'R' || *ptr == 'r') && wants_insert_rows(ctx) &&
+                    (ptr == chunk_start || !(isalnum((unsigned char)ptr[-1]) || ptr[-1] == '_')) &&
+                    (starts_with_word(ptr, end, "INSERT") || starts_with_word(ptr, end, "REPLACE"))) {
+                    const char *values_start = NULL;
+                    StatementResult result = handle_insert(ctx, ptr, end, &values_start);
+                    if (result == STMT_ERROR) {
+                        ctx->error_occurred = true;
+                    }
+                    if (result != STMT_COMPLETE) {
+                        return finish_chunk(ctx, ptr);
+                    }
+                    if (values_start) {
+                        count_lines(ctx, ptr, values_start);
+                        ptr = values_start;
+                        continue;
+                    }
+                    // INSERT ... SELECT / SET: scan it like any other statement
+                }
+                if (*ptr == '\'') {
+                    ctx->state = STATE_S_QUOTE_STRING;
+                } else if (*ptr == '"') {
+                    ctx->state = STATE_D_QUOTE_STRING;
+                } else if (*ptr == '`') {
+                    ctx->state = STATE_BACKTICK_IDENTIFIER;
+                } else if (*ptr == '#' ||
+                           (*ptr == '-' && ptr + 2 < end && ptr[1] == '-' && isspace((unsigned char)ptr[2]))) {
+                    ctx->state = STATE_SL_COMMENT;
+                } else if (*ptr == '/' && ptr + 1 < end && ptr[1] == '*') {
+                    ctx->state = STATE_ML_COMMENT;
+                    ptr += 2;
+                    continue;
+                }
+                break;
+            case STATE_SL_COMMENT:
+                if (*ptr == '\n') ctx->state = STATE_CODE;
+                break;
+            case STATE_ML_COMMENT:
+                if (*ptr == '*' && ptr + 1 < end && ptr[1] == '/') {
+                    ctx->state = STATE_CODE;
+                    ptr += 2;
+                    continue;
+                }
+                break;
+            case STATE_S_QUOTE_STRING:
+            case STATE_D_QUOTE_STRING:
+                if (*ptr == '\\' && ptr + 1 < end) {
+                    count_lines(ctx, ptr + 1, ptr + 2); // Escaped character may be a newline
+                    ptr += 2;
+                    continue;
+                }
+                // A doubled quote closes and reopens the string, which is equivalent
+                if (*ptr == (ctx->state == STATE_S_QUOTE_STRING ? '\'' : '"')) ctx->state = STATE_CODE;
+                break;
+            case STATE_BACKTICK_IDENTIFIER:
+                if (*ptr == '`') ctx->state = STATE_CODE;
+                break;
+        }
+
+        ptr++;
+    }
+
+    // Return the number of bytes fully processed in this chunk.
+    return finish_chunk(ctx, ptr);
+}
+
+// Records whether the unprocessed remainder starts a line and returns the
+// number of bytes processed.
+static size_t finish_chunk(ParsingContext *ctx, const char *ptr) {
+    if (ptr > ctx->buffer) {
+        ctx->at_line_start = ptr[-1] == '\n';
+    }
+    return (size_t)(ptr - ctx->buffer);
+}
+
+// --- INSERT Row Streaming ---
+
+static bool wants_insert_rows(const ParsingContext *ctx) {
+    return ctx->hooks && (ctx->hooks->on_row || ctx->hooks->on_insert_end);
+}
+
+// Parses an INSERT/REPLACE header up to VALUES. On STMT_COMPLETE,
+// *values_start points after VALUES and ctx->insert is active, or is NULL if
+// the statement has no VALUES list (INSERT ... SELECT or ... SET).
+static StatementResult handle_insert(ParsingContext *ctx, const char *stmt_start, const char *end, const char **values_start) {
+    SqlTokenizer tz;
+    SqlToken tok;
+    StrSpan table_name = {NULL, 0};
+
+    *values_start = NULL;
+    sql_tokenizer_init(&tz, stmt_start, end);
+
+    // A token touching the end of the buffer may continue in the next chunk
+#define NEXT_TOKEN_OR_REFILL() \
+    do { \
+        bool got_ = sql_next_token(&tz, &tok); \
+        if (!ctx->eof_reached && (!got_ || tok.text.ptr + tok.text.len == end)) return STMT_NEED_MORE_DATA; \
+        if (!got_) return STMT_COMPLETE; \
+    } while (0)
+
+    NEXT_TOKEN_OR_REFILL(); // INSERT or REPLACE
+    NEXT_TOKEN_OR_REFILL();
+    while (sql_token_is_word(&tok, "LOW_PRIORITY") || sql_token_is_word(&tok, "DELAYED") ||
+           sql_token_is_word(&tok, "HIGH_PRIORITY") || sql_token_is_word(&tok, "IGNORE")) {
+        NEXT_TOKEN_OR_REFILL();
+    }
+    if (sql_token_is_word(&tok, "INTO")) {
+        NEXT_TOKEN_OR_REFILL();
+    }
+
+    // Qualified names (`db`.`table`) keep the last part
+    while (sql_token_is_identifier(&tok)) {
+        table_name = tok.text;
+        NEXT_TOKEN_OR_REFILL();
+        if (tok.type != SQL_TOK_DOT) break;
+        NEXT_TOKEN_OR_REFILL();
+    }
+    if (!table_name.ptr) {
+        return STMT_COMPLETE;
+    }
+
+    // Optional column list
+    if (tok.type == SQL_TOK_LPAREN) {
+        const char *close = sql_find_closing_paren(tok.text.ptr + 1, end);
+        if (!close) {
+            return ctx->eof_reached ? STMT_COMPLETE : STMT_NEED_MORE_DATA;
+        }
+        tz.pos = close + 1;
+        NEXT_TOKEN_OR_REFILL();
+    }
+    if (!sql_token_is_word(&tok, "VALUES") && !sql_token_is_word(&tok, "VALUE")) {
+        return STMT_COMPLETE;
+    }
+#undef NEXT_TOKEN_OR_REFILL
+
+    InsertState *insert = &ctx->insert;
+    insert->table_name = sql_unquote_identifier(table_name);
+    if (!insert->table_name) {
+        perror("Failed to allocate memory for INSERT table name");
+        return STMT_ERROR;
+    }
+    insert->active = true;
+    insert->start_offset = ctx->global_offset + (stmt_start - ctx->buffer);
+    insert->values_offset = ctx->global_offset + (tok.text.ptr + tok.text.len - ctx->buffer);
+    insert->end_offset = -1;
+    insert->complete = false;
+    insert->row_count = 0;
+    insert->retry_len = 0;
+    *values_start = tok.text.ptr + tok.text.len;
+    return STMT_COMPLETE;
+}
+
+// Consumes complete rows of the active INSERT from *ptr, calling on_row for
+// each. Returns STMT_NEED_MORE_DATA when a row is split across chunks, and
+// STMT_COMPLETE once the VALUES list ends or a hook stops the scan.
+static StatementResult continue_insert(ParsingContext *ctx, const char **ptr, const char *end) {
+    InsertState *insert = &ctx->insert;
+    const char *p = *ptr;
+
+    while (true) {
+        SqlTokenizer tz;
+        SqlToken tok;
+        sql_tokenizer_init(&tz, p, end);
+        bool got = sql_next_token(&tz, &tok);
+        if (!ctx->eof_reached && (!got || tok.text.ptr + tok.text.len == end)) {
+            *ptr = p;
+            return STMT_NEED_MORE_DATA;
+        }
+        if (!got) {
+            // Unterminated statement at end of file
+            insert->end_offset = ctx->global_offset + (end - ctx->buffer);
+            *ptr = end;
+            end_insert(ctx);
+            return STMT_COMPLETE;
+        }
+
+        if (tok.type == SQL_TOK_COMMA) {
+            p = tok.text.ptr + 1;
+            continue;
+        }
+        if (tok.type != SQL_TOK_LPAREN) {
+            // ';' or a trailing clause such as ON DUPLICATE KEY UPDATE ends the list
+            count_lines(ctx, p, tok.text.ptr);
+            insert->complete = tok.type == SQL_TOK_SEMICOLON;
+            insert->end_offset = ctx->global_offset + (tok.text.ptr - ctx->buffer) + (insert->complete ? 1 : 0);
+            *ptr = tok.text.ptr;
+            end_insert(ctx);
+            return STMT_COMPLETE;
+        }
+
+        // Re-parse a large split row only after the buffer has grown enough
+        if (!ctx->eof_reached && insert->retry_len > (size_t)(end - tok.text.ptr)) {
+            *ptr = p;
+            return STMT_NEED_MORE_DATA;
+        }
+        const char *row_end = NULL;
+        RowParseResult result = ctx->hooks->raw_rows ? scan_insert_row(tok.text.ptr, end, &row_end)
+                                                     : parse_insert_row(tok.text.ptr, end, &insert->row, &row_end);
+        if (result == ROW_INCOMPLETE && !ctx->eof_reached) {
+            insert->retry_len = (size_t)(end - tok.text.ptr) * 2;
+            *ptr = p;
+            return STMT_NEED_MORE_DATA;
+        }
+        if (result == ROW_ERROR) {
+            *ptr = p;
+            return STMT_ERROR;
+        }
+        if (result != ROW_COMPLETE) {
+            fprintf(stderr, "Warning: Malformed row %" PRIu64 " in INSERT INTO '%s' near line %" PRIu64 "\n",
+                    insert->row_count + 1, insert->table_name, ctx->current_line);
+            count_lines(ctx, p, tok.text.ptr);
+            insert->end_offset = ctx->global_offset + (tok.text.ptr - ctx->buffer);
+            *ptr = tok.text.ptr; // Let the state machine skip the rest
+            end_insert(ctx);
+            return STMT_COMPLETE;
+        }
+
+        insert->retry_len = 0;
+        insert->row_offset = ctx->global_offset + (tok.text.ptr - ctx->buffer);
+        insert->row_text = (StrSpan){tok.text.ptr, (size_t)(row_end - tok.text.ptr)};
+        count_lines(ctx, p, row_end);
+        p = row_end;
+        *ptr = p;
+        if (ctx->hooks->on_row && !ctx->hooks->on_row(ctx->hooks->data, insert, &insert->row)) {
+            ctx->stop_requested = true;
+            return STMT_COMPLETE;
+        }
+        insert->row_count++;
+    }
+}
+
+// Reports the finished statement and resets the INSERT state.
+static void end_insert(ParsingContext *ctx) {
+    InsertState *insert = &ctx->insert;
+    if (ctx->hooks->on_insert_end && !ctx->hooks->on_insert_end(ctx->hooks->data, insert)) {
+        ctx->stop_requested = true;
+    }
+    free(insert->table_name);
+    insert->table_name = NULL;
+    insert->active = false;
+}
+
+// --- Statement Boundaries ---
+
+const char *find_statement_end(const char *p, const char *end, const char *min_end, ParserState *state, uint64_t *line) {
+    ParserState st = *state;
+    uint64_t lines = 0;
+    const char *found = NULL;
+
+    while (p < end && !found) {
+        char c = *p;
+        if (c == '\n') lines++;
+        switch (st) {
+            case STATE_CODE:
+                if (c == ';' && p + 1 >= min_end) {
+                    found = p + 1;
+                } else if (c == '\'') {
+                    st = STATE_S_QUOTE_STRING;
+                } else if (c == '"') {
+                    st = STATE_D_QUOTE_STRING;
+                } else if (c == '`') {
+                    st = STATE_BACKTICK_IDENTIFIER;
+                } else if (c == '#' || (c == '-' && p + 2 < end && p[1] == '-' && isspace((unsigned char)p[2]))) {
+                    st = STATE_SL_COMMENT;
+                } else if (c == '/' && p + 1 < end && p[1] == '*') {
+                    st = STATE_ML_COMMENT;
+                    p++;
+                }
+                break;
+            case STATE_SL_COMMENT:
+                if (c == '\n') st = STATE_CODE;
+                break;
+            case STATE_ML_COMMENT:
+                if (c == '*' && p + 1 < end && p[1] == '/') {
+                    st = STATE_CODE;
+                    p++;
+                }
+                break;
+            case STATE_S_QUOTE_STRING:
+            case STATE_D_QUOTE_STRING:
+                if (c == '\\' && p + 1 < end) {
+                    if (p[1] == '\n') lines++;
+                    p++;
+                } else if (c == (st == STATE_S_QUOTE_STRING ? '\'' : '"')) {
+                    st = STATE_CODE;
+                }
+                break;
+            case STATE_BACKTICK_IDENTIFIER:
+                if (c == '`') st = STATE_CODE;
+                break;
+        }
+        p++;
+    }
+
+    *state = st;
+    if (line) *line += lines;
+    return found;
+}
+
+// --- mysqldump Line Classification ---
+
+// Returns true if `p` starts with `keyword` as a whole word (case-insensitive).
+static bool starts_with_word(const char *p, const char *end, const char *keyword) {
+    size_t len = strlen(keyword);
+    if ((size_t)(end - p) < len || strncasecmp(p, keyword, len) != 0) return false;
+    return p + len == end || !(isalnum((unsigned char)p[len]) || p[len] == '_');
+}
+
+// Classifies a line of mysqldump output by its first bytes.
+static DumpLineKind classify_dump_line(const char *p, const char *end) {
+    static const char *const STATEMENT_KEYWORDS[] = {
+        "USE", "DROP", "LOCK", "UNLOCK", "SET", "ALTER", "START", "COMMIT"
+    };
+
+    if (*p == '\n' || *p == '\r' || *p == '#' ||
+        (*p == '-' && end - p >= 2 && p[1] == '-')) {
+        return DUMP_LINE_COMMENT;
+    }
+    if (*p == '/' && end - p >= 3 && p[1] == '*' && p[2] == '!') {
+        return DUMP_LINE_VERSIONED;
+    }
+    if (starts_with_word(p, end, "CREATE")) {
+        // CREATE TABLE goes to the parser; CREATE PROCEDURE etc. may span lines
+        return strncasecmp(p, CREATE_TABLE_KEYWORD, CREATE_TABLE_LEN) == 0 ? DUMP_LINE_CREATE_TABLE : DUMP_LINE_UNKNOWN;
+    }
+    if (starts_with_word(p, end, "DELIMITER")) {
+        return DUMP_LINE_COMMENT;
+    }
+    if (starts_with_word(p, end, "INSERT") || starts_with_word(p, end, "REPLACE")) {
+        return DUMP_LINE_INSERT;
+    }
+    for (size_t i = 0; i < sizeof(STATEMENT_KEYWORDS) / sizeof(STATEMENT_KEYWORDS[0]); i++) {
+        if (starts_with_word(p, end, STATEMENT_KEYWORDS[i])) {
+            return DUMP_LINE_STATEMENT;
+        }
+    }
+    return DUMP_LINE_UNKNOWN;
+}
+
+// Keeps the last bytes of the line in [from, to), ignoring '\r'.
+static void remember_line_tail(ParsingContext *ctx, const char *from, const char *to) {
+    int cap = (int)sizeof(ctx->line_tail);
+    if (to - from > cap) from = to - cap; // Only the end of the line matters
+    for (; from < to; from++) {
+        if (*from == '\r') continue;
+        if (ctx->line_tail_len == cap) {
+            memmove(ctx->line_tail, ctx->line_tail + 1, cap - 1);
+            ctx->line_tail_len--;
+        }
+        ctx->line_tail[ctx->line_tail_len++] = *from;
+    }
+}
+
+// Returns true if the skipped line ends the way its kind requires, i.e. the
+// next line starts outside any statement, comment or string.
+static bool dump_line_is_complete(const ParsingContext *ctx) {
+    int n = ctx->line_tail_len;
+    const char *tail = ctx->line_tail;
+
+    switch (ctx->dump_line_kind) {
+        case DUMP_LINE_STATEMENT:
+        case DUMP_LINE_INSERT:
+            return n > 0 && tail[n - 1] == ';';
+        case DUMP_LINE_VERSIONED:
+            while (n > 0 && tail[n - 1] == ';') n--; // "*/;" or "*/;;" under DELIMITER ;;
+            return n >= 2 && tail[n - 2] == '*' && tail[n - 1] == '/';
+        default:
+            return true;
+    }
+}
+
+// Returns true if the line ending at `to`, whose earlier bytes may be in the
+// remembered tail, ends with ';' (ignoring '\r').
+static bool line_ends_with_semicolon(const ParsingContext *ctx, const char *from, const char *to) {
+    while (to > from && to[-1] == '\r') to--;
+    if (to > from) {
+        return to[-1] == ';';
+    }
+    return ctx->line_tail_len > 0 && ctx->line_tail[ctx->line_tail_len - 1] == ';';
+}
+
+// Returns true if CREATE follows a ';' in the last DUMP_LINE_TAIL_SCAN bytes
+// of the line ending at `to`, including where the line's remembered tail
+// meets [from, to), so a match split across chunks is found.
+static bool create_follows_semicolon(const ParsingContext *ctx, const char *from, const char *to) {
+    if (to - from > DUMP_LINE_TAIL_SCAN) {
+        return find_create_after_semicolon(to - DUMP_LINE_TAIL_SCAN, to);
+    }
+    if (ctx->line_tail_len > 0) {
+        char joined[2 * sizeof(ctx->line_tail)];
+        size_t head = (size_t)(to - from) < sizeof(ctx->line_tail) ? (size_t)(to - from) : sizeof(ctx->line_tail);
+        memcpy(joined, ctx->line_tail, (size_t)ctx->line_tail_len);
+        memcpy(joined + ctx->line_tail_len, from, head);
+        if (find_create_after_semicolon(joined, joined + ctx->line_tail_len + head)) {
+            return true;
+        }
+    }
+    return find_create_after_semicolon(from, to);
+}
+
+static bool find_create_after_semicolon(const char *p, const char *end) {
+    while ((p = memchr(p, ';', (size_t)(end - p))) != NULL) {
+        const char *q = ++p;
+        while (q < end && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+        if (starts_with_word(q, end, "CREATE")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The rest of the scan inspects every byte
+static void disable_fast_path(ParsingContext *ctx) {
+    fprintf(stderr, "Warning: Line %" PRIu64 " does not look like mysqldump output; "
+            "disabling --assume-mysqldump.\n", ctx->current_line);
+    ctx->assume_mysqldump = false;
+}
+
+// Skips the rest of a classified line from `from`, which is `line_start` when
+// the line begins in this buffer and NULL when it continues from an earlier one.
+// Returns the position after the newline, or NULL if the line does not end as
+// expected and must be rescanned from line_start by the state machine. Lines
+// that ran across chunks cannot be rescanned; the fast path is then disabled.
+static const char *skip_dump_line(ParsingContext *ctx, const char *line_start, const char *from, const char *end) {
+    const char *eol = memchr(from, '\n', (size_t)(end - from));
+    if (!eol) {
+        if (!ctx->eof_reached) {
+            remember_line_tail(ctx, from, end); // Continue in the next chunk
+            return end;
+        }
+        eol = end; // Last line without a newline
+    }
+
+    // A second statement on the line, e.g. "SET @a = 1; CREATE TABLE ...;",
+    // needs the state machine. A CREATE TABLE that continues on the next line
+    // leaves the line incomplete and is rescanned below, so only lines that
+    // end with ';' are searched, and only their tail.
+    bool create_in_line = ctx->dump_line_kind != DUMP_LINE_COMMENT && line_ends_with_semicolon(ctx, from, eol) &&
+                          create_follows_semicolon(ctx, from, eol);
+
+    remember_line_tail(ctx, from, eol);
+    bool complete = !create_in_line && dump_line_is_complete(ctx);
+    ctx->dump_line_kind = DUMP_LINE_NONE;
+    ctx->line_tail_len = 0;
+    if (!complete) {
+        if (line_start) {
+            return NULL;
+        }
+        disable_fast_path(ctx);
+    }
+
+    if (eol == end) {
+        return end;
+    }
+    ctx->current_line++;
+    ctx->last_newline_offset = ctx->global_offset + (eol - ctx->buffer);
+    return eol + 1;
+}
+
+// Advances the line counter over [from, to) of the buffer.
+static void count_lines(ParsingContext *ctx, const char *from, const char *to) {
+    const char *last = NULL;
+    size_t count = sql_count_newlines(from, to, &last);
+    if (count > 0) {
+        ctx->current_line += count;
+        ctx->last_newline_offset = ctx->global_offset + (last - ctx->buffer);
+    }
+}
+
+// Handles one CREATE TABLE statement starting at stmt_start. The statement is
+// tokenized in place; nothing is copied until the table entry is created.
+// On STMT_COMPLETE, *stmt_end points after the table body (or after the name
+// for bodiless forms like CREATE TABLE ... LIKE).
+static StatementResult handle_create_table(ParsingContext *ctx, const char *stmt_start, const char *end, const char **stmt_end) {
+    const char *chunk_start = ctx->buffer;
+    SqlTokenizer tz;
+    SqlToken tok;
+    SqlToken name_tok;
+
+    sql_tokenizer_init(&tz, stmt_start + CREATE_TABLE_LEN, end);
+
+    // A token touching the end of the buffer may continue in the next chunk
+#define NEXT_TOKEN_OR_REFILL() \
+    do { \
+        bool got_ = sql_next_token(&tz, &tok); \
+        if (!ctx->eof_reached && (!got_ || tok.text.ptr + tok.text.len == end)) return STMT_NEED_MORE_DATA; \
+        if (!got_) { *stmt_end = end; return STMT_COMPLETE; } \
+    } while (0)
+
+    NEXT_TOKEN_OR_REFILL();
+    if (sql_token_is_word(&tok, "IF")) { // IF NOT EXISTS
+        NEXT_TOKEN_OR_REFILL();
+        NEXT_TOKEN_OR_REFILL();
+        NEXT_TOKEN_OR_REFILL();
+    }
+    if (!sql_token_is_identifier(&tok)) {
+        // If we found CREATE TABLE but couldn't parse name, advance past keyword
+        *stmt_end = stmt_start + CREATE_TABLE_LEN;
+        return STMT_COMPLETE;
+    }
+
+    // Qualified names (`db`.`table`) keep the last part
+    name_tok = tok;
+    NEXT_TOKEN_OR_REFILL();
+    while (tok.type == SQL_TOK_DOT) {
+        NEXT_TOKEN_OR_REFILL();
+        if (!sql_token_is_identifier(&tok)) break;
+        name_tok = tok;
+        NEXT_TOKEN_OR_REFILL();
+    }
+
+    const char *name_end = name_tok.text.ptr + name_tok.text.len;
+    const char *body_start = NULL;
+    const char *body_close = NULL;
+    if (tok.type == SQL_TOK_LPAREN) {
+        body_start = tok.text.ptr + 1;
+        body_close = sql_find_closing_paren(body_start, end);
+        if (!body_close) {
+            if (!ctx->eof_reached) return STMT_NEED_MORE_DATA;
+            body_close = end; // Unterminated body: parse what is there
+        }
+    }
+#undef NEXT_TOKEN_OR_REFILL
+
+    // The statement ends at the ';' after the table options
+    const char *options = body_start ? (body_close < end ? body_close + 1 : end) : name_end;
+    ParserState options_state = STATE_CODE;
+    const char *ddl_end = find_statement_end(options, end, options, &options_state, NULL);
+    if (!ddl_end) {
+        if (!ctx->eof_reached) return STMT_NEED_MORE_DATA;
+        ddl_end = end; // Unterminated statement
+    }
+
+    char *table_name = sql_unquote_identifier(name_tok.text);
+    if (!table_name) {
+        perror("Failed to allocate memory for table name");
+        return STMT_ERROR;
+    }
+
+    // Add the table entry
+    if (!add_table_entry(&ctx->index, table_name, ctx->current_line)) {
+        free(table_name);
+        return STMT_ERROR;
+    }
+    TableInfo *table_info = ctx->index.entries[ctx->index.count - 1].table_info;
+    table_info->ddl_offset = ctx->global_offset + (stmt_start - chunk_start);
+    table_info->ddl_end_offset = ctx->global_offset + (ddl_end - chunk_start);
+
+    if (body_start) {
+        *stmt_end = body_close < end ? body_close + 1 : end;
+        // Store the global offset after the CREATE TABLE definition
+        table_info->end_offset = ctx->global_offset + (*stmt_end - chunk_start);
+        // Columns are parsed on first use (load_table_columns)
+        table_info->body_offset = ctx->global_offset + (body_start - chunk_start);
+        table_info->body_length = (size_t)(body_close - body_start);
+    } else {
+        // Move just past the table name
+        *stmt_end = name_end;
+        table_info->end_offset = ctx->global_offset + (name_end - chunk_start);
+        table_info->columns_loaded = true; // Nothing to parse
+    }
+
+    if (ctx->hooks && ctx->hooks->on_table) {
+        // The body is still buffered, so parse it now rather than re-reading it
+        if (ctx->hooks->parse_columns && body_start) {
+            if (!parse_table_columns(ctx, table_info, body_start, body_close)) {
+                fprintf(stderr, "Warning: Failed to parse columns for table '%s'\n", table_name);
+            }
+            if (!intern_table_schema(&ctx->index, table_info)) {
+                free(table_name);
+                return STMT_ERROR;
+            }
+            table_info->columns_loaded = true;
+        }
+        if (!ctx->hooks->on_table(ctx->hooks->data, ctx->index.count - 1, table_info)) {
+            ctx->stop_requested = true;
+        }
+    }
+
+    free(table_name);
+    return STMT_COMPLETE;
+}
+
+// Returns the next token without consuming it.
+static bool peek_token(const SqlTokenizer *tz, SqlToken *tok) {
+    SqlTokenizer lookahead = *tz;
+    return sql_next_token(&lookahead, tok);
+}
+
+// Skips tokens up to and including the next top-level comma of the table body.
+static void skip_definition(SqlTokenizer *tz) {
+    SqlToken tok;
+    int depth = 0;
+    while (sql_next_token(tz, &tok)) {
+        if (tok.type == SQL_TOK_LPAREN) depth++;
+        else if (tok.type == SQL_TOK_RPAREN) depth--;
+        else if (tok.type == SQL_TOK_COMMA && depth == 0) return;
+    }
+}
+
+// Parse column definitions from a CREATE TABLE statement.
+// A single pass over the body: each definition is either a column or a
+// table-level constraint, split at top-level commas by the tokenizer.
+bool parse_table_columns(ParsingContext *ctx, TableInfo *table_info, const char *start_ptr, const char *end_ptr) {
+    (void)ctx;
+    SqlTokenizer tz;
+    SqlToken tok;
+    bool success = true;
+
+    sql_tokenizer_init(&tz, start_ptr, end_ptr);
+    while (sql_next_token(&tz, &tok)) {
+        if (tok.type == SQL_TOK_COMMA) {
+            continue;
+        }
+
+        if (is_key_definition_start(&tok)) {
+            // It's a table-level index or constraint like PRIMARY KEY (col1, col2)
+            if (!parse_key_definition(&tz, table_info, &tok)) {
+                success = false;
+            }
+        } else if (sql_token_is_identifier(&tok)) {
+            // It's a column definition
+            if (!parse_column_definition(&tz, table_info, &tok)) {
+                success = false;
+            }
+        } else {
+            skip_definition(&tz);
+        }
+    }
+
+    // Keys may name columns declared after them, so resolve once all are known
+    if (!build_column_hash(table_info)) {
+        return false;
+    }
+    for (int i = 0; i < table_info->key_count; i++) {
+        if (table_info->keys[i].kind == KEY_PRIMARY) {
+            mark_primary_key_columns(table_info, &table_info->keys[i]);
+        }
+    }
+    return success;
+}
+
+// Parses one column definition; name_tok has already been consumed.
+// Consumes the definition up to and including its trailing comma.
+static bool parse_column_definition(SqlTokenizer *tz, TableInfo *table_info, const SqlToken *name_tok) {
+    SqlToken tok;
+    SqlToken next;
+
+    // The type is a word optionally followed by (...) and sign/zerofill
+    // modifiers, e.g. "int(11) unsigned" or "enum('a','b')". It is kept as
+    // the original bytes so long ENUM/SET lists survive intact.
+    if (!peek_token(tz, &tok) || tok.type != SQL_TOK_WORD) {
+        skip_definition(tz);
+        return true; // Not a column we can describe
+    }
+    sql_next_token(tz, &tok);
+    StrSpan type_span = tok.text;
+    if (peek_token(tz, &next) && next.type == SQL_TOK_LPAREN) {
+        sql_next_token(tz, &next);
+        const char *close = sql_find_closing_paren(next.text.ptr + 1, tz->end);
+        tz->pos = close ? close + 1 : tz->end;
+        type_span.len = (size_t)(tz->pos - type_span.ptr);
+    }
+    while (peek_token(tz, &next) &&
+           (sql_token_is_word(&next, "UNSIGNED") || sql_token_is_word(&next, "SIGNED") ||
+            sql_token_is_word(&next, "ZEROFILL"))) {
+        sql_next_token(tz, &next);
+        type_span.len = (size_t)(next.text.ptr + next.text.len - type_span.ptr);
+    }
+
+    // Parse remaining attributes
+    bool is_pk = false, is_nn = false, is_ai = false, is_unique = false;
+    StrSpan default_span = {NULL, 0};
+    StrSpan comment_span = {NULL, 0};
+    StrSpan charset_span = {NULL, 0};
+    StrSpan collation_span = {NULL, 0};
+    while (sql_next_token(tz, &tok) && tok.type != SQL_TOK_COMMA) {
+        if (tok.type == SQL_TOK_LPAREN) {
+            // e.g. GENERATED ALWAYS AS (expr), CHECK (expr)
+            const char *close = sql_find_closing_paren(tok.text.ptr + 1, tz->end);
+            tz->pos = close ? close + 1 : tz->end;
+        } else if (sql_token_is_word(&tok, "NOT")) {
+            if (peek_token(tz, &next) && sql_token_is_word(&next, "NULL")) {
+                sql_next_token(tz, &next);
+                is_nn = true;
+            }
+        } else if (sql_token_is_word(&tok, "AUTO_INCREMENT")) {
+            is_ai = true;
+        } else if (sql_token_is_word(&tok, "PRIMARY")) {
+            is_pk = true;
+        } else if (sql_token_is_word(&tok, "KEY")) {
+            // A bare KEY in a column definition means PRIMARY KEY (UNIQUE KEY is consumed below)
+            is_pk = true;
+        } else if (sql_token_is_word(&tok, "UNIQUE")) {
+            is_unique = true;
+            if (peek_token(tz, &next) && sql_token_is_word(&next, "KEY")) {
+                sql_next_token(tz, &next);
+            }
+        } else if (sql_token_is_word(&tok, "DEFAULT")) {
+            default_span = read_value_span(tz);
+        } else if (sql_token_is_word(&tok, "CHARACTER") || sql_token_is_word(&tok, "CHARSET")) {
+            if (sql_token_is_word(&tok, "CHARACTER")) {
+                sql_next_token(tz, &next); // SET
+            }
+            if (sql_next_token(tz, &next) && sql_token_is_identifier(&next)) {
+                charset_span = next.text;
+            }
+        } else if (sql_token_is_word(&tok, "COLLATE")) {
+            if (sql_next_token(tz, &next) && sql_token_is_identifier(&next)) {
+                collation_span = next.text;
+            }
+        } else if (sql_token_is_word(&tok, "COMMENT")) {
+            if (peek_token(tz, &next) && next.type == SQL_TOK_STRING) {
+                sql_next_token(tz, &next);
+                comment_span = next.text;
+            }
+        }
+    }
+
+    ColumnInfo *col = append_column(table_info);
+    if (!col) {
+        return false;
+    }
+    col->name = sql_unquote_identifier(name_tok->text);
+    col->type = sql_span_strdup(type_span);
+    col->default_value = default_span.ptr ? sql_span_strdup(default_span) : NULL;
+    col->comment = comment_span.ptr ? sql_unquote_string(comment_span) : NULL;
+    col->type_desc.charset = charset_span.ptr ? sql_unquote_identifier(charset_span) : NULL;
+    col->type_desc.collation = collation_span.ptr ? sql_unquote_identifier(collation_span) : NULL;
+    if (!col->name || !col->type ||
+        (default_span.ptr && !col->default_value) || (comment_span.ptr && !col->comment) ||
+        (charset_span.ptr && !col->type_desc.charset) || (collation_span.ptr && !col->type_desc.collation) ||
+        !parse_column_type(col->type, &col->type_desc)) {
+        perror("Failed to duplicate column name or type");
+        free(col->name);
+        free(col->type);
+        free(col->default_value);
+        free(col->comment);
+        cleanup_column_type(&col->type_desc);
+        table_info->column_count--;
+        return false;
+    }
+    col->is_primary_key = is_pk;
+    col->is_not_null = is_nn;
+    col->is_auto_increment = is_ai;
+
+    // Column-level PRIMARY KEY / UNIQUE declare single-column keys
+    if (is_pk || is_unique) {
+        KeyInfo *key = append_key(table_info, is_pk ? KEY_PRIMARY : KEY_UNIQUE);
+        if (!key || !append_name(&key->columns, &key->column_count, col->name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the span of a DEFAULT value: a literal, a signed number, a
+// parenthesized expression, a function call like CURRENT_TIMESTAMP(3) or an
+// introducer/prefixed literal like _utf8mb4'x' or b'101'.
+static StrSpan read_value_span(SqlTokenizer *tz) {
+    SqlToken tok;
+    SqlToken next;
+    StrSpan span = {NULL, 0};
+
+    if (!peek_token(tz, &tok) || tok.type == SQL_TOK_COMMA) {
+        return span;
+    }
+    sql_next_token(tz, &tok);
+    span = tok.text;
+
+    if (tok.type == SQL_TOK_OTHER && (tok.text.ptr[0] == '-' || tok.text.ptr[0] == '+') &&
+        peek_token(tz, &next) && next.type == SQL_TOK_WORD) {
+        sql_next_token(tz, &next);
+        span.len = (size_t)(next.text.ptr + next.text.len - span.ptr);
+    } else if (tok.type == SQL_TOK_LPAREN) {
+        const char *close = sql_find_closing_paren(tok.text.ptr + 1, tz->end);
+        tz->pos = close ? close + 1 : tz->end;
+        span.len = (size_t)(tz->pos - span.ptr);
+    } else if (tok.type == SQL_TOK_WORD && peek_token(tz, &next) &&
+               next.text.ptr == tok.text.ptr + tok.text.len) {
+        if (next.type == SQL_TOK_STRING) {
+            sql_next_token(tz, &next);
+            span.len = (size_t)(next.text.ptr + next.text.len - span.ptr);
+        } else if (next.type == SQL_TOK_LPAREN) {
+            const char *close = sql_find_closing_paren(next.text.ptr + 1, tz->end);
+            tz->pos = close ? close + 1 : tz->end;
+            span.len = (size_t)(tz->pos - span.ptr);
+        }
+    }
+    return span;
+}
+
+// Returns true if a body definition starting with tok is an index or constraint.
+// Only bare words count: a quoted `key` is a column name.
+static bool is_key_definition_start(const SqlToken *tok) {
+    static const char *const keywords[] = {
+        "PRIMARY", "UNIQUE", "KEY", "INDEX", "CONSTRAINT",
+        "FOREIGN", "FULLTEXT", "SPATIAL", "CHECK"
+    };
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if (sql_token_is_word(tok, keywords[i])) return true;
+    }
+    return false;
+}
+
+// Parses a table-level index or constraint; first_tok has already been consumed.
+// Grammar (MySQL/MariaDB):
+//   [CONSTRAINT [symbol]] PRIMARY KEY [USING type] (parts) [options]
+//   [CONSTRAINT [symbol]] UNIQUE [INDEX|KEY] [name] [USING type] (parts) [options]
+//   {INDEX|KEY} [name] [USING type] (parts) [options]
+//   {FULLTEXT|SPATIAL} [INDEX|KEY] [name] (parts) [options]
+//   [CONSTRAINT [symbol]] FOREIGN KEY [name] (parts) REFERENCES tbl (parts)
+//       [MATCH type] [ON DELETE action] [ON UPDATE action]
+//   [CONSTRAINT [symbol]] CHECK (expr)
+// Consumes the definition up to and including its trailing comma.
+static bool parse_key_definition(SqlTokenizer *tz, TableInfo *table_info, const SqlToken *first_tok) {
+    SqlToken tok = *first_tok;
+    SqlToken next;
+    StrSpan constraint_name = {NULL, 0};
+    StrSpan key_name = {NULL, 0};
+    KeyKind kind;
+
+    if (sql_token_is_word(&tok, "CONSTRAINT")) {
+        if (!sql_next_token(tz, &tok)) return true;
+        if (sql_token_is_identifier(&tok) && !is_key_definition_start(&tok)) {
+            constraint_name = tok.text;
+            if (!sql_next_token(tz, &tok)) return true;
+        }
+    }
+
+    if (sql_token_is_word(&tok, "PRIMARY")) {
+        kind = KEY_PRIMARY;
+    } else if (sql_token_is_word(&tok, "UNIQUE")) {
+        kind = KEY_UNIQUE;
+    } else if (sql_token_is_word(&tok, "INDEX") || sql_token_is_word(&tok, "KEY")) {
+        kind = KEY_INDEX;
+    } else if (sql_token_is_word(&tok, "FULLTEXT")) {
+        kind = KEY_FULLTEXT;
+    } else if (sql_token_is_word(&tok, "SPATIAL")) {
+        kind = KEY_SPATIAL;
+    } else if (sql_token_is_word(&tok, "FOREIGN")) {
+        kind = KEY_FOREIGN;
+    } else {
+        skip_definition(tz); // CHECK constraints and anything unknown
+        return true;
+    }
+
+    // Optional INDEX/KEY keyword after PRIMARY, UNIQUE, FULLTEXT, SPATIAL, FOREIGN
+    if (kind != KEY_INDEX && peek_token(tz, &next) &&
+        (sql_token_is_word(&next, "KEY") || sql_token_is_word(&next, "INDEX"))) {
+        sql_next_token(tz, &next);
+    }
+
+    // Optional index name and index type
+    if (peek_token(tz, &next) && sql_token_is_identifier(&next) && !sql_token_is_word(&next, "USING")) {
+        sql_next_token(tz, &next);
+        key_name = next.text;
+    }
+    if (peek_token(tz, &next) && sql_token_is_word(&next, "USING")) {
+        sql_next_token(tz, &next);
+        sql_next_token(tz, &next);
+    }
+
+    if (!peek_token(tz, &next) || next.type != SQL_TOK_LPAREN) {
+        skip_definition(tz); // Malformed: no column list
+        return true;
+    }
+    sql_next_token(tz, &next);
+
+    KeyInfo *key = append_key(table_info, kind);
+    if (!key) return false;
+    if (constraint_name.ptr || key_name.ptr) {
+        key->name = sql_unquote_identifier(constraint_name.ptr ? constraint_name : key_name);
+        if (!key->name) return false;
+    }
+    if (!parse_key_parts(tz, &key->columns, &key->column_count)) {
+        return false;
+    }
+
+    if (kind == KEY_FOREIGN && peek_token(tz, &next) && sql_token_is_word(&next, "REFERENCES")) {
+        sql_next_token(tz, &next);
+
+        // Referenced table, possibly qualified as `db`.`table`
+        StrSpan ref_name = {NULL, 0};
+        while (sql_next_token(tz, &tok) && sql_token_is_identifier(&tok)) {
+            ref_name = tok.text;
+            if (!peek_token(tz, &next) || next.type != SQL_TOK_DOT) break;
+            sql_next_token(tz, &next);
+        }
+        if (ref_name.ptr) {
+            key->ref_table = sql_unquote_identifier(ref_name);
+            if (!key->ref_table) return false;
+        }
+        if (peek_token(tz, &next) && next.type == SQL_TOK_LPAREN) {
+            sql_next_token(tz, &next);
+            if (!parse_key_parts(tz, &key->ref_columns, &key->ref_column_count)) {
+                return false;
+            }
+        }
+
+        // MATCH / ON DELETE / ON UPDATE clauses, in any order
+        while (peek_token(tz, &next) && next.type == SQL_TOK_WORD) {
+            sql_next_token(tz, &next);
+            if (sql_token_is_word(&next, "MATCH")) {
+                sql_next_token(tz, &next);
+            } else if (sql_token_is_word(&next, "ON") && sql_next_token(tz, &tok)) {
+                char **action = sql_token_is_word(&tok, "DELETE") ? &key->on_delete :
+                                sql_token_is_word(&tok, "UPDATE") ? &key->on_update : NULL;
+                if (action) {
+                    free(*action);
+                    *action = read_referential_action(tz);
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    skip_definition(tz); // Index options after the column list
+    return true;
+}
+
+// Parses "(col1, col2(10) DESC, ...)" after its '(' was consumed, appending
+// the column names. Functional key parts are kept as their expression text.
+static bool parse_key_parts(SqlTokenizer *tz, char ***names, int *count) {
+    SqlToken tok;
+    bool expect_name = true;
+
+    while (sql_next_token(tz, &tok) && tok.type != SQL_TOK_RPAREN) {
+        if (tok.type == SQL_TOK_COMMA) {
+            expect_name = true;
+            continue;
+        }
+
+        char *name = NULL;
+        if (tok.type == SQL_TOK_LPAREN) {
+            // Prefix length, e.g. name(100), or a functional key part ((expr))
+            const char *close = sql_find_closing_paren(tok.text.ptr + 1, tz->end);
+            tz->pos = close ? close + 1 : tz->end;
+            if (expect_name) {
+                name = sql_span_strdup((StrSpan){tok.text.ptr, (size_t)(tz->pos - tok.text.ptr)});
+                if (!name) return false;
+            }
+        } else if (expect_name && sql_token_is_identifier(&tok)) {
+            name = sql_unquote_identifier(tok.text);
+            if (!name) return false;
+        }
+
+        if (name) {
+            expect_name = false;
+            bool ok = append_name(names, count, name);
+            free(name);
+            if (!ok) return false;
+        }
+    }
+    return true;
+}
+
+// Reads CASCADE, RESTRICT, SET NULL, SET DEFAULT or NO ACTION.
+static char *read_referential_action(SqlTokenizer *tz) {
+    SqlToken tok;
+    SqlToken next;
+
+    if (!sql_next_token(tz, &tok) || tok.type != SQL_TOK_WORD) return NULL;
+    StrSpan action = tok.text;
+    if ((sql_token_is_word(&tok, "SET") || sql_token_is_word(&tok, "NO")) &&
+        peek_token(tz, &next) && next.type == SQL_TOK_WORD) {
+        sql_next_token(tz, &next);
+        action.len = (size_t)(next.text.ptr + next.text.len - action.ptr);
+    }
+    char *result = sql_span_strdup(action);
+    if (result) {
+        for (char *c = result; *c; c++) *c = (char)toupper((unsigned char)*c);
+    }
+    return result;
+}
+
+// Flags the columns of a PRIMARY KEY definition.
+static void mark_primary_key_columns(TableInfo *table_info, const KeyInfo *key) {
+    for (int k = 0; k < key->column_count; k++) {
+        int ordinal = find_column_index(table_info, key->columns[k]);
+        if (ordinal >= 0) {
+            table_info->columns[ordinal].is_primary_key = true;
+        }
+    }
+}
+
+// --- Column Name Lookup ---
+
+// FNV-1a over the ASCII-lowercased name; column names compare case-insensitively.
+static uint64_t column_name_hash(const char *name, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint64_t)(unsigned char)tolower((unsigned char)name[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// (Re)builds the open-addressing column hash, kept at most half full.
+static bool build_column_hash(TableInfo *table_info) {
+    int slot_count = 8;
+    while (slot_count < table_info->column_count * 2) slot_count *= 2;
+
+    int *slots = mem_calloc(MEM_COLUMNS, (size_t)slot_count, sizeof(int));
+    if (!slots) {
+        perror("Failed to allocate column hash");
+        return false;
+    }
+    for (int i = 0; i < table_info->column_count; i++) {
+        const char *name = table_info->columns[i].name;
+        size_t mask = (size_t)slot_count - 1;
+        size_t slot = (size_t)column_name_hash(name, strlen(name)) & mask;
+        while (slots[slot] != 0) {
+            // Keep the first declaration of a duplicated name
+            if (strcasecmp(table_info->columns[slots[slot] - 1].name, name) == 0) break;
+            slot = (slot + 1) & mask;
+        }
+        if (slots[slot] == 0) slots[slot] = i + 1;
+    }
+    free(table_info->column_slots);
+    table_info->column_slots = slots;
+    table_info->column_slot_count = slot_count;
+    return true;
+}
+
+int find_column_span(const TableInfo *table_info, StrSpan name) {
+    if (table_info->column_slot_count == 0) {
+        // No hash (table still being parsed): fall back to a scan
+        for (int i = 0; i < table_info->column_count; i++) {
+            const char *col = table_info->columns[i].name;
+            if (strlen(col) == name.len && strncasecmp(col, name.ptr, name.len) == 0) return i;
+        }
+        return -1;
+    }
+    size_t mask = (size_t)table_info->column_slot_count - 1;
+    size_t slot = (size_t)column_name_hash(name.ptr, name.len) & mask;
+    while (table_info->column_slots[slot] != 0) {
+        int ordinal = table_info->column_slots[slot] - 1;
+        const char *col = table_info->columns[ordinal].name;
+        if (strlen(col) == name.len && strncasecmp(col, name.ptr, name.len) == 0) return ordinal;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int find_column_index(const TableInfo *table_info, const char *name) {
+    StrSpan span = {name, strlen(name)};
+    return find_column_span(table_info, span);
+}
+
+int map_insert_columns(const TableInfo *table_info, const char *header, const char *header_end, int **map,
+                       int *capacity) {
+    SqlTokenizer tz;
+    SqlToken tok;
+    sql_tokenizer_init(&tz, header, header_end);
+    while (sql_next_token(&tz, &tok) && tok.type != SQL_TOK_LPAREN) {
+    }
+    bool listed = tok.type == SQL_TOK_LPAREN;
+
+    // Commas plus one bounds the number of listed names
+    int count = table_info->column_count;
+    if (listed) {
+        count = 1;
+        for (const char *p = tz.pos; p < header_end; ++p) count += *p == ',';
+    }
+    if (count > *capacity) {
+        int *grown = mem_realloc(MEM_BUFFERS, *map, (size_t)count * sizeof(int));
+        if (!grown) {
+            perror("Failed to allocate INSERT column map");
+            return -1;
+        }
+        *map = grown;
+        *capacity = count;
+    }
+    if (!listed) {
+        for (int i = 0; i < count; ++i) (*map)[i] = i;
+        return count;
+    }
+
+    int mapped = 0;
+    while (mapped < count && sql_next_token(&tz, &tok) && tok.type != SQL_TOK_RPAREN) {
+        if (!sql_token_is_identifier(&tok)) continue;
+        if (tok.type == SQL_TOK_WORD) {
+            (*map)[mapped++] = find_column_span(table_info, tok.text);
+            continue;
+        }
+        char *name = sql_unquote_identifier(tok.text);
+        if (!name) {
+            perror("Failed to allocate column name");
+            return -1;
+        }
+        (*map)[mapped++] = find_column_index(table_info, name);
+        free(name);
+    }
+    return mapped;
+}
+
+// Appends a zeroed key slot to the table and returns it, or NULL on allocation failure.
+static KeyInfo *append_key(TableInfo *table_info, KeyKind kind) {
+    if (table_info->key_count >= table_info->key_capacity) {
+        int new_capacity = table_info->key_capacity == 0 ? 4 : table_info->key_capacity * 2;
+        KeyInfo *new_keys = mem_realloc(MEM_COLUMNS, table_info->keys, new_capacity * sizeof(KeyInfo));
+        if (!new_keys) {
+            perror("Failed to allocate memory for keys");
+            return NULL;
+        }
+        table_info->keys = new_keys;
+        table_info->key_capacity = new_capacity;
+    }
+
+    KeyInfo *key = &table_info->keys[table_info->key_count++];
+    memset(key, 0, sizeof(*key));
+    key->kind = kind;
+    return key;
+}
+
+// Appends a copy of name to a growable string array.
+static bool append_name(char ***names, int *count, const char *name) {
+    char **new_names = mem_realloc(MEM_COLUMNS, *names, (*count + 1) * sizeof(char *));
+    if (!new_names) {
+        perror("Failed to allocate memory for key columns");
         return false;
     }
-    
-    col->is_primary_key = is_primary_key;
-    col->is_not_null = is_not_null;
-    col->is_auto_increment = is_auto_increment;
-    col->default_value = default_value ? strdup(default_value) : NULL;
-    
-    table_info->column_count++;
+    *names = new_names;
+    new_names[*count] = mem_strdup(MEM_COLUMNS, name);
+    if (!new_names[*count]) {
+        perror("Failed to duplicate key column name");
+        return false;
+    }
+    (*count)++;
     return true;
 }
 
-// Updated process_chunk implementation to parse table columns
-static size_t process_chunk(ParsingContext *ctx) {
-    const char *ptr = ctx->buffer;
-    const char *end = ctx->buffer + ctx->buffer_data_len;
-    const char *chunk_start = ctx->buffer;
-    size_t processed_bytes = 0;
+// --- Schema Deduplication ---
 
-    while (ptr < end) {
-        // --- State Machine Logic (Simplified Example) ---
-        // This needs to be fleshed out to handle comments, strings etc.
-        // For now, just look for CREATE TABLE naively.
+#define FNV64_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV64_PRIME 0x100000001b3ULL
 
-        // Track line numbers
-        if (*ptr == '\n') {
-            ctx->current_line++;
-            ctx->last_newline_offset = ctx->global_offset + (ptr - chunk_start);
+// FNV-1a over a string including its terminator; NULL hashes differently from "".
+static uint64_t fnv1a_string(uint64_t hash, const char *str) {
+    if (!str) {
+        return (hash ^ 0xff) * FNV64_PRIME;
+    }
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        hash = (hash ^ *p) * FNV64_PRIME;
+    }
+    return hash * FNV64_PRIME; // Terminator (xor 0)
+}
+
+static uint64_t fnv1a_int(uint64_t hash, int value) {
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ ((unsigned)value >> (i * 8) & 0xff)) * FNV64_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t compute_schema_fingerprint(const ColumnInfo *columns, int column_count, const KeyInfo *keys, int key_count) {
+    uint64_t hash = FNV64_OFFSET_BASIS;
+
+    hash = fnv1a_int(hash, column_count);
+    for (int i = 0; i < column_count; i++) {
+        const ColumnInfo *col = &columns[i];
+        hash = fnv1a_string(hash, col->name);
+        hash = fnv1a_string(hash, col->type);
+        hash = fnv1a_int(hash, col->is_primary_key | col->is_not_null << 1 | col->is_auto_increment << 2);
+        hash = fnv1a_string(hash, col->default_value);
+        hash = fnv1a_string(hash, col->comment);
+        hash = fnv1a_string(hash, col->type_desc.charset);
+        hash = fnv1a_string(hash, col->type_desc.collation);
+    }
+    hash = fnv1a_int(hash, key_count);
+    for (int i = 0; i < key_count; i++) {
+        const KeyInfo *key = &keys[i];
+        hash = fnv1a_int(hash, key->kind);
+        hash = fnv1a_string(hash, key->name);
+        hash = fnv1a_int(hash, key->column_count);
+        for (int k = 0; k < key->column_count; k++) hash = fnv1a_string(hash, key->columns[k]);
+        hash = fnv1a_string(hash, key->ref_table);
+        hash = fnv1a_int(hash, key->ref_column_count);
+        for (int k = 0; k < key->ref_column_count; k++) hash = fnv1a_string(hash, key->ref_columns[k]);
+        hash = fnv1a_string(hash, key->on_delete);
+        hash = fnv1a_string(hash, key->on_update);
+    }
+    return hash;
+}
+
+static bool strings_equal(const char *a, const char *b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// Full comparison guarding against fingerprint collisions.
+static bool schema_matches(const SchemaDef *schema, const TableInfo *table_info) {
+    if (schema->column_count != table_info->column_count || schema->key_count != table_info->key_count) {
+        return false;
+    }
+    for (int i = 0; i < schema->column_count; i++) {
+        const ColumnInfo *a = &schema->columns[i];
+        const ColumnInfo *b = &table_info->columns[i];
+        if (!strings_equal(a->name, b->name) || !strings_equal(a->type, b->type) ||
+            a->is_primary_key != b->is_primary_key || a->is_not_null != b->is_not_null ||
+            a->is_auto_increment != b->is_auto_increment ||
+            !strings_equal(a->default_value, b->default_value) || !strings_equal(a->comment, b->comment) ||
+            !strings_equal(a->type_desc.charset, b->type_desc.charset) ||
+            !strings_equal(a->type_desc.collation, b->type_desc.collation)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < schema->key_count; i++) {
+        const KeyInfo *a = &schema->keys[i];
+        const KeyInfo *b = &table_info->keys[i];
+        if (a->kind != b->kind || !strings_equal(a->name, b->name) ||
+            a->column_count != b->column_count || a->ref_column_count != b->ref_column_count ||
+            !strings_equal(a->ref_table, b->ref_table) ||
+            !strings_equal(a->on_delete, b->on_delete) || !strings_equal(a->on_update, b->on_update)) {
+            return false;
+        }
+        for (int k = 0; k < a->column_count; k++) {
+            if (!strings_equal(a->columns[k], b->columns[k])) return false;
         }
+        for (int k = 0; k < a->ref_column_count; k++) {
+            if (!strings_equal(a->ref_columns[k], b->ref_columns[k])) return false;
+        }
+    }
+    return true;
+}
 
-        // Simple check for "CREATE TABLE" (case-insensitive)
-        // This is a basic example and doesn't handle comments/strings correctly
-        if (ctx->state == STATE_CODE && (end - ptr >= CREATE_TABLE_LEN)) {
-            if (strncasecmp(ptr, CREATE_TABLE_KEYWORD, CREATE_TABLE_LEN) == 0) {
-                const char* next_char_ptr = ptr + CREATE_TABLE_LEN;
-                // Ensure it's followed by whitespace or end of buffer
-                if (next_char_ptr == end || isspace((unsigned char)*next_char_ptr)) {
-                    const char *token_start = find_next_token(next_char_ptr, end);
-                    if (token_start) {
-                        size_t token_len = get_token_length(token_start);
-                        if (token_len > 0 && token_start + token_len <= end) {
-                            char *table_name = malloc(token_len + 1);
-                            if (table_name) {
-                                strncpy(table_name, token_start, token_len);
-                                table_name[token_len] = '\0';
-                                // Remove potential backticks
-                                if (table_name[0] == '`' && table_name[token_len - 1] == '`') {
-                                    memmove(table_name, table_name + 1, token_len - 2);
-                                    table_name[token_len - 2] = '\0';
-                                }
-
-                                // Add the table entry
-                                if (!add_table_entry(&ctx->index, table_name, ctx->current_line)) {
-                                    ctx->error_occurred = true;
-                                    free(table_name);
-                                    return processed_bytes; // Stop processing on error
-                                }
-                                
-                                // Find the start of the table body (look for '(' after table name)
-                                const char *table_body_start = find_table_body_start(token_start + token_len, end);
-                                if (table_body_start) {
-                                    // Find the last entry for this table name
-                                    int table_idx = -1;
-                                    for (int i = ctx->index.count - 1; i >= 0; i--) {
-                                        if (strcmp(ctx->index.entries[i].type, "TABLE") == 0 && strcmp(ctx->index.entries[i].name, table_name) == 0) {
-                                            table_idx = i;
-                                            break;
-                                        }
-                                    }
-                                    if (table_idx == -1) {
-                                        // Should not happen due to add_table_entry logic
-                                        ctx->error_occurred = true;
-                                        free(table_name);
-                                        return processed_bytes;
-                                    }
-                                    TableInfo *table_info = ctx->index.entries[table_idx].table_info;
-                                    
-                                    // Find the end of the table definition
-                                    const char *table_body_end = find_table_body_end(table_body_start, end);
-                                    
-                                    // If we can find both the start and end, parse the columns
-                                    if (table_body_end) {
-                                        // Store the global offset after the CREATE TABLE definition
-                                        table_info->end_offset = ctx->global_offset + (table_body_end - chunk_start);
-
-                                        // Parse column definitions
-                                        if (!parse_table_columns(ctx, table_info, table_body_start, table_body_end)) {
-                                            fprintf(stderr, "Warning: Failed to parse columns for table '%s'\n", table_name);
-                                            // Continue processing even if column parsing fails
-                                        }
-                                    
-                                        // Move past the table definition
-                                        ptr = table_body_end;
-                                    } else {
-                                        // The CREATE TABLE statement is split across chunks.
-                                        processed_bytes = (ptr - chunk_start);
-                                        free(table_name);
-                                        return processed_bytes; // Return, so the buffer can be refilled
-                                    }
-                                } else {
-                                    // Move just past the table name
-                                    ctx->index.entries[ctx->index.count - 1].table_info->end_offset = ctx->global_offset + (token_start + token_len - chunk_start);
-                                    ptr = token_start + token_len;
-                                }
-                                
-                                free(table_name);
-                                processed_bytes = (ptr - chunk_start);
-                                continue; // Continue loop
-                            } else {
-                                perror("Failed to allocate memory for table name");
-                                ctx->error_occurred = true;
-                                return processed_bytes;
-                            }
-                        }
-                    }
-                    // If we found CREATE TABLE but couldn't parse name, advance past keyword
-                    ptr += CREATE_TABLE_LEN;
-                    processed_bytes = (ptr - chunk_start);
-                    continue;
-                }
+// Replaces the table's own column/key arrays with a shared definition,
+// creating one if no identical definition exists yet.
+static bool intern_table_schema(SqlIndex *index, TableInfo *table_info) {
+    if (table_info->schema_id >= 0 || (table_info->column_count == 0 && table_info->key_count == 0)) {
+        return true;
+    }
+
+    uint64_t fingerprint = compute_schema_fingerprint(table_info->columns, table_info->column_count,
+                                                      table_info->keys, table_info->key_count);
+    if (index->schema_slot_count > 0) {
+        size_t mask = index->schema_slot_count - 1;
+        for (size_t slot = fingerprint & mask; index->schema_slots[slot] != 0; slot = (slot + 1) & mask) {
+            int id = index->schema_slots[slot] - 1;
+            if (index->schemas[id].fingerprint == fingerprint && schema_matches(&index->schemas[id], table_info)) {
+                free_table_definition(table_info);
+                attach_schema(index, table_info, id);
+                return true;
             }
         }
+    }
 
-        // --- End State Machine Logic ---
+    int id = add_schema(index, fingerprint, table_info);
+    if (id < 0) {
+        return false;
+    }
+    attach_schema(index, table_info, id);
+    return true;
+}
 
-        ptr++;
-        processed_bytes = (ptr - chunk_start);
+// Adds a schema that takes ownership of the owner's columns, keys and column
+// hash (the owner's pointers are cleared). Returns its id, or -1 on failure.
+static int add_schema(SqlIndex *index, uint64_t fingerprint, TableInfo *owner) {
+    if (index->schema_count >= index->schema_capacity) {
+        int new_capacity = index->schema_capacity == 0 ? 16 : index->schema_capacity * 2;
+        SchemaDef *new_schemas = mem_realloc(MEM_INDEX, index->schemas, new_capacity * sizeof(SchemaDef));
+        if (!new_schemas) {
+            perror("Failed to allocate memory for schemas");
+            return -1;
+        }
+        index->schemas = new_schemas;
+        index->schema_capacity = new_capacity;
+    }
 
-        // Need to handle buffer boundaries carefully - don't process the last few bytes
-        // if they might be part of a multi-byte sequence or keyword split across chunks.
-        // For this simple example, we process up to the end.
+    // Keep the slot table at most half full
+    if ((size_t)(index->schema_count + 1) * 2 > index->schema_slot_count) {
+        size_t new_slot_count = index->schema_slot_count == 0 ? 64 : index->schema_slot_count * 2;
+        int *new_slots = mem_calloc(MEM_INDEX, new_slot_count, sizeof(int));
+        if (!new_slots) {
+            perror("Failed to allocate memory for schema lookup table");
+            return -1;
+        }
+        for (int i = 0; i < index->schema_count; i++) {
+            size_t slot = index->schemas[i].fingerprint & (new_slot_count - 1);
+            while (new_slots[slot] != 0) slot = (slot + 1) & (new_slot_count - 1);
+            new_slots[slot] = i + 1;
+        }
+        free(index->schema_slots);
+        index->schema_slots = new_slots;
+        index->schema_slot_count = new_slot_count;
     }
 
-    // Return the number of bytes fully processed in this chunk.
-    // If the chunk ends mid-token/comment, we might need to return less
-    // and keep the remainder for the next read (requires more complex logic).
-    return processed_bytes;
+    int id = index->schema_count++;
+    SchemaDef *schema = &index->schemas[id];
+    schema->fingerprint = fingerprint;
+    schema->columns = owner->columns;
+    schema->column_count = owner->column_count;
+    schema->keys = owner->keys;
+    schema->key_count = owner->key_count;
+    schema->column_slots = owner->column_slots;
+    schema->column_slot_count = owner->column_slot_count;
+    schema->table_count = 0;
+    owner->columns = NULL;
+    owner->column_count = 0;
+    owner->column_capacity = 0;
+    owner->keys = NULL;
+    owner->key_count = 0;
+    owner->key_capacity = 0;
+    owner->column_slots = NULL;
+    owner->column_slot_count = 0;
+
+    size_t slot = fingerprint & (index->schema_slot_count - 1);
+    while (index->schema_slots[slot] != 0) slot = (slot + 1) & (index->schema_slot_count - 1);
+    index->schema_slots[slot] = id + 1;
+    return id;
 }
 
-// Find the start of the table body (the opening parenthesis)
-static const char* find_table_body_start(const char *ptr, const char *end) {
-    while (ptr < end) {
-        if (*ptr == '(') return ptr + 1; // Return position after the opening parenthesis
-        ptr++;
+static void attach_schema(SqlIndex *index, TableInfo *table_info, int schema_id) {
+    SchemaDef *schema = &index->schemas[schema_id];
+    table_info->schema_id = schema_id;
+    table_info->columns = schema->columns;
+    table_info->column_count = schema->column_count;
+    table_info->column_capacity = 0;
+    table_info->keys = schema->keys;
+    table_info->key_count = schema->key_count;
+    table_info->key_capacity = 0;
+    table_info->column_slots = schema->column_slots;
+    table_info->column_slot_count = schema->column_slot_count;
+    schema->table_count++;
+}
+
+void print_schemas(const SqlIndex *index) {
+    printf("Table Definitions:\n");
+    printf("%-18s %-8s %-8s %s\n", "Fingerprint", "Columns", "Tables", "Names");
+    printf("--------------------------------------------------\n");
+    if (index->schema_count == 0) {
+        printf("No table definitions found.\n");
+        return;
+    }
+
+    // Group table entries by schema id (counting sort)
+    int *starts = mem_calloc(MEM_OTHER, index->schema_count + 1, sizeof(int));
+    const char **names = mem_malloc(MEM_OTHER, (index->count > 0 ? index->count : 1) * sizeof(char *));
+    if (!starts || !names) {
+        perror("Failed to allocate memory for schema listing");
+        free(starts);
+        free(names);
+        return;
+    }
+    for (int i = 0; i < index->count; i++) {
+        const TableInfo *t = index->entries[i].table_info;
+        if (t && t->schema_id >= 0) starts[t->schema_id + 1]++;
     }
-    return NULL; // Not found within buffer bounds
+    for (int i = 0; i < index->schema_count; i++) starts[i + 1] += starts[i];
+    for (int i = 0; i < index->count; i++) {
+        const TableInfo *t = index->entries[i].table_info;
+        if (t && t->schema_id >= 0) names[starts[t->schema_id]++] = t->name;
+    }
+
+    // starts[id] now marks the end of each group. Names repeat once per
+    // tenant database, so each is listed once with its count, and long
+    // lists are cut short.
+    for (int id = 0; id < index->schema_count; id++) {
+        const SchemaDef *schema = &index->schemas[id];
+        int first = id == 0 ? 0 : starts[id - 1];
+        printf("%016" PRIx64 "   %-8d %-8d", schema->fingerprint, schema->column_count, starts[id] - first);
+        qsort(names + first, (size_t)(starts[id] - first), sizeof(char *), compare_name_ptrs);
+        int listed = 0;
+        int i = first;
+        while (i < starts[id] && listed < SCHEMA_NAMES_LISTED) {
+            int run = 1;
+            while (i + run < starts[id] && strcmp(names[i + run], names[i]) == 0) run++;
+            printf("%s%s", listed == 0 ? " " : ", ", names[i]);
+            if (run > 1) printf(" (x%d)", run);
+            listed++;
+            i += run;
+        }
+        if (i < starts[id]) {
+            printf(" (+%d more)", starts[id] - i);
+        }
+        printf("\n");
+    }
+    free(starts);
+    free(names);
+}
+
+static int compare_name_ptrs(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static const char *const KEY_KIND_NAMES[] = {
+    "PRIMARY", "UNIQUE", "INDEX", "FULLTEXT", "SPATIAL", "FOREIGN"
+};
+
+const char *key_kind_to_string(KeyKind kind) {
+    return KEY_KIND_NAMES[kind];
 }
 
-// Find the end of the table body (the closing parenthesis)
-static const char* find_table_body_end(const char *ptr, const char *end) {
-    int depth = 1; // We start after the opening parenthesis
-    while (ptr < end) {
-        if (*ptr == '(') {
-            depth++;
-        } else if (*ptr == ')') {
-            depth--;
-            if (depth == 0) return ptr + 1; // Return position after the closing parenthesis
+static bool parse_key_kind(const char *str, KeyKind *kind) {
+    for (size_t i = 0; i < sizeof(KEY_KIND_NAMES) / sizeof(KEY_KIND_NAMES[0]); i++) {
+        if (strcmp(str, KEY_KIND_NAMES[i]) == 0) {
+            *kind = (KeyKind)i;
+            return true;
         }
-        ptr++;
     }
-    return NULL; // Not found within buffer bounds or not balanced
+    return false;
 }
 
-// Parse column definitions from a CREATE TABLE statement
-bool parse_table_columns(ParsingContext *ctx, TableInfo *table_info, const char *start_ptr, const char *end_ptr) {
-    const char *p = start_ptr;
-    bool success = true;
+// --- Lazy Column Loading ---
 
-    while (p < end_ptr) {
-        // Skip leading whitespace and commas from previous iteration
-        while (p < end_ptr && (isspace((unsigned char)*p) || *p == ',')) {
-            p++;
+// Reads a table's body span from the open SQL file and parses it. This
+// seeks with fseeko rather than reading with pread: fp may be a gzip,
+// archive or multi-part stream from open_sql_input with no descriptor behind
+// it, and off_t is 64-bit (_FILE_OFFSET_BITS=64) either way.
+static bool load_columns_from_file(SqlIndex *index, TableInfo *table_info, FILE *fp) {
+    if (table_info->columns_loaded) {
+        return true;
+    }
+    if (table_info->body_offset < 0) {
+        table_info->columns_loaded = true;
+        return true;
+    }
+
+    char *body = mem_malloc(MEM_BUFFERS, table_info->body_length + 1);
+    if (!body) {
+        perror("Failed to allocate buffer for table definition");
+        return false;
+    }
+    if (fseeko(fp, table_info->body_offset, SEEK_SET) != 0 ||
+        fread(body, 1, table_info->body_length, fp) != table_info->body_length) {
+        fprintf(stderr, "Error reading definition of table '%s' at offset %jd\n",
+                table_info->name, (intmax_t)table_info->body_offset);
+        free(body);
+        return false;
+    }
+    body[table_info->body_length] = '\0';
+
+    DEBUG_PRINT("Parsing columns of table '%s' (%zu bytes)", table_info->name, table_info->body_length);
+    TRACE_BEGIN(parse_start);
+    if (!parse_table_columns(NULL, table_info, body, body + table_info->body_length)) {
+        fprintf(stderr, "Warning: Failed to parse columns for table '%s'\n", table_info->name);
+        // Keep whatever was parsed
+    }
+    TRACE_END(parse_start, "columns", "parse columns", table_info->name);
+    free(body);
+
+    // Share the definition with identical tables loaded before
+    if (!intern_table_schema(index, table_info)) {
+        return false;
+    }
+    table_info->columns_loaded = true;
+    index->modified = true;
+    return true;
+}
+
+bool load_table_columns(SqlIndex *index, TableInfo *table_info, const char *sql_filename) {
+    if (table_info->columns_loaded) {
+        return true;
+    }
+    FILE *fp = open_sql_input(sql_filename, index);
+    if (!fp) {
+        perror("load_table_columns: Error opening file");
+        return false;
+    }
+    bool ok = load_columns_from_file(index, table_info, fp);
+    fclose(fp);
+    return ok;
+}
+
+bool load_all_table_columns(SqlIndex *index, const char *sql_filename) {
+    FILE *fp = NULL;
+    bool ok = true;
+    for (int i = 0; i < index->count && ok; ++i) {
+        TableInfo *table_info = index->entries[i].table_info;
+        if (!table_info || table_info->columns_loaded) {
+            continue;
+        }
+        if (!fp && !(fp = open_sql_input(sql_filename, index))) {
+            perror("load_all_table_columns: Error opening file");
+            return false;
         }
-        if (p >= end_ptr) break;
+        ok = load_columns_from_file(index, table_info, fp);
+    }
+    if (fp) fclose(fp);
+    return ok;
+}
 
-        const char *line_start = p;
-        const char *line_end = NULL;
-        int paren_depth = 0;
+TableInfo *find_table_info(const SqlIndex *index, const char *table_name) {
+    for (int i = 0; i < index->count; ++i) {
+        if (index->entries[i].table_info && strcmp(index->entries[i].name, table_name) == 0) {
+            return index->entries[i].table_info;
+        }
+    }
+    return NULL;
+}
 
-        // Find the end of the current definition (the next comma at parenthesis depth 0)
-        const char *scanner = p;
-        while (scanner < end_ptr) {
-            if (*scanner == '(') paren_depth++;
-            else if (*scanner == ')') paren_depth--;
-            else if (*scanner == ',' && paren_depth == 0) {
-                line_end = scanner;
-                break;
-            }
-            scanner++;
-        }
-        if (!line_end) {
-            // Could be the last definition before the closing ')' of the table
-            line_end = end_ptr -1; // Go to the char before the final ')'
-            while(line_end > line_start && isspace((unsigned char)*line_end)) line_end--;
-            line_end++; // point after the last char of the definition
-        }
-
-
-        // Copy the definition to a mutable buffer for strtok
-        char def[2048];
-        size_t len = line_end - line_start;
-        if (len >= sizeof(def)) len = sizeof(def) - 1;
-        strncpy(def, line_start, len);
-        def[len] = '\0';
-        
-        // Create a copy for checking the first word, as strtok modifies it
-        char def_copy[2048];
-        strncpy(def_copy, def, sizeof(def_copy));
-
-        char *first_word = strtok(def_copy, " \t\n\r");
-        if (!first_word) {
-            p = line_end + 1;
+const char *unqualified_name(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot ? dot + 1 : name;
+}
+
+void print_table_list(const SqlIndex *index) {
+    printf("%-10s %-14s %-10s %s\n", "Line", "DDL Offset", "DDL Bytes", "Name");
+    printf("--------------------------------------------------\n");
+    for (int i = 0; i < index->count; ++i) {
+        const TableInfo *table_info = index->entries[i].table_info;
+        if (!table_info) {
             continue;
         }
+        // Offsets of multi-part dumps are shown within the part
+        off_t part_offset = index->parts.count > 0 ? index->parts.parts[index->entries[i].file_id].offset : 0;
+        printf("%-10" PRIu64 " %-14jd %-10jd %s", entry_part_line(index, &index->entries[i], table_info->line_number),
+               (intmax_t)(table_info->ddl_offset - part_offset),
+               (intmax_t)(table_info->ddl_end_offset - table_info->ddl_offset), table_info->name);
+        print_entry_part(index, &index->entries[i]);
+    }
+}
 
-        if (strcasecmp(first_word, "PRIMARY") == 0 || strcasecmp(first_word, "UNIQUE") == 0) {
-            // It's a table-level constraint like PRIMARY KEY (col1, col2)
-            char *key_type = first_word;
-            char *cols_part = strchr(def, '(');
-            if (cols_part) {
-                char *cols_end = strrchr(cols_part, ')');
-                if (cols_end) *cols_end = '\0';
-                
-                char *col_name = strtok(cols_part + 1, ",` ");
-                while (col_name) {
-                    if (strlen(col_name) > 0) {
-                        for (int i = 0; i < table_info->column_count; i++) {
-                            if (strcmp(table_info->columns[i].name, col_name) == 0) {
-                                if (strcasecmp(key_type, "PRIMARY") == 0) {
-                                    table_info->columns[i].is_primary_key = true;
-                                }
-                                // Could handle UNIQUE here as well
-                                break;
-                            }
-                        }
-                    }
-                    col_name = strtok(NULL, ",` ");
-                }
+// --- Multi-Part Input ---
+
+// One part indexed by index_input_parts
+typedef struct {
+    const InputPart *part;
+    bool assume_mysqldump;
+    SqlIndex index;
+    bool ok;
+} PartScan;
+
+bool index_input_parts(SqlIndex *index, const InputParts *input, int threads, bool assume_mysqldump) {
+    memset(index, 0, sizeof(*index));
+    PartScan *scans = mem_calloc(MEM_INDEX, input->count > 0 ? (size_t)input->count : 1, sizeof(PartScan));
+    PartScan **order = mem_malloc(MEM_INDEX, (input->count > 0 ? (size_t)input->count : 1) * sizeof(PartScan *));
+    if (!scans || !order) {
+        perror("Failed to allocate part scans");
+        free(scans);
+        free(order);
+        return false;
+    }
+    for (int i = 0; i < input->count; ++i) {
+        scans[i].part = &input->parts[i];
+        scans[i].assume_mysqldump = assume_mysqldump;
+        order[i] = &scans[i];
+    }
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    WorkPool pool;
+    bool ok = work_pool_start(&pool, threads < input->count ? threads : input->count);
+    if (ok) {
+        // Workers run their newest task first, so the largest parts are submitted last
+        qsort(order, (size_t)input->count, sizeof(PartScan *), compare_part_size);
+        for (int i = 0; i < input->count; ++i) {
+            if (!work_pool_submit(&pool, scan_part_task, order[i])) {
+                ok = false;
             }
-        } else if (strcasecmp(first_word, "CONSTRAINT") != 0 && strcasecmp(first_word, "KEY") != 0 && strcasecmp(first_word, "FOREIGN") != 0) {
-            // It's a column definition
-            char *col_name = NULL, *col_type = NULL, *default_value = NULL;
-            bool is_pk = false, is_nn = false, is_ai = false;
-
-            // Use the original `def` buffer for parsing the column
-            char *token = strtok(def, " \t\n\r");
-            if (token) {
-                // First token is the name
-                if (token[0] == '`') {
-                    col_name = token + 1;
-                    char *end_tick = strchr(col_name, '`');
-                    if (end_tick) *end_tick = '\0';
-                } else {
-                    col_name = token;
-                }
+        }
+        work_pool_stop(&pool);
+    }
 
-                // Second token is the type
-                token = strtok(NULL, " \t\n\r");
-                if (token) {
-                    // The type might contain spaces or parentheses, e.g., "VARCHAR(255)", "ENUM('M', 'F')"
-                    // We need to reconstruct it carefully.
-                    char type_buffer[256];
-                    strncpy(type_buffer, token, sizeof(type_buffer) - 1);
-                    type_buffer[sizeof(type_buffer) - 1] = '\0';
-
-                    int paren_depth = 0;
-                    for (char *c = type_buffer; *c; c++) {
-                        if (*c == '(') paren_depth++;
-                        else if (*c == ')') paren_depth--;
-                    }
+    // Concatenate the part indexes in input order
+    for (int i = 0; i < input->count; ++i) {
+        if (ok && !scans[i].ok) {
+            fprintf(stderr, "Error processing SQL file '%s'.\n", input->parts[i].path);
+            ok = false;
+        }
+        ok = ok && merge_part_index(index, &scans[i].index, i, &input->parts[i]);
+        cleanup_index(&scans[i].index);
+    }
+    free(scans);
+    free(order);
+    ok = ok && copy_input_parts(&index->parts, input);
+    if (!ok) {
+        cleanup_index(index);
+    }
+    return ok;
+}
 
-                    while (paren_depth > 0 && (token = strtok(NULL, " \t\n\r,"))) {
-                        strncat(type_buffer, " ", sizeof(type_buffer) - strlen(type_buffer) - 1);
-                        strncat(type_buffer, token, sizeof(type_buffer) - strlen(type_buffer) - 1);
-                        for (char *c = (char*)token; *c; c++) {
-                            if (*c == '(') paren_depth++;
-                            else if (*c == ')') paren_depth--;
-                        }
-                    }
-                    col_type = type_buffer;
-                }
+void assign_entry_parts(SqlIndex *index) {
+    for (int i = 0; i < index->count && index->parts.count > 0; ++i) {
+        IndexEntry *entry = &index->entries[i];
+        // A statement may start on a line that continues into the next part
+        entry->file_id = entry->table_info && entry->table_info->ddl_offset >= 0
+                             ? find_input_part(&index->parts, entry->table_info->ddl_offset)
+                             : find_input_part_by_line(&index->parts, entry->line_number);
+    }
+}
 
+// --- Checkpoints ---
+
+// Checkpoint state file, one "KEY:value" per line:
+//   CHECKPOINT:<version>
+//   FILE_SIZE, FILE_MTIME       identify the SQL file the checkpoint belongs to
+//   OFFSET, LINE, LAST_NEWLINE  scan position (global_offset, current_line, last_newline_offset)
+//   STATE, AT_LINE_START, ASSUME_MYSQLDUMP, DUMP_LINE:<kind>,<tail hex>
+//   ENTRIES                     entries in <checkpoint>.index, checked on resume
+//   SHA256_STATE, SHA256_BITLEN, SHA256_DATA   the SHA256_CTX of bytes [0, OFFSET)
+// Both files are written under a temporary name and renamed into place; the
+// partial index goes first, so a state file never refers to missing entries.
+#define CHECKPOINT_FORMAT_VERSION 1
+
+static char *checkpoint_index_filename(const char *checkpoint_filename) {
+    char *name = mem_malloc(MEM_OTHER, strlen(checkpoint_filename) + 7); // + ".index" + null terminator
+    if (!name) {
+        perror("Failed to allocate checkpoint filename");
+        return NULL;
+    }
+    sprintf(name, "%s.index", checkpoint_filename);
+    return name;
+}
 
-                // Parse remaining attributes
-                while ((token = strtok(NULL, " \t\n\r,"))) {
-                    if (strcasecmp(token, "NOT") == 0) {
-                        char* next = strtok(NULL, " \t\n\r,");
-                        if (next && strcasecmp(next, "NULL") == 0) is_nn = true;
-                    } else if (strcasecmp(token, "AUTO_INCREMENT") == 0) {
-                        is_ai = true;
-                    } else if (strcasecmp(token, "PRIMARY") == 0) {
-                         char* next = strtok(NULL, " \t\n\r,");
-                        if (next && strcasecmp(next, "KEY") == 0) is_pk = true;
-                    } else if (strcasecmp(token, "DEFAULT") == 0) {
-                        default_value = strtok(NULL, " \t\n\r,");
-                    }
-                }
+static bool write_checkpoint(const ParsingContext *ctx) {
+    struct stat st;
+    if (fstat(fileno(ctx->file), &st) != 0) {
+        perror("Error reading SQL file status for checkpoint");
+        return false;
+    }
+
+    char *index_name = checkpoint_index_filename(ctx->checkpoint_filename);
+    char *tmp_name = index_name ? mem_malloc(MEM_OTHER, strlen(index_name) + 5) : NULL; // + ".tmp"
+    if (!tmp_name) {
+        free(index_name);
+        return false;
+    }
+    sprintf(tmp_name, "%s.tmp", index_name);
+    bool ok = write_index_to_file(&ctx->index, tmp_name, NULL) && rename(tmp_name, index_name) == 0;
+    if (!ok) {
+        perror("Error saving checkpoint index");
+        remove(tmp_name);
+        free(tmp_name);
+        free(index_name);
+        return false;
+    }
+    free(index_name);
+
+    sprintf(tmp_name, "%s.tmp", ctx->checkpoint_filename);
+    FILE *fp = fopen(tmp_name, "w");
+    if (!fp) {
+        perror("Error opening checkpoint file for writing");
+        free(tmp_name);
+        return false;
+    }
+    fprintf(fp, "CHECKPOINT:%d\n", CHECKPOINT_FORMAT_VERSION);
+    fprintf(fp, "FILE_SIZE:%jd\n", (intmax_t)st.st_size);
+    fprintf(fp, "FILE_MTIME:%jd\n", (intmax_t)st.st_mtime);
+    fprintf(fp, "OFFSET:%jd\n", (intmax_t)ctx->global_offset);
+    fprintf(fp, "LINE:%" PRIu64 "\n", ctx->current_line);
+    fprintf(fp, "LAST_NEWLINE:%jd\n", (intmax_t)ctx->last_newline_offset);
+    fprintf(fp, "STATE:%d\n", (int)ctx->state);
+    fprintf(fp, "AT_LINE_START:%d\n", ctx->at_line_start ? 1 : 0);
+    fprintf(fp, "ASSUME_MYSQLDUMP:%d\n", ctx->assume_mysqldump ? 1 : 0);
+    fprintf(fp, "DUMP_LINE:%d,", (int)ctx->dump_line_kind);
+    for (int i = 0; i < ctx->line_tail_len; i++) {
+        fprintf(fp, "%02x", (unsigned char)ctx->line_tail[i]);
+    }
+    fprintf(fp, "\nENTRIES:%d\n", ctx->index.count);
+    fprintf(fp, "SHA256_STATE:");
+    for (int i = 0; i < 8; i++) {
+        fprintf(fp, "%08x", ctx->sha.state[i]);
+    }
+    fprintf(fp, "\nSHA256_BITLEN:%llu\n", ctx->sha.bitlen);
+    fprintf(fp, "SHA256_DATA:");
+    for (WORD i = 0; i < ctx->sha.datalen; i++) {
+        fprintf(fp, "%02x", ctx->sha.data[i]);
+    }
+    fputc('\n', fp);
+
+    ok = !ferror(fp);
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(tmp_name, ctx->checkpoint_filename) != 0) {
+        perror("Error saving checkpoint");
+        remove(tmp_name);
+        free(tmp_name);
+        return false;
+    }
+    free(tmp_name);
+    DEBUG_PRINT("Checkpoint saved at offset %jd (line %" PRIu64 ", %d entries)",
+                (intmax_t)ctx->global_offset, ctx->current_line, ctx->index.count);
+    return true;
+}
+
+// Decodes up to max_len bytes of hex. Returns the byte count, or -1 on bad input.
+static int decode_hex(const char *hex, unsigned char *out, int max_len) {
+    int len = 0;
+    unsigned int byte;
+    while (hex[0] && hex[1]) {
+        if (len >= max_len || sscanf(hex, "%2x", &byte) != 1) {
+            return -1;
+        }
+        out[len++] = (unsigned char)byte;
+        hex += 2;
+    }
+    return hex[0] ? -1 : len;
+}
+
+// Fills the checkpointed fields of *state. Returns false if a field is missing or malformed.
+static bool read_checkpoint_state(FILE *fp, ParsingContext *state, off_t *file_size, int64_t *file_mtime, int *entry_count) {
+    char line[256];
+    intmax_t number;
+    int version = 0;
+    int found = 0;
+    int value;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *colon = strchr(line, ':');
+        if (!colon) {
+            continue;
+        }
+        *colon = '\0';
+        const char *key = line;
+        const char *val = colon + 1;
+
+        if (strcmp(key, "CHECKPOINT") == 0) {
+            version = atoi(val);
+        } else if (strcmp(key, "FILE_SIZE") == 0 && sscanf(val, "%jd", &number) == 1) {
+            *file_size = (off_t)number;
+            found++;
+        } else if (strcmp(key, "FILE_MTIME") == 0 && sscanf(val, "%jd", &number) == 1) {
+            *file_mtime = (int64_t)number;
+            found++;
+        } else if (strcmp(key, "OFFSET") == 0 && sscanf(val, "%jd", &number) == 1) {
+            state->global_offset = (off_t)number;
+            found++;
+        } else if (strcmp(key, "LINE") == 0 && sscanf(val, "%" SCNu64, &state->current_line) == 1) {
+            found++;
+        } else if (strcmp(key, "LAST_NEWLINE") == 0 && sscanf(val, "%jd", &number) == 1) {
+            state->last_newline_offset = (off_t)number;
+            found++;
+        } else if (strcmp(key, "STATE") == 0 && sscanf(val, "%d", &value) == 1 &&
+                   value >= STATE_CODE && value <= STATE_BACKTICK_IDENTIFIER) {
+            state->state = (ParserState)value;
+            found++;
+        } else if (strcmp(key, "AT_LINE_START") == 0) {
+            state->at_line_start = atoi(val) != 0;
+            found++;
+        } else if (strcmp(key, "ASSUME_MYSQLDUMP") == 0) {
+            state->assume_mysqldump = atoi(val) != 0;
+            found++;
+        } else if (strcmp(key, "DUMP_LINE") == 0 && sscanf(val, "%d", &value) == 1 &&
+                   value >= DUMP_LINE_NONE && value <= DUMP_LINE_COMMENT) {
+            const char *comma = strchr(val, ',');
+            state->dump_line_kind = (DumpLineKind)value;
+            state->line_tail_len = comma ? decode_hex(comma + 1, (unsigned char *)state->line_tail, (int)sizeof(state->line_tail)) : -1;
+            if (state->line_tail_len >= 0) {
+                found++;
             }
-            
-            if (col_name && col_type) {
-                if (!add_column_to_table(table_info, col_name, col_type, is_pk, is_nn, is_ai, default_value)) {
-                    fprintf(stderr, "Error adding column %s to table %s\n", col_name, table_info->name);
-                    success = false;
+        } else if (strcmp(key, "ENTRIES") == 0 && sscanf(val, "%d", entry_count) == 1) {
+            found++;
+        } else if (strcmp(key, "SHA256_STATE") == 0 && strlen(val) == 64) {
+            for (int i = 0; i < 8; i++) {
+                if (sscanf(val + i * 8, "%8x", &state->sha.state[i]) != 1) {
+                    return false;
                 }
             }
+            found++;
+        } else if (strcmp(key, "SHA256_BITLEN") == 0 && sscanf(val, "%llu", &state->sha.bitlen) == 1) {
+            found++;
+        } else if (strcmp(key, "SHA256_DATA") == 0) {
+            int len = decode_hex(val, state->sha.data, (int)sizeof(state->sha.data) - 1);
+            if (len < 0) {
+                return false;
+            }
+            state->sha.datalen = (WORD)len;
+            found++;
         }
-        
-        p = line_end + 1;
     }
-    return success;
+    return version == CHECKPOINT_FORMAT_VERSION && found == 13;
 }
 
-static const char* find_next_token(const char *ptr, const char *end) {
-    // Skip whitespace
-    while (ptr < end && isspace((unsigned char)*ptr)) {
-        ptr++;
+bool resume_from_checkpoint(ParsingContext *ctx, const char *checkpoint_filename) {
+    FILE *fp = fopen(checkpoint_filename, "r");
+    if (!fp) {
+        return false; // No checkpoint
     }
-    return ptr < end ? ptr : NULL;
+
+    ParsingContext state = *ctx;
+    off_t file_size = -1;
+    int64_t file_mtime = 0;
+    int entry_count = -1;
+    sha256_init(&state.sha);
+    bool ok = read_checkpoint_state(fp, &state, &file_size, &file_mtime, &entry_count);
+    fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "Warning: Checkpoint '%s' is incomplete or from another version. Starting over.\n", checkpoint_filename);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fileno(ctx->file), &st) != 0 || st.st_size != file_size || (int64_t)st.st_mtime != file_mtime ||
+        state.global_offset < 0 || state.global_offset > file_size ||
+        (uint64_t)state.global_offset * 8 != state.sha.bitlen + state.sha.datalen * 8) {
+        fprintf(stderr, "Warning: Checkpoint '%s' does not match the SQL file. Starting over.\n", checkpoint_filename);
+        return false;
+    }
+
+    char *index_name = checkpoint_index_filename(checkpoint_filename);
+    if (!index_name) {
+        return false;
+    }
+    ok = read_index_from_file(&state.index, index_name);
+    free(index_name);
+    if (!ok || state.index.count != entry_count) {
+        fprintf(stderr, "Warning: Checkpoint '%s' has an unreadable or inconsistent index. Starting over.\n", checkpoint_filename);
+        if (ok) cleanup_index(&state.index);
+        return false;
+    }
+
+    if (fseeko(ctx->file, state.global_offset, SEEK_SET) != 0) {
+        perror("Error seeking to checkpoint offset");
+        cleanup_index(&state.index);
+        return false;
+    }
+
+    // Only the requested fast path survives; it may have been disabled since
+    state.assume_mysqldump = state.assume_mysqldump && ctx->assume_mysqldump;
+    state.hash_input = true;
+    cleanup_index(&ctx->index);
+    *ctx = state;
+    fprintf(stderr, "Resuming from checkpoint at offset %jd (line %" PRIu64 ", %d entries).\n",
+            (intmax_t)ctx->global_offset, ctx->current_line, ctx->index.count);
+    return true;
 }
 
-static size_t get_token_length(const char *token_start) {
-    const char *ptr = token_start;
-    while (*ptr && !isspace((unsigned char)*ptr) && *ptr != ',' && *ptr != '(') {
-        ptr++;
+void remove_checkpoint(const char *checkpoint_filename) {
+    char *index_name = checkpoint_index_filename(checkpoint_filename);
+    remove(checkpoint_filename);
+    if (index_name) {
+        remove(index_name);
+        free(index_name);
     }
-    return ptr - token_start;
 }
 
 // --- New Function: Get First Row Sample ---
@@ -957,18 +3179,18 @@ static size_t get_token_length(const char *token_start) {
 // Returns a dynamically allocated string with the sample (up to 300 chars or "BLOB"),
 // or NULL on error or if not found.
 // Caller must free the returned string.
-char* get_first_row_sample(const char *filename, long start_offset, const char *table_name) {
+char* get_first_row_sample(const SqlIndex *index, const char *filename, off_t start_offset, const char *table_name) {
     if (start_offset < 0 || !filename || !table_name) {
         return NULL;
     }
 
-    FILE *fp = fopen(filename, "rb");
+    FILE *fp = open_sql_input(filename, index);
     if (!fp) {
         perror("get_first_row_sample: Error opening file");
         return NULL;
     }
 
-    if (fseek(fp, start_offset, SEEK_SET) != 0) {
+    if (fseeko(fp, start_offset, SEEK_SET) != 0) {
         perror("get_first_row_sample: Error seeking in file");
         fclose(fp);
         return NULL;
@@ -986,7 +3208,7 @@ char* get_first_row_sample(const char *filename, long start_offset, const char *
     size_t bytes_read;
     char *found_pattern = NULL;
     size_t found_pattern_len = 0;
-    long current_offset = start_offset;
+    off_t current_offset = start_offset;
     char *sample = NULL;
 
     // Read chunks until INSERT is found or EOF
@@ -1053,7 +3275,7 @@ char* get_first_row_sample(const char *filename, long start_offset, const char *
 
         if (found_pattern) break; // Exit outer loop if found
 
-        current_offset += bytes_read;
+        current_offset += (off_t)bytes_read;
         // Need logic to handle patterns split across buffer boundaries (more complex)
     }
 
@@ -1093,10 +3315,10 @@ char* get_first_row_sample(const char *filename, long start_offset, const char *
             size_t row_len = row_end - row_start;
             // Check for _binary prefix (case-insensitive? Assuming case-sensitive here)
             if (strncmp(row_start, "_binary ", 8) == 0) {
-                 sample = strdup("BLOB");
+                 sample = mem_strdup(MEM_OTHER, "BLOB");
             } else {
                 size_t sample_len = row_len < 300 ? row_len : 300;
-                sample = malloc(sample_len + 1);
+                sample = mem_malloc(MEM_OTHER, sample_len + 1);
                 if (sample) {
                     strncpy(sample, row_start, sample_len);
                     sample[sample_len] = '\0';
@@ -1111,24 +3333,8 @@ char* get_first_row_sample(const char *filename, long start_offset, const char *
     return sample;
 }
 
-void dump_table_as_json(const SqlIndex *index, const char *table_name, const char *sql_filename) {
-    // Find the table in the index
-    TableInfo *table_info = NULL;
-    for (int i = 0; i < index->count; ++i) {
-        if (strcmp(index->entries[i].type, "TABLE") == 0 && strcmp(index->entries[i].name, table_name) == 0) {
-            table_info = index->entries[i].table_info;
-            break;
-        }
-    }
-
-    if (!table_info) {
-        fprintf(stderr, "Table '%s' not found in index.\n", table_name);
-        return;
-    }
-
-    // Create JSON object
-    cJSON *root = cJSON_CreateObject();
-    cJSON *table = cJSON_AddObjectToObject(root, table_name);
+cJSON *table_definition_to_json(const TableInfo *table_info) {
+    cJSON *table = cJSON_CreateObject();
     cJSON *columns = cJSON_AddArrayToObject(table, "columns");
     for (int i = 0; i < table_info->column_count; ++i) {
         ColumnInfo *col_info = &table_info->columns[i];
@@ -1141,108 +3347,111 @@ void dump_table_as_json(const SqlIndex *index, const char *table_name, const cha
         if (col_info->default_value) {
             cJSON_AddStringToObject(column, "default", col_info->default_value);
         }
+        if (col_info->comment) {
+            cJSON_AddStringToObject(column, "comment", col_info->comment);
+        }
+        const ColumnTypeDesc *desc = &col_info->type_desc;
+        cJSON *type_info = cJSON_AddObjectToObject(column, "type_info");
+        cJSON_AddStringToObject(type_info, "class", type_class_to_string(desc->type_class));
+        if (desc->storage_bytes > 0) cJSON_AddNumberToObject(type_info, "storage_bytes", desc->storage_bytes);
+        if (desc->length >= 0) cJSON_AddNumberToObject(type_info, "length", desc->length);
+        if (desc->precision >= 0) cJSON_AddNumberToObject(type_info, "precision", desc->precision);
+        if (desc->scale >= 0) cJSON_AddNumberToObject(type_info, "scale", desc->scale);
+        if (desc->is_unsigned) cJSON_AddBoolToObject(type_info, "unsigned", true);
+        if (desc->is_zerofill) cJSON_AddBoolToObject(type_info, "zerofill", true);
+        if (desc->charset) cJSON_AddStringToObject(type_info, "charset", desc->charset);
+        if (desc->collation) cJSON_AddStringToObject(type_info, "collation", desc->collation);
+        if (desc->enum_value_count > 0) {
+            cJSON *values = cJSON_AddArrayToObject(type_info, "values");
+            for (int k = 0; k < desc->enum_value_count; ++k) {
+                cJSON_AddItemToArray(values, cJSON_CreateString(desc->enum_values[k]));
+            }
+        }
         cJSON_AddItemToArray(columns, column);
     }
 
-    cJSON *rows = cJSON_AddArrayToObject(table, "rows");
-
-    FILE *fp = fopen(sql_filename, "rb");
-    if (!fp) {
-        perror("dump_table_as_json: Error opening file");
-        cJSON_Delete(root);
-        return;
+    cJSON *keys = cJSON_AddArrayToObject(table, "keys");
+    for (int i = 0; i < table_info->key_count; ++i) {
+        KeyInfo *key_info = &table_info->keys[i];
+        cJSON *key = cJSON_CreateObject();
+        cJSON_AddStringToObject(key, "kind", key_kind_to_string(key_info->kind));
+        if (key_info->name) {
+            cJSON_AddStringToObject(key, "name", key_info->name);
+        }
+        cJSON *key_columns = cJSON_AddArrayToObject(key, "columns");
+        for (int k = 0; k < key_info->column_count; ++k) {
+            cJSON_AddItemToArray(key_columns, cJSON_CreateString(key_info->columns[k]));
+        }
+        if (key_info->kind == KEY_FOREIGN && key_info->ref_table) {
+            cJSON_AddStringToObject(key, "ref_table", key_info->ref_table);
+            cJSON *ref_columns = cJSON_AddArrayToObject(key, "ref_columns");
+            for (int k = 0; k < key_info->ref_column_count; ++k) {
+                cJSON_AddItemToArray(ref_columns, cJSON_CreateString(key_info->ref_columns[k]));
+            }
+            if (key_info->on_delete) cJSON_AddStringToObject(key, "on_delete", key_info->on_delete);
+            if (key_info->on_update) cJSON_AddStringToObject(key, "on_update", key_info->on_update);
+        }
+        cJSON_AddItemToArray(keys, key);
     }
 
-    fseek(fp, table_info->end_offset, SEEK_SET);
+    return table;
+}
 
-    char *buffer = malloc(CHUNK_SIZE + 1);
-    if (!buffer) {
-        perror("Failed to allocate buffer for JSON dump");
-        fclose(fp);
-        cJSON_Delete(root);
-        return;
+static void scan_part_task(void *arg) {
+    PartScan *scan = arg;
+    ParsingContext ctx = {0};
+    if (initialize_context(&ctx, scan->part->path)) {
+        ctx.assume_mysqldump = scan->assume_mysqldump;
+        scan->ok = process_sql_file(&ctx);
+        scan->index = ctx.index;
+        ctx.index = (SqlIndex){0};
     }
+    cleanup_context(&ctx);
+}
 
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, CHUNK_SIZE, fp)) > 0) {
-        buffer[bytes_read] = '\0';
-        char *p = buffer;
-        while ((p = strcasestr(p, "INSERT INTO"))) {
-            // Basic check for correct table name
-            char *name_start = p + 11;
-            while (isspace(*name_start) || *name_start == '`') name_start++;
-            if (strncmp(name_start, table_name, strlen(table_name)) != 0) {
-                p++;
-                continue;
-            }
-
-            char *values = strcasestr(p, "VALUES");
-            if (!values) break;
-
-            p = values + 6;
-            // Find the end of the INSERT statement
-            char *stmt_end = strchr(p, ';');
-            if (!stmt_end) {
-                // If no semicolon, assume it ends at the end of the buffer
-                // This is a simplification.
-                stmt_end = p + strlen(p);
-            }
-
-            // Loop through all (...) value sets within this single INSERT statement
-            while ((p = strchr(p, '(')) && p < stmt_end) {
-                p++; // Move past '('
-                cJSON *row_array = cJSON_CreateArray();
-                char *row_end = strchr(p, ')');
-                if (!row_end || row_end > stmt_end) break; // Row is malformed or part of another statement
-
-                char *value_start = p;
-                while (value_start < row_end) {
-                    // Find the end of the current value
-                    char *value_end = value_start;
-                    bool in_string = false;
-                    while (value_end < row_end) {
-                        if (*value_end == '\'') in_string = !in_string;
-                        if (*value_end == ',' && !in_string) break;
-                        value_end++;
-                    }
-
-                    // Extract and clean the value
-                    char value_buffer[256];
-                    size_t len = value_end - value_start;
-                    if (len >= sizeof(value_buffer)) len = sizeof(value_buffer) - 1;
-                    strncpy(value_buffer, value_start, len);
-                    value_buffer[len] = '\0';
-
-                    // Trim quotes and whitespace
-                    char *trimmed_start = value_buffer;
-                    while (isspace(*trimmed_start) || *trimmed_start == '\'') trimmed_start++;
-                    char *trimmed_end = trimmed_start + strlen(trimmed_start) - 1;
-                    while (trimmed_end > trimmed_start && (isspace(*trimmed_end) || *trimmed_end == '\'')) *trimmed_end-- = '\0';
-
-                    // Add to JSON array
-                    char *endptr;
-                    double num = strtod(trimmed_start, &endptr);
-                    if (*endptr == '\0' && strlen(trimmed_start) > 0) {
-                        cJSON_AddItemToArray(row_array, cJSON_CreateNumber(num));
-                    } else {
-                        cJSON_AddItemToArray(row_array, cJSON_CreateString(trimmed_start));
-                    }
+static int compare_part_size(const void *a, const void *b) {
+    off_t sa = (*(PartScan *const *)a)->part->size;
+    off_t sb = (*(PartScan *const *)b)->part->size;
+    return (sa > sb) - (sa < sb);
+}
 
-                    value_start = value_end + 1;
-                }
-                cJSON_AddItemToArray(rows, row_array);
-                p = row_end + 1;
+// Appends the entries of one part's index, moving its offsets and lines
+// to their place in the concatenation
+static bool merge_part_index(SqlIndex *index, const SqlIndex *part_index, int file_id, const InputPart *part) {
+    uint64_t line_base = part->first_line - 1;
+    for (int i = 0; i < part_index->count; ++i) {
+        const IndexEntry *entry = &part_index->entries[i];
+        const TableInfo *src = entry->table_info;
+        if (src) {
+            if (!add_table_entry(index, entry->name, entry->line_number + line_base)) {
+                return false;
             }
-            p = stmt_end + 1; // Continue searching after this statement
+            TableInfo *dst = index->entries[index->count - 1].table_info;
+            dst->end_offset = src->end_offset >= 0 ? src->end_offset + part->offset : -1;
+            dst->ddl_offset = src->ddl_offset >= 0 ? src->ddl_offset + part->offset : -1;
+            dst->ddl_end_offset = src->ddl_end_offset >= 0 ? src->ddl_end_offset + part->offset : -1;
+            dst->body_offset = src->body_offset >= 0 ? src->body_offset + part->offset : -1;
+            dst->body_length = src->body_length;
+        } else if (!add_index_entry(index, entry->type, entry->name, entry->line_number + line_base)) {
+            return false;
         }
+        index->entries[index->count - 1].file_id = file_id;
     }
+    return true;
+}
 
-    free(buffer);
-    fclose(fp);
-
-    char *json_string = cJSON_Print(root);
-    printf("%s\n", json_string);
+// Line within the entry's part for a line of the concatenation
+static uint64_t entry_part_line(const SqlIndex *index, const IndexEntry *entry, uint64_t line) {
+    if (index->parts.count == 0) {
+        return line;
+    }
+    return line - index->parts.parts[entry->file_id].first_line + 1;
+}
 
-    cJSON_Delete(root);
-    free(json_string);
+// Ends a listing line, naming the entry's part for multi-part dumps
+static void print_entry_part(const SqlIndex *index, const IndexEntry *entry) {
+    if (index->parts.count > 0) {
+        printf("  (%s)", index->parts.parts[entry->file_id].path);
+    }
+    putchar('\n');
 }
@@ -4,6 +4,16 @@
 #include <stdio.h>
 #include <stdbool.h> // Include for bool type
 #include <stddef.h> // Include for size_t
+#include <stdint.h> // Include for uint64_t
+#include <sys/types.h> // For off_t (64-bit with _FILE_OFFSET_BITS=64)
+#include "sql_tokenizer.h"
+#include "column_type.h"
+#include "insert_parser.h"
+#include "sha256.h"
+#include "progress.h"
+#include "output_compress.h"
+#include "gzip_input.h"
+#include "input_parts.h"
 
 // --- Global Verbose Flag ---
 extern bool verbose_mode;
@@ -29,6 +39,17 @@ typedef enum {
     STATE_BACKTICK_IDENTIFIER // Backtick-quoted identifier (`...`)
 } ParserState;
 
+// Line kinds recognised by the --assume-mysqldump fast path
+typedef enum {
+    DUMP_LINE_NONE,         // Not inside a skipped line
+    DUMP_LINE_UNKNOWN,      // Not recognised; scanned by the state machine
+    DUMP_LINE_CREATE_TABLE, // Parsed by the state machine
+    DUMP_LINE_STATEMENT,    // One complete statement ending in ';' (USE, SET, LOCK, ...)
+    DUMP_LINE_INSERT,       // INSERT or REPLACE; like DUMP_LINE_STATEMENT unless rows are streamed
+    DUMP_LINE_VERSIONED,    // /*!40101 ... */; conditional comment
+    DUMP_LINE_COMMENT       // --, # or DELIMITER line, or a blank line
+} DumpLineKind;
+
 // --- Data Structures ---
 
 // Structure to hold column information
@@ -38,45 +59,146 @@ typedef struct {
     bool is_primary_key;
     bool is_not_null;
     bool is_auto_increment;
-    char *default_value;
+    char *default_value; // Raw SQL expression, e.g. 'active' or NULL; NULL if absent
+    char *comment;       // Unquoted COMMENT text; NULL if absent
+    ColumnTypeDesc type_desc; // Parsed form of `type` plus charset/collation
 } ColumnInfo;
 
+// Kind of an index or constraint declared in CREATE TABLE
+typedef enum {
+    KEY_PRIMARY,
+    KEY_UNIQUE,
+    KEY_INDEX,
+    KEY_FULLTEXT,
+    KEY_SPATIAL,
+    KEY_FOREIGN
+} KeyKind;
+
+// Structure to hold one index, unique key or foreign key definition
+typedef struct {
+    KeyKind kind;
+    char *name;             // Index or constraint name; NULL if unnamed
+    char **columns;         // Key column names in key order
+    int column_count;
+    // FOREIGN KEY only (NULL/0 otherwise)
+    char *ref_table;        // Referenced table
+    char **ref_columns;     // Referenced columns, parallel to `columns`
+    int ref_column_count;
+    char *on_delete;        // e.g. "CASCADE", "SET NULL"; NULL if unspecified
+    char *on_update;
+} KeyInfo;
+
 // Structure to hold table information with columns
 typedef struct {
     char *name;
     ColumnInfo *columns;
     int column_count;
     int column_capacity;
-    int line_number;
-    long end_offset; // Added: Byte offset after CREATE TABLE definition
+    KeyInfo *keys;          // Secondary indexes, unique and foreign keys
+    int key_count;
+    int key_capacity;
+    int schema_id;          // Shared definition in SqlIndex.schemas; -1 if the arrays are owned
+    int *column_slots;      // Column-name hash: slot -> column ordinal + 1 (0 = empty)
+    int column_slot_count;  // Power of two, or 0 if not built
+    uint64_t line_number;
+    off_t end_offset; // Added: Byte offset after CREATE TABLE definition (the body's ')')
+    off_t ddl_offset;       // Start of the CREATE TABLE statement
+    off_t ddl_end_offset;   // After the statement's ';', past the table options; the DDL spans [ddl_offset, ddl_end_offset)
+    off_t body_offset;      // First byte after the body's '('; -1 if the statement has no body
+    size_t body_length;     // Bytes up to (not including) the closing ')'
+    bool columns_loaded;    // Body parsed into columns/keys; see load_table_columns
 } TableInfo;
 
 // Structure to hold one index entry
 typedef struct {
     char *type; // e.g., "TABLE", "INDEX", "FUNCTION", "PROCEDURE"
     char *name;
-    int line_number;
+    uint64_t line_number;
+    int file_id;            // Part of a multi-part dump the entry is in (see SqlIndex.parts), else 0
     
     // For TABLE entries only
     TableInfo *table_info; // Will be NULL for non-table entries
 } IndexEntry;
 
+// A table definition (columns and keys) shared by every table that declares
+// it identically, e.g. the same table in thousands of tenant databases.
+// Tables sharing a schema point their columns/keys at these arrays.
+typedef struct {
+    uint64_t fingerprint;   // Hash of the column and key definitions
+    ColumnInfo *columns;
+    int column_count;
+    KeyInfo *keys;
+    int key_count;
+    int *column_slots;      // Column-name hash shared with the tables, see TableInfo
+    int column_slot_count;
+    int table_count;        // Number of tables using this definition
+} SchemaDef;
+
 typedef struct {
     char sql_file_sha256[65]; // 64 hex chars + null terminator
     IndexEntry *entries;
     int count;
     int capacity;
+    SchemaDef *schemas;     // Deduplicated table definitions
+    int schema_count;
+    int schema_capacity;
+    int *schema_slots;      // Open-addressing table: fingerprint -> schema id + 1 (0 = empty)
+    size_t schema_slot_count;
+    bool modified;          // Columns were loaded since the index was read, so it is worth rewriting
+    GzipAccessIndex gzip;   // Access points into a gzip dump; span is 0 for plain files
+    InputParts parts;       // Files of a multi-part dump; offsets and lines refer to their concatenation
 } SqlIndex;
 
+// The INSERT statement whose VALUES list is being streamed to ScanHooks
+typedef struct {
+    bool active;
+    char *table_name;           // Unquoted target table
+    off_t start_offset;         // Offset of the INSERT keyword
+    off_t values_offset;        // Offset after the VALUES keyword
+    off_t end_offset;           // Offset after the VALUES list (after ';' if it ends there)
+    bool complete;              // The VALUES list ended with ';' (no trailing clause, not malformed)
+    uint64_t row_count;         // Rows seen so far in this statement
+    off_t row_offset;           // Offset of the current row's '('
+    StrSpan row_text;           // The current row as written, "(...)"; points into the read buffer
+    size_t retry_len;           // Bytes to buffer before re-parsing an incomplete row
+    SqlRow row;                 // Values of the current row; spans point into the read buffer
+} InsertState;
+
+// Optional callbacks invoked by process_sql_file. Any hook may return false
+// to stop the scan early; process_sql_file still returns true then.
+typedef struct {
+    void *data;                 // Passed to every hook
+    bool parse_columns;         // Parse each CREATE TABLE body while it is buffered
+    bool raw_rows;              // Only find each row's end; on_row gets row_text and no values
+    bool (*on_table)(void *data, int entry, TableInfo *table_info);
+    bool (*on_row)(void *data, const InsertState *insert, const SqlRow *row);
+    bool (*on_insert_end)(void *data, const InsertState *insert);
+} ScanHooks;
+
 typedef struct {
     FILE *file;                 // Renamed from fp
     char *buffer;
     size_t buffer_size;         // Renamed from buffer_alloc_size
     size_t buffer_data_len;     // Added
-    size_t global_offset;       // Added
-    int current_line;           // Added
-    long last_newline_offset;   // Added
+    off_t global_offset;        // File offset of buffer[0]
+    uint64_t current_line;      // Added
+    off_t last_newline_offset;  // Added
     ParserState state;          // Added
+    bool eof_reached;           // No more data will be appended to the buffer
+    bool assume_mysqldump;      // Only inspect line starts, see process_chunk
+    bool at_line_start;         // buffer[0] starts a line
+    DumpLineKind dump_line_kind; // Line being skipped across chunks, or DUMP_LINE_NONE
+    char line_tail[16];         // Last bytes of the skipped line, without '\r'
+    int line_tail_len;
+    const ScanHooks *hooks;     // NULL when only indexing
+    InsertState insert;
+    bool stop_requested;        // A hook asked to end the scan
+    bool hash_input;            // Hash the scanned bytes into `sha`, see get_scan_sha256
+    bool gzip_input;            // `file` inflates a .sql.gz and records index.gzip
+    SHA256_CTX sha;             // Hash of bytes [0, global_offset)
+    const char *checkpoint_filename; // Where to save checkpoints, NULL to disable
+    off_t checkpoint_interval;  // Bytes scanned between checkpoints
+    ProgressReporter *progress; // NULL for a silent scan
     SqlIndex index;
     bool error_occurred; // Flag to indicate if an error stopped processing
 } ParsingContext;
@@ -85,33 +207,111 @@ typedef struct {
 
 // Initialize the parsing context (opens file, allocates buffer)
 bool initialize_context(ParsingContext *ctx, const char *filename);
+// Same for an already open stream, e.g. fmemopen; the context closes it
+bool initialize_context_stream(ParsingContext *ctx, FILE *file);
 
 // Free resources held by the context (closes file, frees memory)
 void cleanup_context(ParsingContext *ctx);
 
 // Main loop for reading and processing the file
 bool process_sql_file(ParsingContext *ctx);
+// on_table hook that ends a scan of a table's data at the next CREATE TABLE
+bool stop_at_table(void *data, int entry, TableInfo *table_info);
+
+// Writes the SHA256 of the scanned file (65 bytes with the NUL) as computed
+// during process_sql_file. Fails unless hash_input was set and the whole
+// file was scanned.
+bool get_scan_sha256(ParsingContext *ctx, char *hash_buffer);
+
+// --- Checkpoints ---
+// With checkpoint_filename set, process_sql_file saves its position, parser
+// state, hash state and the entries found so far every checkpoint_interval
+// bytes: the state goes to <checkpoint_filename> and the partial index to
+// <checkpoint_filename>.index.
+
+// Restores a freshly initialized context from a checkpoint of the same file
+// so that process_sql_file continues where it stopped. Returns false, with
+// the context untouched, if there is no usable checkpoint.
+bool resume_from_checkpoint(ParsingContext *ctx, const char *checkpoint_filename);
+// Deletes both checkpoint files
+void remove_checkpoint(const char *checkpoint_filename);
+
+// --- Multi-Part Input ---
+// Indexes the parts of an independent input (see InputParts) on `threads`
+// workers (0 = one per CPU), one part per task, into one index with
+// offsets and lines of their concatenation. `input` must be hashed first
+// (hash_input_parts) so that first_line is known; the index keeps a copy.
+bool index_input_parts(SqlIndex *index, const InputParts *input, int threads, bool assume_mysqldump);
+// Sets the file_id of entries found by scanning the concatenation of
+// index->parts as one stream
+void assign_entry_parts(SqlIndex *index);
 
 // Print the indexed results
 void print_results(const SqlIndex *index);
+// Print each distinct table definition with the tables that share it
+void print_schemas(const SqlIndex *index);
+// Print table names with their line and DDL span, without loading columns
+void print_table_list(const SqlIndex *index);
 void cleanup_index(SqlIndex *index); // Function to clean up only the index structure
 bool read_index_from_file(SqlIndex *index, const char *index_filename); // Function to read index from file
+// Same, from an open stream; `index_filename` only names it in messages
+bool read_index_from_stream(SqlIndex *index, FILE *fp, const char *index_filename);
 // If sql_file_sha256 is not NULL, it will be written to the index file.
 bool write_index_to_file(const SqlIndex *index, const char *index_filename, const char *sql_file_sha256);
+// Same, to an open stream; returns false if a write failed
+bool write_index_to_stream(const SqlIndex *index, FILE *fp, const char *sql_file_sha256);
 
 // Function to display interactive table selection and column display
 void display_table_columns_ui(SqlIndex *index);
 
-// Function to extract column information from CREATE TABLE statement
+// Scans [p, end) from *state and returns the position just after the first
+// top-level ';' at or past min_end, or NULL if there is none. Quotes and
+// comments are tracked the same way process_chunk does; *state is left at
+// the returned position (or at end) and *line, if not NULL, advances by the
+// newlines passed.
+const char *find_statement_end(const char *p, const char *end, const char *min_end, ParserState *state, uint64_t *line);
+
+// Function to extract column information from CREATE TABLE statement.
+// [start_ptr, end_ptr) is the table body between the outer parentheses.
 bool parse_table_columns(ParsingContext *ctx, TableInfo *table_info, const char *start_ptr, const char *end_ptr);
+// Frees the columns, keys and column hash a table owns (not a shared schema's)
+void free_table_definition(TableInfo *table_info);
+
+// Columns are parsed on first use from the table's recorded body span.
+// Loads one table's columns (a no-op if already loaded) and shares the
+// result with identical definitions. Sets index->modified.
+bool load_table_columns(SqlIndex *index, TableInfo *table_info, const char *sql_filename);
+// Loads the columns of every table, opening the SQL file once
+bool load_all_table_columns(SqlIndex *index, const char *sql_filename);
+// Returns the table with the given name, or NULL
+TableInfo *find_table_info(const SqlIndex *index, const char *table_name);
+// "db.t" -> "t"
+const char *unqualified_name(const char *name);
+
+// Returns the ordinal of the named column (case-insensitive) in O(1), or -1
+int find_column_index(const TableInfo *table_info, const char *name);
+// Same as find_column_index for a name that is not NUL-terminated
+int find_column_span(const TableInfo *table_info, StrSpan name);
+// Maps the values of an INSERT to the table's columns. [header, header_end)
+// is the statement up to VALUES: with a column list (*map)[i] is the
+// ordinal of the i-th listed column, or -1 if the table has none; without
+// one values map to columns in order. *map grows as needed. Returns the
+// number of values mapped, or -1 on allocation failure.
+int map_insert_columns(const TableInfo *table_info, const char *header, const char *header_end, int **map,
+                       int *capacity);
+
+// Returns the SQL keyword for a key kind, e.g. "UNIQUE" or "FOREIGN"
+const char *key_kind_to_string(KeyKind kind);
 
 // Function to get a sample of the first data row from an INSERT statement
-char* get_first_row_sample(const char *filename, long start_offset, const char *table_name);
+// index (may be NULL) locates the data of compressed and multi-part dumps.
+char* get_first_row_sample(const SqlIndex *index, const char *filename, off_t start_offset, const char *table_name);
 
 // Calculates the SHA256 hash of a file.
 bool calculate_sha256(const char *filename, char *hash_buffer);
 
-#endif // SQL_INDEXER_H
+// Builds {"columns": [...], "keys": [...]} for a table with loaded columns.
+// Caller must cJSON_Delete the result.
+struct cJSON *table_definition_to_json(const TableInfo *table_info);
 
-// Dumps a specific table's data to a JSON file.
-void dump_table_as_json(const SqlIndex *index, const char *table_name, const char *sql_filename);
+#endif // SQL_INDEXER_H
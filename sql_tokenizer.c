@@ -0,0 +1,227 @@
+#include "sql_tokenizer.h"
+#include "mem_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <strings.h> // For strncasecmp
+
+// --- Static Helper Function Declarations ---
+static const char *skip_quoted(const char *p, const char *end, char quote);
+static const char *skip_space_and_comments(SqlTokenizer *tz);
+static bool is_word_char(unsigned char c);
+
+// --- Function Implementations ---
+
+void sql_tokenizer_init(SqlTokenizer *tz, const char *start, const char *end) {
+    tz->pos = start;
+    tz->end = end;
+    tz->truncated = false;
+}
+
+bool sql_next_token(SqlTokenizer *tz, SqlToken *tok) {
+    const char *p = skip_space_and_comments(tz);
+    const char *end = tz->end;
+
+    tok->type = SQL_TOK_END;
+    tok->text.ptr = p;
+    tok->text.len = 0;
+    if (p >= end || tz->truncated) {
+        return false;
+    }
+
+    const char *start = p;
+    unsigned char c = (unsigned char)*p;
+    if (c == '`' || c == '\'' || c == '"') {
+        p = skip_quoted(p + 1, end, (char)c);
+        if (!p) {
+            tz->truncated = true;
+            tz->pos = end;
+            return false;
+        }
+        tok->type = (c == '`') ? SQL_TOK_QUOTED_IDENT : SQL_TOK_STRING;
+    } else if (isdigit(c)) {
+        // Numbers keep their decimal point and exponent: 10.50, 1e-3
+        p++;
+        while (p < end && (isalnum((unsigned char)*p) || *p == '.' || *p == '_' ||
+                           ((*p == '-' || *p == '+') && (p[-1] == 'e' || p[-1] == 'E')))) {
+            p++;
+        }
+        tok->type = SQL_TOK_WORD;
+    } else if (is_word_char(c)) {
+        while (p < end && is_word_char((unsigned char)*p)) p++;
+        tok->type = SQL_TOK_WORD;
+    } else {
+        p++;
+        switch (c) {
+            case '(': tok->type = SQL_TOK_LPAREN; break;
+            case ')': tok->type = SQL_TOK_RPAREN; break;
+            case ',': tok->type = SQL_TOK_COMMA; break;
+            case ';': tok->type = SQL_TOK_SEMICOLON; break;
+            case '.': tok->type = SQL_TOK_DOT; break;
+            default:  tok->type = SQL_TOK_OTHER; break;
+        }
+    }
+
+    tok->text.ptr = start;
+    tok->text.len = (size_t)(p - start);
+    tz->pos = p;
+    return true;
+}
+
+const char *sql_find_closing_paren(const char *p, const char *end) {
+    SqlTokenizer tz;
+    SqlToken tok;
+    int depth = 1;
+
+    sql_tokenizer_init(&tz, p, end);
+    while (sql_next_token(&tz, &tok)) {
+        if (tok.type == SQL_TOK_LPAREN) {
+            depth++;
+        } else if (tok.type == SQL_TOK_RPAREN) {
+            if (--depth == 0) return tok.text.ptr;
+        }
+    }
+    return NULL; // Not balanced within the buffer
+}
+
+size_t sql_count_newlines(const char *p, const char *end, const char **last) {
+    size_t count = 0;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        count++;
+        *last = p++;
+    }
+    return count;
+}
+
+bool sql_span_equals_ci(StrSpan span, const char *keyword) {
+    size_t kw_len = strlen(keyword);
+    return span.len == kw_len && strncasecmp(span.ptr, keyword, kw_len) == 0;
+}
+
+bool sql_token_is_word(const SqlToken *tok, const char *keyword) {
+    return tok->type == SQL_TOK_WORD && sql_span_equals_ci(tok->text, keyword);
+}
+
+bool sql_token_is_identifier(const SqlToken *tok) {
+    return tok->type == SQL_TOK_WORD || tok->type == SQL_TOK_QUOTED_IDENT ||
+           (tok->type == SQL_TOK_STRING && tok->text.ptr[0] == '"');
+}
+
+char *sql_span_strdup(StrSpan span) {
+    char *copy = mem_malloc(MEM_COLUMNS, span.len + 1);
+    if (copy) {
+        memcpy(copy, span.ptr, span.len);
+        copy[span.len] = '\0';
+    }
+    return copy;
+}
+
+char *sql_unquote_identifier(StrSpan span) {
+    if (span.len < 2 || (span.ptr[0] != '`' && span.ptr[0] != '"')) {
+        return sql_span_strdup(span);
+    }
+
+    char quote = span.ptr[0];
+    char *out = mem_malloc(MEM_COLUMNS, span.len - 1);
+    if (!out) return NULL;
+
+    size_t n = 0;
+    const char *p = span.ptr + 1;
+    const char *end = span.ptr + span.len - 1; // Closing quote
+    while (p < end) {
+        if (*p == quote && p + 1 < end && p[1] == quote) p++; // `` -> `
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+char *sql_unquote_string(StrSpan span) {
+    if (span.len < 2 || (span.ptr[0] != '\'' && span.ptr[0] != '"')) {
+        return sql_span_strdup(span);
+    }
+
+    char quote = span.ptr[0];
+    char *out = mem_malloc(MEM_COLUMNS, span.len - 1);
+    if (!out) return NULL;
+
+    size_t n = 0;
+    const char *p = span.ptr + 1;
+    const char *end = span.ptr + span.len - 1; // Closing quote
+    while (p < end) {
+        if (*p == '\\' && p + 1 < end) {
+            p++;
+            switch (*p) {
+                case 'n': out[n++] = '\n'; break;
+                case 'r': out[n++] = '\r'; break;
+                case 't': out[n++] = '\t'; break;
+                case '0': out[n++] = '\0'; break;
+                case 'Z': out[n++] = '\x1a'; break;
+                default:  out[n++] = *p; break; // \\ \' \" and unknown escapes
+            }
+            p++;
+        } else if (*p == quote && p + 1 < end && p[1] == quote) {
+            out[n++] = quote; // '' -> '
+            p += 2;
+        } else {
+            out[n++] = *p++;
+        }
+    }
+    out[n] = '\0';
+    return out;
+}
+
+// --- Static Helper Function Implementations ---
+
+// Returns the position after the closing quote, or NULL if it lies beyond `end`.
+// `p` points just after the opening quote.
+static const char *skip_quoted(const char *p, const char *end, char quote) {
+    while (p < end) {
+        if (*p == '\\' && quote != '`') {
+            p += 2; // Skip escaped character
+            continue;
+        }
+        if (*p == quote) {
+            if (p + 1 < end && p[1] == quote) {
+                p += 2; // Doubled quote stays inside the token
+                continue;
+            }
+            return p + 1;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static const char *skip_space_and_comments(SqlTokenizer *tz) {
+    const char *p = tz->pos;
+    const char *end = tz->end;
+
+    while (p < end) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+        } else if (*p == '#' ||
+                   (*p == '-' && p + 1 < end && p[1] == '-' &&
+                    (p + 2 == end || isspace((unsigned char)p[2])))) {
+            const char *eol = memchr(p, '\n', (size_t)(end - p));
+            p = eol ? eol + 1 : end;
+        } else if (*p == '/' && p + 1 < end && p[1] == '*') {
+            const char *q = p + 2;
+            while (q + 1 < end && !(q[0] == '*' && q[1] == '/')) q++;
+            if (q + 1 >= end) {
+                tz->truncated = true;
+                p = end;
+                break;
+            }
+            p = q + 2;
+        } else {
+            break;
+        }
+    }
+    tz->pos = p;
+    return p;
+}
+
+static bool is_word_char(unsigned char c) {
+    return isalnum(c) || c == '_' || c == '$' || c >= 0x80;
+}
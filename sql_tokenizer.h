@@ -0,0 +1,76 @@
+#ifndef SQL_TOKENIZER_H
+#define SQL_TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// --- String Span ---
+// A non-owning view into a buffer (not NUL-terminated).
+typedef struct {
+    const char *ptr;
+    size_t len;
+} StrSpan;
+
+// --- Token Types ---
+typedef enum {
+    SQL_TOK_END,            // No more tokens (or input truncated, see `truncated`)
+    SQL_TOK_WORD,           // Bare word or number: CREATE, varchar, 10.50, utf8mb4_unicode_ci
+    SQL_TOK_QUOTED_IDENT,   // Backtick-quoted identifier, span includes the backticks
+    SQL_TOK_STRING,         // '...' or "..." literal, span includes the quotes
+    SQL_TOK_LPAREN,
+    SQL_TOK_RPAREN,
+    SQL_TOK_COMMA,
+    SQL_TOK_SEMICOLON,
+    SQL_TOK_DOT,
+    SQL_TOK_OTHER           // Any other single punctuation character
+} SqlTokenType;
+
+typedef struct {
+    SqlTokenType type;
+    StrSpan text;
+} SqlToken;
+
+// Tokenizer state. Plain struct so callers can copy it for lookahead.
+typedef struct {
+    const char *pos;
+    const char *end;
+    bool truncated; // Set when a quoted token or comment runs past `end`
+} SqlTokenizer;
+
+// --- Function Declarations ---
+
+void sql_tokenizer_init(SqlTokenizer *tz, const char *start, const char *end);
+
+// Returns the next token, skipping whitespace and comments.
+// Returns false (and sets tok->type = SQL_TOK_END) at end of input.
+bool sql_next_token(SqlTokenizer *tz, SqlToken *tok);
+
+// Returns a pointer to the ')' matching an already consumed '(' (p points just
+// after it), respecting quotes and comments. Returns NULL if not found before `end`.
+const char *sql_find_closing_paren(const char *p, const char *end);
+
+// Counts the '\n' bytes in [p, end) and points *last at the final one
+// (left unchanged if there is none).
+size_t sql_count_newlines(const char *p, const char *end, const char **last);
+
+// Case-insensitive comparison of a span against a NUL-terminated keyword.
+bool sql_span_equals_ci(StrSpan span, const char *keyword);
+
+// Returns true if the token is a bare word equal to `keyword` (case-insensitive).
+bool sql_token_is_word(const SqlToken *tok, const char *keyword);
+
+// Returns true if the token can name an identifier (bare word or quoted).
+bool sql_token_is_identifier(const SqlToken *tok);
+
+// Allocates a NUL-terminated copy of the span. Caller must free.
+char *sql_span_strdup(StrSpan span);
+
+// Allocates an identifier with surrounding quotes removed and doubled quote
+// characters collapsed. Caller must free.
+char *sql_unquote_identifier(StrSpan span);
+
+// Allocates the contents of a '...' or "..." literal with quotes removed and
+// escape sequences resolved. Caller must free.
+char *sql_unquote_string(StrSpan span);
+
+#endif // SQL_TOKENIZER_H
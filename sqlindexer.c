@@ -0,0 +1,396 @@
+#include "sqlindexer.h"
+#include "sql_indexer.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // For access()
+
+// --- Handle ---
+struct SqlIndexer {
+    char *sql_filename;
+    char *index_filename;
+    unsigned flags;
+    SqlIndex index;
+    bool indexed;               // `index` covers the whole file
+};
+
+// Adapts the internal ScanHooks to the public callbacks for one scan.
+typedef struct {
+    const SqlIndexerCallbacks *callbacks;
+    void *user;
+    const SqlIndex *tables;     // Index used to resolve INSERT targets
+    int only_table;             // Rows of this table only, or -1 for all
+    bool stop_at_next_table;    // Extraction ends at the next CREATE TABLE
+    int last_table;             // Cached result of the previous lookup
+    uint64_t *row_counts;       // Rows seen per table
+    int row_count_capacity;
+    uint64_t orphan_rows;       // Rows of tables without CREATE TABLE
+    bool stopped;               // A callback ended the scan early
+    SqlIndexerValue *values;
+    int value_capacity;
+} ScanAdapter;
+
+// --- Static Helper Function Declarations ---
+static bool load_or_build_index(SqlIndexer *ix);
+static bool run_scan(SqlIndexer *ix, ScanAdapter *adapter, off_t start_offset, uint64_t start_line, SqlIndex *result);
+static int resolve_table(ScanAdapter *adapter, const char *name);
+static void fill_table(const TableInfo *table_info, SqlIndexerTable *out);
+static void fill_column(const ColumnInfo *col, SqlIndexerColumn *out);
+static TableInfo *table_at(const SqlIndexer *ix, int table);
+static bool adapter_on_table(void *data, int entry, TableInfo *table_info);
+static bool adapter_on_row(void *data, const InsertState *insert, const SqlRow *row);
+static bool adapter_on_insert_end(void *data, const InsertState *insert);
+
+// --- Function Implementations ---
+
+SqlIndexer *sqlindexer_open(const char *sql_filename, unsigned flags) {
+    if (access(sql_filename, R_OK) != 0) {
+        perror("sqlindexer_open: Cannot read SQL file");
+        return NULL;
+    }
+
+    SqlIndexer *ix = mem_calloc(MEM_OTHER, 1, sizeof(SqlIndexer));
+    if (!ix) {
+        perror("Failed to allocate indexer handle");
+        return NULL;
+    }
+    ix->flags = flags;
+    ix->sql_filename = mem_strdup(MEM_OTHER, sql_filename);
+    ix->index_filename = mem_malloc(MEM_OTHER, strlen(sql_filename) + 7); // + ".index" + null terminator
+    if (!ix->sql_filename || !ix->index_filename) {
+        perror("Failed to allocate indexer file names");
+        sqlindexer_close(ix);
+        return NULL;
+    }
+    sprintf(ix->index_filename, "%s.index", sql_filename);
+    return ix;
+}
+
+void sqlindexer_close(SqlIndexer *ix) {
+    if (!ix) {
+        return;
+    }
+    cleanup_index(&ix->index);
+    free(ix->sql_filename);
+    free(ix->index_filename);
+    free(ix);
+}
+
+bool sqlindexer_index(SqlIndexer *ix) {
+    return ix->indexed || load_or_build_index(ix);
+}
+
+int sqlindexer_table_count(const SqlIndexer *ix) {
+    return ix->index.count;
+}
+
+int sqlindexer_find_table(const SqlIndexer *ix, const char *name) {
+    for (int i = 0; i < ix->index.count; ++i) {
+        if (ix->index.entries[i].table_info && strcmp(ix->index.entries[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool sqlindexer_get_table(const SqlIndexer *ix, int table, SqlIndexerTable *out) {
+    const TableInfo *table_info = table_at(ix, table);
+    if (!table_info) {
+        return false;
+    }
+    fill_table(table_info, out);
+    return true;
+}
+
+int sqlindexer_column_count(SqlIndexer *ix, int table) {
+    TableInfo *table_info = table_at(ix, table);
+    if (!table_info || !load_table_columns(&ix->index, table_info, ix->sql_filename)) {
+        return -1;
+    }
+    return table_info->column_count;
+}
+
+int sqlindexer_find_column(SqlIndexer *ix, int table, const char *name) {
+    TableInfo *table_info = table_at(ix, table);
+    if (!table_info || !load_table_columns(&ix->index, table_info, ix->sql_filename)) {
+        return -1;
+    }
+    return find_column_index(table_info, name);
+}
+
+bool sqlindexer_get_column(SqlIndexer *ix, int table, int column, SqlIndexerColumn *out) {
+    TableInfo *table_info = table_at(ix, table);
+    if (!table_info || !load_table_columns(&ix->index, table_info, ix->sql_filename) ||
+        column < 0 || column >= table_info->column_count) {
+        return false;
+    }
+    fill_column(&table_info->columns[column], out);
+    return true;
+}
+
+bool sqlindexer_scan(SqlIndexer *ix, const SqlIndexerCallbacks *callbacks, void *user) {
+    ScanAdapter adapter = {0};
+    adapter.callbacks = callbacks;
+    adapter.user = user;
+    adapter.only_table = -1;
+    adapter.last_table = -1;
+
+    SqlIndex result = {0};
+    bool ok = run_scan(ix, &adapter, 0, 1, &result);
+    // Keep the index built along the way if it covers the whole file
+    if (ok && !adapter.stopped && !ix->indexed) {
+        cleanup_index(&ix->index);
+        ix->index = result;
+        ix->indexed = true;
+    } else {
+        cleanup_index(&result);
+    }
+    return ok;
+}
+
+bool sqlindexer_extract(SqlIndexer *ix, int table, const SqlIndexerCallbacks *callbacks, void *user) {
+    const TableInfo *table_info = table_at(ix, table);
+    if (!table_info) {
+        fprintf(stderr, "sqlindexer_extract: No table %d\n", table);
+        return false;
+    }
+
+    ScanAdapter adapter = {0};
+    adapter.callbacks = callbacks;
+    adapter.user = user;
+    adapter.tables = &ix->index;
+    adapter.only_table = table;
+    adapter.stop_at_next_table = true;
+    adapter.last_table = -1;
+
+    SqlIndex result = {0};
+    bool ok = run_scan(ix, &adapter, table_info->end_offset, table_info->line_number, &result);
+    cleanup_index(&result);
+    return ok;
+}
+
+void sqlindexer_set_verbose(bool verbose) {
+    verbose_mode = verbose;
+}
+
+// --- Static Helper Function Implementations ---
+
+// Same policy as the command line tool: reuse the index file when its SHA256
+// matches, otherwise scan and save a new one.
+static bool load_or_build_index(SqlIndexer *ix) {
+    char current_sha[65] = {0};
+    bool use_file = !(ix->flags & SQLINDEXER_NO_INDEX_FILE);
+
+    if (use_file && access(ix->index_filename, F_OK) == 0 && read_index_from_file(&ix->index, ix->index_filename)) {
+        if (ix->index.sql_file_sha256[0] != '\0' && calculate_sha256(ix->sql_filename, current_sha) &&
+            strcmp(ix->index.sql_file_sha256, current_sha) == 0) {
+            ix->indexed = true;
+            return true;
+        }
+        DEBUG_PRINT("Index file '%s' is stale. Re-parsing.", ix->index_filename);
+        cleanup_index(&ix->index);
+    }
+
+    ParsingContext ctx = {0};
+    if (!initialize_context(&ctx, ix->sql_filename)) {
+        return false;
+    }
+    ctx.assume_mysqldump = (ix->flags & SQLINDEXER_ASSUME_MYSQLDUMP) != 0;
+    ctx.hash_input = use_file;
+    bool ok = process_sql_file(&ctx);
+    if (ok) {
+        if (use_file) {
+            get_scan_sha256(&ctx, current_sha);
+        }
+        ix->index = ctx.index;
+        ctx.index = (SqlIndex){0}; // Prevent double free
+        ix->indexed = true;
+    }
+    cleanup_context(&ctx);
+
+    if (ok && use_file) {
+        if (current_sha[0] == '\0') {
+            calculate_sha256(ix->sql_filename, current_sha);
+        }
+        if (!write_index_to_file(&ix->index, ix->index_filename, current_sha)) {
+            fprintf(stderr, "Warning: Could not write index file '%s'.\n", ix->index_filename);
+        }
+    }
+    return ok;
+}
+
+// Scans the file from start_offset with the adapter's hooks. The tables
+// found are returned in *result, which the caller must clean up; it stays
+// empty if a callback stopped the scan.
+static bool run_scan(SqlIndexer *ix, ScanAdapter *adapter, off_t start_offset, uint64_t start_line, SqlIndex *result) {
+    ParsingContext ctx = {0};
+    if (!initialize_context(&ctx, ix->sql_filename)) {
+        return false;
+    }
+    if (start_offset > 0) {
+        if (fseeko(ctx.file, start_offset, SEEK_SET) != 0) {
+            perror("Error seeking in SQL file");
+            cleanup_context(&ctx);
+            return false;
+        }
+        ctx.global_offset = start_offset;
+        ctx.current_line = start_line;
+        ctx.at_line_start = false;
+    }
+    if (!adapter->tables) {
+        adapter->tables = &ctx.index; // Full scan: resolve against the tables found so far
+    }
+
+    ScanHooks hooks = {0};
+    hooks.data = adapter;
+    hooks.parse_columns = adapter->callbacks->on_column != NULL;
+    hooks.on_table = adapter_on_table;
+    if (adapter->callbacks->on_row || adapter->callbacks->on_value || adapter->callbacks->on_insert_range) {
+        hooks.on_row = adapter_on_row;
+        hooks.on_insert_end = adapter_on_insert_end;
+    }
+    ctx.hooks = &hooks;
+    ctx.assume_mysqldump = (ix->flags & SQLINDEXER_ASSUME_MYSQLDUMP) != 0;
+
+    bool ok = process_sql_file(&ctx);
+    adapter->stopped = ctx.stop_requested;
+    if (ok && !ctx.stop_requested) {
+        *result = ctx.index;
+        ctx.index = (SqlIndex){0}; // Prevent double free
+    }
+    cleanup_context(&ctx);
+    free(adapter->row_counts);
+    free(adapter->values);
+    return ok;
+}
+
+// Maps an INSERT target to a table number, remembering the last hit since
+// consecutive statements almost always target the same table.
+static int resolve_table(ScanAdapter *adapter, const char *name) {
+    const SqlIndex *tables = adapter->tables;
+    if (adapter->last_table >= 0 && adapter->last_table < tables->count &&
+        strcmp(tables->entries[adapter->last_table].name, name) == 0) {
+        return adapter->last_table;
+    }
+    for (int i = tables->count - 1; i >= 0; --i) {
+        if (tables->entries[i].table_info && strcmp(tables->entries[i].name, name) == 0) {
+            adapter->last_table = i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void fill_table(const TableInfo *table_info, SqlIndexerTable *out) {
+    out->name = table_info->name;
+    out->line_number = table_info->line_number;
+    out->ddl_offset = (int64_t)table_info->ddl_offset;
+    out->ddl_end_offset = (int64_t)table_info->ddl_end_offset;
+    out->end_offset = (int64_t)table_info->end_offset;
+    out->column_count = table_info->columns_loaded ? table_info->column_count : -1;
+}
+
+static void fill_column(const ColumnInfo *col, SqlIndexerColumn *out) {
+    out->name = col->name;
+    out->type = col->type;
+    out->default_value = col->default_value;
+    out->comment = col->comment;
+    out->is_primary_key = col->is_primary_key;
+    out->is_not_null = col->is_not_null;
+    out->is_auto_increment = col->is_auto_increment;
+}
+
+static TableInfo *table_at(const SqlIndexer *ix, int table) {
+    if (table < 0 || table >= ix->index.count) {
+        return NULL;
+    }
+    return ix->index.entries[table].table_info;
+}
+
+static bool adapter_on_table(void *data, int entry, TableInfo *table_info) {
+    ScanAdapter *adapter = data;
+    const SqlIndexerCallbacks *callbacks = adapter->callbacks;
+    if (adapter->stop_at_next_table) {
+        return false;
+    }
+
+    if (callbacks->on_table) {
+        SqlIndexerTable info;
+        fill_table(table_info, &info);
+        if (!callbacks->on_table(adapter->user, entry, &info)) return false;
+    }
+    if (callbacks->on_column) {
+        for (int i = 0; i < table_info->column_count; i++) {
+            SqlIndexerColumn info;
+            fill_column(&table_info->columns[i], &info);
+            if (!callbacks->on_column(adapter->user, entry, i, &info)) return false;
+        }
+    }
+    return true;
+}
+
+static bool adapter_on_row(void *data, const InsertState *insert, const SqlRow *row) {
+    ScanAdapter *adapter = data;
+    const SqlIndexerCallbacks *callbacks = adapter->callbacks;
+    int table = resolve_table(adapter, insert->table_name);
+    if (adapter->only_table >= 0 && table != adapter->only_table) {
+        return true;
+    }
+
+    // Per-table row numbers, grown as tables appear
+    uint64_t *counter = &adapter->orphan_rows;
+    if (table >= 0) {
+        if (table >= adapter->row_count_capacity) {
+            int new_capacity = adapter->row_count_capacity == 0 ? 64 : adapter->row_count_capacity;
+            while (new_capacity <= table) new_capacity *= 2;
+            uint64_t *new_counts = mem_realloc(MEM_ROWS, adapter->row_counts, new_capacity * sizeof(uint64_t));
+            if (!new_counts) {
+                perror("Failed to allocate row counters");
+                return false;
+            }
+            memset(new_counts + adapter->row_count_capacity, 0,
+                   (size_t)(new_capacity - adapter->row_count_capacity) * sizeof(uint64_t));
+            adapter->row_counts = new_counts;
+            adapter->row_count_capacity = new_capacity;
+        }
+        counter = &adapter->row_counts[table];
+    }
+    uint64_t row_number = (*counter)++;
+
+    if (row->count > adapter->value_capacity) {
+        SqlIndexerValue *new_values = mem_realloc(MEM_ROWS, adapter->values, row->capacity * sizeof(SqlIndexerValue));
+        if (!new_values) {
+            perror("Failed to allocate row values");
+            return false;
+        }
+        adapter->values = new_values;
+        adapter->value_capacity = row->capacity;
+    }
+    for (int i = 0; i < row->count; i++) {
+        // The public kinds share their order with SqlValueKind
+        adapter->values[i].kind = (SqlIndexerValueKind)row->values[i].kind;
+        adapter->values[i].ptr = row->values[i].text.ptr;
+        adapter->values[i].len = row->values[i].text.len;
+    }
+
+    if (callbacks->on_row && !callbacks->on_row(adapter->user, table, row_number, adapter->values, row->count)) {
+        return false;
+    }
+    if (callbacks->on_value) {
+        for (int i = 0; i < row->count; i++) {
+            if (!callbacks->on_value(adapter->user, table, row_number, i, &adapter->values[i])) return false;
+        }
+    }
+    return true;
+}
+
+static bool adapter_on_insert_end(void *data, const InsertState *insert) {
+    ScanAdapter *adapter = data;
+    int table = resolve_table(adapter, insert->table_name);
+    if (!adapter->callbacks->on_insert_range || (adapter->only_table >= 0 && table != adapter->only_table)) {
+        return true;
+    }
+    return adapter->callbacks->on_insert_range(adapter->user, table, (int64_t)insert->start_offset,
+                                               (int64_t)insert->end_offset, insert->row_count);
+}
@@ -0,0 +1,117 @@
+#ifndef SQLINDEXER_H
+#define SQLINDEXER_H
+
+// Public C API of libsqlindexer.
+// Only the types and functions in this header are part of the stable
+// interface; everything else in the library is internal.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define SQLINDEXER_API __attribute__((visibility("default")))
+#else
+#define SQLINDEXER_API
+#endif
+
+#define SQLINDEXER_API_VERSION 1
+
+// --- Open Flags ---
+#define SQLINDEXER_NO_INDEX_FILE      0x1u  // Never read or write <sql_file>.index
+#define SQLINDEXER_ASSUME_MYSQLDUMP   0x2u  // Statements start at line starts (see --assume-mysqldump)
+
+// Opaque handle for one SQL file and its index.
+typedef struct SqlIndexer SqlIndexer;
+
+// --- Value Kinds ---
+typedef enum {
+    SQLINDEXER_VALUE_NULL,
+    SQLINDEXER_VALUE_NUMBER,
+    SQLINDEXER_VALUE_STRING,        // Span includes the quotes and escapes
+    SQLINDEXER_VALUE_HEX,           // 0x.. or X'..'
+    SQLINDEXER_VALUE_BIT,           // 0b.. or b'..'
+    SQLINDEXER_VALUE_EXPRESSION     // Anything else, verbatim
+} SqlIndexerValueKind;
+
+// A value of an INSERT row. Not NUL-terminated; only valid during the callback.
+typedef struct {
+    SqlIndexerValueKind kind;
+    const char *ptr;
+    size_t len;
+} SqlIndexerValue;
+
+typedef struct {
+    const char *name;
+    uint64_t line_number;
+    int64_t ddl_offset;             // CREATE TABLE statement spans [ddl_offset, ddl_end_offset)
+    int64_t ddl_end_offset;         // After the statement's ';', past the table options
+    int64_t end_offset;             // After the closing ')' of the column list
+    int column_count;               // -1 if the columns have not been parsed yet
+} SqlIndexerTable;
+
+typedef struct {
+    const char *name;
+    const char *type;               // As declared, e.g. "decimal(10,2) unsigned"
+    const char *default_value;      // NULL if none
+    const char *comment;            // NULL if none
+    bool is_primary_key;
+    bool is_not_null;
+    bool is_auto_increment;
+} SqlIndexerColumn;
+
+// --- Streaming Callbacks ---
+// Every callback is optional. Returning false stops the scan early; the
+// scan function still returns true. `table` is the table number used by the
+// lookup functions, or -1 for rows of a table with no CREATE TABLE.
+typedef struct {
+    bool (*on_table)(void *user, int table, const SqlIndexerTable *info);
+    bool (*on_column)(void *user, int table, int column, const SqlIndexerColumn *info);
+    // One INSERT statement: bytes [start_offset, end_offset) holding row_count rows
+    bool (*on_insert_range)(void *user, int table, int64_t start_offset, int64_t end_offset, uint64_t row_count);
+    // `row` counts the table's rows from 0 across statements
+    bool (*on_row)(void *user, int table, uint64_t row, const SqlIndexerValue *values, int value_count);
+    bool (*on_value)(void *user, int table, uint64_t row, int column, const SqlIndexerValue *value);
+} SqlIndexerCallbacks;
+
+// --- Function Declarations ---
+
+// Opens a handle; nothing is read until sqlindexer_index or a scan.
+// Returns NULL if the file cannot be opened.
+SQLINDEXER_API SqlIndexer *sqlindexer_open(const char *sql_filename, unsigned flags);
+SQLINDEXER_API void sqlindexer_close(SqlIndexer *ix);
+
+// Loads <sql_file>.index if it matches the file, otherwise scans the file
+// and saves the index. Cheap once done; later calls return immediately.
+SQLINDEXER_API bool sqlindexer_index(SqlIndexer *ix);
+
+// Table lookups. Tables are numbered 0..count-1 in file order.
+SQLINDEXER_API int sqlindexer_table_count(const SqlIndexer *ix);
+SQLINDEXER_API int sqlindexer_find_table(const SqlIndexer *ix, const char *name);
+SQLINDEXER_API bool sqlindexer_get_table(const SqlIndexer *ix, int table, SqlIndexerTable *out);
+
+// Column lookups parse the table's definition on first use.
+SQLINDEXER_API int sqlindexer_column_count(SqlIndexer *ix, int table);
+SQLINDEXER_API int sqlindexer_find_column(SqlIndexer *ix, int table, const char *name);
+SQLINDEXER_API bool sqlindexer_get_column(SqlIndexer *ix, int table, int column, SqlIndexerColumn *out);
+
+// Streams the whole file through the callbacks in one pass and keeps the
+// index built along the way.
+SQLINDEXER_API bool sqlindexer_scan(SqlIndexer *ix, const SqlIndexerCallbacks *callbacks, void *user);
+
+// Streams the INSERT data of one table: from the end of its CREATE TABLE
+// up to the next CREATE TABLE. Requires sqlindexer_index.
+SQLINDEXER_API bool sqlindexer_extract(SqlIndexer *ix, int table, const SqlIndexerCallbacks *callbacks, void *user);
+
+// Turns [DEBUG] messages on stderr on or off.
+SQLINDEXER_API void sqlindexer_set_verbose(bool verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SQLINDEXER_H
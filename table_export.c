@@ -0,0 +1,688 @@
+#define _GNU_SOURCE // For fmemopen, open_memstream
+#include "table_export.h"
+#include "work_pool.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include "dump_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h> // For isspace, isdigit
+#include <errno.h>
+#include <inttypes.h> // For PRIu64
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cjson/cJSON.h>
+
+typedef struct ExportJob ExportJob;
+typedef struct TableExport TableExport;
+
+// A range of a table's data that starts and ends between statements
+typedef struct {
+    TableExport *table;
+    off_t start;
+    off_t end;
+    uint64_t start_line;
+    FrameWriter writer;         // Compresses the rows into `data`
+    char *data;                 // The piece's output, held until the pieces before it are written
+    size_t data_len;
+    uint64_t rows;
+    bool done;
+    bool failed;
+} ExportPiece;
+
+struct TableExport {
+    ExportJob *job;
+    const TableInfo *table_info;
+    char *filename;
+    off_t start;                // Data spans [start, end)
+    off_t end;
+    FILE *file;
+    FrameWriter writer;         // Compresses what is written to `out` into `file`
+    FILE *out;
+    pthread_mutex_t lock;       // Guards the fields below while pieces run
+    ExportPiece *pieces;        // NULL if the table is exported in one go
+    int piece_count;
+    int piece_capacity;
+    int next_piece;             // First piece not yet written to `out`
+    bool split_done;            // piece_count is final
+    uint64_t rows;              // Rows written to `out`
+    bool failed;
+};
+
+struct ExportJob {
+    DumpMap dump;               // The whole SQL file
+    const ExportOptions *options;
+    FILE *stream;               // The one table's output for export_table_stream; NULL for files
+    WorkPool pool;
+    pthread_mutex_t lock;       // Guards the totals
+    uint64_t rows;
+    int failed_tables;
+};
+
+// Hook data for writing one range's rows
+typedef struct {
+    const TableInfo *table_info;
+    FILE *out;
+    uint64_t rows;
+    bool foreign;               // Met an INSERT into another table
+} RowWriter;
+
+// --- Static Helper Function Declarations ---
+static bool run_export(SqlIndex *index, const char *sql_filename, const bool *selected, const ExportOptions *options,
+                       FILE *stream);
+static bool prepare_output_dir(const char *output_dir);
+static bool assign_filenames(TableExport *tables, int count, const char *output_dir, const char *suffix);
+static int compare_by_name(const void *a, const void *b);
+static int compare_by_size(const void *a, const void *b);
+static void export_table_task(void *arg);
+static void export_piece_task(void *arg);
+static bool split_table(TableExport *table);
+static bool submit_piece(TableExport *table, off_t start, off_t end, uint64_t start_line);
+static void commit_piece(ExportPiece *piece);
+static void write_pieces(TableExport *table);
+static void finish_table(TableExport *table, bool ok);
+static FILE *open_output(FILE *sink, FrameWriter *writer, const CompressOptions *compress);
+static bool close_output(FILE *out, FrameWriter *writer, bool seek_table);
+static bool write_header(FILE *out, const TableInfo *table_info);
+static bool export_range(ExportJob *job, const TableInfo *table_info, off_t start, off_t end, uint64_t start_line,
+                         FILE *out, uint64_t *rows);
+static bool write_row(void *data, const InsertState *insert, const SqlRow *row);
+static void write_value(FILE *out, const SqlValue *value);
+static bool is_json_number(StrSpan text);
+static void write_json_string(FILE *out, const char *s, size_t len);
+static void write_sql_string(FILE *out, StrSpan literal);
+static void write_escaped_char(FILE *out, unsigned char c);
+
+// --- Function Implementations ---
+
+bool export_tables(SqlIndex *index, const char *sql_filename, const bool *selected, const ExportOptions *options) {
+    return run_export(index, sql_filename, selected, options, NULL);
+}
+
+bool export_table_stream(SqlIndex *index, const char *sql_filename, int entry, FILE *out, const ExportOptions *options) {
+    bool *selected = mem_calloc(MEM_EXPORT, (size_t)index->count, sizeof(bool));
+    if (!selected) {
+        perror("Failed to allocate table selection");
+        return false;
+    }
+    selected[entry] = true;
+    bool ok = run_export(index, sql_filename, selected, options, out);
+    free(selected);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+// Exports the selected tables to their files in options->output_dir, or the
+// one selected table to `stream` if it is set
+static bool run_export(SqlIndex *index, const char *sql_filename, const bool *selected, const ExportOptions *options,
+                       FILE *stream) {
+    int count = 0;
+    for (int i = 0; i < index->count; ++i) {
+        if (selected[i] && index->entries[i].table_info) count++;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    // Column loading updates the shared index, so it happens before the workers start
+    for (int i = 0; i < index->count; ++i) {
+        if (selected[i] && index->entries[i].table_info &&
+            !load_table_columns(index, index->entries[i].table_info, sql_filename)) {
+            return false;
+        }
+    }
+
+    ExportJob job = {0};
+    job.options = options;
+    job.stream = stream;
+    if (!dump_map_open(&job.dump, sql_filename, index) || (!stream && !prepare_output_dir(options->output_dir))) {
+        dump_map_close(&job.dump);
+        return false;
+    }
+
+    TableExport *tables = mem_calloc(MEM_EXPORT, (size_t)count, sizeof(TableExport));
+    TableExport **order = mem_malloc(MEM_EXPORT, (size_t)count * sizeof(TableExport *));
+    if (!tables || !order) {
+        perror("Failed to allocate export tasks");
+        free(tables);
+        free(order);
+        dump_map_close(&job.dump);
+        return false;
+    }
+
+    // A table's data runs up to the next CREATE TABLE (or the end of the file)
+    int n = 0;
+    for (int i = 0; i < index->count; ++i) {
+        const TableInfo *table_info = index->entries[i].table_info;
+        if (!selected[i] || !table_info) {
+            continue;
+        }
+        TableExport *table = &tables[n];
+        table->job = &job;
+        table->table_info = table_info;
+        table->start = table_info->end_offset < job.dump.size ? table_info->end_offset : job.dump.size;
+        table->end = job.dump.size;
+        for (int j = i + 1; j < index->count; ++j) {
+            const TableInfo *next = index->entries[j].table_info;
+            if (next && next->ddl_offset >= table->start) {
+                table->end = next->ddl_offset;
+                break;
+            }
+        }
+        pthread_mutex_init(&table->lock, NULL);
+        order[n] = table;
+        n++;
+    }
+
+    bool ok = stream || assign_filenames(tables, count, options->output_dir, compress_suffix(options->compress.format));
+    int threads = options->threads > 0 ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_mutex_init(&job.lock, NULL);
+    if (ok && work_pool_start(&job.pool, threads)) {
+        // Workers run their newest task first, so the largest tables are submitted last
+        qsort(order, (size_t)count, sizeof(TableExport *), compare_by_size);
+        for (int i = 0; i < count; ++i) {
+            if (!work_pool_submit(&job.pool, export_table_task, order[i])) {
+                finish_table(order[i], false);
+            }
+        }
+        work_pool_stop(&job.pool);
+        DEBUG_PRINT("Export finished on %d workers with %" PRIu64 " steals.", job.pool.worker_count, job.pool.steals);
+        if (!stream) {
+            printf("Exported %d tables (%" PRIu64 " rows) to '%s'.\n", count - job.failed_tables, job.rows,
+                   options->output_dir);
+        }
+        ok = job.failed_tables == 0;
+    } else {
+        ok = false;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        pthread_mutex_destroy(&tables[i].lock);
+        free(tables[i].filename);
+        free(tables[i].pieces);
+    }
+    pthread_mutex_destroy(&job.lock);
+    free(tables);
+    free(order);
+    dump_map_close(&job.dump);
+    return ok;
+}
+
+static bool prepare_output_dir(const char *output_dir) {
+    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error creating output directory '%s': %s\n", output_dir, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// <dir>/<name>.json, or <dir>/<name>.<k>.json for the k-th table of that name,
+// plus the compression suffix. Sorting by name (then file order) makes
+// repeated names adjacent.
+static bool assign_filenames(TableExport *tables, int count, const char *output_dir, const char *suffix) {
+    TableExport **sorted = mem_malloc(MEM_EXPORT, (size_t)count * sizeof(TableExport *));
+    if (!sorted) {
+        perror("Failed to allocate export file names");
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        sorted[i] = &tables[i];
+    }
+    qsort(sorted, (size_t)count, sizeof(TableExport *), compare_by_name);
+
+    int occurrence = 0;
+    for (int i = 0; i < count; ++i) {
+        const char *name = sorted[i]->table_info->name;
+        occurrence = i > 0 && strcmp(sorted[i - 1]->table_info->name, name) == 0 ? occurrence + 1 : 1;
+        size_t size = strlen(output_dir) + strlen(name) + strlen(suffix) + 24; // '/', ".<k>", ".json" and the NUL
+        char *filename = mem_malloc(MEM_EXPORT, size);
+        if (!filename) {
+            perror("Failed to allocate export file names");
+            free(sorted);
+            return false;
+        }
+        int dir_len = snprintf(filename, size, "%s/", output_dir);
+        if (occurrence > 1) {
+            snprintf(filename + dir_len, size - (size_t)dir_len, "%s.%d.json%s", name, occurrence, suffix);
+        } else {
+            snprintf(filename + dir_len, size - (size_t)dir_len, "%s.json%s", name, suffix);
+        }
+        // Table names may hold any character; keep the file inside output_dir
+        for (char *p = filename + dir_len; *p; ++p) {
+            if (*p == '/') *p = '_';
+        }
+        sorted[i]->filename = filename;
+    }
+    free(sorted);
+    return true;
+}
+
+static int compare_by_name(const void *a, const void *b) {
+    const TableExport *ta = *(const TableExport *const *)a;
+    const TableExport *tb = *(const TableExport *const *)b;
+    int cmp = strcmp(ta->table_info->name, tb->table_info->name);
+    if (cmp != 0) return cmp;
+    return ta < tb ? -1 : ta > tb; // File order
+}
+
+static int compare_by_size(const void *a, const void *b) {
+    const TableExport *ta = *(const TableExport *const *)a;
+    const TableExport *tb = *(const TableExport *const *)b;
+    off_t sa = ta->end - ta->start;
+    off_t sb = tb->end - tb->start;
+    if (sa != sb) return sa < sb ? -1 : 1;
+    return ta < tb ? -1 : ta > tb;
+}
+
+// Writes the header, then either all rows or, for a large table, splits the
+// data into pieces that are queued on this worker for others to steal.
+static void export_table_task(void *arg) {
+    TableExport *table = arg;
+    ExportJob *job = table->job;
+    const TableInfo *table_info = table->table_info;
+    TRACE_BEGIN(table_start);
+
+    if (!dump_map_fill(&job->dump, table->start, table->end)) {
+        finish_table(table, false);
+        return;
+    }
+
+    table->file = job->stream ? job->stream : fopen(table->filename, "wb");
+    if (!table->file) {
+        fprintf(stderr, "Error creating '%s': %s\n", table->filename, strerror(errno));
+        finish_table(table, false);
+        return;
+    }
+    table->out = open_output(table->file, &table->writer, &job->options->compress);
+    if (!table->out || !write_header(table->out, table_info)) {
+        finish_table(table, false);
+        return;
+    }
+
+    size_t piece_size = job->options->piece_size;
+    if (piece_size == 0 || (size_t)(table->end - table->start) <= piece_size) {
+        uint64_t rows = 0;
+        bool ok = export_range(job, table_info, table->start, table->end, table_info->line_number, table->out, &rows);
+        table->rows = rows;
+        finish_table(table, ok);
+    } else if (!split_table(table)) {
+        pthread_mutex_lock(&table->lock);
+        table->failed = true;
+        table->split_done = true;
+        write_pieces(table);
+        pthread_mutex_unlock(&table->lock);
+    }
+    TRACE_END(table_start, "export", "table", table_info->name);
+}
+
+static void export_piece_task(void *arg) {
+    ExportPiece *piece = arg;
+    TableExport *table = piece->table;
+    TRACE_BEGIN(piece_start);
+
+    // Compressed here, on the worker; the frames are copied to the file in order
+    FILE *sink = open_memstream(&piece->data, &piece->data_len);
+    FILE *out = sink ? open_output(sink, &piece->writer, &table->job->options->compress) : NULL;
+    if (!out) {
+        perror("Failed to allocate export buffer");
+        piece->failed = true;
+    } else {
+        piece->failed = !export_range(table->job, table->table_info, piece->start, piece->end, piece->start_line,
+                                      out, &piece->rows);
+        if (!close_output(out, &piece->writer, false)) {
+            piece->failed = true;
+        }
+    }
+    if (sink && fclose(sink) != 0) {
+        piece->failed = true;
+    }
+    TRACE_END(piece_start, "export", "table piece", table->table_info->name);
+    commit_piece(piece);
+}
+
+// Cuts the data after the first top-level ';' past every piece_size bytes,
+// queueing each piece as soon as its end is known. Every piece starts in
+// plain code with no statement open (see find_statement_end).
+static bool split_table(TableExport *table) {
+    ExportJob *job = table->job;
+    size_t piece_size = job->options->piece_size;
+    off_t region = table->end - table->start;
+    table->piece_capacity = (int)((size_t)region / piece_size) + 1; // Every piece but the last is >= piece_size
+    table->pieces = mem_calloc(MEM_EXPORT, (size_t)table->piece_capacity, sizeof(ExportPiece));
+    if (!table->pieces) {
+        perror("Failed to allocate export pieces");
+        return false;
+    }
+
+    const char *base = job->dump.data;
+    const char *p = base + table->start;
+    const char *end = base + table->end;
+    const char *cut;
+    uint64_t line = table->table_info->line_number;
+    uint64_t piece_line = line;
+    ParserState state = STATE_CODE;
+
+    while ((cut = find_statement_end(p, end, p + piece_size, &state, &line)) && cut < end) {
+        if (!submit_piece(table, p - base, cut - base, piece_line)) return false;
+        p = cut;
+        piece_line = line;
+    }
+
+    if (!submit_piece(table, p - base, table->end, piece_line)) return false;
+    pthread_mutex_lock(&table->lock);
+    table->split_done = true;
+    write_pieces(table); // All pieces may have finished during the split
+    pthread_mutex_unlock(&table->lock);
+    return true;
+}
+
+static bool submit_piece(TableExport *table, off_t start, off_t end, uint64_t start_line) {
+    pthread_mutex_lock(&table->lock);
+    if (table->piece_count == table->piece_capacity) {
+        pthread_mutex_unlock(&table->lock);
+        fprintf(stderr, "Error: Too many export pieces for table '%s'.\n", table->table_info->name);
+        return false;
+    }
+    ExportPiece *piece = &table->pieces[table->piece_count];
+    piece->table = table;
+    piece->start = start;
+    piece->end = end;
+    piece->start_line = start_line;
+    table->piece_count++;
+    pthread_mutex_unlock(&table->lock);
+
+    if (!work_pool_submit(&table->job->pool, export_piece_task, piece)) {
+        piece->failed = true;
+        commit_piece(piece);
+    }
+    return true;
+}
+
+static void commit_piece(ExportPiece *piece) {
+    TableExport *table = piece->table;
+    pthread_mutex_lock(&table->lock);
+    piece->done = true;
+    write_pieces(table);
+    pthread_mutex_unlock(&table->lock);
+}
+
+// Writes finished pieces in order; the table is done after the last one.
+// Called with table->lock held.
+static void write_pieces(TableExport *table) {
+    while (table->next_piece < table->piece_count && table->pieces[table->next_piece].done) {
+        ExportPiece *piece = &table->pieces[table->next_piece++];
+        if (piece->failed) {
+            table->failed = true;
+        }
+        if (!table->failed && piece->rows > 0) {
+            // Each piece starts its rows with "\n", so only the comma between pieces is missing
+            if (table->rows > 0) fputc(',', table->out);
+            if (fflush(table->out) != 0 ||
+                !frame_writer_append(&table->writer, &piece->writer, piece->data, piece->data_len)) {
+                table->failed = true;
+            }
+            table->rows += piece->rows;
+        }
+        frame_writer_cleanup(&piece->writer);
+        free(piece->data);
+        piece->data = NULL;
+    }
+    if (table->split_done && table->next_piece == table->piece_count) {
+        finish_table(table, !table->failed);
+    }
+}
+
+// Closes the rows array and the file and adds the table to the totals.
+// A failed table's file is removed rather than left truncated.
+static void finish_table(TableExport *table, bool ok) {
+    ExportJob *job = table->job;
+    if (table->out) {
+        if (ok) fputs("\n]}}\n", table->out);
+        if (!close_output(table->out, &table->writer, ok)) ok = false;
+        frame_writer_cleanup(&table->writer);
+        table->out = NULL;
+    }
+    if (table->file && table->file == job->stream) {
+        // The caller's stream is flushed, not closed
+        if (fflush(table->file) != 0 || ferror(table->file)) ok = false;
+        table->file = NULL;
+        if (!ok) {
+            fprintf(stderr, "Error writing the rows of '%s'.\n", table->table_info->name);
+        }
+    } else if (table->file) {
+        if (ferror(table->file) || fclose(table->file) != 0) ok = false;
+        table->file = NULL;
+        if (!ok) {
+            fprintf(stderr, "Error writing '%s'.\n", table->filename);
+            remove(table->filename);
+        }
+    }
+    if (ok) {
+        DEBUG_PRINT("Exported %" PRIu64 " rows of '%s'.", table->rows, table->table_info->name);
+    }
+
+    pthread_mutex_lock(&job->lock);
+    if (ok) {
+        job->rows += table->rows;
+    } else {
+        job->failed_tables++;
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Returns a stream that compresses into `sink` through `writer`
+static FILE *open_output(FILE *sink, FrameWriter *writer, const CompressOptions *compress) {
+    if (!frame_writer_init(writer, sink, compress)) {
+        return NULL;
+    }
+    FILE *out = frame_writer_open_stream(writer);
+    if (!out) {
+        frame_writer_cleanup(writer);
+    }
+    return out;
+}
+
+// Flushes the stream's last frame. The caller closes the sink and cleans up
+// the writer, which a piece keeps for its frame list until it is appended.
+static bool close_output(FILE *out, FrameWriter *writer, bool seek_table) {
+    bool ok = fclose(out) == 0;
+    return frame_writer_finish(writer, seek_table) && ok;
+}
+
+static bool write_header(FILE *out, const TableInfo *table_info) {
+    cJSON *definition = table_definition_to_json(table_info);
+    char *columns = cJSON_PrintUnformatted(cJSON_GetObjectItemCaseSensitive(definition, "columns"));
+    char *keys = cJSON_PrintUnformatted(cJSON_GetObjectItemCaseSensitive(definition, "keys"));
+    bool ok = columns && keys;
+    if (ok) {
+        fputc('{', out);
+        write_json_string(out, table_info->name, strlen(table_info->name));
+        fprintf(out, ":{\"columns\":%s,\"keys\":%s,\"rows\":[", columns, keys);
+    } else {
+        perror("Failed to format table definition");
+    }
+    free(columns);
+    free(keys);
+    cJSON_Delete(definition);
+    return ok;
+}
+
+// Streams the INSERT rows of table_info in [start, end) of the mapping to `out`
+static bool export_range(ExportJob *job, const TableInfo *table_info, off_t start, off_t end, uint64_t start_line,
+                         FILE *out, uint64_t *rows) {
+    *rows = 0;
+    if (start >= end) {
+        return true;
+    }
+    FILE *in = fmemopen((void *)(job->dump.data + start), (size_t)(end - start), "rb");
+    if (!in) {
+        perror("Failed to open SQL file range");
+        return false;
+    }
+
+    ParsingContext ctx = {0};
+    if (!initialize_context_stream(&ctx, in)) {
+        cleanup_context(&ctx);
+        return false;
+    }
+    ctx.global_offset = start;
+    ctx.current_line = start_line;
+    ctx.at_line_start = start == 0 || job->dump.data[start - 1] == '\n';
+    ctx.assume_mysqldump = job->options->assume_mysqldump;
+
+    RowWriter writer = {table_info, out, 0, false};
+    ScanHooks hooks = {0};
+    hooks.data = &writer;
+    hooks.on_table = stop_at_table;
+    hooks.on_row = write_row;
+    ctx.hooks = &hooks;
+
+    bool ok = process_sql_file(&ctx) && !ferror(out) && !writer.foreign;
+    cleanup_context(&ctx);
+    *rows = writer.rows;
+    return ok;
+}
+
+static bool write_row(void *data, const InsertState *insert, const SqlRow *row) {
+    RowWriter *writer = data;
+    if (strcmp(insert->table_name, writer->table_info->name) != 0) {
+        // Its own table's range would not see it
+        fprintf(stderr, "Error: The INSERT INTO '%s' at offset %jd, after the CREATE TABLE of '%s', is for another "
+                "table; each table's rows must follow its own definition.\n", insert->table_name,
+                (intmax_t)insert->start_offset, writer->table_info->name);
+        writer->foreign = true;
+        return false;
+    }
+    FILE *out = writer->out;
+    fputs(writer->rows > 0 ? ",\n[" : "\n[", out);
+    for (int i = 0; i < row->count; ++i) {
+        if (i > 0) fputc(',', out);
+        write_value(out, &row->values[i]);
+    }
+    fputc(']', out);
+    writer->rows++;
+    return true;
+}
+
+// NULL and numbers map to JSON null and numbers, string literals to their
+// unescaped text; hex, bit and other values are kept as their SQL text.
+static void write_value(FILE *out, const SqlValue *value) {
+    switch (value->kind) {
+        case SQL_VALUE_NULL:
+            fputs("null", out);
+            break;
+        case SQL_VALUE_NUMBER:
+            if (is_json_number(value->text)) {
+                fwrite(value->text.ptr, 1, value->text.len, out);
+            } else {
+                write_json_string(out, value->text.ptr, value->text.len); // e.g. "+1", "- 2", "00"
+            }
+            break;
+        case SQL_VALUE_STRING:
+            write_sql_string(out, value->text);
+            break;
+        default:
+            write_json_string(out, value->text.ptr, value->text.len);
+            break;
+    }
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool is_json_number(StrSpan text) {
+    const char *p = text.ptr;
+    const char *end = text.ptr + text.len;
+    if (p < end && *p == '-') p++;
+    if (p == end || !isdigit((unsigned char)*p)) return false;
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < end && isdigit((unsigned char)*p)) p++;
+    }
+    if (p < end && *p == '.') {
+        if (++p == end || !isdigit((unsigned char)*p)) return false;
+        while (p < end && isdigit((unsigned char)*p)) p++;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        if (++p < end && (*p == '+' || *p == '-')) p++;
+        if (p == end || !isdigit((unsigned char)*p)) return false;
+        while (p < end && isdigit((unsigned char)*p)) p++;
+    }
+    return p == end;
+}
+
+static void write_json_string(FILE *out, const char *s, size_t len) {
+    const char *run = s;
+    const char *end = s + len;
+    fputc('"', out);
+    for (const char *p = s; p < end; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (c < 0x20 || c == '"' || c == '\\') {
+            fwrite(run, 1, (size_t)(p - run), out);
+            write_escaped_char(out, c);
+            run = p + 1;
+        }
+    }
+    fwrite(run, 1, (size_t)(end - run), out);
+    fputc('"', out);
+}
+
+// Same unescaping as sql_unquote_string, written straight to `out`
+static void write_sql_string(FILE *out, StrSpan literal) {
+    if (literal.len < 2) {
+        write_json_string(out, literal.ptr, literal.len);
+        return;
+    }
+    char quote = literal.ptr[0];
+    const char *p = literal.ptr + 1;
+    const char *end = literal.ptr + literal.len - 1; // Closing quote
+    const char *run = p;
+    fputc('"', out);
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c != '\\' && c != quote && c >= 0x20 && c != '"') {
+            p++;
+            continue;
+        }
+        fwrite(run, 1, (size_t)(p - run), out);
+        if (c == '\\' && p + 1 < end) {
+            switch (p[1]) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case '0': c = '\0'; break;
+                case 'Z': c = '\x1a'; break;
+                default:  c = (unsigned char)p[1]; break; // \\ \' \" and unknown escapes
+            }
+            p += 2;
+        } else if (c == (unsigned char)quote && p + 1 < end && p[1] == quote) {
+            p += 2; // '' -> '
+        } else {
+            p++;
+        }
+        write_escaped_char(out, c);
+        run = p;
+    }
+    fwrite(run, 1, (size_t)(end - run), out);
+    fputc('"', out);
+}
+
+static void write_escaped_char(FILE *out, unsigned char c) {
+    switch (c) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        case '\b': fputs("\\b", out); break;
+        case '\f': fputs("\\f", out); break;
+        default:
+            if (c < 0x20) {
+                fprintf(out, "\\u%04x", c);
+            } else {
+                fputc(c, out);
+            }
+            break;
+    }
+}
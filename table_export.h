@@ -0,0 +1,46 @@
+#ifndef TABLE_EXPORT_H
+#define TABLE_EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sql_indexer.h"
+#include "output_compress.h"
+
+// --- Multi-Table Export ---
+// Writes the rows of many tables in one run, one JSON file per table, from
+// a single mmap of the SQL file. A table's rows are the INSERTs into it
+// between the end of its CREATE TABLE and the next CREATE TABLE. Each table
+// is a task on a work-stealing pool; a table with more than piece_size
+// bytes of data is cut after top-level ';' into pieces that are parsed in
+// parallel and written in file order. A packed archive (see sql_archive.h)
+// is read by decompressing only the frames of the selected tables.
+//
+// <output_dir>/<table>.json (".2.json", ".3.json", ... for repeated names,
+// followed by ".gz" or ".zst" when compressed):
+//   {"t1":{"columns":[...],"keys":[...],"rows":[
+//   [1,"text",null],
+//   [2,"more",3.5]
+//   ]}}
+
+#define EXPORT_DEFAULT_PIECE_MIB 64
+
+typedef struct {
+    const char *output_dir;     // Created if missing
+    int threads;                // Worker threads; <= 0 for one per online CPU
+    size_t piece_size;          // Split tables with more data than this; 0 never splits
+    bool assume_mysqldump;      // See ParsingContext.assume_mysqldump
+    CompressOptions compress;   // Frames are compressed by the worker that produced them
+} ExportOptions;
+
+// --- Function Declarations ---
+
+// Exports the tables whose entries have selected[i] set, loading their
+// columns first (which updates the index). Returns false if any table
+// could not be exported; the others are still written.
+bool export_tables(SqlIndex *index, const char *sql_filename, const bool *selected, const ExportOptions *options);
+
+// Writes the table of index entry `entry` to `out` in the same format, the
+// same way; output_dir is not used. `out` is flushed, not closed.
+bool export_table_stream(SqlIndex *index, const char *sql_filename, int entry, FILE *out, const ExportOptions *options);
+
+#endif // TABLE_EXPORT_H
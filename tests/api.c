@@ -0,0 +1,134 @@
+// Exercises the public libsqlindexer API against the shared library: table
+// and column lookups, DDL spans, scans, extraction, early stops and the
+// saved index.
+#include "sqlindexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHECK(cond, what)                                            \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            fprintf(stderr, "FAIL: %s (line %d)\n", what, __LINE__); \
+            failures++;                                              \
+        }                                                            \
+    } while (0)
+
+static const char DUMP[] =
+    "-- dump\n"
+    "CREATE TABLE `users` (\n"
+    "  `id` int NOT NULL AUTO_INCREMENT,\n"
+    "  `name` varchar(20) DEFAULT 'x' COMMENT 'full; name',\n"
+    "  PRIMARY KEY (`id`)\n"
+    ") ENGINE=InnoDB COMMENT='a;b';\n"
+    "INSERT INTO `users` VALUES (1,'Al'),(2,'B;ob');\n"
+    "INSERT INTO `users` VALUES (3,NULL);\n"
+    "CREATE TABLE `tags` (\n"
+    "  `tag` varchar(8) NOT NULL\n"
+    ");\n"
+    "INSERT INTO `tags` VALUES ('t1'),(0x7432);\n";
+
+typedef struct {
+    int tables;
+    int inserts;
+    int rows[2];
+    int stop_after;             // Rows before a callback stops the scan, or 0
+    char values[256];           // "table:row:column=value;" of every value
+} Seen;
+
+static int failures;
+
+static bool on_table(void *user, int table, const SqlIndexerTable *info) {
+    (void)table;
+    (void)info;
+    ((Seen *)user)->tables++;
+    return true;
+}
+
+static bool on_insert_range(void *user, int table, int64_t start_offset, int64_t end_offset, uint64_t row_count) {
+    (void)table;
+    CHECK(strncmp(DUMP + start_offset, "INSERT INTO", 11) == 0, "INSERT range start");
+    CHECK(DUMP[end_offset - 1] == ';', "INSERT range end");
+    CHECK(row_count > 0, "INSERT rows");
+    ((Seen *)user)->inserts++;
+    return true;
+}
+
+static bool on_row(void *user, int table, uint64_t row, const SqlIndexerValue *values, int value_count) {
+    Seen *seen = user;
+    CHECK(table == 0 || table == 1, "row table");
+    seen->rows[table]++;
+    for (int i = 0; i < value_count; ++i) {
+        size_t len = strlen(seen->values);
+        snprintf(seen->values + len, sizeof(seen->values) - len, "%d:%d:%d=%.*s;", table, (int)row, i,
+                 (int)values[i].len, values[i].ptr);
+    }
+    return seen->stop_after == 0 || seen->rows[0] + seen->rows[1] < seen->stop_after;
+}
+
+static const SqlIndexerCallbacks CALLBACKS = {on_table, NULL, on_insert_range, on_row, NULL};
+
+int main(void) {
+    char path[] = "/tmp/sqlindexer-api-XXXXXX.sql";
+    int fd = mkstemps(path, 4);
+    if (fd < 0 || write(fd, DUMP, sizeof(DUMP) - 1) != (ssize_t)(sizeof(DUMP) - 1)) {
+        perror("Failed to write the test dump");
+        return 1;
+    }
+    close(fd);
+    char index_path[sizeof(path) + 8];
+    snprintf(index_path, sizeof(index_path), "%s.index", path);
+
+    // Lookups; the spans cover whole statements
+    SqlIndexer *ix = sqlindexer_open(path, SQLINDEXER_NO_INDEX_FILE);
+    CHECK(ix && sqlindexer_index(ix), "index");
+    CHECK(sqlindexer_table_count(ix) == 2, "table count");
+    CHECK(sqlindexer_find_table(ix, "tags") == 1 && sqlindexer_find_table(ix, "nope") < 0, "find table");
+    SqlIndexerTable table;
+    CHECK(sqlindexer_get_table(ix, 0, &table) && strcmp(table.name, "users") == 0, "get table");
+    const char *ddl = strstr(DUMP, "CREATE TABLE `users`");
+    const char *ddl_end = strstr(DUMP, "'a;b';\n") + 6;
+    CHECK(table.ddl_offset == ddl - DUMP && table.ddl_end_offset == ddl_end - DUMP, "DDL span");
+    CHECK(DUMP[table.end_offset - 1] == ')', "end of the column list");
+    CHECK(sqlindexer_column_count(ix, 0) == 2 && sqlindexer_find_column(ix, 0, "NAME") == 1, "columns");
+    SqlIndexerColumn column;
+    CHECK(sqlindexer_get_column(ix, 0, 0, &column) && column.is_primary_key && column.is_auto_increment &&
+          column.is_not_null, "id column");
+    CHECK(sqlindexer_get_column(ix, 0, 1, &column) && strcmp(column.type, "varchar(20)") == 0 &&
+          strcmp(column.default_value, "'x'") == 0 && strcmp(column.comment, "full; name") == 0, "name column");
+    CHECK(!sqlindexer_get_column(ix, 0, 2, &column) && !sqlindexer_get_table(ix, 2, &table), "out of range");
+
+    // A scan sees every statement and value
+    Seen seen = {0};
+    CHECK(sqlindexer_scan(ix, &CALLBACKS, &seen), "scan");
+    CHECK(seen.tables == 2 && seen.inserts == 3 && seen.rows[0] == 3 && seen.rows[1] == 2, "scanned counts");
+    CHECK(strcmp(seen.values, "0:0:0=1;0:0:1='Al';0:1:0=2;0:1:1='B;ob';0:2:0=3;0:2:1=NULL;"
+                              "1:0:0='t1';1:1:0=0x7432;") == 0, "scanned values");
+
+    // Extraction reads one table; a callback can stop a scan
+    memset(&seen, 0, sizeof(seen));
+    CHECK(sqlindexer_extract(ix, 1, &CALLBACKS, &seen), "extract");
+    CHECK(seen.rows[0] == 0 && strcmp(seen.values, "1:0:0='t1';1:1:0=0x7432;") == 0, "extracted values");
+    memset(&seen, 0, sizeof(seen));
+    seen.stop_after = 2;
+    CHECK(sqlindexer_scan(ix, &CALLBACKS, &seen), "stopped scan");
+    CHECK(seen.rows[0] == 2 && seen.rows[1] == 0, "rows before the stop");
+    sqlindexer_close(ix);
+    CHECK(access(index_path, F_OK) != 0, "no index file written");
+
+    // The saved index is loaded by the next handle
+    ix = sqlindexer_open(path, 0);
+    CHECK(ix && sqlindexer_index(ix) && access(index_path, F_OK) == 0, "saved index");
+    sqlindexer_close(ix);
+    ix = sqlindexer_open(path, 0);
+    CHECK(ix && sqlindexer_index(ix) && sqlindexer_table_count(ix) == 2, "loaded index");
+    CHECK(sqlindexer_get_table(ix, 1, &table) && strcmp(table.name, "tags") == 0, "loaded table");
+    CHECK(sqlindexer_column_count(ix, 1) == 1, "columns from the loaded index");
+    sqlindexer_close(ix);
+    CHECK(sqlindexer_open("/nonexistent/dump.sql", 0) == NULL, "open of a missing file");
+
+    unlink(index_path);
+    unlink(path);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+# --assume-mysqldump finds the tables a full scan finds, including those
+# created after another statement on the same line, and none inside
+# strings or comments.
+. "$(dirname "$0")/common.sh"
+
+{
+    echo '/*!40101 SET NAMES utf8mb4 */;'
+    echo 'CREATE TABLE `a` ('
+    echo '  `id` int NOT NULL'
+    echo ') ENGINE=InnoDB;'
+    echo "INSERT INTO \`a\` VALUES (1),(2);"
+    echo "SET @x = 1; CREATE TABLE \`b\` (\`id\` int NOT NULL, \`s\` text) ENGINE=InnoDB; INSERT INTO \`b\` VALUES (1,'x');"
+    echo "INSERT INTO \`b\` VALUES (3,'x; CREATE TABLE \`in_string\` (i int)'); CREATE TABLE \`d\` (\`id\` int);"
+    echo "/*!40101 SET @y = 2 */; create table \`e\` (\`id\` int, \`s\` text);"
+    echo "INSERT INTO \`e\` VALUES (2,'first line"
+    echo 'CREATE TABLE `not_a_table` (`id` int);'
+    echo "last line');"
+    echo '/* a comment'
+    echo 'CREATE TABLE `commented` (`id` int);'
+    echo '*/'
+    echo "INSERT INTO \`e\` VALUES (4,'y'); CREATE TABLE \`f\` ("
+    echo '  `id` int'
+    echo ');'
+    awk 'BEGIN {
+        for (t = 0; t < 20; t++) {
+            printf "CREATE TABLE `c%d` (\n  `id` int NOT NULL\n) ENGINE=InnoDB;\n", t
+            for (j = 0; j < 50; j++) printf "INSERT INTO `c%d` VALUES (%d),(%d);\n", t, j, j + 50
+        }
+    }'
+} > full.sql
+cp full.sql fast.sql
+
+"$SQL_INDEXER" --list-tables full.sql 2> /dev/null | grep -v '^Successfully loaded' > expected.txt
+"$SQL_INDEXER" --assume-mysqldump --list-tables fast.sql 2> /dev/null | grep -v '^Successfully loaded' > got.txt
+expect_same_file got.txt expected.txt "tables found with --assume-mysqldump"
+for table in b d e f; do
+    expect_eq "$(grep -c " $table\$" got.txt)" 1 "table $table"
+done
+if grep -q 'not_a_table\|commented\|in_string' got.txt; then
+    fail "a table inside a string or comment was listed"
+fi
+"$SQL_INDEXER" --dump-all --output-dir full full.sql > /dev/null 2>&1 || fail "export of full.sql"
+"$SQL_INDEXER" --assume-mysqldump --dump-all --output-dir fast fast.sql > /dev/null 2>&1 || fail "export of fast.sql"
+for json in full/*.json; do
+    expect_same_file fast/${json#full/} $json "$json with --assume-mysqldump"
+done
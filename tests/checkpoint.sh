@@ -0,0 +1,50 @@
+# An indexing run killed after a checkpoint resumes with --resume into the
+# index a run from the start writes; a checkpoint of a changed file is not
+# used.
+. "$(dirname "$0")/common.sh"
+
+awk -v q="'" 'BEGIN {
+    for (t = 0; t < 64; t++) {
+        printf "CREATE TABLE `t%d` (\n  `id` int NOT NULL,\n  `s` varchar(40) DEFAULT NULL\n) ENGINE=InnoDB;\n", t
+        for (j = 0; j < 40; j++) {
+            printf "INSERT INTO `t%d` VALUES ", t
+            for (i = 0; i < 1000; i++) printf "%s(%d,%srow %d; (x)%s)", i ? "," : "", i, q, i, q
+            print ";"
+        }
+    }
+}' > dump.sql
+cp -p dump.sql fresh.sql
+"$SQL_INDEXER" fresh.sql > /dev/null 2>&1 || fail "indexing from the start"
+
+# Indexes dump.sql and kills the run once it has saved a checkpoint
+interrupt() {
+    "$SQL_INDEXER" --checkpoint-interval 1 dump.sql > /dev/null 2>&1 &
+    pid=$!
+    polls=0
+    while [ ! -f dump.sql.checkpoint ] && kill -0 $pid 2> /dev/null && [ $polls -lt 3000 ]; do
+        sleep 0.01
+        polls=$((polls + 1))
+    done
+    kill -9 $pid 2> /dev/null || fail "the scan ended before it could be interrupted"
+    wait $pid 2> /dev/null || true
+    [ -f dump.sql.checkpoint ] || fail "no checkpoint saved"
+}
+
+interrupt
+[ ! -f dump.sql.index ] || fail "an interrupted run wrote the index"
+
+"$SQL_INDEXER" --resume dump.sql > resumed.txt 2>&1 || fail "resuming"
+grep -q '^Resuming from checkpoint at offset [1-9]' resumed.txt || fail "the checkpoint was not used"
+expect_same_file dump.sql.index fresh.sql.index "resumed index"
+[ ! -f dump.sql.checkpoint ] || fail "checkpoint left after the scan"
+
+# A checkpoint no longer matching the file is ignored
+rm dump.sql.index
+interrupt
+echo '-- appended' >> dump.sql
+echo '-- appended' >> fresh.sql
+rm fresh.sql.index
+"$SQL_INDEXER" fresh.sql > /dev/null 2>&1 || fail "indexing the changed file"
+"$SQL_INDEXER" --resume dump.sql > resumed.txt 2>&1 || fail "resuming the changed file"
+grep -q 'does not match the SQL file. Starting over.' resumed.txt || fail "a stale checkpoint was used"
+expect_same_file dump.sql.index fresh.sql.index "index of the changed file"
@@ -0,0 +1,30 @@
+# Shared setup for the behaviour tests, sourced by each tests/*.sh.
+# $1 is the sql_indexer binary; the test runs in a scratch directory that
+# is removed when it exits.
+set -eu
+
+SQL_INDEXER=$1
+TESTS_DIR=$(cd "$(dirname "$0")" && pwd)
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/sqlindexer-test.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK"
+
+fail() {
+    printf 'FAIL: %s\n' "$*" >&2
+    exit 1
+}
+
+# expect_eq <actual> <expected> <what>
+expect_eq() {
+    [ "$1" = "$2" ] || fail "$3: expected '$2', got '$1'"
+}
+
+# expect_same_file <actual> <expected> <what>
+expect_same_file() {
+    cmp -s "$1" "$2" || { diff "$2" "$1" | head -20 >&2; fail "$3: '$1' differs from '$2'"; }
+}
+
+# JSON with the whitespace removed, for matching with grep
+squeeze() {
+    tr -d ' \t\n' < "$1"
+}
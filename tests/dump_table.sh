@@ -0,0 +1,30 @@
+# --dump-table parses rows the way --dump-tables does: separators inside
+# strings, tables with a common name prefix and multi-row INSERTs.
+. "$(dirname "$0")/common.sh"
+
+cat > d.sql <<'SQL'
+CREATE TABLE `customers` (
+  `id` int NOT NULL,
+  `name` varchar(20),
+  PRIMARY KEY (`id`)
+) ENGINE=InnoDB;
+INSERT INTO `customers` VALUES (1,'Al'),(2,'B;ob'),(3,'C(a),l');
+INSERT INTO `customers` VALUES (4,'it''s'),(5,'back\\slash; INSERT INTO `customers` VALUES (6)'),(7,NULL);
+CREATE TABLE `customers_old` (
+  `id` int NOT NULL
+);
+INSERT INTO `customers_old` VALUES (9);
+SQL
+
+"$SQL_INDEXER" --dump-table customers d.sql > customers.json 2> /dev/null
+rows=$(squeeze customers.json | sed 's/.*"rows":\(.*\)}}$/\1/')
+expect_eq "$rows" '[[1,"Al"],[2,"B;ob"],[3,"C(a),l"],[4,"it'"'"'s"],[5,"back\\slash;INSERTINTO`customers`VALUES(6)"],[7,null]]' "rows of 'customers'"
+"$SQL_INDEXER" --dump-tables customers --output-dir out d.sql > /dev/null 2>&1
+expect_same_file customers.json out/customers.json "--dump-table against --dump-tables"
+
+"$SQL_INDEXER" --dump-table customers_old d.sql > old.json 2> /dev/null
+squeeze old.json | grep -q '"rows":\[\[9\]\]}}$' || fail "rows of 'customers_old'"
+
+if "$SQL_INDEXER" --dump-table missing d.sql > /dev/null 2>&1; then
+    fail "--dump-table of a missing table succeeded"
+fi
@@ -0,0 +1,31 @@
+# A .sql.gz is indexed and read as the plain dump: the same tables, the
+# same exported rows from the access points, on the first run and when
+# read back through its index.
+. "$(dirname "$0")/common.sh"
+
+awk -v q="'" 'BEGIN {
+    for (t = 0; t < 6; t++) {
+        printf "CREATE TABLE `t%d` (\n  `id` int NOT NULL,\n  `s` varchar(32) DEFAULT NULL\n) ENGINE=InnoDB;\n", t
+        for (j = 0; j < 60; j++) {
+            printf "INSERT INTO `t%d` VALUES ", t
+            for (i = 0; i < 500; i++) printf "%s(%d,%srow %d %d%s)", i ? "," : "", j * 500 + i, q, t, i * 7919 % 10007, q
+            print ";"
+        }
+    }
+}' > dump.sql
+gzip -c dump.sql > dump.sql.gz
+
+"$SQL_INDEXER" --list-tables dump.sql 2> /dev/null | grep -v '^Successfully loaded' > expected.txt
+"$SQL_INDEXER" --dump-all --output-dir plain dump.sql > /dev/null 2>&1 || fail "export of the dump"
+for run in scanned loaded; do
+    "$SQL_INDEXER" --gzip-span 1 --list-tables dump.sql.gz 2> /dev/null | grep -v '^Successfully loaded' > got.txt
+    expect_same_file got.txt expected.txt "tables of dump.sql.gz, $run"
+    rm -rf gz
+    "$SQL_INDEXER" --dump-all --output-dir gz dump.sql.gz > /dev/null 2>&1 || fail "export of dump.sql.gz, $run"
+    for t in 0 1 2 3 4 5; do
+        expect_same_file gz/t$t.json plain/t$t.json "rows of t$t from dump.sql.gz, $run"
+    done
+    "$SQL_INDEXER" --dump-table t4 dump.sql.gz > t4.json 2> /dev/null || fail "--dump-table from dump.sql.gz"
+    expect_same_file t4.json plain/t4.json "--dump-table t4 from dump.sql.gz, $run"
+    [ -f dump.sql.gz.index ] || fail "no index for dump.sql.gz"
+done
@@ -0,0 +1,43 @@
+# The index written by a scan must load back to the same tables, DDL spans
+# and definitions, and each span must cover its statement up to the ';'.
+. "$(dirname "$0")/common.sh"
+
+cat > d.sql <<'SQL'
+CREATE TABLE `a` (
+  `id` int NOT NULL,
+  `v` enum('x,y','z') DEFAULT 'x,y' COMMENT 'it''s, here',
+  PRIMARY KEY (`id`)
+) ENGINE=InnoDB COMMENT='ends; not here';
+INSERT INTO `a` VALUES (1,'z');
+CREATE TABLE `b` (
+  `id` int NOT NULL,
+  `a_id` int,
+  KEY `k` (`a_id`),
+  CONSTRAINT `fk` FOREIGN KEY (`a_id`) REFERENCES `a` (`id`)
+);
+CREATE TABLE `c` LIKE `b`;
+SQL
+
+# Fresh scan, then the same listings from the index
+"$SQL_INDEXER" --list-tables d.sql > tables1.txt
+grep -q '^FORMAT:' d.sql.index || fail "index lacks its FORMAT record"
+"$SQL_INDEXER" --schemas d.sql 2> /dev/null | grep -v '^Successfully loaded' > schemas1.txt
+grep -q '^SCHEMA,' d.sql.index || fail "--schemas did not save the definitions"
+"$SQL_INDEXER" --list-tables d.sql 2> /dev/null | grep -v '^Successfully loaded' > tables2.txt
+"$SQL_INDEXER" --schemas d.sql 2> /dev/null | grep -v '^Successfully loaded' > schemas2.txt
+expect_same_file tables2.txt tables1.txt "--list-tables from the index"
+expect_same_file schemas2.txt schemas1.txt "--schemas from the index"
+grep -q '^KEY,[0-9]*,FOREIGN,fk,1,a_id,a,' d.sql.index || fail "foreign key record"
+grep -q "x\\\\,y" d.sql.index || fail "ENUM value with a comma"
+
+# Each DDL span is the whole statement, table options included
+awk 'NR > 2 { print $2, $3, $4 }' tables1.txt | while read -r offset bytes name; do
+    ddl=$(tail -c +"$((offset + 1))" d.sql | head -c "$bytes")
+    case "$name" in
+        a) expected=$(sed -n '1,5p' d.sql) ;;
+        b) expected=$(sed -n '7,12p' d.sql) ;;
+        c) expected=$(sed -n '13p' d.sql) ;;
+        *) fail "unexpected table '$name'" ;;
+    esac
+    expect_eq "$ddl" "$expected" "DDL span of '$name'"
+done
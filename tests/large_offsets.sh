@@ -0,0 +1,17 @@
+# A sparse dump with a table past 4 GiB: its offsets must survive in the
+# index and --dump-table must read its rows from there.
+. "$(dirname "$0")/common.sh"
+
+printf 'CREATE TABLE `small` (\n  `id` int\n);\nINSERT INTO `small` VALUES (1);\n' > big.sql
+truncate -s 4500000000 big.sql
+printf "\nCREATE TABLE \`big\` (\n  \`id\` int NOT NULL,\n  \`v\` varchar(10)\n);\nINSERT INTO \`big\` VALUES (1,'a'),(2,'b');\n" >> big.sql
+
+"$SQL_INDEXER" --list-tables big.sql > tables.txt
+line=$(awk '$4 == "big" { print $1, $2 }' tables.txt)
+expect_eq "$line" "6 4500000001" "line and DDL offset of 'big'"
+grep -q '^TABLE,big,6,' big.sql.index || fail "index lacks the 64-bit record of 'big'"
+
+# An index without a hash is used unverified, which spares hashing 4 GiB again
+sed -i '/^SHA256:/d' big.sql.index
+"$SQL_INDEXER" --dump-table big big.sql > big.json 2> /dev/null
+squeeze big.json | grep -q '"rows":\[\[1,"a"\],\[2,"b"\]\]' || fail "rows of 'big' past 4 GiB"
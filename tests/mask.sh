@@ -0,0 +1,124 @@
+# --mask keeps masked key columns distinct and joined: "hash" maps each
+# integer to another of as many digits within the type, and other methods
+# are refused on keys. Unmasked columns are copied as they are.
+. "$(dirname "$0")/common.sh"
+
+{
+    echo 'CREATE TABLE `users` ('
+    echo '  `id` int NOT NULL,'
+    echo '  `code` smallint NOT NULL,'
+    echo '  `email` varchar(64) DEFAULT NULL,'
+    echo '  PRIMARY KEY (`id`),'
+    echo '  UNIQUE KEY `code` (`code`)'
+    echo ') ENGINE=InnoDB;'
+    awk -v q="'" 'BEGIN {
+        for (i = 1; i <= 2000; i++) {
+            code = i <= 1000 ? -32769 + i : 30767 + i
+            printf "INSERT INTO `users` VALUES (%d,%d,%su%d@example.com%s);\n", i, code, q, i, q
+        }
+    }'
+    echo 'CREATE TABLE `levels` ('
+    echo '  `id` tinyint unsigned NOT NULL,'
+    echo '  PRIMARY KEY (`id`)'
+    echo ') ENGINE=InnoDB;'
+    awk 'BEGIN { for (i = 0; i < 256; i++) printf "INSERT INTO `levels` VALUES (%d);\n", i }'
+    echo 'CREATE TABLE `orders` ('
+    echo '  `id` bigint NOT NULL,'
+    echo '  `user_id` int NOT NULL,'
+    echo '  `amount` decimal(10,2) NOT NULL,'
+    echo '  PRIMARY KEY (`id`),'
+    echo '  CONSTRAINT `fk_user` FOREIGN KEY (`user_id`) REFERENCES `users` (`id`)'
+    echo ') ENGINE=InnoDB;'
+    awk 'BEGIN {
+        for (i = 1; i <= 3000; i++) printf "INSERT INTO `orders` VALUES (%d,%d,%d.%02d);\n", i, i % 2000 + 1, i, i % 100
+    }'
+} > dump.sql
+
+cat > rules.json <<'EOF'
+{
+  "salt": "test",
+  "tables": {
+    "users": {"id": "hash", "code": "hash", "email": "hash"},
+    "levels": {"id": "hash"},
+    "orders": {"id": "hash", "user_id": "hash"}
+  }
+}
+EOF
+"$SQL_INDEXER" --mask rules.json --mask-output masked.sql dump.sql > /dev/null 2>&1 || fail "masking"
+
+# Rows as tab-separated values, in dump order
+rows() {
+    grep "^INSERT INTO \`$1\`" "$2" | sed -e 's/^[^(]*(//' -e 's/);$//' | tr ',' '\t'
+}
+rows users dump.sql > users.txt
+rows users masked.sql > users_masked.txt
+rows orders dump.sql > orders.txt
+rows orders masked.sql > orders_masked.txt
+expect_eq "$(wc -l < users_masked.txt)" 2000 "masked users"
+expect_eq "$(wc -l < orders_masked.txt)" 3000 "masked orders"
+
+# Keys stay distinct, keep their digits and sign, and fit their types
+for column in 1 2; do
+    expect_eq "$(cut -f$column users_masked.txt | sort -u | wc -l)" 2000 "distinct users column $column"
+done
+expect_eq "$(cut -f1 orders_masked.txt | sort -u | wc -l)" 3000 "distinct order ids"
+expect_eq "$(rows levels masked.sql | sort -n | tr '\n' ' ')" "$(rows levels dump.sql | tr '\n' ' ')" \
+    "tinyint unsigned keys"
+paste users.txt users_masked.txt | awk -F'\t' '
+    length($1) != length($4) || length($2) != length($5) { print "width: " $0; bad = 1 }
+    $5 < -32768 || $5 > 32767 { print "range: " $0; bad = 1 }
+    $1 == $4 { same++ }
+    END { if (same > 20) print same " ids unchanged"; exit bad || same > 20 }' || fail "masked user keys"
+
+# Foreign keys map as the keys they reference; other columns are untouched
+paste users.txt users_masked.txt | cut -f1,4 > id_map.txt
+awk -F'\t' 'NR == FNR { map[$1] = $2; next } { print map[$2] }' id_map.txt orders.txt > expected.txt
+cut -f2 orders_masked.txt > got.txt
+expect_same_file got.txt expected.txt "masked foreign keys"
+cut -f3 orders.txt > expected.txt
+cut -f3 orders_masked.txt > got.txt
+expect_same_file got.txt expected.txt "unmasked amounts"
+expect_eq "$(grep -c '^CREATE TABLE' masked.sql)" 3 "definitions kept"
+
+# A run is repeatable
+"$SQL_INDEXER" --mask rules.json --mask-output again.sql dump.sql > /dev/null 2>&1 || fail "masking again"
+cmp -s masked.sql again.sql || fail "masking is not repeatable"
+
+# Methods that would give duplicate keys are refused
+printf '{"salt": "test", "tables": {"orders": {"user_id": "fake"}}}\n' > fake.json
+if "$SQL_INDEXER" --mask fake.json --mask-output faked.sql dump.sql > out.txt 2>&1; then
+    fail "fake on a foreign key was accepted"
+fi
+grep -q "Column 'orders.user_id' is part of a key" out.txt || fail "refusal message"
+printf '{"salt": "test", "tables": {"orders": {"amount": "fake"}}}\n' > amount.json
+"$SQL_INDEXER" --mask amount.json --mask-output faked.sql dump.sql > /dev/null 2>&1 || fail "fake on a plain column"
+
+# String keys hash to distinct values only with room for a long enough digest
+{
+    echo 'CREATE TABLE `codes` ('
+    echo '  `short` varchar(4) NOT NULL,'
+    echo '  `wide` varchar(40) NOT NULL,'
+    echo '  UNIQUE KEY `short` (`short`),'
+    echo '  UNIQUE KEY `wide` (`wide`)'
+    echo ') ENGINE=InnoDB;'
+    awk -v q="'" 'BEGIN { for (i = 0; i < 3000; i++) printf "INSERT INTO `codes` VALUES (%s%04d%s,%sw%d%s);\n", q, i, q, q, i, q }'
+} > codes.sql
+printf '{"salt": "test", "tables": {"codes": {"short": "hash"}}}\n' > short.json
+if "$SQL_INDEXER" --mask short.json --mask-output short.sql codes.sql > out.txt 2>&1; then
+    fail "hash on a short string key was accepted"
+fi
+grep -q "Column 'codes.short' is part of a key" out.txt || fail "short string key message"
+printf '{"salt": "test", "tables": {"codes": {"wide": "hash"}}}\n' > wide.json
+"$SQL_INDEXER" --mask wide.json --mask-output wide.sql codes.sql > /dev/null 2>&1 || fail "hash on a wide string key"
+expect_eq "$(rows codes wide.sql | cut -f2 | sort -u | wc -l)" 3000 "distinct wide string keys"
+
+# Rows that come after another table's definition are refused, not copied
+# through in the clear
+printf 'CREATE TABLE `users` (`id` int, `email` text);\nCREATE TABLE `logs` (`id` int);\n' > apart.sql
+printf "INSERT INTO \`users\` VALUES (1,'a@example.com');\nINSERT INTO \`logs\` VALUES (1);\n" >> apart.sql
+printf '{"salt": "test", "tables": {"users": {"email": "hash"}}}\n' > email.json
+if "$SQL_INDEXER" --mask email.json --mask-output apart_masked.sql apart.sql > out.txt 2>&1; then
+    fail "rows apart from their table were masked"
+fi
+grep -q "is for another table" out.txt || fail "rows apart from their table message"
+[ ! -e apart_masked.sql ] || fail "output written for rows apart from their table"
@@ -0,0 +1,27 @@
+# --mem-stats reports the peak RSS, and in builds with the counters one row
+# per subsystem that adds up to the total; the output is left as it is.
+. "$(dirname "$0")/common.sh"
+
+{
+    for t in a b c; do
+        echo "CREATE TABLE \`$t\` (\`id\` int NOT NULL, \`s\` text);"
+        awk -v t=$t 'BEGIN { for (i = 0; i < 200; i++) printf "INSERT INTO `%s` VALUES (%d,'\''%s'\'');\n", t, i, t i }'
+    done
+} > dump.sql
+cp dump.sql plain.sql
+"$SQL_INDEXER" --dump-all --output-dir plain plain.sql > /dev/null 2>&1 || fail "export without stats"
+
+"$SQL_INDEXER" --mem-stats --dump-all --output-dir out dump.sql > /dev/null 2> report.txt || fail "export with stats"
+grep -q '^Peak RSS: [0-9.]* MiB$' report.txt || fail "peak RSS"
+if ! grep -q 'allocation counters not built in' report.txt; then
+    grep -q '^Subsystem  *Allocs  *Reallocs  *Bytes  *Largest$' report.txt || fail "counter header"
+    for subsystem in index columns buffers rows export; do
+        grep -q "^$subsystem  *[1-9]" report.txt || fail "no allocations counted for $subsystem"
+    done
+    awk '/^Subsystem/ { on = 1; next }
+        on && $1 == "total" { exit !(allocs == $2 && bytes == $4) }
+        on { allocs += $2; bytes += $4 }' report.txt || fail "subsystems do not add up to the total"
+fi
+for t in a b c; do
+    expect_same_file out/$t.json plain/$t.json "$t.json with stats"
+done
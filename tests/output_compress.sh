@@ -0,0 +1,33 @@
+# --output-compress writes exports that decompress, frame after frame, to
+# the plain JSON; zstd is checked when the build and a zstd tool have it.
+. "$(dirname "$0")/common.sh"
+
+awk -v q="'" 'BEGIN {
+    for (t = 0; t < 3; t++) {
+        printf "CREATE TABLE `t%d` (\n  `id` int NOT NULL,\n  `s` varchar(32) DEFAULT NULL\n) ENGINE=InnoDB;\n", t
+        for (j = 0; j < 80; j++) {
+            printf "INSERT INTO `t%d` VALUES ", t
+            for (i = 0; i < 500; i++) printf "%s(%d,%srow %d%s)", i ? "," : "", j * 500 + i, q, i * 7919 % 10007, q
+            print ";"
+        }
+    }
+}' > dump.sql
+
+"$SQL_INDEXER" --dump-all --output-dir plain dump.sql > /dev/null 2>&1 || fail "plain export"
+"$SQL_INDEXER" --dump-all --split-size 1 --output-compress gzip:9 --output-dir gz dump.sql > /dev/null 2>&1 ||
+    fail "gzip export"
+for t in 0 1 2; do
+    gzip -dc gz/t$t.json.gz > got.json || fail "gzip -d of t$t"
+    expect_same_file got.json plain/t$t.json "gzip export of t$t"
+done
+
+if "$SQL_INDEXER" --dump-all --split-size 1 --output-compress zstd --output-dir zst dump.sql > zstd.txt 2>&1; then
+    if command -v zstd > /dev/null; then
+        for t in 0 1 2; do
+            zstd -dcq zst/t$t.json.zst > got.json || fail "zstd -d of t$t"
+            expect_same_file got.json plain/t$t.json "zstd export of t$t"
+        done
+    fi
+else
+    grep -q 'zstd output is not available' zstd.txt || fail "zstd export"
+fi
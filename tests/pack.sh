@@ -0,0 +1,41 @@
+# An archive made by --pack reads as the dump it was packed from: the same
+# tables and spans, the same exported rows, and no '.index' beside it.
+. "$(dirname "$0")/common.sh"
+
+awk -v q="'" 'BEGIN {
+    for (t = 0; t < 8; t++) {
+        printf "CREATE TABLE `t%d` (\n  `id` int NOT NULL,\n  `s` text,\n  PRIMARY KEY (`id`)\n) ENGINE=InnoDB;\n", t
+        for (j = 0; j < 50; j++) {
+            printf "INSERT INTO `t%d` VALUES ", t
+            for (i = 0; i < 500; i++) printf "%s(%d,%s%d; it%s%ss (%d)%s)", i ? "," : "", j * 500 + i, q, t, q, q, i, q
+            print ";"
+        }
+    }
+}' > dump.sql
+
+"$SQL_INDEXER" --pack dump.sql dump.sqlz > /dev/null 2>&1 || fail "--pack"
+"$SQL_INDEXER" --pack --output-compress zstd:19 --threads 2 dump.sql level19.sqlz > /dev/null 2>&1 ||
+    fail "--pack at level 19"
+"$SQL_INDEXER" --list-tables dump.sql 2> /dev/null | grep -v '^Successfully loaded' > expected.txt
+"$SQL_INDEXER" --dump-all --output-dir from_dump dump.sql > /dev/null 2>&1 || fail "export of the dump"
+for archive in dump.sqlz level19.sqlz; do
+    [ "$(wc -c < $archive)" -lt "$(wc -c < dump.sql)" ] || fail "$archive is not compressed"
+    "$SQL_INDEXER" --list-tables $archive 2> /dev/null | grep -v '^Successfully loaded' > got.txt
+    expect_same_file got.txt expected.txt "tables of $archive"
+    rm -rf from_archive
+    "$SQL_INDEXER" --dump-all --split-size 1 --output-dir from_archive $archive > /dev/null 2>&1 ||
+        fail "export of $archive"
+    for t in 0 1 2 3 4 5 6 7; do
+        expect_same_file from_archive/t$t.json from_dump/t$t.json "rows of t$t from $archive"
+    done
+    "$SQL_INDEXER" --dump-table t5 $archive > t5.json 2> /dev/null || fail "--dump-table from $archive"
+    expect_same_file t5.json from_dump/t5.json "--dump-table t5 from $archive"
+    [ ! -f $archive.index ] || fail "an index was written beside $archive"
+done
+
+# The dump is never packed over itself
+cp dump.sql copy.sql
+if "$SQL_INDEXER" --pack dump.sql dump.sql > /dev/null 2>&1; then
+    fail "--pack over its own input succeeded"
+fi
+expect_same_file dump.sql copy.sql "dump packed over itself"
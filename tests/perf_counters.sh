@@ -0,0 +1,32 @@
+# --perf-counters reports each phase with its bytes, counters (or n/a where
+# the system has none) and time, and leaves the output as it is.
+. "$(dirname "$0")/common.sh"
+
+{
+    for t in a b c; do
+        echo "CREATE TABLE \`$t\` (\`id\` int NOT NULL, \`s\` text);"
+        awk -v t=$t 'BEGIN { for (i = 0; i < 200; i++) printf "INSERT INTO `%s` VALUES (%d,'\''%s'\'');\n", t, i, t i }'
+    done
+} > dump.sql
+cp dump.sql plain.sql
+"$SQL_INDEXER" --dump-all --output-dir plain plain.sql > /dev/null 2>&1 || fail "export without counters"
+
+# The first run scans the dump; the second loads its index and hashes it
+for phases in 'scan export' 'hash export'; do
+    rm -rf out
+    "$SQL_INDEXER" --perf-counters --dump-all --output-dir out dump.sql > /dev/null 2> report.txt ||
+        fail "export with counters"
+    grep -q '^Phase  *MiB  *Cycles  *Instructions  *IPC  *B/cycle  *Br-misses  *L1d-misses  *LLC-misses  *Faults  *Seconds$' \
+        report.txt || fail "counter header"
+    expect_eq "$(awk '/^Phase/ { on = 1; next } on && NF == 11 { printf "%s%s", sep, $1; sep = " " }' report.txt)" \
+        "$phases" "phases"
+    awk '/^Phase/ { on = 1; next } on && NF == 11 {
+        for (i = 2; i <= 11; i++) if ($i != "n/a" && $i !~ /^[0-9]+(\.[0-9]+)?$/) { print "field " i ": " $0; bad = 1 }
+    } END { exit bad }' report.txt || fail "counter values"
+    if awk '/^Phase/ { on = 1; next } on && NF == 11 && / n\/a / { found = 1 } END { exit !found }' report.txt; then
+        grep -q '^Unavailable on this system: ' report.txt || fail "unavailable counters not named"
+    fi
+    for t in a b c; do
+        expect_same_file out/$t.json plain/$t.json "$t.json with counters"
+    done
+done
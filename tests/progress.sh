@@ -0,0 +1,13 @@
+# --progress-fd ends with exactly one "done" report, covering the whole file.
+. "$(dirname "$0")/common.sh"
+
+awk 'BEGIN {
+    print "CREATE TABLE `t` (\n  `id` int\n);"
+    for (i = 0; i < 100000; i++) printf "INSERT INTO `t` VALUES (%d);\n", i
+}' > dump.sql
+size=$(wc -c < dump.sql | tr -d ' ')
+
+"$SQL_INDEXER" --progress-fd 3 --list-tables dump.sql 3> progress.json > /dev/null 2>&1
+expect_eq "$(grep -c '"done":true' progress.json)" 1 "done reports"
+tail -n 1 progress.json | grep -q "\"bytes\":$size,\"total_bytes\":$size,.*\"done\":true}" ||
+    fail "last report is not the final one: $(tail -n 1 progress.json)"
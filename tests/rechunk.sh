@@ -0,0 +1,51 @@
+# --rechunk splits large INSERTs into bounded batches without changing a
+# row: the copy exports the same JSON as the dump it was made from.
+. "$(dirname "$0")/common.sh"
+
+{
+    echo 'CREATE TABLE `t` ('
+    echo '  `id` int NOT NULL,'
+    echo '  `s` varchar(64) DEFAULT NULL,'
+    echo '  PRIMARY KEY (`id`)'
+    echo ') ENGINE=InnoDB;'
+    awk -v q="'" 'BEGIN {
+        for (j = 0; j < 20; j++) {
+            printf "INSERT INTO `t` (`id`, `s`) VALUES "
+            for (i = 0; i < 100; i++) {
+                n = j * 100 + i
+                printf "(%d,%s),", n, n % 3 == 0 ? "NULL" : q "a),(b;" n "\\" q "c" q
+            }
+            print "(" 100000 + j ",\"x\");"
+        }
+    }'
+    echo 'CREATE TABLE `u` ('
+    echo '  `id` int NOT NULL'
+    echo ') ENGINE=InnoDB;'
+    echo 'INSERT INTO `u` VALUES (1),(2),(3);'
+} > dump.sql
+
+"$SQL_INDEXER" --rechunk by_rows.sql --batch-rows 7 dump.sql > /dev/null 2>&1 || fail "--rechunk --batch-rows"
+"$SQL_INDEXER" --rechunk by_size.sql --batch-size 1 dump.sql > /dev/null 2>&1 || fail "--rechunk --batch-size"
+"$SQL_INDEXER" --dump-all --output-dir before dump.sql > /dev/null 2>&1 || fail "export of the dump"
+for copy in by_rows by_size; do
+    "$SQL_INDEXER" --dump-all --output-dir $copy $copy.sql > /dev/null 2>&1 || fail "export of $copy.sql"
+    for table in t u; do
+        expect_same_file $copy/$table.json before/$table.json "rows of $table in $copy.sql"
+    done
+done
+
+# Each INSERT of 101 rows of t becomes 15; u's 3 rows stay one INSERT
+expect_eq "$(grep -c '^INSERT INTO `t`' by_rows.sql)" 300 "INSERTs of t by rows"
+expect_eq "$(grep -c '^INSERT INTO `u`' by_rows.sql)" 1 "INSERTs of u by rows"
+[ "$(grep -c '^INSERT INTO `t`' by_size.sql)" -gt 20 ] || fail "INSERTs of t by size"
+if grep '^INSERT INTO `t`' by_rows.sql | grep -qv '^INSERT INTO `t` (`id`, `s`) VALUES ('; then
+    fail "INSERT header not kept"
+fi
+awk 'length($0) > 1024 { exit 1 }' by_size.sql || fail "INSERT over the batch size"
+
+# One action per run: --rechunk does not quietly win over another
+if "$SQL_INDEXER" --rechunk again.sql --to-mydumper md --dump-all --output-dir x dump.sql > out.txt 2>&1; then
+    fail "several actions were accepted"
+fi
+grep -q '^Error: Only one of' out.txt || fail "several actions message"
+[ ! -e again.sql ] && [ ! -e md ] && [ ! -e x ] || fail "output written with several actions"
@@ -0,0 +1,34 @@
+# --plan-restore splits the dump into scripts that together hold every
+# statement once; a second plan with fewer streams leaves no stale ones.
+. "$(dirname "$0")/common.sh"
+
+awk 'BEGIN {
+    print "SET NAMES utf8mb4;"
+    print "CREATE TABLE `parent` (\n  `id` int NOT NULL,\n  PRIMARY KEY (`id`)\n);"
+    for (i = 0; i < 300; i++) printf "INSERT INTO `parent` VALUES (%d);\n", i
+    print "CREATE TABLE `child` (\n  `id` int NOT NULL,\n  `parent_id` int,\n  CONSTRAINT `fk` FOREIGN KEY (`parent_id`) REFERENCES `parent` (`id`)\n);"
+    for (i = 0; i < 300; i++) printf "INSERT INTO `child` VALUES (%d,%d);\n", i, i % 7
+}' > nopost.sql
+cp nopost.sql dump.sql
+cat >> dump.sql <<'SQL'
+DELIMITER ;;
+CREATE TRIGGER `tr` BEFORE INSERT ON `child` FOR EACH ROW BEGIN SET NEW.id = NEW.id; END ;;
+DELIMITER ;
+SQL
+
+"$SQL_INDEXER" --plan-restore -j 4 --output-dir plan dump.sql > /dev/null 2>&1
+for f in schema 1 2 3 4 post; do
+    [ -f plan/restore-$f.sql ] || fail "restore-$f.sql missing"
+done
+grep -h '^INSERT' plan/restore-*.sql | sort > planned.txt
+grep '^INSERT' dump.sql | sort > expected.txt
+expect_same_file planned.txt expected.txt "INSERTs of the streams"
+grep -q 'CREATE TRIGGER' plan/restore-post.sql || fail "trigger not in the post script"
+
+# Fewer streams, then a dump without a post script, into the same directory
+"$SQL_INDEXER" --plan-restore -j 2 --output-dir plan dump.sql > /dev/null 2>&1
+[ ! -e plan/restore-3.sql ] && [ ! -e plan/restore-4.sql ] || fail "streams 3 and 4 of the first plan left behind"
+grep -h '^INSERT' plan/restore-*.sql | sort > planned.txt
+expect_same_file planned.txt expected.txt "INSERTs of the two streams"
+"$SQL_INDEXER" --plan-restore -j 2 --output-dir plan nopost.sql > /dev/null 2>&1
+[ ! -e plan/restore-post.sql ] || fail "post script of the first dump left behind"
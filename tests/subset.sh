@@ -0,0 +1,64 @@
+# --subset copies the rows matching the filter, the rows referencing them
+# through foreign keys and the rows those reference, and nothing else.
+. "$(dirname "$0")/common.sh"
+
+cat > dump.sql <<'SQL'
+CREATE TABLE `customers` (
+  `id` int NOT NULL,
+  `name` varchar(20) DEFAULT NULL,
+  PRIMARY KEY (`id`)
+) ENGINE=InnoDB;
+INSERT INTO `customers` VALUES (1,'Ann'),(2,'Bo, Jr.'),(3,'Cy');
+CREATE TABLE `products` (
+  `sku` varchar(8) NOT NULL,
+  PRIMARY KEY (`sku`)
+) ENGINE=InnoDB;
+INSERT INTO `products` VALUES ('p1'),('p2'),('p3'),('p4');
+CREATE TABLE `orders` (
+  `id` int NOT NULL,
+  `customer_id` int NOT NULL,
+  PRIMARY KEY (`id`),
+  CONSTRAINT `fk_customer` FOREIGN KEY (`customer_id`) REFERENCES `customers` (`id`)
+) ENGINE=InnoDB;
+INSERT INTO `orders` VALUES (10,1),(11,2),(12,2);
+INSERT INTO `orders` VALUES (13,3);
+CREATE TABLE `items` (
+  `order_id` int NOT NULL,
+  `sku` varchar(8) NOT NULL,
+  PRIMARY KEY (`order_id`,`sku`),
+  CONSTRAINT `fk_order` FOREIGN KEY (`order_id`) REFERENCES `orders` (`id`),
+  CONSTRAINT `fk_sku` FOREIGN KEY (`sku`) REFERENCES `products` (`sku`)
+) ENGINE=InnoDB;
+INSERT INTO `items` VALUES (10,'p1'),(11,'p2'),(12,'p2'),(12,'p3'),(13,'p4');
+SQL
+
+"$SQL_INDEXER" --subset customers "id=2" --subset-output subset.sql dump.sql > /dev/null 2>&1 || fail "--subset"
+"$SQL_INDEXER" --dump-all --output-dir out subset.sql > /dev/null 2>&1 || fail "export of the subset"
+rows() {
+    squeeze out/$1.json | sed 's/.*"rows":\(.*\)}}$/\1/'
+}
+expect_eq "$(rows customers)" '[[2,"Bo,Jr."]]' "customers"
+expect_eq "$(rows orders)" '[[11,2],[12,2]]' "orders"
+expect_eq "$(rows items)" '[[11,"p2"],[12,"p2"],[12,"p3"]]' "items"
+expect_eq "$(rows products)" '[["p2"],["p3"]]' "products"
+expect_eq "$(grep -c '^CREATE TABLE' subset.sql)" 4 "definitions kept"
+
+# A string filter selects from a child table; its parents follow
+"$SQL_INDEXER" --subset items "sku='p4'" --subset-output p4.sql dump.sql > /dev/null 2>&1 || fail "--subset of items"
+"$SQL_INDEXER" --dump-all --output-dir out p4.sql > /dev/null 2>&1 || fail "export of the items subset"
+expect_eq "$(rows items)" '[[13,"p4"]]' "items of p4"
+expect_eq "$(rows orders)" '[[13,3]]' "orders of p4"
+expect_eq "$(rows customers)" '[[3,"Cy"]]' "customers of p4"
+expect_eq "$(rows products)" '[["p4"]]' "products of p4"
+
+if "$SQL_INDEXER" --subset missing "id=1" --subset-output none.sql dump.sql > /dev/null 2>&1; then
+    fail "--subset of a missing table succeeded"
+fi
+
+# Rows that come after another table's definition are refused, not left out
+printf 'CREATE TABLE `users` (`id` int);\nCREATE TABLE `logs` (`id` int);\n' > apart.sql
+printf 'INSERT INTO `users` VALUES (1),(2);\nINSERT INTO `logs` VALUES (1);\n' >> apart.sql
+if "$SQL_INDEXER" --subset users "id=1" --subset-output apart_subset.sql apart.sql > out.txt 2>&1; then
+    fail "rows apart from their table were subset"
+fi
+grep -q "is for another table" out.txt || fail "rows apart from their table message"
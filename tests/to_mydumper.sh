@@ -0,0 +1,50 @@
+# --to-mydumper writes every table's definition, INSERTs and triggers to
+# the files of that table, wherever the dump has the triggers.
+. "$(dirname "$0")/common.sh"
+
+{
+    echo '/*!40101 SET NAMES utf8mb4 */;'
+    echo 'USE `shop`;'
+    awk 'BEGIN {
+        for (t = 0; t < 2; t++) {
+            printf "CREATE TABLE `t%d` (\n  `id` int NOT NULL\n) ENGINE=InnoDB;\n", t
+            for (i = 0; i < 500; i++) printf "INSERT INTO `t%d` VALUES (%d),(%d);\n", t, 2 * i, 2 * i + 1
+        }
+    }'
+    for t in t0 t1; do
+        echo 'DELIMITER ;;'
+        echo "/*!50003 CREATE*/ /*!50017 DEFINER=\`root\`@\`localhost\`*/ /*!50003 TRIGGER \`tr_$t\` BEFORE INSERT ON \`$t\` FOR EACH ROW SET NEW.id = NEW.id */;;"
+        echo 'DELIMITER ;'
+    done
+    echo 'DELIMITER ;;'
+    echo 'CREATE PROCEDURE `p`() BEGIN SELECT 1; END ;;'
+    echo 'DELIMITER ;'
+} > dump.sql
+
+"$SQL_INDEXER" --to-mydumper out --chunk-rows 300 dump.sql > /dev/null 2>&1
+[ -f out/metadata ] || fail "metadata missing"
+for t in t0 t1; do
+    grep -q "CREATE TABLE \`$t\`" out/shop.$t-schema.sql || fail "definition of $t"
+    grep -h '^INSERT' out/shop.$t.0*.sql > got.txt
+    grep "^INSERT INTO \`$t\`" dump.sql > expected.txt
+    expect_same_file got.txt expected.txt "INSERTs of $t"
+    expect_eq "$(grep -c 'TRIGGER' out/shop.$t-schema-triggers.sql)" 1 "triggers in the file of $t"
+    grep -q "TRIGGER \`tr_$t\`" out/shop.$t-schema-triggers.sql || fail "trigger tr_$t not with $t"
+done
+[ -f out/shop.t0.00001.sql ] || fail "t0 not chunked by --chunk-rows"
+grep -q 'PROCEDURE' out/shop-schema-post.sql || fail "routine not in the post file"
+grep -q 'TRIGGER' out/shop-schema-post.sql && fail "trigger in the post file"
+
+# Rows that come after another table's definition are refused, not filed
+# with that table; so is exporting them as JSON
+printf 'CREATE TABLE `users` (`id` int);\nCREATE TABLE `logs` (`id` int);\n' > apart.sql
+printf 'INSERT INTO `users` VALUES (1),(2);\nINSERT INTO `logs` VALUES (1);\n' >> apart.sql
+if "$SQL_INDEXER" --to-mydumper apart apart.sql > out.txt 2>&1; then
+    fail "rows apart from their table were converted"
+fi
+grep -q "is for another table" out.txt || fail "rows apart from their table message"
+if "$SQL_INDEXER" --dump-all --output-dir apart_json apart.sql > out.txt 2>&1; then
+    fail "rows apart from their table were exported"
+fi
+grep -q "is for another table" out.txt || fail "rows apart from their table export message"
+true
@@ -0,0 +1,26 @@
+# --trace writes a Chrome trace with the scan, the export of every table
+# and the index write; builds without tracing refuse the option.
+. "$(dirname "$0")/common.sh"
+
+{
+    for t in a b c; do
+        echo "CREATE TABLE \`$t\` (\`id\` int NOT NULL);"
+        echo "INSERT INTO \`$t\` VALUES (1),(2),(3);"
+    done
+} > dump.sql
+
+if ! "$SQL_INDEXER" --trace trace.json --dump-all --output-dir out dump.sql > /dev/null 2> err.txt; then
+    grep -q 'is not available; rebuild with -DSQLINDEXER_TRACE=ON' err.txt || fail "--trace"
+    exit 0
+fi
+expect_eq "$(head -1 trace.json)" '{"displayTimeUnit":"ms","traceEvents":[' "trace header"
+expect_eq "$(tail -1 trace.json)" ']}' "trace end"
+# One event per line, each a complete object with the fields the viewers need
+sed -e '1d' -e '$d' trace.json | awk '
+    !/^\{"ph":"[XMi]","pid":1,"tid":[0-9]+,.*\}\}?,?$/ { print "malformed: " $0; bad = 1 }
+    /"ph":"X"/ && !/"ts":[0-9]+,"dur":[0-9]+,/ { print "untimed: " $0; bad = 1 }
+    END { exit bad }' || fail "trace events"
+for name in 'index file' 'dump tables' 'write index'; do
+    expect_eq "$(grep -c "\"name\":\"$name\"" trace.json)" 1 "'$name' events"
+done
+expect_eq "$(grep -c '"name":"table"' trace.json)" 3 "table export events"
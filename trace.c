@@ -0,0 +1,181 @@
+#include "trace.h"
+// Only compiled with the SQLINDEXER_TRACE CMake option; see trace.h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Events beyond this are dropped (and counted) to bound memory on huge inputs
+#define TRACE_MAX_EVENTS (1 << 22)
+#define TRACE_DETAIL_SIZE 112
+
+typedef struct {
+    const char *category;
+    const char *name;           // NULL for a thread name record
+    uint64_t start_us;
+    uint64_t duration_us;
+    int tid;
+    char detail[TRACE_DETAIL_SIZE];
+} TraceEvent;
+
+bool trace_enabled = false;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *trace_filename = NULL;
+static TraceEvent *trace_events = NULL;
+static size_t trace_count = 0;
+static size_t trace_capacity = 0;
+static size_t trace_dropped = 0;
+static int trace_next_tid = 1;
+static uint64_t trace_epoch_us = 0;
+static _Thread_local int trace_tid = 0;
+
+// --- Static Helper Function Declarations ---
+static uint64_t monotonic_us(void);
+static TraceEvent *append_event(void);
+static void write_json_string(FILE *fp, const char *s);
+
+// --- Function Implementations ---
+
+bool trace_start(const char *filename) {
+    pthread_mutex_lock(&trace_mutex);
+    free(trace_filename);
+    trace_filename = strdup(filename);
+    trace_epoch_us = monotonic_us();
+    trace_enabled = trace_filename != NULL;
+    pthread_mutex_unlock(&trace_mutex);
+    if (!trace_enabled) {
+        perror("Failed to start trace");
+        return false;
+    }
+    trace_set_thread_name("main");
+    return true;
+}
+
+uint64_t trace_now(void) {
+    return monotonic_us() - trace_epoch_us + 1; // Never 0, which TRACE_END treats as "not traced"
+}
+
+void trace_complete(const char *category, const char *name, uint64_t start_us, const char *detail) {
+    uint64_t end_us = trace_now();
+    pthread_mutex_lock(&trace_mutex);
+    TraceEvent *event = trace_enabled ? append_event() : NULL; // Spans still open at trace_stop are lost
+    if (event) {
+        event->category = category;
+        event->name = name;
+        event->start_us = start_us;
+        event->duration_us = end_us - start_us;
+        snprintf(event->detail, sizeof(event->detail), "%s", detail ? detail : "");
+    }
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+void trace_set_thread_name(const char *name) {
+    if (!trace_enabled) {
+        return;
+    }
+    pthread_mutex_lock(&trace_mutex);
+    TraceEvent *event = append_event();
+    if (event) {
+        event->category = "";
+        event->name = NULL;
+        event->start_us = 0;
+        event->duration_us = 0;
+        snprintf(event->detail, sizeof(event->detail), "%s", name);
+    }
+    pthread_mutex_unlock(&trace_mutex);
+}
+
+bool trace_stop(void) {
+    pthread_mutex_lock(&trace_mutex);
+    trace_enabled = false;
+    bool ok = false;
+    FILE *fp = trace_filename ? fopen(trace_filename, "w") : NULL;
+    if (!fp) {
+        perror("Error opening trace file for writing");
+    } else {
+        fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (size_t i = 0; i < trace_count; ++i) {
+            const TraceEvent *event = &trace_events[i];
+            if (event->name) {
+                fprintf(fp, "{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu,\"cat\":\"%s\",\"name\":\"%s\"",
+                        event->tid, (unsigned long long)event->start_us, (unsigned long long)event->duration_us,
+                        event->category, event->name);
+                if (event->detail[0]) {
+                    fprintf(fp, ",\"args\":{\"detail\":");
+                    write_json_string(fp, event->detail);
+                    fputc('}', fp);
+                }
+            } else {
+                fprintf(fp, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", event->tid);
+                write_json_string(fp, event->detail);
+                fputc('}', fp);
+            }
+            fprintf(fp, "}%s\n", i + 1 < trace_count ? "," : "");
+        }
+        fprintf(fp, "]}\n");
+        ok = !ferror(fp);
+        if (fclose(fp) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            perror("Error writing trace file");
+        }
+    }
+    if (trace_dropped > 0) {
+        fprintf(stderr, "Warning: Trace was truncated; %zu events were dropped.\n", trace_dropped);
+    }
+
+    free(trace_events);
+    trace_events = NULL;
+    trace_count = trace_capacity = trace_dropped = 0;
+    free(trace_filename);
+    trace_filename = NULL;
+    pthread_mutex_unlock(&trace_mutex);
+    return ok;
+}
+
+// --- Static Helper Function Implementations ---
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// Appends an event for the calling thread. Called with trace_mutex held.
+static TraceEvent *append_event(void) {
+    if (trace_count >= trace_capacity) {
+        size_t new_capacity = trace_capacity == 0 ? 1024 : trace_capacity * 2;
+        TraceEvent *new_events = new_capacity <= TRACE_MAX_EVENTS ?
+            realloc(trace_events, new_capacity * sizeof(TraceEvent)) : NULL;
+        if (!new_events) {
+            trace_dropped++;
+            return NULL;
+        }
+        trace_events = new_events;
+        trace_capacity = new_capacity;
+    }
+    if (trace_tid == 0) {
+        trace_tid = trace_next_tid++;
+    }
+    TraceEvent *event = &trace_events[trace_count++];
+    event->tid = trace_tid;
+    return event;
+}
+
+static void write_json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(fp, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        } else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// --- Chrome Trace Events ---
+// Records timed spans (reads, scan blocks, column parsing, hashing, index
+// I/O, exports) per thread and writes them in Chrome trace format, which
+// chrome://tracing and Perfetto open directly. Built only when
+// SQLINDEXER_TRACE is defined (CMake option SQLINDEXER_TRACE); otherwise the
+// macros below expand to nothing. At run time a span costs one branch until
+// trace_start is called.
+//
+//   TRACE_BEGIN(t0);
+//   ... work ...
+//   TRACE_END(t0, "scan", "read", NULL);   // category, name, optional detail
+
+#ifdef SQLINDEXER_TRACE
+
+extern bool trace_enabled;
+
+// Starts recording; the file is written by trace_stop
+bool trace_start(const char *filename);
+// Writes the trace file and stops recording. Returns false on write errors.
+bool trace_stop(void);
+// Microseconds on the trace clock
+uint64_t trace_now(void);
+// Records a span from start_us until now. `category` and `name` must be
+// string literals; `detail` is copied and shown under the event's args.
+void trace_complete(const char *category, const char *name, uint64_t start_us, const char *detail);
+// Names the calling thread in the viewer, e.g. "worker 3"
+void trace_set_thread_name(const char *name);
+
+#define TRACE_BEGIN(t) uint64_t t = trace_enabled ? trace_now() : 0
+#define TRACE_END(t, category, name, detail) \
+    do { if (t) trace_complete(category, name, t, detail); } while (0)
+
+#else
+
+#define TRACE_BEGIN(t) ((void)0)
+#define TRACE_END(t, category, name, detail) ((void)0)
+
+#endif // SQLINDEXER_TRACE
+
+#endif // TRACE_H
@@ -0,0 +1,229 @@
+#include "work_pool.h"
+#include "trace.h"
+#include "mem_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Worker identity of the calling thread
+static _Thread_local WorkPool *current_pool = NULL;
+static _Thread_local int current_worker = -1;
+
+// --- Static Helper Function Declarations ---
+static void *worker_main(void *arg);
+static bool take_task(WorkPool *pool, int worker, WorkTask *task);
+static bool deque_push(WorkDeque *deque, WorkTask task);
+static bool deque_pop_newest(WorkDeque *deque, WorkTask *task);
+static bool deque_pop_oldest(WorkDeque *deque, WorkTask *task);
+
+// --- Function Implementations ---
+
+bool work_pool_start(WorkPool *pool, int worker_count) {
+    memset(pool, 0, sizeof(*pool));
+    if (worker_count < 1) {
+        worker_count = 1;
+    }
+    pool->threads = mem_calloc(MEM_OTHER, (size_t)worker_count, sizeof(pthread_t));
+    pool->deques = mem_calloc(MEM_OTHER, (size_t)worker_count, sizeof(WorkDeque));
+    if (!pool->threads || !pool->deques) {
+        perror("Failed to allocate worker pool");
+        free(pool->threads);
+        free(pool->deques);
+        return false;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+    for (int i = 0; i < worker_count; ++i) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+
+    for (int i = 0; i < worker_count; ++i) {
+        int err = pthread_create(&pool->threads[i], NULL, worker_main, pool);
+        if (err != 0) {
+            fprintf(stderr, "Error starting worker thread: %s\n", strerror(err));
+            break; // Run with the workers we have
+        }
+        pool->worker_count = i + 1;
+    }
+    // Deques past worker_count are never used
+    for (int i = pool->worker_count; i < worker_count; ++i) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    if (pool->worker_count == 0) {
+        work_pool_stop(pool);
+        return false;
+    }
+    return true;
+}
+
+bool work_pool_submit(WorkPool *pool, WorkTaskFn fn, void *arg) {
+    WorkTask task = {fn, arg};
+    int target = current_pool == pool ? current_worker : -1;
+
+    pthread_mutex_lock(&pool->lock);
+    // Both counted before the push, so a fast worker cannot take or finish
+    // the task before it is counted
+    pool->pending++;
+    pool->queued++;
+    if (target < 0) {
+        target = (int)(pool->next_deque++ % (size_t)pool->worker_count);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!deque_push(&pool->deques[target], task)) {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->all_done);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return false;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+void work_pool_wait(WorkPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void work_pool_stop(WorkPool *pool) {
+    work_pool_wait(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->worker_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->worker_count; ++i) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_cond_destroy(&pool->all_done);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->deques);
+    free(pool->threads);
+    pool->deques = NULL;
+    pool->threads = NULL;
+}
+
+int work_pool_current_worker(void) {
+    return current_worker;
+}
+
+// --- Static Helper Function Implementations ---
+
+static void *worker_main(void *arg) {
+    WorkPool *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    int worker = pool->started++;
+    pthread_mutex_unlock(&pool->lock);
+    current_pool = pool;
+    current_worker = worker;
+#ifdef SQLINDEXER_TRACE
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", worker);
+    trace_set_thread_name(name);
+#endif
+
+    while (true) {
+        WorkTask task;
+        if (take_task(pool, worker, &task)) {
+            task.fn(task.arg);
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0) {
+                pthread_cond_broadcast(&pool->all_done);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        // Nothing to run or steal: sleep until a task is queued
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+        }
+        bool stop = pool->stopping && pool->queued == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Own deque first (newest task), then the other deques in turn (oldest task)
+static bool take_task(WorkPool *pool, int worker, WorkTask *task) {
+    bool stolen = false;
+    bool found = deque_pop_newest(&pool->deques[worker], task);
+    for (int i = 1; !found && i < pool->worker_count; ++i) {
+        found = stolen = deque_pop_oldest(&pool->deques[(worker + i) % pool->worker_count], task);
+    }
+    if (found) {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        if (stolen) {
+            pool->steals++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return found;
+}
+
+static bool deque_push(WorkDeque *deque, WorkTask task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        size_t new_capacity = deque->capacity == 0 ? 16 : deque->capacity * 2;
+        WorkTask *new_tasks = mem_malloc(MEM_OTHER, new_capacity * sizeof(WorkTask));
+        if (!new_tasks) {
+            pthread_mutex_unlock(&deque->lock);
+            perror("Failed to grow worker task queue");
+            return false;
+        }
+        // Unwrap the ring into the new array
+        for (size_t i = 0; i < deque->count; ++i) {
+            new_tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = new_tasks;
+        deque->capacity = new_capacity;
+        deque->head = 0;
+    }
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+    return true;
+}
+
+static bool deque_pop_newest(WorkDeque *deque, WorkTask *task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->count > 0;
+    if (found) {
+        deque->count--;
+        *task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool deque_pop_oldest(WorkDeque *deque, WorkTask *task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->count > 0;
+    if (found) {
+        *task = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
@@ -0,0 +1,64 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// --- Work-Stealing Thread Pool ---
+// Every worker owns a deque of tasks. It runs its newest task first and,
+// once its deque is empty, steals the oldest task of another worker. Tasks
+// a task submits (e.g. the pieces of a large table) go to the submitting
+// worker's own deque, so they stay local unless another worker is idle.
+// Tasks are expected to be coarse (milliseconds or more); the deques are
+// guarded by plain mutexes.
+
+typedef void (*WorkTaskFn)(void *arg);
+
+typedef struct {
+    WorkTaskFn fn;
+    void *arg;
+} WorkTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    WorkTask *tasks;            // Ring buffer
+    size_t head;                // Oldest task; thieves take from here
+    size_t count;
+    size_t capacity;
+} WorkDeque;
+
+typedef struct WorkPool {
+    pthread_t *threads;
+    WorkDeque *deques;          // One per worker
+    int worker_count;
+    int started;                // Workers that have claimed their index
+    pthread_mutex_t lock;       // Guards the counters below
+    pthread_cond_t work_available;
+    pthread_cond_t all_done;
+    size_t queued;              // Tasks sitting in deques
+    size_t pending;             // Tasks submitted and not yet finished
+    size_t next_deque;          // Round robin for submissions from other threads
+    uint64_t steals;            // Tasks run by a worker other than the one they were queued on
+    bool stopping;
+} WorkPool;
+
+// --- Function Declarations ---
+
+// Starts worker_count threads (at least one)
+bool work_pool_start(WorkPool *pool, int worker_count);
+
+// Queues fn(arg). Safe to call from any thread, including from a task.
+bool work_pool_submit(WorkPool *pool, WorkTaskFn fn, void *arg);
+
+// Blocks until every submitted task, and every task those submitted, has finished
+void work_pool_wait(WorkPool *pool);
+
+// Waits for the remaining tasks, then joins the workers and frees the pool
+void work_pool_stop(WorkPool *pool);
+
+// Index of the calling worker thread, or -1 outside the pool
+int work_pool_current_worker(void);
+
+#endif // WORK_POOL_H